@@ -0,0 +1,78 @@
+# 0 "kernel/entry.S"
+# 0 "<built-in>"
+# 0 "<command-line>"
+# 1 "/usr/include/stdc-predef.h" 1 3 4
+# 0 "<command-line>" 2
+# 1 "kernel/entry.S"
+# The xv6 kernel starts executing in this file. This file is linked with
+# the kernel C code, so it can refer to kernel symbols such as main().
+# The boot block (bootasm.S and bootmain.c) jumps to entry below.
+
+# Multiboot header, for multiboot boot loaders like GNU Grub.
+# http:
+
+# Using GRUB 2, you can boot xv6 from a file stored in a
+# Linux file system by copying kernel or kernelmemfs to /boot
+# and then adding this menu entry:
+
+# menuentry "xv6" {
+# insmod ext2
+# set root='(hd0,msdos1)'
+# set kernel='/boot/kernel'
+# echo "Loading ${kernel}..."
+# multiboot ${kernel} ${kernel}
+# boot
+# }
+
+# 1 "kernel/asm.h" 1
+# 22 "kernel/entry.S" 2
+# 1 "kernel/memlayout.h" 1
+# 23 "kernel/entry.S" 2
+# 1 "kernel/mmu.h" 1
+# 24 "kernel/entry.S" 2
+# 1 "include/param.h" 1
+# 25 "kernel/entry.S" 2
+
+# Multiboot header. Data to direct multiboot loader.
+.p2align 2
+.text
+.globl multiboot_header
+multiboot_header:
+
+
+  .long 0x1badb002
+  .long 0
+  .long (-0x1badb002 -0)
+
+# By convention, the _start symbol specifies the ELF entry point.
+# Since we haven't set up virtual memory yet, our entry point is
+# the physical address of 'entry'.
+.globl _start
+_start = ((entry) - 0x80000000)
+
+ # Entering xv6 on boot processor, with paging off.
+.globl entry
+entry:
+  # Turn on page size extension for 4Mbyte pages
+  movl %cr4, %eax
+  orl $(0x00000010), %eax
+  movl %eax, %cr4
+  # Set page directory
+  movl $(((entrypgdir) - 0x80000000)), %eax
+  movl %eax, %cr3
+  # Turn on paging.
+  movl %cr0, %eax
+  orl $(0x80000000|0x00010000), %eax
+  movl %eax, %cr0
+
+  # Set up the stack pointer.
+  movl $(stack + 4096), %esp
+
+  # Jump to main(), and switch to executing at
+  # high addresses. The indirect call is needed because
+  # the assembler produces a PC-relative instruction
+  # for a direct jump.
+  mov $main, %eax
+  jmp *%eax
+
+.comm stack, 4096
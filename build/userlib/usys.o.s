@@ -0,0 +1,41 @@
+# 0 "user/lib/usys.S"
+# 0 "<built-in>"
+# 0 "<command-line>"
+# 1 "/usr/include/stdc-predef.h" 1 3 4
+# 0 "<command-line>" 2
+# 1 "user/lib/usys.S"
+# 1 "include/syscall.h" 1
+# 2 "user/lib/usys.S" 2
+# 1 "include/traps.h" 1
+# 3 "user/lib/usys.S" 2
+# 11 "user/lib/usys.S"
+.globl fork; fork: movl $1, %eax; int $64; ret
+.globl exit; exit: movl $2, %eax; int $64; ret
+.globl wait; wait: movl $3, %eax; int $64; ret
+.globl pipe; pipe: movl $4, %eax; int $64; ret
+.globl read; read: movl $5, %eax; int $64; ret
+.globl write; write: movl $16, %eax; int $64; ret
+.globl close; close: movl $21, %eax; int $64; ret
+.globl kill; kill: movl $6, %eax; int $64; ret
+.globl exec; exec: movl $7, %eax; int $64; ret
+.globl open; open: movl $15, %eax; int $64; ret
+.globl mknod; mknod: movl $17, %eax; int $64; ret
+.globl unlink; unlink: movl $18, %eax; int $64; ret
+.globl fstat; fstat: movl $8, %eax; int $64; ret
+.globl link; link: movl $19, %eax; int $64; ret
+.globl mkdir; mkdir: movl $20, %eax; int $64; ret
+.globl chdir; chdir: movl $9, %eax; int $64; ret
+.globl dup; dup: movl $10, %eax; int $64; ret
+.globl getpid; getpid: movl $11, %eax; int $64; ret
+.globl sbrk; sbrk: movl $12, %eax; int $64; ret
+.globl sleep; sleep: movl $13, %eax; int $64; ret
+.globl uptime; uptime: movl $14, %eax; int $64; ret
+.globl mount; mount: movl $22, %eax; int $64; ret
+.globl umount; umount: movl $23, %eax; int $64; ret
+.globl unshare; unshare: movl $24, %eax; int $64; ret
+.globl usleep; usleep: movl $25, %eax; int $64; ret
+.globl ioctl; ioctl: movl $26, %eax; int $64; ret
+.globl getppid; getppid: movl $27, %eax; int $64; ret
+.globl getcpu; getcpu: movl $28, %eax; int $64; ret
+.globl pivot_root; pivot_root: movl $29, %eax; int $64; ret
+.globl fsync; fsync: movl $30, %eax; int $64; ret
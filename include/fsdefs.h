@@ -24,9 +24,13 @@ struct native_superblock {
   uint ninodes;     // Number of inodes.
 };
 
-#define NDIRECT 12
+// A file has NDIRECT direct blocks, followed by the blocks of a single, a
+// double and a triple indirect block tree.
+#define NDIRECT 10
 #define NINDIRECT (BSIZE / sizeof(uint))
-#define MAXFILE (NDIRECT + NINDIRECT)
+#define NDINDIRECT (NINDIRECT * NINDIRECT)
+#define NTINDIRECT (NDINDIRECT * NINDIRECT)
+#define MAXFILE (NDIRECT + NINDIRECT + NDINDIRECT + NTINDIRECT)
 
 // Base structure for on-disk inode.
 // this structure is used to save common details about inode
@@ -44,7 +48,7 @@ struct base_dinode {
 struct native_dinode {
   struct base_dinode base_dinode;
   uint size;                // Size of file (bytes)
-  uint addrs[NDIRECT + 1];  // Data block addresses
+  uint addrs[NDIRECT + 3];  // Data and indirect block addresses
 };
 
 // Inodes per block.
@@ -68,4 +72,75 @@ struct dirent {
   char name[DIRSIZ];
 };
 
+// Object file system on-disk format.
+// The super block is located at offset 0 of the device and the objects table
+// right after it. The rest of the device, from `store_offset`, is the store
+// holding the objects data. Offsets and sizes are in bytes.
+
+#define OBJ_FS_MAGIC 0x6f626a73  // "objs"
+
+#define MAX_OBJECT_NAME_LENGTH 20
+#define SUPER_BLOCK_ID "\x01"
+#define OBJECT_TABLE_ID "\x02"
+
+// In the future, this can be set the size of SHA256 digest.
+#define OBJECT_ID_LENGTH MAX_OBJECT_NAME_LENGTH
+
+// The object table is of variable size.
+// However, this is its default initial size.
+// During the creation and deletion of files
+// this table can grow in otder to index many files,
+// Or shrink, making room for content storage.
+#define INITIAL_OBJECT_TABLE_SIZE 200
+
+struct objsuperblock {
+  uint magic;  // Must be OBJ_FS_MAGIC
+  uint storage_device_size;
+  uint objects_table_offset;
+  // the last inode added
+  uint last_inode;
+  // variables to trace the file-system state
+  uint bytes_occupied;
+  uint occupied_objects;
+  // determines the limit between object table space and the store itself
+  uint store_offset;
+  uint flags;  // OBJ_FS_* flags
+  // the bytes objects share with identical objects, instead of occupying them
+  uint shared_bytes;
+  // Objects written by a clone of the store are stamped with the generation
+  // of the clone, which is the one of the snapshot it was cloned from plus 1.
+  uint generation;
+};
+
+// Identical objects share their content.
+#define OBJ_FS_DEDUP 0x1
+// Small objects are written compressed.
+#define OBJ_FS_COMPRESS 0x2
+
+// The codecs of the objects content.
+#define OBJ_CODEC_NONE 0
+#define OBJ_CODEC_LZ 1
+
+typedef struct objects_table_entry {
+  /*
+   * If the object's name is exactly `MAX_OBJECT_NAME_LENGTH` we don't store
+   * the null terminator.
+   */
+  char object_id[OBJECT_ID_LENGTH];
+  uint disk_offset;
+  uint size;
+  int occupied;
+  // Content deduplication. An object either holds its content, or shares the
+  // content held by another object.
+  uint content_hash;
+  uint shared_with;  // index + 1 of the entry holding the content, or 0
+  uint refs;         // the amount of objects sharing the content of this one
+  // The content of a compressed object takes `size` bytes in the store, and
+  // `raw_size` bytes once decompressed.
+  uint codec;  // OBJ_CODEC_*
+  uint raw_size;
+  uint generation;  // the store generation the object was written in
+  uint checksum;    // CRC32C of the content in the store
+} objects_table_entry;
+
 #endif /* XV6_FSDEFS_H */
@@ -12,11 +12,14 @@
 #define MAX_TTY 4                  // maximum minor tty number
 #define ROOTDEV 1                  // device number of file system root disk
 #define MAXARG 32                  // max exec arguments
-#define MAXOPBLOCKS 10             // max # of blocks any FS op writes
-#define LOGSIZE (MAXOPBLOCKS * 3)  // max data blocks in on-disk log
-#define NBUF 200                   // size of system disks block cache
-#define FSSIZE 3600                // size of file system in blocks
+#define MAXOPBLOCKS 12             // max # of blocks any FS op writes
+#define LOGSIZE (MAXOPBLOCKS * 6)  // max data blocks in on-disk log
+#define NOPLOGS 4                  // max # of fs logs any FS op joins
+#define NBUF 200                   // disks block cache buffers always held
+#define NBUF_MAX 3072              // maximum disks block cache buffers
+#define FSSIZE 16384               // size of file system in blocks
 #define INT_FSSIZE 180             // size of internal file systems in blocks
+#define OBJFS_SIZE 4096            // size of obj-fs images in blocks
 #define NNAMESPACE 20              // maximum number of namespaces
 #define MAX_PATH_LENGTH 512        // maximum path length allowed
 #define MAX_CGROUP_FILE_NAME_LENGTH \
@@ -1,5 +1,6 @@
 #include "cgroup.h"
 
+#include "device/buf_cache.h"
 #include "fs/cgfs.h"
 #include "memlayout.h"
 #include "spinlock.h"
@@ -220,6 +221,9 @@ result_code cgroup_delete(char* path, char* type) {
 
   if (cgp != cgroup_root() && cgp->mem_controller_enabled) set_min_mem(cgp, 0);
 
+  /*Uncharge the cached blocks of the cgroup, so none refers to it.*/
+  if (cgp != cgroup_root()) buf_cache_forget_cgroup(cgp);
+
   /*Delete the path.*/
   *(cgp->cgroup_dir_path) = '\0';
 
@@ -321,6 +325,7 @@ void cgroup_initialize(struct cgroup* cgroup, char* path,
   // By default a group is not frozen
   frz_grp(cgroup, 0);
 
+  cgroup->mem_stat_file = 0;
   cgroup->mem_stat_file_dirty = 0;
   cgroup->mem_stat_file_dirty_aggregated = 0;
   cgroup->mem_stat_pgfault = 0;
@@ -370,9 +375,13 @@ result_code unsafe_cgroup_insert(struct cgroup* cgroup, struct proc* proc) {
     return RESULT_ERROR;
 
   // If the process memory in addition to existing memory is over the limit and
-  // memory controller is enabled, return error.
-  if (cgroup->mem_controller_enabled == 1 &&
-      (cgroup->current_mem + proc->sz) > cgroup->max_mem) {
+  // memory controller is enabled, reclaim the cached blocks of the cgroup, or
+  // return error.
+  if (cgroup_mem_over_max(cgroup, proc->sz)) {
+    buf_cache_reclaim(cgroup,
+                      cgroup->current_mem + proc->sz - cgroup->max_mem);
+  }
+  if (cgroup_mem_over_max(cgroup, proc->sz)) {
     cgroup_incr_mem_failcnt(cgroup);
     return RESULT_ERROR;
   }
@@ -851,6 +860,10 @@ result_code set_max_mem(struct cgroup* cgroup, unsigned int limit) {
   // 0 is used for testing.
   if (limit >= 0 && limit <= KERNBASE && limit >= cgroup->min_mem) {
     cgroup->max_mem = limit;
+    // Reclaim the cached blocks of the cgroup over the new limit.
+    if (cgroup_mem_over_max(cgroup, 0)) {
+      buf_cache_reclaim(cgroup, cgroup->current_mem - limit);
+    }
     return RESULT_SUCCESS_OPERATION;
   }
 
@@ -967,6 +980,23 @@ result_code disable_mem_controller(struct cgroup* cgroup) {
   return res;
 }
 
+// The root cgroup is not charged, like its stats are not counted. The cache
+// charges blocks without the cgroup table lock, so the counters are updated
+// atomically.
+void cgroup_mem_charge_file(struct cgroup* cgroup) {
+  for (; cgroup != 0 && cgroup != cgroup_root(); cgroup = cgroup->parent) {
+    __sync_fetch_and_add(&cgroup->current_mem, BSIZE);
+    __sync_fetch_and_add(&cgroup->mem_stat_file, BSIZE);
+  }
+}
+
+void cgroup_mem_uncharge_file(struct cgroup* cgroup) {
+  for (; cgroup != 0 && cgroup != cgroup_root(); cgroup = cgroup->parent) {
+    __sync_fetch_and_sub(&cgroup->current_mem, BSIZE);
+    __sync_fetch_and_sub(&cgroup->mem_stat_file, BSIZE);
+  }
+}
+
 void cgroup_mem_stat_file_dirty_incr(struct cgroup* cgroup) {
   if (cgroup != cgroup_root() && cgroup != 0 && cgroup->populated == 1) {
     cgroup->mem_stat_file_dirty++;
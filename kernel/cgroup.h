@@ -117,6 +117,9 @@ struct cgroup {
   unsigned int current_mem;
   /* The current amount of memory used by the group in pages. */
   unsigned int current_page;
+  /* Amount of cached filesystem data charged to the group, in bytes. Counted
+   * in current_mem too. */
+  unsigned int mem_stat_file;
   /* Amount of cached filesystem data that was modified
    * but not yet written back to disk. */
   unsigned int mem_stat_file_dirty;
@@ -565,6 +568,22 @@ result_code enable_mem_controller(struct cgroup* cgroup);
 result_code unsafe_disable_mem_controller(struct cgroup* cgroup);
 result_code disable_mem_controller(struct cgroup* cgroup);
 
+/**
+ * @brief Charges a block of the buffer cache to the cgroup and its ancestors,
+ * in their current_mem and file stat. Does nothing if the cgroup is 0.
+ *
+ * @param cgroup pointer to a cgroup
+ */
+void cgroup_mem_charge_file(struct cgroup* cgroup);
+
+/**
+ * @brief Uncharges a block of the buffer cache charged by
+ * cgroup_mem_charge_file.
+ *
+ * @param cgroup pointer to a cgroup
+ */
+void cgroup_mem_uncharge_file(struct cgroup* cgroup);
+
 /**
  * @brief Increments the cgroup Memory Controller stat of file_dirty
  *
@@ -652,4 +671,16 @@ static inline int cgroup_incr_mem_failcnt(struct cgroup* cgroup) {
   return 1;
 }
 
+/**
+ * @brief Returns whether using n more bytes takes the cgroup over its memory
+ * limit, given its memory controller is enabled.
+ *
+ * @param cgroup pointer to cgroup, or 0
+ * @param n amount of bytes
+ */
+static inline int cgroup_mem_over_max(struct cgroup* cgroup, unsigned int n) {
+  return cgroup != 0 && cgroup->mem_controller_enabled &&
+         cgroup->current_mem + n > cgroup->max_mem;
+}
+
 #endif /* XV6_CGROUP_H */
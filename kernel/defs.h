@@ -7,6 +7,7 @@ struct buf;
 union buf_id;
 struct context;
 struct file;
+struct log;
 // struct native_inode;
 struct mount;
 struct mount_list;
@@ -17,6 +18,7 @@ struct proc;
 struct rtcdate;
 struct spinlock;
 struct sleeplock;
+struct rwsleeplock;
 struct stat;
 // struct native_superblock;
 struct cgroup;
@@ -75,7 +77,7 @@ void sbdup(struct vfs_superblock* sb);
 void sbput(struct vfs_superblock* sb);
 
 // sysmount.c
-int handle_objfs_mounts();
+int handle_objfs_mounts(bool clone);
 int handle_cgroup_mounts();
 int handle_proc_mounts();
 int handle_bind_mounts();
@@ -113,6 +115,7 @@ uint get_total_memory();
 
 // kvector.c
 vector newvector(unsigned int, unsigned int);
+vector vectorofbuffer(char*, unsigned int, unsigned int);
 void freevector(vector*);
 uint setelement(vector, unsigned int, char*);
 char* getelementpointer(const vector, unsigned int);
@@ -137,11 +140,15 @@ void lapicinit(void);
 void lapicstartap(uchar, uint);
 void microdelay(int);
 
-// log.c
+// native_log.c
+void loginit(void);
 void initlog(struct vfs_superblock*);
-void log_write(struct buf*);
+void log_join(struct log*);
+void log_write(struct log*, struct buf*);
 void begin_op();
 void end_op();
+void log_sync(struct log*);
+void log_destroy(struct log*);
 
 // mount_ns.c
 void mount_nsinit(void);
@@ -178,6 +185,7 @@ int cpuid(void);
 void exit(int);
 int fork(void);
 int growproc(int);
+void kthread_create(char*, void (*)(void));
 #ifndef HOST_TESTS
 int kill(int);
 #endif
@@ -203,6 +211,12 @@ void acquiresleep(struct sleeplock*);
 void releasesleep(struct sleeplock*);
 int holdingsleep(struct sleeplock*);
 void initsleeplock(struct sleeplock*, char*);
+void acquirereadsleep(struct rwsleeplock*);
+void releasereadsleep(struct rwsleeplock*);
+void acquirewritesleep(struct rwsleeplock*);
+void releasewritesleep(struct rwsleeplock*);
+int holdingrwsleep(struct rwsleeplock*);
+void initrwsleeplock(struct rwsleeplock*, char*);
 
 // When running host tests we use the host's libc which
 // presents a bit different string method signatures.
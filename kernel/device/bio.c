@@ -8,6 +8,8 @@
 // Interface:
 // * To get a buffer for a particular disk block, call bread.
 // * After changing buffer data, call bwrite to write it to disk.
+// * bread_multi and bwrite_multi do the same for up to
+//     BIO_MULTI_MAX blocks of a device, in one batch of disk IO.
 // * When done with the buffer, call brelse.
 // * Do not use the buffer after calling brelse.
 // * Only one process at a time can use a buffer,
@@ -32,12 +34,19 @@
 static void devicerw(struct vfs_inode *const vfs_inode, struct buf *const b) {
   if ((b->flags & B_DIRTY) == 0) {
     vector read_result_vector;
-    read_result_vector = newvector(BSIZE, 1);
-    vfs_inode->i_op->readi(vfs_inode, BSIZE * b->id.blockno, BSIZE,
-                           &read_result_vector);
-    memmove_from_vector((char *)b->data, read_result_vector, 0, BSIZE);
-    // vectormemcmp("devicerw", read_result_vector, 0, (char *) b->data, BSIZE);
+    read_result_vector = vectorofbuffer((char *)b->data, BSIZE, 1);
+    int read_result = vfs_inode->i_op->readi(
+        vfs_inode, BSIZE * b->id.blockno, BSIZE, &read_result_vector);
     freevector(&read_result_vector);
+    // The block past the end of the backing file reads as zeros.
+    if (read_result < 0) read_result = 0;
+    if (read_result < BSIZE)
+      memset(b->data + read_result, 0, BSIZE - read_result);
+  } else if (vfs_inode->i_op->overwritei) {
+    // The file system on the loop device journals the block.
+    if (vfs_inode->i_op->overwritei(vfs_inode, (char *)b->data,
+                                    BSIZE * b->id.blockno, BSIZE) != BSIZE)
+      panic("devicerw: write past the backing file");
   } else {
     vfs_inode->i_op->writei(vfs_inode, (char *)b->data, BSIZE * b->id.blockno,
                             BSIZE);
@@ -56,6 +65,22 @@ static void brw(struct buf *const b) {
   }
 }
 
+// Sync n bufs of a device with disk, as one batch.
+static void brw_multi(struct buf *const *const bufs, const uint n) {
+  uint i;
+
+  if (n == 0) return;
+  for (i = 1; i < n; i++) {
+    if (bufs[i]->dev != bufs[0]->dev) panic("brw_multi: mixed devices");
+  }
+  // Loop devices go through their backing inode, a block at a time.
+  if (getinodefordevice(bufs[0]->dev) != 0) {
+    for (i = 0; i < n; i++) brw(bufs[i]);
+  } else {
+    iderw_multi(bufs, n);
+  }
+}
+
 // Return a locked buf with the contents of the indicated block.
 struct buf *bread(const struct device *const dev, const uint blockno) {
   struct buf *b;
@@ -75,5 +100,51 @@ void bwrite(struct buf *const b) {
   brw(b);
 }
 
+// Fill bufs[i] with a locked buf with the contents of block
+// blocknos[i], for n distinct blocks of dev.
+// The bufs are locked in increasing block order, so that two
+// batches never wait for each other, and the blocks missing
+// from the cache are read in one batch.
+void bread_multi(const struct device *const dev, const uint *const blocknos,
+                 const uint n, struct buf **const bufs) {
+  uint order[BIO_MULTI_MAX];
+  struct buf *missing[BIO_MULTI_MAX];
+  uint i, j, nmissing = 0;
+
+  if (n > BIO_MULTI_MAX) panic("bread_multi: too many blocks");
+
+  // Sort the indexes of the blocks by block number.
+  for (i = 0; i < n; i++) {
+    for (j = i; j > 0 && blocknos[order[j - 1]] > blocknos[i]; j--) {
+      order[j] = order[j - 1];
+    }
+    order[j] = i;
+  }
+
+  for (i = 0; i < n; i++) {
+    const uint k = order[i];
+    union buf_id id = {.blockno = blocknos[k]};
+
+    if (i > 0 && blocknos[order[i - 1]] == blocknos[k])
+      panic("bread_multi: duplicate block");
+    bufs[k] = buf_cache_get(dev, &id, 0);
+    if ((bufs[k]->flags & B_VALID) == 0) missing[nmissing++] = bufs[k];
+  }
+  brw_multi(missing, nmissing);
+}
+
+// Write the contents of n locked bufs of a device to disk,
+// as one batch.
+void bwrite_multi(struct buf *const *const bufs, const uint n) {
+  uint i;
+
+  if (n > BIO_MULTI_MAX) panic("bwrite_multi: too many blocks");
+  for (i = 0; i < n; i++) {
+    if (!holdingsleep(&bufs[i]->lock)) panic("bwrite_multi");
+    bufs[i]->flags |= B_DIRTY;
+  }
+  brw_multi(bufs, n);
+}
+
 // PAGEBREAK!
 //  Blank page.
@@ -4,7 +4,13 @@
 #include "buf.h"
 #include "device.h"
 
+// The most blocks bread_multi and bwrite_multi take at once.
+#define BIO_MULTI_MAX 8
+
 struct buf* bread(const struct device* const, uint);
 void bwrite(struct buf*);
+void bread_multi(const struct device* const, const uint*, uint,
+                 struct buf**);
+void bwrite_multi(struct buf* const*, uint);
 
 #endif  // XV6_DEVICE_BIO_H
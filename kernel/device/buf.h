@@ -29,9 +29,13 @@ struct buf {
   union buf_id id;
   struct sleeplock lock;
   uint refcnt;
-  struct buf *prev;  // LRU cache list
+  uint referenced;   // used since the cache CLOCK hand passed it
+  uint cold;         // in the cold queue of the 2Q cache policy
+  uint shard;        // index of the cache shard holding it
+  struct buf *prev;  // cache shard ring or cold queue
   struct buf *next;
   struct buf *qnext;  // disk queue
+  struct buf *hnext;  // hash bucket of the cache shard
   struct cgroup *cgroup;
   uchar data[BUF_DATA_SIZE];
 };
@@ -39,9 +43,12 @@ struct buf {
 enum B_FLAGS_SHIFT {
   B_VALID_SHIFT = 1,
   B_DIRTY_SHIFT = 2,
+  B_READAHEAD_SHIFT = 3,
 };
 
 #define B_VALID (1 << B_VALID_SHIFT)  // buffer has been read from disk
 #define B_DIRTY (1 << B_DIRTY_SHIFT)  // buffer needs to be written to disk
+// buffer was read ahead of a reader, and was not read yet
+#define B_READAHEAD (1 << B_READAHEAD_SHIFT)
 
 #endif /* XV6_DEVICE_BUF_H */
@@ -2,52 +2,514 @@
 
 #include "buf.h"
 #include "cgroup.h"
+#include "mmu.h"
 #include "param.h"
 
-struct {
+// The cache is split into shards by the hash of the blocks, so lookups of
+// different blocks mostly take different locks. A buf with an identity is in
+// the shard of its hash. Each shard recycles its bufs by the cache policy, and
+// takes a buf of another shard when all of its bufs are in use.
+//
+// Bufs without a block are at the head of the cold queue of the shard, and
+// are recycled first.
+//
+// CLOCK keeps the bufs with a block in a ring, and recycles the first buf
+// which was not used since the hand passed it.
+//
+// 2Q resists scans: a block missing from the cache is put in a cold FIFO
+// queue, where further hits don't keep it. Blocks recycled from the cold
+// queue are remembered as ghosts, and a ghost block missing again is put in
+// the CLOCK ring, now the hot queue. The cold queue is recycled first once it
+// holds a quarter of the bufs, so a single pass over many blocks only cycles
+// through the cold queue.
+//
+// The cache always holds NBUF static bufs. It grows by kalloc pages of bufs up
+// to its max limit while the free memory is plentiful, and frees pages whose
+// bufs are not in use when the memory runs low, down to its min limit. When
+// all the bufs are in use, lookups wait for one to be released.
+//
+// A buf with a block is charged to the cgroup which missed it, or which made
+// it dirty. A cgroup over its memory limit recycles its own bufs before the
+// bufs of anyone else, so its misses don't evict the blocks of other cgroups.
+#define BUF_CACHE_SHARDS NCPU
+// A prime, so the shards buckets hold about a buf each.
+#define BUF_CACHE_BUCKETS 37
+
+struct buf_cache_shard {
   struct spinlock lock;
-  struct buf buf[NBUF];
 
-  // Linked list of all buffers, through prev/next.
-  // head.next is most recently used.
+  // Ring of the bufs of the shard, through prev/next.
   struct buf head;
+  // The next buf the CLOCK examines, or head.
+  struct buf *hand;
+  // The bufs of the shard, in the ring and in the cold queue.
+  uint count;
+
+  // 2Q cold queue, oldest first, through prev/next.
+  struct buf cold;
+  uint cold_count;
+  // Hashes of the blocks last recycled from the cold queue, about as many
+  // as the shard holds.
+  uint *ghosts;
+  uint ghosts_count;
+  uint ghost_next;
+
+  // The bufs with an identity, hashed by their device and id, through hnext.
+  struct buf *buckets[BUF_CACHE_BUCKETS];
 
   // Whether buffers are cached upon release, or invalidated immediately.
-  // Used mostly for performance measurements.
+  // Used mostly for performance measurements. The same in all the shards.
   uint is_cache_enabled;
+  // The same in all the shards.
+  uint policy;
+
+  // Lookups that found the block cached, and that did not, by policy.
+  uint hits[BUF_CACHE_POLICIES];
+  uint misses[BUF_CACHE_POLICIES];
+  // Bufs which were read ahead and recycled before anyone read them.
+  uint readahead_evictions;
+};
+
+#define BUF_CACHE_PAGE_BUFS (PGSIZE / sizeof(struct buf))
+#define BUF_CACHE_PAGES ((NBUF_MAX - NBUF) / BUF_CACHE_PAGE_BUFS)
+
+struct {
+  struct buf buf[NBUF];
+  struct buf_cache_shard shards[BUF_CACHE_SHARDS];
+  // The shards in use, BUF_CACHE_SHARDS unless tests pin fewer.
+  uint shards_count;
+  // The ghosts of all the shards.
+  uint ghosts[NBUF];
+
+  // Taken before any shard lock.
+  struct spinlock lock;
+  // The amount of bufs, and its limits.
+  uint size;
+  uint min;
+  uint max;
+  // The kalloc pages of bufs.
+  char *pages[BUF_CACHE_PAGES];
+  uint pages_count;
+  // Lookups waiting for a buf to be released, and the amount of releases
+  // they were woken up by.
+  uint waiters;
+  uint releases;
 } bufs_cache;
 
-void buf_cache_init(void) {
-  struct buf *b;
+// Hashes the device and id by FNV-1a. The low bits of FNV-1a depend only on
+// the low bits of the bytes, so the high bits are folded into them.
+static uint buf_cache_hash(const struct device *const dev,
+                           const union buf_id *id) {
+  const uchar *bytes = (const uchar *)id;
+  uint hash = 2166136261u ^ (uint)(ulong)dev;
+
+  hash *= 16777619u;
+  for (uint i = 0; i < sizeof(*id); i++) {
+    hash ^= bytes[i];
+    hash *= 16777619u;
+  }
+  return hash ^ (hash >> 16);
+}
+
+static struct buf_cache_shard *buf_cache_shard(uint hash) {
+  return &bufs_cache.shards[hash % bufs_cache.shards_count];
+}
+
+static struct buf **buf_cache_bucket(struct buf_cache_shard *shard,
+                                     uint hash) {
+  return &shard->buckets[(hash / bufs_cache.shards_count) % BUF_CACHE_BUCKETS];
+}
+
+// Inserts the buf to the ring of the shard, just behind the hand, so it is
+// examined last.
+// Must be called with shard->lock held.
+static void buf_cache_link(struct buf_cache_shard *shard, struct buf *b) {
+  b->shard = shard - bufs_cache.shards;
+  b->cold = 0;
+  b->next = shard->hand;
+  b->prev = shard->hand->prev;
+  shard->hand->prev->next = b;
+  shard->hand->prev = b;
+  shard->count++;
+}
+
+// Inserts the buf to the tail of the cold queue of the shard.
+// Must be called with shard->lock held.
+static void buf_cache_link_cold(struct buf_cache_shard *shard, struct buf *b) {
+  b->shard = shard - bufs_cache.shards;
+  b->cold = 1;
+  b->next = &shard->cold;
+  b->prev = shard->cold.prev;
+  shard->cold.prev->next = b;
+  shard->cold.prev = b;
+  shard->count++;
+  shard->cold_count++;
+}
+
+// Inserts a buf without a block to the head of the cold queue of the shard,
+// so it is recycled before any buf with a block, by either policy.
+// Must be called with shard->lock held.
+static void buf_cache_link_free(struct buf_cache_shard *shard, struct buf *b) {
+  b->shard = shard - bufs_cache.shards;
+  b->refcnt = 0;
+  b->cold = 1;
+  b->referenced = 0;
+  b->next = shard->cold.next;
+  b->prev = &shard->cold;
+  shard->cold.next->prev = b;
+  shard->cold.next = b;
+  shard->count++;
+  shard->cold_count++;
+}
+
+// Removes the buf from the ring or the cold queue of the shard, and from its
+// bucket.
+// Must be called with shard->lock held.
+static void buf_cache_unlink(struct buf_cache_shard *shard, struct buf *b) {
+  if (b->dev) {
+    struct buf **pp =
+        buf_cache_bucket(shard, buf_cache_hash(b->dev, &b->id));
+    while (*pp != b) {
+      pp = &(*pp)->hnext;
+    }
+    *pp = b->hnext;
+  }
+  if (shard->hand == b) {
+    shard->hand = b->next;
+  }
+  b->next->prev = b->prev;
+  b->prev->next = b->next;
+  shard->count--;
+  if (b->cold) {
+    shard->cold_count--;
+  }
+}
+
+// Uncharges the buf from its cgroup.
+// Must be called with the lock of the shard of the buf held.
+static void buf_cache_uncharge(struct buf *b) {
+  if (b->cgroup) {
+    cgroup_mem_uncharge_file(b->cgroup);
+    b->cgroup = 0;
+  }
+}
+
+// Returns whether the block of the hash was recently recycled from the cold
+// queue, and forgets it.
+// Must be called with shard->lock held.
+static uint buf_cache_ghost_hit(struct buf_cache_shard *shard, uint hash) {
+  for (uint i = 0; i < shard->ghosts_count; i++) {
+    if (shard->ghosts[i] == hash) {
+      shard->ghosts[i] = 0;
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+// Returns a buf of the ring which is not in use, or 0 if there is none. The
+// bufs used since the hand passed them get a second chance.
+// Must be called with shard->lock held.
+static struct buf *buf_cache_evict_clock(struct buf_cache_shard *shard) {
+  // The first round might only clear the reference bits.
+  for (uint i = 0; i < 2 * (shard->count + 1); i++) {
+    struct buf *b = shard->hand;
+    shard->hand = b->next;
+    if (b == &shard->head || b->refcnt != 0 || (b->flags & B_DIRTY)) {
+      continue;
+    }
+    if (b->referenced) {
+      b->referenced = 0;
+      continue;
+    }
+    return b;
+  }
+
+  return 0;
+}
+
+// Returns the oldest buf of the cold queue which is not in use, or 0 if there
+// is none, and remembers its block as a ghost.
+// Must be called with shard->lock held.
+static struct buf *buf_cache_evict_cold(struct buf_cache_shard *shard) {
+  for (struct buf *b = shard->cold.next; b != &shard->cold; b = b->next) {
+    if (b->refcnt != 0 || (b->flags & B_DIRTY)) {
+      continue;
+    }
+    if (b->dev) {
+      shard->ghosts[shard->ghost_next] = buf_cache_hash(b->dev, &b->id);
+      shard->ghost_next = (shard->ghost_next + 1) % shard->ghosts_count;
+    }
+    return b;
+  }
+
+  return 0;
+}
 
-  initlock(&bufs_cache.lock, "bufs_cache");
+// Returns a buf of the shard which is not in use and is charged to the
+// cgroup, or 0 if there is none.
+// Must be called with shard->lock held.
+static struct buf *buf_cache_evict_charged(struct buf_cache_shard *shard,
+                                           const struct cgroup *cg) {
+  struct buf *queues[] = {&shard->cold, &shard->head};
+
+  for (uint q = 0; q < ARRAY_LEN(queues); q++) {
+    for (struct buf *b = queues[q]->next; b != queues[q]; b = b->next) {
+      if (b->cgroup == cg && b->refcnt == 0 && !(b->flags & B_DIRTY)) {
+        return b;
+      }
+    }
+  }
+
+  return 0;
+}
+
+// Returns a buf of the shard which is not in use, or 0 if there is none.
+// Must be called with shard->lock held.
+static struct buf *buf_cache_evict(struct buf_cache_shard *shard) {
+  struct buf *b = shard->cold.next;
+
+  // A buf without a block is not in the bucket, and so not in use.
+  if (b != &shard->cold && b->dev == 0) {
+    return b;
+  }
+  b = 0;
+  // The cold queue holds a quarter of the bufs when the hot one has room.
+  if (shard->cold_count > shard->count / 4) {
+    b = buf_cache_evict_cold(shard);
+  }
+  if (b == 0) {
+    b = buf_cache_evict_clock(shard);
+  }
+  if (b == 0) {
+    b = buf_cache_evict_cold(shard);
+  }
+  if (b && (b->flags & B_READAHEAD)) {
+    shard->readahead_evictions++;
+  }
+
+  return b;
+}
+
+// Takes a buf which is not in use out of a shard other than the thief, or out
+// of any shard if the thief is 0. Only a buf charged to the cgroup is taken,
+// unless the cgroup is 0. Returns 0 if there is no such buf.
+// The buf is returned in use, and is freed by linking it with
+// buf_cache_link_free.
+// Must be called with no shard lock held.
+static struct buf *buf_cache_steal(struct buf_cache_shard *thief,
+                                   const struct cgroup *cg) {
+  for (uint i = 0; i < bufs_cache.shards_count; i++) {
+    struct buf_cache_shard *shard = &bufs_cache.shards[i];
+    if (shard == thief) {
+      continue;
+    }
+    acquire(&shard->lock);
+    struct buf *b =
+        cg ? buf_cache_evict_charged(shard, cg) : buf_cache_evict(shard);
+    if (b) {
+      buf_cache_unlink(shard, b);
+      buf_cache_uncharge(b);
+      b->dev = 0;
+      b->flags = 0;
+      // In use until the thief links it, so that the cache doesn't free it.
+      b->refcnt = 1;
+    }
+    release(&shard->lock);
+    if (b) {
+      return b;
+    }
+  }
+
+  return 0;
+}
+
+// Returns the buf of the block in the shard, with a new reference, or 0.
+// Must be called with shard->lock held.
+static struct buf *buf_cache_lookup(struct buf_cache_shard *shard, uint hash,
+                                    const struct device *const dev,
+                                    const union buf_id *id) {
+  for (struct buf *b = *buf_cache_bucket(shard, hash); b != 0; b = b->hnext) {
+    if (b->dev == dev && (0 == memcmp(&(b->id), id, sizeof(*id)))) {
+      b->refcnt++;
+      return b;
+    }
+  }
+
+  return 0;
+}
+
+static void buf_cache_init_buf(struct buf *b) {
+  b->flags = 0;
+  b->refcnt = 0;
+  b->referenced = 0;
+  b->dev = 0;
+  b->cgroup = 0;
+  initsleeplock(&b->lock, "buffer");
+}
+
+void buf_cache_init(void) { buf_cache_init_shards(BUF_CACHE_SHARDS); }
+
+void buf_cache_init_shards(uint shards) {
+  bufs_cache.shards_count = shards;
+  for (uint i = 0; i < shards; i++) {
+    struct buf_cache_shard *shard = &bufs_cache.shards[i];
+    initlock(&shard->lock, "bufs_cache");
+    shard->head.prev = &shard->head;
+    shard->head.next = &shard->head;
+    shard->hand = &shard->head;
+    shard->count = 0;
+    shard->cold.prev = &shard->cold;
+    shard->cold.next = &shard->cold;
+    shard->cold_count = 0;
+    shard->ghosts = &bufs_cache.ghosts[i * (NBUF / shards)];
+    shard->ghosts_count = NBUF / shards;
+    memset(shard->ghosts, 0, shard->ghosts_count * sizeof(uint));
+    shard->ghost_next = 0;
+    memset(shard->buckets, 0, sizeof(shard->buckets));
+    shard->is_cache_enabled = 1;
+    shard->policy = BUF_CACHE_POLICY_CLOCK;
+    memset(shard->hits, 0, sizeof(shard->hits));
+    memset(shard->misses, 0, sizeof(shard->misses));
+    shard->readahead_evictions = 0;
+  }
+
+  initlock(&bufs_cache.lock, "bufs_cache_size");
+  bufs_cache.size = NBUF;
+  bufs_cache.min = NBUF;
+  bufs_cache.max = NBUF_MAX;
+  bufs_cache.pages_count = 0;
+  bufs_cache.waiters = 0;
+  bufs_cache.releases = 0;
 
   // PAGEBREAK!
-  //  Create linked list of buffers
-  bufs_cache.head.prev = &bufs_cache.head;
-  bufs_cache.head.next = &bufs_cache.head;
-  for (b = bufs_cache.buf; b < bufs_cache.buf + NBUF; b++) {
-    b->flags = 0;
-    b->refcnt = 0;
-    b->next = bufs_cache.head.next;
-    b->prev = &bufs_cache.head;
-    initsleeplock(&b->lock, "buffer");
-    bufs_cache.head.next->prev = b;
-    bufs_cache.head.next = b;
+  //  Deal the buffers to the shards
+  for (uint i = 0; i < NBUF; i++) {
+    struct buf *b = &bufs_cache.buf[i];
+    buf_cache_init_buf(b);
+    buf_cache_link_free(&bufs_cache.shards[i % shards], b);
   }
+}
 
-  bufs_cache.is_cache_enabled = 1;
+// Returns whether the shard has no free buf, and the cache may grow.
+// Must be called with shard->lock held.
+static uint buf_cache_should_grow(struct buf_cache_shard *shard) {
+  return (shard->cold.next == &shard->cold || shard->cold.next->dev != 0) &&
+         bufs_cache.size + BUF_CACHE_PAGE_BUFS <= bufs_cache.max &&
+         bufs_cache.pages_count < BUF_CACHE_PAGES &&
+         get_total_memory() > BUF_CACHE_GROW_FREE_PAGES;
 }
 
-void buf_cache_invalidate_blocks(const struct device *const dev) {
+// Adds a page of free bufs to the shard, if the cache may grow.
+// Must be called with no shard lock held.
+static void buf_cache_grow(struct buf_cache_shard *shard) {
+  char *page = kalloc();
+
+  if (page == 0) {
+    return;
+  }
   acquire(&bufs_cache.lock);
-  struct buf *b;
-  for (b = bufs_cache.head.next; b != &bufs_cache.head; b = b->next) {
-    if (b->dev == dev) {
-      b->flags &= ~(B_VALID | B_DIRTY);
+  if (bufs_cache.size + BUF_CACHE_PAGE_BUFS > bufs_cache.max ||
+      bufs_cache.pages_count == BUF_CACHE_PAGES) {
+    release(&bufs_cache.lock);
+    kfree(page);
+    return;
+  }
+  acquire(&shard->lock);
+  for (uint i = 0; i < BUF_CACHE_PAGE_BUFS; i++) {
+    struct buf *b = (struct buf *)page + i;
+    buf_cache_init_buf(b);
+    buf_cache_link_free(shard, b);
+  }
+  release(&shard->lock);
+  bufs_cache.pages[bufs_cache.pages_count++] = page;
+  bufs_cache.size += BUF_CACHE_PAGE_BUFS;
+  release(&bufs_cache.lock);
+}
+
+// Returns whether the cache is above its max limit, or the memory runs low
+// and the cache can shrink by a page without going below its min limit.
+static uint buf_cache_should_shrink(void) {
+  return bufs_cache.size > bufs_cache.max ||
+         (bufs_cache.size >= bufs_cache.min + BUF_CACHE_PAGE_BUFS &&
+          get_total_memory() < BUF_CACHE_SHRINK_FREE_PAGES);
+}
+
+// Frees a page whose bufs are not in use, and returns whether there was one.
+// Must be called with bufs_cache.lock held, and no shard lock held.
+static uint buf_cache_shrink(void) {
+  char *page = 0;
+
+  for (uint i = 0; i < bufs_cache.shards_count; i++) {
+    acquire(&bufs_cache.shards[i].lock);
+  }
+  for (uint p = 0; p < bufs_cache.pages_count && page == 0; p++) {
+    struct buf *bufs = (struct buf *)bufs_cache.pages[p];
+    uint in_use = 0;
+    for (uint i = 0; i < BUF_CACHE_PAGE_BUFS; i++) {
+      in_use |= bufs[i].refcnt != 0 || (bufs[i].flags & B_DIRTY);
+    }
+    if (in_use) {
+      continue;
     }
+    for (uint i = 0; i < BUF_CACHE_PAGE_BUFS; i++) {
+      buf_cache_unlink(&bufs_cache.shards[bufs[i].shard], &bufs[i]);
+      buf_cache_uncharge(&bufs[i]);
+    }
+    page = bufs_cache.pages[p];
+    bufs_cache.pages[p] = bufs_cache.pages[--bufs_cache.pages_count];
+    bufs_cache.size -= BUF_CACHE_PAGE_BUFS;
+  }
+  for (uint i = 0; i < bufs_cache.shards_count; i++) {
+    release(&bufs_cache.shards[i].lock);
+  }
+  if (page) {
+    kfree(page);
+  }
+
+  return page != 0;
+}
+
+// Waits for a buf to be released, unless a buf which is not in use is found
+// meanwhile, then returns it.
+// Must be called with no shard lock held.
+static struct buf *buf_cache_wait(void) {
+  struct buf *b;
+  uint releases;
+
+  acquire(&bufs_cache.lock);
+  bufs_cache.waiters++;
+  releases = bufs_cache.releases;
+  release(&bufs_cache.lock);
+
+  // A buf released after its shard is looked at wakes the waiter up.
+  b = buf_cache_steal(0, 0);
+
+  acquire(&bufs_cache.lock);
+  while (b == 0 && bufs_cache.releases == releases) {
+    sleep(&bufs_cache.releases, &bufs_cache.lock);
   }
+  bufs_cache.waiters--;
   release(&bufs_cache.lock);
+
+  return b;
+}
+
+void buf_cache_invalidate_blocks(const struct device *const dev) {
+  for (uint i = 0; i < bufs_cache.shards_count; i++) {
+    struct buf_cache_shard *shard = &bufs_cache.shards[i];
+    struct buf *queues[] = {&shard->head, &shard->cold};
+    acquire(&shard->lock);
+    for (uint q = 0; q < ARRAY_LEN(queues); q++) {
+      for (struct buf *b = queues[q]->next; b != queues[q]; b = b->next) {
+        if (b->dev == dev) {
+          b->flags &= ~(B_VALID | B_DIRTY);
+        }
+      }
+    }
+    release(&shard->lock);
+  }
 }
 
 // Look through buffer cache for block on device dev.
@@ -57,119 +519,320 @@ struct buf *buf_cache_get(const struct device *const dev,
                           const union buf_id *id, const uint alloc_flags) {
   struct buf *b;
   struct cgroup *cg = proc_get_cgroup();
+  uint hash = buf_cache_hash(dev, id);
+  struct buf_cache_shard *shard = buf_cache_shard(hash);
+  uint resized = 0;
+  uint reclaimed = 0;
 
-  acquire(&bufs_cache.lock);
-
-  // Is the block already cached?
-  for (b = bufs_cache.head.next; b != &bufs_cache.head; b = b->next) {
-    if (b->dev == dev && (0 == memcmp(&(b->id), id, sizeof(*id)))) {
-      b->refcnt++;
-      release(&bufs_cache.lock);
+  acquire(&shard->lock);
+  for (;;) {
+    // Is the block already cached?
+    b = buf_cache_lookup(shard, hash, dev, id);
+    if (b) {
+      shard->hits[shard->policy]++;
+      release(&shard->lock);
       acquiresleep(&b->lock);
       cgroup_mem_stat_pgfault_incr(cg);
       return b;
     }
-  }
 
-  // Not cached; recycle an unused buffer.
-  // Even if refcnt==0, B_DIRTY indicates a buffer is in use
-  // because log.c has modified it but not yet committed it.
-  for (b = bufs_cache.head.prev; b != &bufs_cache.head; b = b->prev) {
-    if (b->refcnt == 0 && (b->flags & B_DIRTY) == 0) {
-      b->dev = dev;
-      b->id = *id;
-      b->flags = 0;
-      b->alloc_flags = alloc_flags;
-      b->cgroup = 0;
-      b->refcnt = 1;
-      release(&bufs_cache.lock);
-      acquiresleep(&b->lock);
-      cgroup_mem_stat_pgmajfault_incr(cg);
-      return b;
+    // Not cached; a cgroup over its memory limit recycles a buf of its own
+    // once, from any shard.
+    if (!reclaimed && cgroup_mem_over_max(cg, BSIZE)) {
+      reclaimed = 1;
+      b = buf_cache_evict_charged(shard, cg);
+      if (b) {
+        buf_cache_unlink(shard, b);
+        break;
+      }
+      release(&shard->lock);
+      b = buf_cache_steal(shard, cg);
+      acquire(&shard->lock);
+      if (b) {
+        buf_cache_link_free(shard, b);
+      }
+      continue;
+    }
+
+    // Resize the cache once if needed, the block is looked up again as it
+    // might be cached meanwhile.
+    if (!resized && (buf_cache_should_shrink() ||
+                     buf_cache_should_grow(shard))) {
+      release(&shard->lock);
+      resized = 1;
+      acquire(&bufs_cache.lock);
+      if (buf_cache_should_shrink()) {
+        buf_cache_shrink();
+        release(&bufs_cache.lock);
+      } else {
+        release(&bufs_cache.lock);
+        buf_cache_grow(shard);
+      }
+      acquire(&shard->lock);
+      continue;
+    }
+
+    // Recycle an unused buffer.
+    // Even if refcnt==0, B_DIRTY indicates a buffer is in use
+    // because log.c has modified it but not yet committed it.
+    b = buf_cache_evict(shard);
+    if (b) {
+      buf_cache_unlink(shard, b);
+      break;
+    }
+
+    // All the bufs of the shard are in use, take one of another shard, or
+    // wait for one to be released.
+    release(&shard->lock);
+    b = buf_cache_steal(shard, 0);
+    if (b == 0) {
+      b = buf_cache_wait();
+    }
+    acquire(&shard->lock);
+    if (b) {
+      buf_cache_link_free(shard, b);
     }
   }
-  panic("buf_cache_get: no buffers");
+
+  shard->misses[shard->policy]++;
+  buf_cache_uncharge(b);
+  b->dev = dev;
+  b->id = *id;
+  b->flags = 0;
+  b->alloc_flags = alloc_flags;
+  b->cgroup = cg;
+  cgroup_mem_charge_file(cg);
+  b->refcnt = 1;
+  b->referenced = 0;
+  struct buf **bucket = buf_cache_bucket(shard, hash);
+  b->hnext = *bucket;
+  *bucket = b;
+  if (shard->policy == BUF_CACHE_POLICY_2Q &&
+      !buf_cache_ghost_hit(shard, hash)) {
+    buf_cache_link_cold(shard, b);
+  } else {
+    buf_cache_link(shard, b);
+  }
+  release(&shard->lock);
+  acquiresleep(&b->lock);
+  cgroup_mem_stat_pgmajfault_incr(cg);
+  return b;
 }
 
 // Release a locked buffer.
 void buf_cache_release(struct buf *const b) {
-  uint insert_first = 0;
+  uint wakeup_waiters = 0;
+
   if (!holdingsleep(&b->lock)) panic("buf_cache_release");
 
   releasesleep(&b->lock);
 
-  acquire(&bufs_cache.lock);
+  // A buf in use stays in its shard.
+  struct buf_cache_shard *shard = &bufs_cache.shards[b->shard];
+  acquire(&shard->lock);
   b->refcnt--;
   if (b->refcnt == 0) {
     // no one is waiting for it.
-    if (!bufs_cache.is_cache_enabled) {
-      insert_first = 0;
+    if (!shard->is_cache_enabled) {
+      b->referenced = 0;
       // When the cache is disabled and the buffer is not used anymore,
       // use the buf only as a memory and therefore invalidate it.
       if (!(b->flags & B_DIRTY)) {
         b->flags &= ~B_VALID;
       }
     } else {
-      if (b->alloc_flags & BUF_ALLOC_NO_CACHE) {
-        // This buffer does not have priority.
-        insert_first = 0;
-      } else {
-        insert_first = 1;
-      }
-    }
-
-    // Remove the buf from the list and re-insert it according to its type
-    b->next->prev = b->prev;
-    b->prev->next = b->next;
-    if (insert_first) {
-      // Move to the head of the MRU list.
-      b->next = bufs_cache.head.next;
-      b->prev = &bufs_cache.head;
-      bufs_cache.head.next->prev = b;
-      bufs_cache.head.next = b;
-    } else {
-      // Move to the tail of the MRU list.
-      b->prev = bufs_cache.head.prev;
-      b->next = &bufs_cache.head;
-      bufs_cache.head.prev->next = b;
-      bufs_cache.head.prev = b;
+      // A buffer which should not be cached, or which holds no valid data,
+      // does not get a second chance.
+      b->referenced = (b->flags & B_VALID) &&
+                      !(b->alloc_flags & BUF_ALLOC_NO_CACHE);
     }
+    wakeup_waiters = bufs_cache.waiters != 0;
   }
 
-  release(&bufs_cache.lock);
+  release(&shard->lock);
+
+  if (wakeup_waiters) {
+    acquire(&bufs_cache.lock);
+    bufs_cache.releases++;
+    wakeup(&bufs_cache.releases);
+    release(&bufs_cache.lock);
+  }
 }
 
 uint buf_cache_is_cache_enabled(void) {
+  struct buf_cache_shard *shard = &bufs_cache.shards[0];
   uint is_cache_enabled = 0;
 
-  acquire(&bufs_cache.lock);
-  is_cache_enabled = bufs_cache.is_cache_enabled;
-  release(&bufs_cache.lock);
+  acquire(&shard->lock);
+  is_cache_enabled = shard->is_cache_enabled;
+  release(&shard->lock);
 
   return is_cache_enabled;
 }
 
 void buf_cache_enable_cache(void) {
-  acquire(&bufs_cache.lock);
+  for (uint i = 0; i < bufs_cache.shards_count; i++) {
+    struct buf_cache_shard *shard = &bufs_cache.shards[i];
+    acquire(&shard->lock);
+    shard->is_cache_enabled = 1;
+    release(&shard->lock);
+  }
+}
+
+void buf_cache_disable_cache(void) {
+  for (uint i = 0; i < bufs_cache.shards_count; i++) {
+    struct buf_cache_shard *shard = &bufs_cache.shards[i];
+    acquire(&shard->lock);
+    if (shard->is_cache_enabled) {
+      // Invalidate all unused bufs
+      struct buf *queues[] = {&shard->head, &shard->cold};
+      for (uint q = 0; q < ARRAY_LEN(queues); q++) {
+        for (struct buf *b = queues[q]->next; b != queues[q]; b = b->next) {
+          if (b->refcnt == 0 && (b->flags & B_DIRTY) == 0) {
+            b->flags &= ~B_VALID;
+            b->referenced = 0;
+          }
+        }
+      }
+      shard->is_cache_enabled = 0;
+    }
+    release(&shard->lock);
+  }
+}
 
-  bufs_cache.is_cache_enabled = 1;
+uint buf_cache_readahead_evictions(void) {
+  uint readahead_evictions = 0;
 
-  release(&bufs_cache.lock);
+  for (uint i = 0; i < bufs_cache.shards_count; i++) {
+    struct buf_cache_shard *shard = &bufs_cache.shards[i];
+    acquire(&shard->lock);
+    readahead_evictions += shard->readahead_evictions;
+    release(&shard->lock);
+  }
+
+  return readahead_evictions;
 }
 
-void buf_cache_disable_cache(void) {
-  struct buf *b;
-  acquire(&bufs_cache.lock);
+uint buf_cache_policy(void) {
+  struct buf_cache_shard *shard = &bufs_cache.shards[0];
+  uint policy = 0;
 
-  if (bufs_cache.is_cache_enabled) {
-    // Invalidate all unused bufs
-    for (b = bufs_cache.head.next; b != &bufs_cache.head; b = b->next) {
-      if (b->refcnt == 0 && (b->flags & B_DIRTY) == 0) {
-        b->flags &= ~B_VALID;
+  acquire(&shard->lock);
+  policy = shard->policy;
+  release(&shard->lock);
+
+  return policy;
+}
+
+void buf_cache_set_policy(uint policy) {
+  for (uint i = 0; i < bufs_cache.shards_count; i++) {
+    struct buf_cache_shard *shard = &bufs_cache.shards[i];
+    acquire(&shard->lock);
+    if (shard->policy != policy) {
+      // CLOCK keeps the bufs with a block in the ring only, move the cold
+      // ones to it. 2Q starts with only free bufs in the cold queue, which
+      // fills as blocks miss.
+      struct buf *next;
+      for (struct buf *b = shard->cold.next; b != &shard->cold; b = next) {
+        next = b->next;
+        if (b->dev) {
+          b->next->prev = b->prev;
+          b->prev->next = b->next;
+          shard->count--;
+          shard->cold_count--;
+          buf_cache_link(shard, b);
+        }
       }
+      memset(shard->ghosts, 0, shard->ghosts_count * sizeof(uint));
+      shard->policy = policy;
     }
-    bufs_cache.is_cache_enabled = 0;
+    release(&shard->lock);
+  }
+}
+
+void buf_cache_policy_stats(uint policy, uint *hits, uint *misses) {
+  *hits = 0;
+  *misses = 0;
+  for (uint i = 0; i < bufs_cache.shards_count; i++) {
+    struct buf_cache_shard *shard = &bufs_cache.shards[i];
+    acquire(&shard->lock);
+    *hits += shard->hits[policy];
+    *misses += shard->misses[policy];
+    release(&shard->lock);
   }
+}
 
+void buf_cache_limits(uint *size, uint *min, uint *max) {
+  acquire(&bufs_cache.lock);
+  *size = bufs_cache.size;
+  *min = bufs_cache.min;
+  *max = bufs_cache.max;
   release(&bufs_cache.lock);
 }
+
+result_code buf_cache_set_limits(uint min, uint max) {
+  if (min < NBUF || max < min || max > NBUF_MAX) {
+    return RESULT_ERROR_ARGUMENT;
+  }
+
+  acquire(&bufs_cache.lock);
+  bufs_cache.min = min;
+  bufs_cache.max = max;
+  // Shrink as much as possible now, the pages in use are freed by lookups
+  // later.
+  while (bufs_cache.size > bufs_cache.max && buf_cache_shrink()) {
+  }
+  // A waiter might grow the cache now.
+  bufs_cache.releases++;
+  wakeup(&bufs_cache.releases);
+  release(&bufs_cache.lock);
+
+  return RESULT_SUCCESS;
+}
+
+void buf_cache_charge(struct buf *b, struct cgroup *cg) {
+  struct buf_cache_shard *shard = &bufs_cache.shards[b->shard];
+
+  acquire(&shard->lock);
+  if (b->cgroup != cg) {
+    buf_cache_uncharge(b);
+    b->cgroup = cg;
+    cgroup_mem_charge_file(cg);
+  }
+  release(&shard->lock);
+}
+
+uint buf_cache_reclaim(struct cgroup *cg, uint bytes) {
+  uint reclaimed = 0;
+
+  while (reclaimed < bytes) {
+    struct buf *b = buf_cache_steal(0, cg);
+    if (b == 0) {
+      break;
+    }
+    // The buf is free now, it stays in its shard.
+    struct buf_cache_shard *shard = &bufs_cache.shards[b->shard];
+    acquire(&shard->lock);
+    buf_cache_link_free(shard, b);
+    release(&shard->lock);
+    reclaimed += BSIZE;
+  }
+
+  return reclaimed;
+}
+
+void buf_cache_forget_cgroup(struct cgroup *cg) {
+  for (uint i = 0; i < bufs_cache.shards_count; i++) {
+    struct buf_cache_shard *shard = &bufs_cache.shards[i];
+    struct buf *queues[] = {&shard->head, &shard->cold};
+    acquire(&shard->lock);
+    for (uint q = 0; q < ARRAY_LEN(queues); q++) {
+      for (struct buf *b = queues[q]->next; b != queues[q]; b = b->next) {
+        if (b->cgroup == cg) {
+          buf_cache_uncharge(b);
+        }
+      }
+    }
+    release(&shard->lock);
+  }
+}
@@ -3,12 +3,44 @@
 
 #include "defs.h"
 
+// Policies by which the cache recycles its buffers.
+#define BUF_CACHE_POLICY_CLOCK 0
+// Scan resistant, see buf_cache.c.
+#define BUF_CACHE_POLICY_2Q 1
+#define BUF_CACHE_POLICIES 2
+
+// The cache grows while the free memory is above the first watermark, and
+// shrinks while it is below the second one, in pages.
+#define BUF_CACHE_GROW_FREE_PAGES 4096
+#define BUF_CACHE_SHRINK_FREE_PAGES 2048
+
 void buf_cache_init();
+// Initializes the cache split into `shards` shards, 1 to NCPU, rather than
+// NCPU. Tests pin a single shard, so all the blocks compete for its bufs.
+void buf_cache_init_shards(uint shards);
 void buf_cache_invalidate_blocks(const struct device*);
 struct buf* buf_cache_get(const struct device*, const union buf_id*, uint);
 void buf_cache_release(struct buf* b);
 uint buf_cache_is_cache_enabled(void);
 void buf_cache_enable_cache(void);
 void buf_cache_disable_cache(void);
+// The amount of bufs which were recycled while marked B_READAHEAD.
+uint buf_cache_readahead_evictions(void);
+uint buf_cache_policy(void);
+void buf_cache_set_policy(uint policy);
+// The amount of lookups that found the block cached, and that did not, while
+// the policy was in use.
+void buf_cache_policy_stats(uint policy, uint* hits, uint* misses);
+// The amount of bufs in the cache, and its limits.
+void buf_cache_limits(uint* size, uint* min, uint* max);
+// Sets the limits of the amount of bufs, between NBUF and NBUF_MAX.
+result_code buf_cache_set_limits(uint min, uint max);
+// Charges the buf to the cgroup instead of the cgroup it is charged to.
+void buf_cache_charge(struct buf* b, struct cgroup* cg);
+// Recycles unused bufs charged to the cgroup, until at least `bytes` are
+// uncharged or none is left. Returns the amount of bytes uncharged.
+uint buf_cache_reclaim(struct cgroup* cg, uint bytes);
+// Uncharges all the bufs charged to the cgroup, which is being deleted.
+void buf_cache_forget_cgroup(struct cgroup* cg);
 
 #endif  // XV6_DEVICE_BUF_CACHE_H
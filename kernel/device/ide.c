@@ -117,32 +117,50 @@ void ideintr(void) {
   release(&idelock);
 }
 
+// Check that b is a valid request.
+static void idecheck(struct buf *const b) {
+  if (!holdingsleep(&b->lock)) panic("iderw: buf not locked");
+  if ((b->flags & (B_VALID | B_DIRTY)) == B_VALID)
+    panic("iderw: nothing to do");
+  if (b->dev != 0 && !havedisk1) panic("iderw: ide disk 1 not present");
+}
+
 // PAGEBREAK!
 //  Sync buf with disk.
 //  If B_DIRTY is set, write buf to disk, clear B_DIRTY, set B_VALID.
 //  Else if B_VALID is not set, read buf from disk, set B_VALID.
-void iderw(struct buf *const b) {
+void iderw(struct buf *const b) { iderw_multi(&b, 1); }
+
+// Sync n bufs with disk, as one batch.
+// The bufs are queued together, so that ideintr starts each
+// request as soon as the previous one is done, and the caller
+// sleeps until the whole batch is done.
+void iderw_multi(struct buf *const *const bufs, const uint n) {
   struct buf **pp;
+  uint i;
 
-  if (!holdingsleep(&b->lock)) panic("iderw: buf not locked");
-  if ((b->flags & (B_VALID | B_DIRTY)) == B_VALID)
-    panic("iderw: nothing to do");
-  if (b->dev != 0 && !havedisk1) panic("iderw: ide disk 1 not present");
+  if (n == 0) return;
+  for (i = 0; i < n; i++) idecheck(bufs[i]);
 
   acquire(&idelock);  // DOC:acquire-lock
 
-  // Append b to idequeue.
-  b->qnext = 0;
+  // Append the bufs to idequeue.
   for (pp = &idequeue; *pp; pp = &(*pp)->qnext) {
   }  // DOC:insert-queue
-  *pp = b;
+  for (i = 0; i < n; i++) {
+    bufs[i]->qnext = 0;
+    *pp = bufs[i];
+    pp = &bufs[i]->qnext;
+  }
 
   // Start disk if necessary.
-  if (idequeue == b) idestart(b);
+  if (idequeue == bufs[0]) idestart(bufs[0]);
 
-  // Wait for request to finish.
-  while ((b->flags & (B_VALID | B_DIRTY)) != B_VALID) {
-    sleep(b, &idelock);
+  // Wait for the requests to finish.
+  for (i = 0; i < n; i++) {
+    while ((bufs[i]->flags & (B_VALID | B_DIRTY)) != B_VALID) {
+      sleep(bufs[i], &idelock);
+    }
   }
 
   release(&idelock);
@@ -5,5 +5,6 @@
 void ideinit(void);
 void ideintr(void);
 void iderw(struct buf*);
+void iderw_multi(struct buf* const*, uint);
 
 #endif  // XV6_DEVICE_IDE_H
@@ -29,7 +29,15 @@ struct device* get_loop_device(const struct vfs_inode* const ip) {
   return NULL;
 }
 
+// Caller must hold ip->lock.
 struct device* create_loop_device(struct vfs_inode* const ip) {
+  // Blocks are written to the file in place, which can't allocate any.
+  if (ip->i_op->isallocated != NULL &&
+      !ip->i_op->isallocated(ip, 0, ip->size)) {
+    cprintf("loop device: the backing file has holes\n");
+    return NULL;
+  }
+
   acquire(&dev_holder.lock);
   struct device* dev = _get_new_device(DEVICE_TYPE_LOOP);
 
@@ -1,14 +1,35 @@
 #include "obj_cache.h"
 
 #include "buf_cache.h"
+#include "cgroup.h"
+#include "obj_checksum.h"
 #include "obj_disk.h"
 #include "proc.h"
 #include "spinlock.h"
 
+// An object with blocks which were not written back yet.
+struct obj_cache_dirty_object {
+  struct device *dev;
+  char name[MAX_OBJECT_NAME_LENGTH];
+  // The object size, including the bytes which were not written back yet.
+  uint size;
+};
+
 struct obj_cache {
   struct spinlock lock;
   uint hits;
   uint misses;
+  uint readahead_hits;
+  // Blocks which were read ahead and dropped before anyone read them. The
+  // recycled ones are counted by the bufs cache.
+  uint readahead_misses;
+  uint writes;
+  uint writebacks;
+  uint dirty_blocks;
+  // Every dirty block has its object here, so there are never more dirty
+  // objects than bufs.
+  struct obj_cache_dirty_object dirty_objects[NBUF];
+  uint dirty_objects_count;
 };
 
 struct bufs_alloc_hint {
@@ -31,6 +52,115 @@ static void obj_cahce_misses_inc(void) {
   release(&obj_cache.lock);
 }
 
+// Clears the readahead mark of the bufs, and counts the ones which were read
+// ahead and are still valid as readahead hits. If `readahead` is set, marks
+// the invalid bufs as read ahead instead.
+static void obj_cache_mark_readahead(vector bufs, uint readahead) {
+  struct buf *curr_buf;
+  uint hits = 0;
+  uint misses = 0;
+
+  for (uint index = 0; index < bufs.vectorsize; index++) {
+    memmove_from_vector((char *)&curr_buf, bufs, index, 1);
+    if (curr_buf->flags & B_READAHEAD) {
+      if (curr_buf->flags & B_VALID) {
+        if (readahead) {
+          continue;
+        }
+        hits++;
+      } else {
+        misses++;
+      }
+      curr_buf->flags &= ~B_READAHEAD;
+    }
+    if (readahead && !(curr_buf->flags & B_VALID)) {
+      curr_buf->flags |= B_READAHEAD;
+    }
+  }
+
+  acquire(&obj_cache.lock);
+  obj_cache.readahead_hits += hits;
+  obj_cache.readahead_misses += misses;
+  release(&obj_cache.lock);
+}
+
+// Returns the index of the object in the dirty objects, or -1.
+// Must be called with obj_cache.lock held.
+static int obj_cache_find_dirty(const struct device *dev, const char *name) {
+  for (uint index = 0; index < obj_cache.dirty_objects_count; index++) {
+    struct obj_cache_dirty_object *object = &obj_cache.dirty_objects[index];
+    if (object->dev == dev &&
+        0 == strncmp(object->name, name, MAX_OBJECT_NAME_LENGTH)) {
+      return index;
+    }
+  }
+
+  return -1;
+}
+
+// Must be called with obj_cache.lock held.
+static void obj_cache_remove_dirty(int index) {
+  obj_cache.dirty_objects_count--;
+  obj_cache.dirty_objects[index] =
+      obj_cache.dirty_objects[obj_cache.dirty_objects_count];
+}
+
+// Records that the object has dirty blocks, and is of `size` bytes.
+static void obj_cache_add_dirty(struct device *dev, const char *name,
+                                uint size) {
+  struct obj_cache_dirty_object *object;
+
+  acquire(&obj_cache.lock);
+  int index = obj_cache_find_dirty(dev, name);
+  if (index < 0) {
+    if (obj_cache.dirty_objects_count == NBUF) {
+      panic("obj_cache_add_dirty: too many dirty objects");
+    }
+    index = obj_cache.dirty_objects_count++;
+    object = &obj_cache.dirty_objects[index];
+    object->dev = dev;
+    strncpy(object->name, name, MAX_OBJECT_NAME_LENGTH);
+    object->name[MAX_OBJECT_NAME_LENGTH - 1] = '\0';
+    object->size = 0;
+  }
+  object = &obj_cache.dirty_objects[index];
+  if (object->size < size) {
+    object->size = size;
+  }
+  obj_cache.writes++;
+  release(&obj_cache.lock);
+}
+
+// A buf made dirty is charged to the cgroup of the writer, which is counted
+// as dirty until the buf is written back, like the blocks of the native file
+// system log.
+static void obj_cache_mark_dirty(struct buf *b) {
+  if (b->flags & B_DIRTY) {
+    return;
+  }
+  b->flags |= B_DIRTY;
+  buf_cache_charge(b, proc_get_cgroup());
+  cgroup_mem_stat_file_dirty_incr(b->cgroup);
+
+  acquire(&obj_cache.lock);
+  obj_cache.dirty_blocks++;
+  release(&obj_cache.lock);
+}
+
+// `written` tells whether the content of the buf reached the disk, or was
+// dropped.
+static void obj_cache_mark_clean(struct buf *b, uint written) {
+  b->flags &= ~B_DIRTY;
+  cgroup_mem_stat_file_dirty_decr(b->cgroup);
+  if (written) {
+    cgroup_mem_stat_file_dirty_aggregated_incr(b->cgroup);
+  }
+
+  acquire(&obj_cache.lock);
+  obj_cache.dirty_blocks--;
+  release(&obj_cache.lock);
+}
+
 static uint obj_cache_are_bufs_valid(vector bufs) {
   struct buf *curr_buf;
 
@@ -106,13 +236,13 @@ static void obj_cache_copy_to_bufs(vector bufs, const void *data, uint size,
     memmove_from_vector((char *)&curr_buf, bufs, curr_block, 1);
     memmove(curr_buf->data + in_block_offset, ((char *)data) + copied_bytes,
             block_size);
-    curr_buf->flags |= B_VALID | B_DIRTY;
+    curr_buf->flags |= B_VALID;
     copied_bytes += block_size;
   }
 }
 
 static void obj_cache_copy_from_bufs(vector bufs, uint size, uint offset,
-                                     vector dst) {
+                                     vector dst, uint dst_offset) {
   struct buf *curr_buf;
   uint first_block = OFFSET_TO_BLOCKNO(offset);
   uint last_block = OFFSET_TO_BLOCKNO(offset + size - 1);
@@ -130,46 +260,66 @@ static void obj_cache_copy_from_bufs(vector bufs, uint size, uint offset,
     }
 
     memmove_from_vector((char *)&curr_buf, bufs, curr_block, 1);
-    memmove_into_vector_bytes(dst, copied_bytes,
+    memmove_into_vector_bytes(dst, dst_offset + copied_bytes,
                               (char *)(curr_buf->data + in_block_offset),
                               block_size);
     copied_bytes += block_size;
   }
 }
 
-static uint validate_bufs(struct device *dev, const char *name, uint obj_size,
-                          vector obj_bufs, uint size, uint offset) {
-  uint err = NO_ERR;
+// Returns a new vector of `count` bufs of the vector, starting at `index`.
+static vector obj_cache_bufs_range(vector bufs, uint index, uint count) {
   struct buf *curr_buf;
-  uint found_invalid = 0;
+  vector range_bufs = newvector(count, sizeof(struct buf *));
 
-  for (uint index = 0; index < size; index++) {
-    memmove_from_vector((char *)&curr_buf, obj_bufs, offset + index, 1);
-    if (!(curr_buf->flags & B_VALID)) {
-      found_invalid = 1;
-    }
+  for (uint range_index = 0; range_index < count; range_index++) {
+    memmove_from_vector((char *)&curr_buf, bufs, index + range_index, 1);
+    memmove_into_vector_elements(range_bufs, range_index, (char *)&curr_buf,
+                                 1);
   }
 
-  if (found_invalid) {
-    obj_cahce_hits_inc();
+  return range_bufs;
+}
 
-    // Read the object from disk
-    err = get_object(dev, name, obj_bufs);
-    if (NO_ERR != err) {
-      return err;
-    }
-  } else {
-    obj_cahce_misses_inc();
-  }
+// Reads `count` bufs of the vector, starting at `index`, from the disk. The
+// vector holds the object blocks starting at block `first_block`.
+static uint obj_cache_fill_bufs(struct device *dev, const char *name,
+                                vector bufs, uint first_block, uint index,
+                                uint count, uint obj_size) {
+  vector range_bufs = obj_cache_bufs_range(bufs, index, count);
+  uint offset = (first_block + index) * BUF_DATA_SIZE;
+  uint size = min(count * BUF_DATA_SIZE, obj_size - offset);
+  uint err;
 
-  return NO_ERR;
+  err = get_object_range(dev, name, offset, size, range_bufs);
+  freevector(&range_bufs);
+
+  return err;
 }
 
+static uint obj_cache_is_buf_valid(vector bufs, uint index) {
+  struct buf *curr_buf;
+
+  memmove_from_vector((char *)&curr_buf, bufs, index, 1);
+  return curr_buf->flags & B_VALID;
+}
+
+static uint obj_cache_is_buf_dirty(vector bufs, uint index) {
+  struct buf *curr_buf;
+
+  memmove_from_vector((char *)&curr_buf, bufs, index, 1);
+  return curr_buf->flags & B_DIRTY;
+}
+
+// Invalidates the bufs, and drops the dirty content.
 static void obj_cache_invalidate_bufs(vector bufs) {
   struct buf *curr_buf;
 
   for (uint index = 0; index < bufs.vectorsize; index++) {
     memmove_from_vector((char *)&curr_buf, bufs, index, 1);
+    if (curr_buf->flags & B_DIRTY) {
+      obj_cache_mark_clean(curr_buf, 0);
+    }
     curr_buf->flags &= ~B_VALID;
   }
 }
@@ -210,8 +360,16 @@ static void obj_cache_set_contiguous_area_hints(
 
 void obj_cache_init(void) {
   initlock(&obj_cache.lock, "obj_cache");
+  obj_queue_init();
+  obj_checksum_init();
   obj_cache.hits = 0;
   obj_cache.misses = 0;
+  obj_cache.readahead_hits = 0;
+  obj_cache.readahead_misses = 0;
+  obj_cache.writes = 0;
+  obj_cache.writebacks = 0;
+  obj_cache.dirty_blocks = 0;
+  obj_cache.dirty_objects_count = 0;
 }
 
 uint obj_cache_add(struct device *dev, const char *name, const void *data,
@@ -251,43 +409,58 @@ uint obj_cache_write(struct device *dev, const char *name, const void *data,
   vector obj_bufs = {0};
   uint new_obj_size =
       max(offset + size, prev_obj_size);  // NOLINT(build/include_what_you_use)
-  uint first_buf_index;
-  uint bufs_count;
-  struct bufs_alloc_hint alloc_hints[3];
-
-  // Don't cache the whole object, but just the requested data and padding
-  obj_cache_set_contiguous_area_hints(alloc_hints, size, offset, new_obj_size);
+  uint first_block = OFFSET_TO_BLOCKNO(offset);
+  uint last_block = OFFSET_TO_BLOCKNO(offset + size - 1);
+  uint range_offset = first_block * BUF_DATA_SIZE;
+  uint range_size =
+      (min((last_block + 1) * BUF_DATA_SIZE, new_obj_size)) - range_offset;
+  uint fetched = 0;
+
+  // Flush before taking any buf when too many blocks are dirty, so the dirty
+  // blocks never take the cache over.
+  if (objects_cache_dirty() >= OBJ_CACHE_DIRTY_LIMIT) {
+    err = obj_cache_sync(0);
+    if (NO_ERR != err) {
+      return err;
+    }
+  }
 
-  obj_bufs = obj_cache_get_bufs(
-      dev, name, 0, OFFSET_TO_BLOCKNO(new_obj_size - 1) + 1, alloc_hints);
+  // Only the blocks covered by the write are dirtied
+  obj_bufs = obj_cache_get_bufs(dev, name, first_block,
+                                last_block - first_block + 1, 0);
 
-  // If we don't write the whole object we need to read the rest of the content
-  // (from either disk or cache) as writes are done on entire objects
-  if (offset > 0) {
-    err = validate_bufs(dev, name, prev_obj_size, obj_bufs,
-                        OFFSET_TO_BLOCKNO(offset - 1) + 1, 0);
+  // The blocks at the edges might be written partially. Their rest of content
+  // is needed (from either cache or disk) as writes are done on entire blocks.
+  if (offset > range_offset && !obj_cache_is_buf_valid(obj_bufs, 0)) {
+    err = obj_cache_fill_bufs(dev, name, obj_bufs, first_block, 0, 1,
+                              prev_obj_size);
     if (NO_ERR != err) {
       goto clean;
     }
+    fetched = 1;
   }
-
-  if ((offset + size) < prev_obj_size) {
-    first_buf_index = OFFSET_TO_BLOCKNO(offset + size);
-    bufs_count = OFFSET_TO_BLOCKNO(prev_obj_size - 1) - first_buf_index + 1;
-    err = validate_bufs(dev, name, prev_obj_size, obj_bufs, bufs_count,
-                        first_buf_index);
+  if ((offset + size) < (min(range_offset + range_size, prev_obj_size)) &&
+      !obj_cache_is_buf_valid(obj_bufs, last_block - first_block)) {
+    err = obj_cache_fill_bufs(dev, name, obj_bufs, first_block,
+                              last_block - first_block, 1, prev_obj_size);
     if (NO_ERR != err) {
       goto clean;
     }
+    fetched = 1;
+  }
+  if (fetched) {
+    obj_cahce_misses_inc();
   }
 
-  // Copy the new data to bufs
-  obj_cache_copy_to_bufs(obj_bufs, data, size, offset);
-
-  err = write_object(dev, name, obj_bufs, new_obj_size);
-  if (NO_ERR != err) {
-    goto clean;
+  // Copy the new data to bufs. They are written back later, together with
+  // the following writes to the object.
+  obj_cache_copy_to_bufs(obj_bufs, data, size, offset - range_offset);
+  for (uint index = 0; index < obj_bufs.vectorsize; index++) {
+    struct buf *curr_buf;
+    memmove_from_vector((char *)&curr_buf, obj_bufs, index, 1);
+    obj_cache_mark_dirty(curr_buf);
   }
+  obj_cache_add_dirty(dev, name, new_obj_size);
 
 clean:
   obj_cache_release_bufs(obj_bufs);
@@ -297,40 +470,76 @@ clean:
 
 uint obj_cache_read(struct device *dev, const char *name, vector *dst,
                     uint size, uint offset, uint obj_size) {
-  uint err = NO_ERR;
+  return obj_cache_read_at(dev, name, dst, 0, size, offset, obj_size);
+}
+
+uint obj_cache_read_at(struct device *dev, const char *name, vector *dst,
+                       uint dst_offset, uint size, uint offset,
+                       uint obj_size) {
+  struct obj_cache_read read;
+
+  obj_cache_read_start(&read, dev, name, size, offset, obj_size);
+  return obj_cache_read_end(&read, dst, dst_offset);
+}
+
+// Reads the missing blocks of the range from the disk, see
+// `obj_cache_read_start`.
+static void obj_cache_submit_read(struct obj_cache_read *read,
+                                  struct device *dev, const char *name,
+                                  uint size, uint offset, uint obj_size,
+                                  uint readahead) {
   vector obj_bufs = {0};
   uint start_block = OFFSET_TO_BLOCKNO(offset);
   uint end_block = OFFSET_TO_BLOCKNO(offset + size - 1);
-  struct bufs_alloc_hint alloc_hints[3];
+  uint range_offset = start_block * BUF_DATA_SIZE;
+
+  read->size = size;
+  read->offset = offset - range_offset;
 
-  // Try to read the object directly from cache
+  // Try to read the object directly from cache, and read only the missing
+  // blocks from the disk
   obj_bufs = obj_cache_get_bufs(dev, name, start_block,
                                 end_block - start_block + 1, 0);
-  if (obj_cache_are_bufs_valid(obj_bufs)) {
-    obj_cahce_hits_inc();
-    obj_cache_copy_from_bufs(obj_bufs, size, offset - OFFSET_ROUND_DOWN(offset),
-                             *dst);
-  } else {
-    // The data we want to read is not entirely on cache, we need to read the
-    // whole object directly from disk
-    obj_cache_release_bufs(obj_bufs);
-    obj_cahce_misses_inc();
+  if (!readahead) {
+    if (obj_cache_are_bufs_valid(obj_bufs)) {
+      obj_cahce_hits_inc();
+    } else {
+      obj_cahce_misses_inc();
+    }
+  }
+  obj_cache_mark_readahead(obj_bufs, readahead);
+  read->request = (struct obj_request){
+      .dev = dev,
+      .name = name,
+      .offset = range_offset,
+      .size = (min((end_block + 1) * BUF_DATA_SIZE, obj_size)) - range_offset,
+      .bufs = obj_bufs,
+  };
+  obj_submit(&read->request);
+}
 
-    // Don't cache the whole object, but just the requested data and padding
-    obj_cache_set_contiguous_area_hints(alloc_hints, size, offset, obj_size);
+void obj_cache_read_start(struct obj_cache_read *read, struct device *dev,
+                          const char *name, uint size, uint offset,
+                          uint obj_size) {
+  obj_cache_submit_read(read, dev, name, size, offset, obj_size, 0);
+}
 
-    obj_bufs = obj_cache_get_bufs(
-        dev, name, 0, OFFSET_TO_BLOCKNO(obj_size - 1) + 1, alloc_hints);
-    err = get_object(dev, name, obj_bufs);
-    if (NO_ERR != err) {
-      goto clean;
-    }
+void obj_cache_readahead_start(struct obj_cache_read *read,
+                               struct device *dev, const char *name,
+                               uint size, uint offset, uint obj_size) {
+  obj_cache_submit_read(read, dev, name, size, offset, obj_size, 1);
+}
 
-    obj_cache_copy_from_bufs(obj_bufs, size, offset, *dst);
+uint obj_cache_read_end(struct obj_cache_read *read, vector *dst,
+                        uint dst_offset) {
+  uint err = obj_wait(&read->request);
+
+  if (NO_ERR == err && dst) {
+    obj_cache_copy_from_bufs(read->request.bufs, read->size, read->offset,
+                             *dst, dst_offset);
   }
+  obj_cache_release_bufs(read->request.bufs);
 
-clean:
-  obj_cache_release_bufs(obj_bufs);
   return err;
 }
 
@@ -350,6 +559,13 @@ uint obj_cache_delete(struct device *dev, const char *name, uint obj_size) {
     obj_cache_release_bufs(obj_bufs);
   }
 
+  acquire(&obj_cache.lock);
+  int index = obj_cache_find_dirty(dev, name);
+  if (index >= 0) {
+    obj_cache_remove_dirty(index);
+  }
+  release(&obj_cache.lock);
+
   err = delete_object(dev, name);
   if (NO_ERR != err) {
     return err;
@@ -358,6 +574,127 @@ uint obj_cache_delete(struct device *dev, const char *name, uint obj_size) {
   return NO_ERR;
 }
 
+uint obj_cache_flush(struct device *dev, const char *name) {
+  uint err = NO_ERR;
+  uint size;
+
+  acquire(&obj_cache.lock);
+  int index = obj_cache_find_dirty(dev, name);
+  size = index < 0 ? 0 : obj_cache.dirty_objects[index].size;
+  release(&obj_cache.lock);
+  if (size == 0) {
+    return NO_ERR;
+  }
+
+  uint bufs_count = SIZE_TO_NUM_OF_BUFS(size);
+  uint bufs_size = bufs_count * BUF_DATA_SIZE;
+  struct bufs_alloc_hint alloc_hints[] = {
+      {.start_index = 0, .count = bufs_count, .flags = BUF_ALLOC_NO_CACHE},
+      {.count = 0}};
+  vector obj_bufs =
+      obj_cache_get_bufs(dev, name, 0, bufs_count, alloc_hints);
+
+  // The object might have been written or deleted before its bufs were
+  // locked, look it up again.
+  acquire(&obj_cache.lock);
+  index = obj_cache_find_dirty(dev, name);
+  size = index < 0 ? 0 : obj_cache.dirty_objects[index].size;
+  release(&obj_cache.lock);
+  if (size > bufs_size) {
+    size = bufs_size;
+  }
+
+  // Write every run of dirty bufs at once.
+  for (uint buf_index = 0; buf_index < bufs_count && NO_ERR == err;) {
+    if (buf_index * BUF_DATA_SIZE >= size ||
+        !obj_cache_is_buf_dirty(obj_bufs, buf_index)) {
+      buf_index++;
+      continue;
+    }
+    uint count = 1;
+    while (buf_index + count < bufs_count &&
+           obj_cache_is_buf_dirty(obj_bufs, buf_index + count)) {
+      count++;
+    }
+    vector range_bufs = obj_cache_bufs_range(obj_bufs, buf_index, count);
+    uint offset = buf_index * BUF_DATA_SIZE;
+    uint range_size = min(count * BUF_DATA_SIZE, size - offset);
+    err = write_object_range(dev, name, offset, range_size, range_bufs);
+    if (NO_ERR == err) {
+      for (uint range_index = 0; range_index < count; range_index++) {
+        struct buf *curr_buf;
+        memmove_from_vector((char *)&curr_buf, range_bufs, range_index, 1);
+        obj_cache_mark_clean(curr_buf, 1);
+      }
+      acquire(&obj_cache.lock);
+      obj_cache.writebacks++;
+      release(&obj_cache.lock);
+    }
+    freevector(&range_bufs);
+    buf_index += count;
+  }
+
+  // A write which grew the object past the locked bufs keeps it dirty.
+  acquire(&obj_cache.lock);
+  index = obj_cache_find_dirty(dev, name);
+  if (NO_ERR == err && index >= 0 &&
+      obj_cache.dirty_objects[index].size <= bufs_size) {
+    obj_cache_remove_dirty(index);
+  }
+  release(&obj_cache.lock);
+
+  obj_cache_release_bufs(obj_bufs);
+
+  return err;
+}
+
+uint obj_cache_sync(struct device *dev) {
+  char name[MAX_OBJECT_NAME_LENGTH];
+  struct device *object_dev = 0;
+  uint err = NO_ERR;
+
+  // The objects dirtied meanwhile are left to the next sync, so it ends even
+  // when others keep writing.
+  acquire(&obj_cache.lock);
+  uint left = obj_cache.dirty_objects_count;
+  release(&obj_cache.lock);
+  for (; left > 0 && NO_ERR == err; left--) {
+    int found = 0;
+    acquire(&obj_cache.lock);
+    for (uint index = 0; index < obj_cache.dirty_objects_count; index++) {
+      struct obj_cache_dirty_object *object = &obj_cache.dirty_objects[index];
+      if (dev == 0 || object->dev == dev) {
+        object_dev = object->dev;
+        memmove(name, object->name, MAX_OBJECT_NAME_LENGTH);
+        found = 1;
+        break;
+      }
+    }
+    release(&obj_cache.lock);
+    if (!found) {
+      break;
+    }
+    err = obj_cache_flush(object_dev, name);
+  }
+
+  return err;
+}
+
+void obj_cache_flusher(void) {
+  for (;;) {
+    acquire(&tickslock);
+    uint start = ticks;
+    while (ticks - start < OBJ_CACHE_FLUSH_INTERVAL) {
+      sleep(&ticks, &tickslock);
+    }
+    release(&tickslock);
+
+    if (NO_ERR != obj_cache_sync(0)) {
+      panic("obj_cache_flusher: failed writing back");
+    }
+  }
+}
+
 uint objects_cache_hits() {
   uint hits;
 
@@ -377,3 +714,53 @@ uint objects_cache_misses() {
 
   return misses;
 }
+
+uint objects_cache_readahead_hits() {
+  uint readahead_hits;
+
+  acquire(&obj_cache.lock);
+  readahead_hits = obj_cache.readahead_hits;
+  release(&obj_cache.lock);
+
+  return readahead_hits;
+}
+
+uint objects_cache_readahead_misses() {
+  uint readahead_misses;
+
+  acquire(&obj_cache.lock);
+  readahead_misses = obj_cache.readahead_misses;
+  release(&obj_cache.lock);
+
+  return readahead_misses + buf_cache_readahead_evictions();
+}
+
+uint objects_cache_dirty() {
+  uint dirty_blocks;
+
+  acquire(&obj_cache.lock);
+  dirty_blocks = obj_cache.dirty_blocks;
+  release(&obj_cache.lock);
+
+  return dirty_blocks;
+}
+
+uint objects_cache_writes() {
+  uint writes;
+
+  acquire(&obj_cache.lock);
+  writes = obj_cache.writes;
+  release(&obj_cache.lock);
+
+  return writes;
+}
+
+uint objects_cache_writebacks() {
+  uint writebacks;
+
+  acquire(&obj_cache.lock);
+  writebacks = obj_cache.writebacks;
+  release(&obj_cache.lock);
+
+  return writebacks;
+}
@@ -17,17 +17,48 @@
  * Big objects might take a lot of cache space. When the usage is of only a
  * small part of a big object, following cache buffer allocations will cause
  * invalidation of much more useful cache buffers instead of using the now
- * unused cache buffers of the big object. Therefore, cache only buffers around
- * the requested data area, and use the rest of the buffers as temporal memory.
+ * unused cache buffers of the big object. Therefore, reads and writes get
+ * buffers only for the blocks they cover, and on a cache miss only the missing
+ * blocks are read from the disk. Adding an object caches only buffers around
+ * its beginning, and uses the rest of the buffers as temporal memory.
+ *
+ * Write-back
+ * ~~~~~~~~~~
+ * Adding and deleting objects reach the disk at once, but writes only dirty
+ * the buffers they cover. The dirty buffers are pinned in the cache and the
+ * following writes to the same blocks are absorbed by them, so a file which
+ * is written in small chunks is written to the disk once. The dirty objects
+ * are written back by `obj_cache_flush` and `obj_cache_sync`, which the file
+ * system calls when the last reference to an inode is dropped and when it is
+ * unmounted, by writers when more than `OBJ_CACHE_DIRTY_LIMIT` blocks are
+ * dirty, and by a kernel thread every `OBJ_CACHE_FLUSH_INTERVAL` ticks. Each
+ * run of contiguous dirty blocks of an object is written by a single
+ * `write_object_range`. The dirty buffers are charged to the `file_dirty`
+ * memory stat of the writer cgroup until they are written back.
+ *
+ * Readahead
+ * ~~~~~~~~~
+ * The file system reads the blocks ahead of a sequential reader by
+ * `obj_cache_readahead_start`. Their bufs are marked `B_READAHEAD` until the
+ * first read of them, which counts a readahead hit, or until they are dropped
+ * from the cache, which counts a readahead miss.
  */
 
 #include "buf.h"
 #include "kvector.h"
+#include "obj_queue.h"
+#include "param.h"
 #include "types.h"
 
 /* The number of blocks to cache around the requested contiguous data area. */
 #define OBJ_CACHE_BLOCKS_PADDING (3)
 
+/* The amount of dirty blocks above which writers flush the dirty objects. */
+#define OBJ_CACHE_DIRTY_LIMIT (NBUF / 4)
+
+/* The ticks between the runs of the flusher thread. */
+#define OBJ_CACHE_FLUSH_INTERVAL (100)
+
 #define OFFSET_ROUND_DOWN(offset) ((offset) & ~(BUF_DATA_SIZE - 1))
 #define OFFSET_ROUND_UP(offset) \
   (OFFSET_ROUND_DOWN((offset) + BUF_DATA_SIZE - 1))
@@ -46,6 +77,47 @@ uint obj_cache_read(struct device* dev, const char* name, vector* dst,
                     uint size, uint offset, uint obj_size);
 uint obj_cache_delete(struct device* dev, const char* name, uint obj_size);
 
+/* Same as `obj_cache_read`, but copies the data into `dst` starting at
+ * `dst_offset`. Used to gather a single read out of several objects. */
+uint obj_cache_read_at(struct device* dev, const char* name, vector* dst,
+                       uint dst_offset, uint size, uint offset, uint obj_size);
+
+/* A read of an object which is in progress. Several reads can be in flight,
+ * as long as they do not cover the same blocks. */
+struct obj_cache_read {
+  struct obj_request request;
+  uint size;
+  uint offset;
+};
+
+/* Same as `obj_cache_read_at`, split into starting the read and waiting for
+ * it to end. The object name is used only by `obj_cache_read_start`. The
+ * read holds its cache buffers until `obj_cache_read_end` is called, which
+ * must be called even if the start failed. */
+void obj_cache_read_start(struct obj_cache_read* read, struct device* dev,
+                          const char* name, uint size, uint offset,
+                          uint obj_size);
+uint obj_cache_read_end(struct obj_cache_read* read, vector* dst,
+                        uint dst_offset);
+
+/* Same as `obj_cache_read_start`, but only brings the blocks into the cache,
+ * ahead of a sequential reader. The read is ended by `obj_cache_read_end`
+ * with a null `dst`. */
+void obj_cache_readahead_start(struct obj_cache_read* read, struct device* dev,
+                               const char* name, uint size, uint offset,
+                               uint obj_size);
+
+/* Writes back the dirty blocks of the object. The object might be written
+ * meanwhile, so its inode doesn't have to be locked. */
+uint obj_cache_flush(struct device* dev, const char* name);
+
+/* Writes back the dirty objects of the device, or of all the devices if `dev`
+ * is null. */
+uint obj_cache_sync(struct device* dev);
+
+/* The body of the flusher kernel thread, which never returns. */
+void obj_cache_flusher(void);
+
 /**
  * The following methods provides statistics about the cache layer. They can
  * used by program to show performance of the file system or to try and
@@ -54,6 +126,15 @@ uint obj_cache_delete(struct device* dev, const char* name, uint obj_size);
 
 uint objects_cache_hits();
 uint objects_cache_misses();
+/* The amount of blocks read ahead which were then read from the cache, and
+ * which were dropped before they were read. */
+uint objects_cache_readahead_hits();
+uint objects_cache_readahead_misses();
+/* The amount of dirty blocks. */
+uint objects_cache_dirty();
+/* The amount of writes to the cache, and of writes of it to the disk. */
+uint objects_cache_writes();
+uint objects_cache_writebacks();
 uint cache_max_object_size();
 
 #endif /* XV6_DEVICE_OBJ_CACHE_H */
@@ -0,0 +1,78 @@
+#include "obj_checksum.h"
+
+// The Castagnoli polynomial, bit reversed.
+#define CRC32C_POLY 0x82f63b78u
+
+static uint crc32c_table[8][256];
+// x^(2^k) modulo the polynomial, for a CRC shifted by 2^k bits.
+static uint crc32c_x2n_table[32];
+
+static inline uint crc32c_read32(const char* p) {
+  return (uchar)p[0] | ((uchar)p[1] << 8) | ((uchar)p[2] << 16) |
+         ((uint)(uchar)p[3] << 24);
+}
+
+// Multiplies `a` by `b` modulo the polynomial. In the bit reversed order, the
+// top bit is x^0.
+static uint crc32c_multmodp(uint a, uint b) {
+  uint product = 0;
+
+  for (uint m = 1u << 31; m != 0; m >>= 1) {
+    if (a & m) {
+      product ^= b;
+    }
+    b = (b & 1) ? (b >> 1) ^ CRC32C_POLY : b >> 1;
+  }
+  return product;
+}
+
+void obj_checksum_init(void) {
+  uint p = 1u << 30;  // x^1
+
+  for (uint n = 0; n < 256; n++) {
+    uint crc = n;
+    for (uint bit = 0; bit < 8; bit++) {
+      crc = (crc & 1) ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+    }
+    crc32c_table[0][n] = crc;
+  }
+  for (uint n = 0; n < 256; n++) {
+    for (uint k = 1; k < 8; k++) {
+      uint prev = crc32c_table[k - 1][n];
+      crc32c_table[k][n] = (prev >> 8) ^ crc32c_table[0][prev & 0xff];
+    }
+  }
+  for (uint k = 0; k < 32; k++) {
+    crc32c_x2n_table[k] = p;
+    p = crc32c_multmodp(p, p);
+  }
+}
+
+uint obj_crc32c(uint crc, const char* data, uint size) {
+  crc = ~crc;
+  for (; size >= 8; data += 8, size -= 8) {
+    uint low = crc32c_read32(data) ^ crc;
+    uint high = crc32c_read32(data + 4);
+    crc = crc32c_table[7][low & 0xff] ^ crc32c_table[6][(low >> 8) & 0xff] ^
+          crc32c_table[5][(low >> 16) & 0xff] ^ crc32c_table[4][low >> 24] ^
+          crc32c_table[3][high & 0xff] ^ crc32c_table[2][(high >> 8) & 0xff] ^
+          crc32c_table[1][(high >> 16) & 0xff] ^ crc32c_table[0][high >> 24];
+  }
+  for (; size > 0; data++, size--) {
+    crc = crc32c_table[0][(crc ^ (uchar)*data) & 0xff] ^ (crc >> 8);
+  }
+  return ~crc;
+}
+
+uint obj_crc32c_patch(uint crc, uint delta, uint tail) {
+  // The change of the CRC is `delta` followed by `tail` zero bytes, that is
+  // `delta` times x^(8 * tail).
+  uint shift = 1u << 31;  // x^0
+
+  for (uint k = 3; tail != 0; tail >>= 1, k++) {
+    if (tail & 1) {
+      shift = crc32c_multmodp(crc32c_x2n_table[k & 31], shift);
+    }
+  }
+  return crc ^ crc32c_multmodp(shift, delta);
+}
@@ -0,0 +1,38 @@
+#ifndef XV6_DEVICE_OBJ_CHECKSUM_H
+#define XV6_DEVICE_OBJ_CHECKSUM_H
+
+/**
+ * Objects content checksums.
+ *
+ * CRC32C
+ * ======
+ * The CRC with the Castagnoli polynomial, as used by iSCSI and ext4. The
+ * kernel is built without SSE, so the `crc32` instruction is not available
+ * and the CRC is computed by the slice-by-8 method: 8 tables of 256 entries
+ * fold 8 bytes into the CRC at a time, with independent lookups that the
+ * processor runs in parallel. The tables take 8KB and are built by
+ * `obj_checksum_init`.
+ *
+ * A CRC is linear, which lets the checksum of an object be updated when a
+ * range of it is overwritten, from the checksums of the old and the new
+ * range only (see `obj_crc32c_patch`).
+ */
+
+#include "types.h"
+
+void obj_checksum_init(void);
+
+/**
+ * Returns the CRC32C of `size` bytes of `data`, continuing the CRC32C `crc`
+ * of the bytes before them. The CRC32C of no bytes is 0.
+ */
+uint obj_crc32c(uint crc, const char* data, uint size);
+
+/**
+ * Returns the CRC32C `crc` of a content after a range of it is overwritten.
+ * `delta` is the CRC32C of the old range XOR the CRC32C of the new one, both
+ * starting from 0, and `tail` is the amount of bytes after the range.
+ */
+uint obj_crc32c_patch(uint crc, uint delta, uint tail);
+
+#endif /* XV6_DEVICE_OBJ_CHECKSUM_H */
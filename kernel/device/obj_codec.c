@@ -0,0 +1,136 @@
+#include "obj_codec.h"
+
+#include "defs.h"
+
+#define OBJ_LZ_NIBBLE_MAX 15
+
+static inline uint lz_read32(const char* p) {
+  return (uchar)p[0] | ((uchar)p[1] << 8) | ((uchar)p[2] << 16) |
+         ((uint)(uchar)p[3] << 24);
+}
+
+static inline uint lz_hash(uint sequence) {
+  return (sequence * 2654435761u) >> (32 - OBJ_LZ_HASH_BITS);
+}
+
+// Writes the extension bytes of a length whose nibble is full.
+static int lz_put_length(char* dst, uint capacity, uint* out, uint length) {
+  for (; length >= 255; length -= 255) {
+    if (*out >= capacity) return 0;
+    dst[(*out)++] = (char)255;
+  }
+  if (*out >= capacity) return 0;
+  dst[(*out)++] = (char)length;
+  return 1;
+}
+
+// Writes a sequence of `literals` bytes of `src`, followed by a match of
+// `match` bytes at `offset` back, or by nothing if `match` is 0.
+static int lz_put_sequence(char* dst, uint capacity, uint* out,
+                           const char* src, uint literals, uint offset,
+                           uint match) {
+  uint literals_nibble = min(literals, OBJ_LZ_NIBBLE_MAX);
+  uint match_nibble = 0;
+
+  if (match > 0) {
+    match_nibble = min(match - OBJ_LZ_MIN_MATCH, OBJ_LZ_NIBBLE_MAX);
+  }
+  if (*out >= capacity) return 0;
+  dst[(*out)++] = (char)((literals_nibble << 4) | match_nibble);
+  if (literals_nibble == OBJ_LZ_NIBBLE_MAX &&
+      !lz_put_length(dst, capacity, out, literals - OBJ_LZ_NIBBLE_MAX))
+    return 0;
+  if (literals > capacity - *out) return 0;
+  memmove(dst + *out, src, literals);
+  *out += literals;
+
+  if (match == 0) return 1;
+  if (capacity - *out < 2) return 0;
+  dst[(*out)++] = (char)(offset & 0xff);
+  dst[(*out)++] = (char)(offset >> 8);
+  if (match_nibble == OBJ_LZ_NIBBLE_MAX &&
+      !lz_put_length(dst, capacity, out,
+                     match - OBJ_LZ_MIN_MATCH - OBJ_LZ_NIBBLE_MAX))
+    return 0;
+  return 1;
+}
+
+uint obj_lz_compress(const char* src, uint size, char* dst, uint capacity,
+                     ushort* table) {
+  uint anchor = 0;
+  uint out = 0;
+
+  if (size > OBJ_LZ_MAX_INPUT) return 0;
+  // A slot holds a position plus one, zero marks an empty slot.
+  memset(table, 0, OBJ_LZ_TABLE_SIZE);
+  for (uint pos = 0; pos + OBJ_LZ_MIN_MATCH <= size;) {
+    uint sequence = lz_read32(src + pos);
+    uint slot = lz_hash(sequence);
+    uint candidate = table[slot];
+    table[slot] = pos + 1;
+    if (candidate == 0 || lz_read32(src + candidate - 1) != sequence) {
+      pos++;
+      continue;
+    }
+    candidate--;
+
+    uint match = OBJ_LZ_MIN_MATCH;
+    while (pos + match < size && src[candidate + match] == src[pos + match]) {
+      match++;
+    }
+    if (!lz_put_sequence(dst, capacity, &out, src + anchor, pos - anchor,
+                         pos - candidate, match))
+      return 0;
+    pos += match;
+    anchor = pos;
+  }
+  if (!lz_put_sequence(dst, capacity, &out, src + anchor, size - anchor, 0, 0))
+    return 0;
+
+  return out;
+}
+
+// Reads the extension bytes of a length whose nibble is full.
+static int lz_get_length(const char* src, uint size, uint* in, uint* length) {
+  uint byte;
+
+  do {
+    if (*in >= size) return 0;
+    byte = (uchar)src[(*in)++];
+    *length += byte;
+  } while (byte == 255);
+  return 1;
+}
+
+int obj_lz_decompress(const char* src, uint size, char* dst, uint capacity) {
+  uint in = 0;
+  uint out = 0;
+
+  while (in < size) {
+    uint token = (uchar)src[in++];
+    uint literals = token >> 4;
+    if (literals == OBJ_LZ_NIBBLE_MAX &&
+        !lz_get_length(src, size, &in, &literals))
+      return -1;
+    if (literals > size - in || literals > capacity - out) return -1;
+    memmove(dst + out, src + in, literals);
+    in += literals;
+    out += literals;
+    if (in == size) break;
+
+    if (size - in < 2) return -1;
+    uint offset = (uchar)src[in] | ((uchar)src[in + 1] << 8);
+    in += 2;
+    uint match = token & OBJ_LZ_NIBBLE_MAX;
+    if (match == OBJ_LZ_NIBBLE_MAX && !lz_get_length(src, size, &in, &match))
+      return -1;
+    match += OBJ_LZ_MIN_MATCH;
+    if (offset == 0 || offset > out || match > capacity - out) return -1;
+    // The match might overlap the bytes it produces, copy forward.
+    for (uint k = 0; k < match; k++, out++) {
+      dst[out] = dst[out - offset];
+    }
+  }
+
+  return out;
+}
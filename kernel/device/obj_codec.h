@@ -0,0 +1,44 @@
+#ifndef XV6_DEVICE_OBJ_CODEC_H
+#define XV6_DEVICE_OBJ_CODEC_H
+
+/**
+ * Objects content codecs.
+ *
+ * LZ codec
+ * ========
+ * A byte oriented LZ77 codec, in the spirit of LZ4, fast enough to compress
+ * every write. The compressed content is a sequence of:
+ * - A token byte. The high nibble is the literals length and the low nibble
+ *   is the match length minus `OBJ_LZ_MIN_MATCH`. A nibble of 15 is followed
+ *   by bytes adding to the length, until a byte which is not 255.
+ * - The literals.
+ * - The match offset back from the current position, 2 bytes little endian.
+ *   The last sequence ends after its literals and has no match.
+ * Matches are found by a hash table of the positions of 4 bytes sequences,
+ * which is kept by the caller, so the codec itself needs no memory.
+ */
+
+#include "types.h"
+
+#define OBJ_LZ_MIN_MATCH 4
+#define OBJ_LZ_HASH_BITS 11
+/* The size in bytes of the hash table `obj_lz_compress` needs. */
+#define OBJ_LZ_TABLE_SIZE ((1 << OBJ_LZ_HASH_BITS) * sizeof(ushort))
+/* The maximal size of content `obj_lz_compress` accepts. */
+#define OBJ_LZ_MAX_INPUT 0xffff
+
+/**
+ * Compresses `size` bytes of `src` into `dst`. Returns the compressed size,
+ * or 0 if it would exceed `capacity` bytes.
+ */
+uint obj_lz_compress(const char* src, uint size, char* dst, uint capacity,
+                     ushort* table);
+
+/**
+ * Decompresses `size` bytes of `src` into `dst`, which has room for
+ * `capacity` bytes. Returns the decompressed size, or -1 if the compressed
+ * content is corrupted.
+ */
+int obj_lz_decompress(const char* src, uint size, char* dst, uint capacity);
+
+#endif /* XV6_DEVICE_OBJ_CODEC_H */
@@ -1,5 +1,7 @@
 #include "obj_device.h"
 
+#include "defs.h"
+#include "fs/vfs_file.h"
 #include "obj_disk.h"
 
 struct device* create_obj_device() {
@@ -9,3 +11,55 @@ struct device* create_obj_device() {
   release(&dev_holder.lock);
   return dev;
 }
+
+struct device* create_backed_obj_device(struct device* backing_dev) {
+  acquire(&dev_holder.lock);
+  struct device* dev = _get_new_device(DEVICE_TYPE_OBJ);
+  release(&dev_holder.lock);
+  if (dev == NULL) {
+    return NULL;
+  }
+
+  // Loading reads the backing device, hence it is done without the lock.
+  if (load_obj_device(dev, backing_dev) != NO_ERR) {
+    deviceput(dev);
+    return NULL;
+  }
+  // The store is written in place, within the file of a loop device.
+  struct vfs_inode* backing = getinodefordevice(backing_dev);
+  if (backing != NULL && device_size(dev->private) > backing->size) {
+    cprintf("obj device: the store is larger than its file\n");
+    deviceput(dev);
+    return NULL;
+  }
+  return dev;
+}
+
+struct device* get_obj_snapshot_device(struct device* backing_dev) {
+  acquire(&dev_holder.lock);
+  for (struct device* dev = dev_holder.devs; dev < &dev_holder.devs[NMAXDEVS];
+       dev++) {
+    struct obj_device_private* device = dev_private(dev);
+    if (dev->ref > 0 && dev->type == DEVICE_TYPE_OBJ && device != NULL &&
+        device->backing_dev == backing_dev && device->frozen) {
+      dev->ref++;
+      release(&dev_holder.lock);
+      return dev;
+    }
+  }
+  release(&dev_holder.lock);
+  return NULL;
+}
+
+struct device* create_obj_clone_device(struct device* base) {
+  acquire(&dev_holder.lock);
+  struct device* dev = _get_new_device(DEVICE_TYPE_OBJ);
+  release(&dev_holder.lock);
+  if (dev == NULL) {
+    return NULL;
+  }
+
+  freeze_obj_device(base);
+  init_obj_clone_device(dev, base);
+  return dev;
+}
@@ -3,5 +3,12 @@
 
 #include "device.h"
 struct device* create_obj_device();
+// Creates a device whose store is loaded from the block device `backing_dev`.
+struct device* create_backed_obj_device(struct device* backing_dev);
+// Returns the snapshot of the store of `backing_dev` which the clones of the
+// store share, or NULL if no clone of it is mounted.
+struct device* get_obj_snapshot_device(struct device* backing_dev);
+// Freezes `base` as a snapshot and creates a writable clone of it.
+struct device* create_obj_clone_device(struct device* base);
 
 #endif  // XV6_DEVICE_OBJ_DEVICE_H
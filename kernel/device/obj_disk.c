@@ -1,32 +1,154 @@
-// Required for new gcc versions such as 9.4.0
-#pragma GCC diagnostic ignored "-Wstack-usage="
-
 #include "obj_disk.h"
 
+#include "bio.h"
 #include "buf.h"
 #include "defs.h"
 #include "device.h"
 #include "device/buf_cache.h"
 #include "kvector.h"
+#include "mmu.h"
+#include "obj_checksum.h"
+#include "obj_codec.h"
 #include "sleeplock.h"
 #include "types.h"
 
+_Static_assert(OBJECTS_TABLE_MAX_ENTRIES < 0xffff,
+               "objects table entry indices must fit in ushort");
+
 static inline int entry_index_to_entry_offset(
     const struct obj_device_private* const device, const int index) {
   return device->sb.objects_table_offset + index * sizeof(objects_table_entry);
 }
 
+// FNV-1a over the object id. Ids are compared by `obj_id_cmp`, hence we
+// stop at the null terminator or after `OBJECT_ID_LENGTH` bytes.
+static uint obj_id_hash(const char* object_id) {
+  uint hash = 2166136261u;
+  for (uint i = 0; i < OBJECT_ID_LENGTH && object_id[i]; i++) {
+    hash ^= (uchar)object_id[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+static inline uint objects_index_home_slot(const char* object_id) {
+  return obj_id_hash(object_id) % OBJECTS_INDEX_SIZE;
+}
+
+static inline uint objects_index_next_slot(uint slot) {
+  return (slot + 1) % OBJECTS_INDEX_SIZE;
+}
+
+// Whether, after emptying slot `hole`, the index entry at `slot` whose home
+// slot is `home` is still reachable from its home. That is when its home is
+// cyclically in (hole, slot].
+static inline int index_slot_stays(uint hole, uint home, uint slot) {
+  return (hole <= slot) ? (hole < home && home <= slot)
+                        : (hole < home || home <= slot);
+}
+
+// Returns the index slot holding the object `name`, or `OBJECTS_INDEX_SIZE`
+// when the object is not indexed.
+static uint objects_index_find_slot(struct obj_device_private* device,
+                                    const char* name) {
+  ushort* index = device->storage_holder->objects_index;
+  for (uint slot = objects_index_home_slot(name); index[slot] != 0;
+       slot = objects_index_next_slot(slot)) {
+    objects_table_entry* entry =
+        get_objects_table_entry(device, index[slot] - 1);
+    if (obj_id_cmp(entry->object_id, name) == 0) {
+      return slot;
+    }
+  }
+  return OBJECTS_INDEX_SIZE;
+}
+
+static void objects_index_insert(struct obj_device_private* device,
+                                 uint entry_index) {
+  ushort* index = device->storage_holder->objects_index;
+  objects_table_entry* entry = get_objects_table_entry(device, entry_index);
+  uint slot = objects_index_home_slot(entry->object_id);
+  while (index[slot] != 0) {
+    slot = objects_index_next_slot(slot);
+  }
+  index[slot] = entry_index + 1;
+}
+
+// Removes the object `name` from the index. Linear probing requires that no
+// empty slot separates an entry from its home slot, so instead of leaving a
+// tombstone we shift back the following entries of the probe sequence.
+static void objects_index_remove(struct obj_device_private* device,
+                                 const char* name) {
+  ushort* index = device->storage_holder->objects_index;
+  uint hole = objects_index_find_slot(device, name);
+  if (hole == OBJECTS_INDEX_SIZE) {
+    panic("objects_index_remove: object is not indexed");
+  }
+
+  for (uint slot = objects_index_next_slot(hole); index[slot] != 0;
+       slot = objects_index_next_slot(slot)) {
+    objects_table_entry* entry =
+        get_objects_table_entry(device, index[slot] - 1);
+    uint home = objects_index_home_slot(entry->object_id);
+    if (!index_slot_stays(hole, home, slot)) {
+      index[hole] = index[slot];
+      hole = slot;
+    }
+  }
+  index[hole] = 0;
+}
+
+static inline uint content_index_home_slot(uint content_hash) {
+  return content_hash % OBJECTS_INDEX_SIZE;
+}
+
+static void content_index_insert(struct obj_device_private* device,
+                                 uint entry_index) {
+  ushort* index = device->storage_holder->content_index;
+  objects_table_entry* entry = get_objects_table_entry(device, entry_index);
+  uint slot = content_index_home_slot(entry->content_hash);
+  while (index[slot] != 0) {
+    slot = objects_index_next_slot(slot);
+  }
+  index[slot] = entry_index + 1;
+}
+
+// Removes entry `entry_index` from the content index, like
+// `objects_index_remove`. Returns whether the entry was indexed.
+static int content_index_remove(struct obj_device_private* device,
+                                uint entry_index) {
+  ushort* index = device->storage_holder->content_index;
+  objects_table_entry* entry = get_objects_table_entry(device, entry_index);
+  uint hole = content_index_home_slot(entry->content_hash);
+  while (index[hole] != 0 && index[hole] != entry_index + 1) {
+    hole = objects_index_next_slot(hole);
+  }
+  if (index[hole] == 0) {
+    return 0;
+  }
+
+  for (uint slot = objects_index_next_slot(hole); index[slot] != 0;
+       slot = objects_index_next_slot(slot)) {
+    entry = get_objects_table_entry(device, index[slot] - 1);
+    uint home = content_index_home_slot(entry->content_hash);
+    if (!index_slot_stays(hole, home, slot)) {
+      index[hole] = index[slot];
+      hole = slot;
+    }
+  }
+  index[hole] = 0;
+  return 1;
+}
+
 uint get_objects_table_index(struct obj_device_private* device,
                              const char* name, uint* output) {
-  for (uint i = 0; i < get_object_table_size(device); ++i) {
-    objects_table_entry* entry = get_objects_table_entry(device, i);
-    if (entry->occupied && obj_id_cmp(entry->object_id, name) == 0) {
-      *output = i;
-      return NO_ERR;
-    }
+  uint slot = objects_index_find_slot(device, name);
+  if (slot == OBJECTS_INDEX_SIZE) {
+    return OBJECT_NOT_EXISTS;
   }
 
-  return OBJECT_NOT_EXISTS;
+  *output = device->storage_holder->objects_index[slot] - 1;
+  return NO_ERR;
 }
 
 objects_table_entry* get_objects_table_entry(struct obj_device_private* device,
@@ -35,14 +157,178 @@ objects_table_entry* get_objects_table_entry(struct obj_device_private* device,
       ->memory_storage[entry_index_to_entry_offset(device, entry_index)];
 }
 
-uint flush_objects_table_entry(uint offset) {
-  /**
-   * Currently, because the implemntation is memory only, writing to the
-   * entry received by `objects_table_entry` changes the table itself.
-   * In the future, this method would write the specific bytes to the disk.
-   */
+// The entry holding the content of entry `i`, which is `i` itself unless it
+// shares the content of another object.
+static objects_table_entry* content_entry(struct obj_device_private* device,
+                                          uint i) {
+  objects_table_entry* entry = get_objects_table_entry(device, i);
+  if (entry->shared_with == 0) {
+    return entry;
+  }
+  return get_objects_table_entry(device, entry->shared_with - 1);
+}
 
-  return NO_ERR;
+// Whether the content of the entry is in the base snapshot, that is the
+// object was not written since the device was cloned.
+static inline int entry_in_base(struct obj_device_private* device,
+                                objects_table_entry* entry) {
+  return device->base != NULL && entry->generation < device->sb.generation;
+}
+
+// The entry holding the content of entry `i`, and in `device`, the device
+// whose store holds it.
+static objects_table_entry* content_location(
+    struct obj_device_private** device, uint i) {
+  if (entry_in_base(*device, get_objects_table_entry(*device, i))) {
+    *device = dev_private((*device)->base);
+  }
+  return content_entry(*device, i);
+}
+
+/**
+ * Store access.
+ * All the accesses to the store, except for the objects table entries, go
+ * through the methods below, which either copy the memory storage or read and
+ * write the blocks of the backing device. The objects table entries are
+ * always accessed in the memory storage and written through to the backing
+ * device by `flush_objects_table_entry`.
+ */
+static void backing_dev_rw(struct obj_device_private* device, uint offset,
+                           char* data, uint size, int write) {
+  while (size > 0) {
+    uint block_offset = offset % BSIZE;
+    uint bytes = min(BSIZE - block_offset, size);
+    struct buf* b = bread(device->backing_dev, offset / BSIZE);
+    if (write) {
+      memmove(b->data + block_offset, data, bytes);
+      bwrite(b);
+    } else {
+      memmove(data, b->data + block_offset, bytes);
+    }
+    buf_cache_release(b);
+    offset += bytes;
+    data += bytes;
+    size -= bytes;
+  }
+}
+
+static void store_read(struct obj_device_private* device, uint offset,
+                       char* dst, uint size) {
+  if (device->backing_dev == NULL) {
+    memmove(dst, device->storage_holder->memory_storage + offset, size);
+    return;
+  }
+  backing_dev_rw(device, offset, dst, size, 0);
+}
+
+static void store_write(struct obj_device_private* device, uint offset,
+                        const char* src, uint size) {
+  if (device->backing_dev == NULL) {
+    memmove(device->storage_holder->memory_storage + offset, src, size);
+    return;
+  }
+  backing_dev_rw(device, offset, (char*)src, size, 1);
+}
+
+// Moves `size` bytes from offset `src` to offset `dst`. The ranges may
+// overlap.
+static void store_move(struct obj_device_private* device, uint dst, uint src,
+                       uint size) {
+  char chunk[BSIZE];
+
+  if (device->backing_dev == NULL) {
+    char* storage = device->storage_holder->memory_storage;
+    memmove(storage + dst, storage + src, size);
+    return;
+  }
+  // Copy in chunks, starting from the end of the range that is overwritten
+  // last.
+  for (uint moved = 0; moved < size;) {
+    uint bytes = min(sizeof(chunk), size - moved);
+    uint chunk_offset = dst > src ? size - moved - bytes : moved;
+    store_read(device, src + chunk_offset, chunk, bytes);
+    store_write(device, dst + chunk_offset, chunk, bytes);
+    moved += bytes;
+  }
+}
+
+static void flush_objects_table_entry(struct obj_device_private* device,
+                                      uint entry_index) {
+  // In the memory storage, the entry is already in the store.
+  if (device->backing_dev == NULL) {
+    return;
+  }
+  uint offset = entry_index_to_entry_offset(device, entry_index);
+  store_write(device, offset, device->storage_holder->memory_storage + offset,
+              sizeof(objects_table_entry));
+}
+
+// The bytes of a store on a block device that are hashed or compared at a
+// time. Two chunks fit in a scratch page.
+#define STORE_SCAN_CHUNK (PGSIZE / 2)
+
+// Returns the store bytes at `offset`. When the store is on a block device,
+// at most `STORE_SCAN_CHUNK` of them are read into `scratch`. `size` is set to
+// the amount of bytes returned.
+static const char* store_peek(struct obj_device_private* device, uint offset,
+                              uint* size, char* scratch) {
+  if (device->backing_dev == NULL) {
+    return device->storage_holder->memory_storage + offset;
+  }
+  *size = min(*size, STORE_SCAN_CHUNK);
+  store_read(device, offset, scratch, *size);
+  return scratch;
+}
+
+// FNV-1a over `size` bytes of the store.
+static uint store_hash(struct obj_device_private* device, uint offset,
+                       uint size, char* scratch) {
+  uint hash = 2166136261u;
+  while (size > 0) {
+    uint bytes = size;
+    const char* data = store_peek(device, offset, &bytes, scratch);
+    for (uint k = 0; k < bytes; k++) {
+      hash ^= (uchar)data[k];
+      hash *= 16777619u;
+    }
+    offset += bytes;
+    size -= bytes;
+  }
+  return hash;
+}
+
+// CRC32C of `size` bytes of the store, continuing the CRC32C `crc`.
+static uint store_checksum(struct obj_device_private* device, uint crc,
+                           uint offset, uint size) {
+  char chunk[BSIZE];
+
+  if (device->backing_dev == NULL) {
+    return obj_crc32c(crc, device->storage_holder->memory_storage + offset,
+                      size);
+  }
+  for (uint done = 0; done < size;) {
+    uint bytes = min(sizeof(chunk), size - done);
+    store_read(device, offset + done, chunk, bytes);
+    crc = obj_crc32c(crc, chunk, bytes);
+    done += bytes;
+  }
+  return crc;
+}
+
+static int store_equal(struct obj_device_private* device, uint a, uint b,
+                       uint size, char* scratch) {
+  while (size > 0) {
+    uint bytes = size;
+    const char* x = store_peek(device, a, &bytes, scratch);
+    const char* y = store_peek(device, b, &bytes, scratch + STORE_SCAN_CHUNK);
+    if (memcmp(x, y, bytes) != 0) {
+      return 0;
+    }
+    a += bytes;
+    b += bytes;
+    size -= bytes;
+  }
+  return 1;
 }
 
 int obj_id_cmp(const char* p, const char* q) {
@@ -63,115 +349,566 @@ uint obj_id_bytes(const char* object_id) {
   return bytes;
 }
 
-void swap(uint* xp, uint* yp) {
-  int temp = *xp;
-  *xp = *yp;
-  *yp = temp;
+/**
+ * Store space management.
+ * The space map (see `struct objects_space_map`) links the occupied objects
+ * by their disk offset and bins the gaps between them by size. Every change
+ * in the extent of an object must be reflected in the map:
+ * - `space_map_link` when an object gets an extent.
+ * - `space_map_unlink` when the extent is released.
+ * - `space_map_resize` when the object shrinks in place.
+ */
+static inline struct objects_space_map* space_map(
+    struct obj_device_private* device) {
+  return &device->storage_holder->space_map;
+}
+
+// The first byte after the extent of entry `i`. For the list head, this is
+// the first byte of the store.
+static uint extent_end(struct obj_device_private* device, uint i) {
+  if (i == 0) {
+    return device->sb.store_offset;
+  }
+  objects_table_entry* entry = get_objects_table_entry(device, i);
+  return entry->disk_offset + entry->size;
+}
+
+// The first byte of the extent of entry `i`. For the list head, this is the
+// end of the device.
+static uint extent_start(struct obj_device_private* device, uint i) {
+  if (i == 0) {
+    return device->sb.storage_device_size;
+  }
+  return get_objects_table_entry(device, i)->disk_offset;
+}
+
+// The free bytes between the extent of entry `i` and the next extent.
+static uint gap_size(struct obj_device_private* device, uint i) {
+  return extent_start(device, space_map(device)->order_next[i]) -
+         extent_end(device, i);
 }
 
-void bubble_sort(struct obj_device_private* device, uint* arr, uint n) {
-  if (n >= 2) {
-    for (uint i = 0; i < n - 1; i++) {
-      for (uint j = 0; j < n - i - 1; j++) {
-        if (get_objects_table_entry(device, arr[j])->disk_offset >
-            get_objects_table_entry(device, arr[j + 1])->disk_offset) {
-          swap(&arr[j], &arr[j + 1]);  // NOLINT(build/include_what_you_use)
-        }
+static uint gap_bin_of(uint size) {
+  uint bin = 0;
+  while (size >>= 1) {
+    bin++;
+  }
+  return bin;
+}
+
+static void space_map_unbin_gap(struct obj_device_private* device, uint i) {
+  struct objects_space_map* map = space_map(device);
+  uint bin = map->gap_bin[i];
+  if (bin == OBJECTS_GAP_NOT_BINNED) {
+    return;
+  }
+
+  ushort prev = map->gap_prev[i];
+  ushort next = map->gap_next[i];
+  if (prev == 0) {
+    map->gap_bins[bin] = next;
+  } else {
+    map->gap_next[prev] = next;
+  }
+  if (next != 0) {
+    map->gap_prev[next] = prev;
+  }
+  map->gap_bin[i] = OBJECTS_GAP_NOT_BINNED;
+  map->holes--;
+}
+
+static void space_map_bin_gap(struct obj_device_private* device, uint i) {
+  struct objects_space_map* map = space_map(device);
+  uint size;
+  // The gap before the first object is kept for the objects table.
+  if (i == 0 || (size = gap_size(device, i)) == 0) {
+    return;
+  }
+
+  uint bin = gap_bin_of(size);
+  map->gap_bin[i] = bin;
+  map->gap_prev[i] = 0;
+  map->gap_next[i] = map->gap_bins[bin];
+  if (map->gap_bins[bin] != 0) {
+    map->gap_prev[map->gap_bins[bin]] = i;
+  }
+  map->gap_bins[bin] = i;
+  map->holes++;
+}
+
+// The compacted objects must stay contiguous up to the end of the device.
+// Restart the compaction when an extent among them is released or shrunk.
+static void space_map_invalidate_compaction(struct obj_device_private* device,
+                                            uint i) {
+  struct objects_space_map* map = space_map(device);
+  if (map->compact_cursor != 0 &&
+      extent_start(device, i) >= extent_start(device, map->compact_cursor)) {
+    map->compact_cursor = 0;
+  }
+}
+
+// Links entry `i` after entry `prev`. The extent of `i` must be inside the
+// gap following `prev`.
+static void space_map_link(struct obj_device_private* device, uint i,
+                           uint prev) {
+  struct objects_space_map* map = space_map(device);
+  uint next = map->order_next[prev];
+
+  space_map_unbin_gap(device, prev);
+  map->order_prev[i] = prev;
+  map->order_next[i] = next;
+  map->order_next[prev] = i;
+  map->order_prev[next] = i;
+  space_map_bin_gap(device, prev);
+  space_map_bin_gap(device, i);
+}
+
+// Releases the extent of entry `i`, merging it with the gaps around it.
+static void space_map_unlink(struct obj_device_private* device, uint i) {
+  struct objects_space_map* map = space_map(device);
+  uint prev = map->order_prev[i];
+  uint next = map->order_next[i];
+
+  space_map_invalidate_compaction(device, i);
+  space_map_unbin_gap(device, i);
+  space_map_unbin_gap(device, prev);
+  map->order_next[prev] = next;
+  map->order_prev[next] = prev;
+  space_map_bin_gap(device, prev);
+}
+
+// Should be called after entry `i` was shrunk in place.
+static void space_map_resize(struct obj_device_private* device, uint i) {
+  space_map_invalidate_compaction(device, i);
+  space_map_unbin_gap(device, i);
+  space_map_bin_gap(device, i);
+}
+
+// Entry `j` takes the place of entry `i`, after the extent of `i` was handed
+// over to it.
+static void space_map_replace(struct obj_device_private* device, uint i,
+                              uint j) {
+  struct objects_space_map* map = space_map(device);
+  uint prev = map->order_prev[i];
+  uint next = map->order_next[i];
+
+  space_map_unbin_gap(device, i);
+  map->order_prev[j] = prev;
+  map->order_next[j] = next;
+  map->order_next[prev] = j;
+  map->order_prev[next] = j;
+  space_map_bin_gap(device, j);
+  if (map->compact_cursor == i) {
+    map->compact_cursor = j;
+  }
+}
+
+// Orders entries by their extent. An empty extent comes before a non-empty
+// one starting at the same offset.
+static int extent_less(struct obj_device_private* device, uint i, uint j) {
+  objects_table_entry* a = get_objects_table_entry(device, i);
+  objects_table_entry* b = get_objects_table_entry(device, j);
+  if (a->disk_offset != b->disk_offset) {
+    return a->disk_offset < b->disk_offset;
+  }
+  return a->size < b->size;
+}
+
+static void sift_down(struct obj_device_private* device, ushort* heap,
+                      uint root, uint n) {
+  for (uint child; (child = 2 * root + 1) < n; root = child) {
+    if (child + 1 < n && extent_less(device, heap[child], heap[child + 1])) {
+      child++;
+    }
+    if (!extent_less(device, heap[root], heap[child])) {
+      return;
+    }
+    ushort tmp = heap[root];
+    heap[root] = heap[child];
+    heap[child] = tmp;
+  }
+}
+
+static void sort_by_extent(struct obj_device_private* device, ushort* entries,
+                           uint n) {
+  for (uint i = n / 2; i > 0; i--) {
+    sift_down(device, entries, i - 1, n);
+  }
+  for (uint end = n; end > 1; end--) {
+    ushort tmp = entries[0];
+    entries[0] = entries[end - 1];
+    entries[end - 1] = tmp;
+    sift_down(device, entries, 0, end - 1);
+  }
+}
+
+static void rebuild_space_map(struct obj_device_private* device) {
+  struct objects_space_map* map = space_map(device);
+  // The gaps links are free until the gaps are binned, use them as the sort
+  // buffer.
+  ushort* entries = map->gap_prev;
+  uint count = 0;
+
+  map->first_free_entry = get_object_table_size(device);
+  for (uint i = OBJ_ROOTINO - 1; i < get_object_table_size(device); ++i) {
+    objects_table_entry* entry = get_objects_table_entry(device, i);
+    if (entry->occupied) {
+      // Objects sharing the content of another one, or of the base snapshot,
+      // have no extent.
+      if (entry->shared_with == 0 && !entry_in_base(device, entry)) {
+        entries[count++] = i;
       }
+    } else if (map->first_free_entry > i) {
+      map->first_free_entry = i;
     }
   }
+  sort_by_extent(device, entries, count);
+
+  uint prev = 0;
+  for (uint k = 0; k < count; k++) {
+    map->order_next[prev] = entries[k];
+    map->order_prev[entries[k]] = prev;
+    prev = entries[k];
+  }
+  map->order_next[prev] = 0;
+  map->order_prev[0] = prev;
+
+  memset(map->gap_bin, OBJECTS_GAP_NOT_BINNED, sizeof(map->gap_bin));
+  memset(map->gap_bins, 0, sizeof(map->gap_bins));
+  map->holes = 0;
+  map->compact_cursor = 0;
+  for (uint i = map->order_next[0]; i != 0; i = map->order_next[i]) {
+    space_map_bin_gap(device, i);
+  }
+}
+
+// Slides the extent of entry `i` to the end of the gap following it.
+static void slide_object(struct obj_device_private* device, uint i) {
+  objects_table_entry* entry = get_objects_table_entry(device, i);
+  uint prev = space_map(device)->order_prev[i];
+  uint gap = gap_size(device, i);
+
+  store_move(device, entry->disk_offset + gap, entry->disk_offset,
+             entry->size);
+  space_map_unbin_gap(device, i);
+  space_map_unbin_gap(device, prev);
+  entry->disk_offset += gap;
+  flush_objects_table_entry(device, i);
+  space_map_bin_gap(device, prev);
 }
 
 /**
- * The method finds a sequence of empty bytes of length `size`.
- * If no such sequence exists, NULL is returned.
- *
- * To achieve this, the method first sort the objects in the table by their
- * address in the disk. Then, we check the space between every 2 consecutive
- * entries. We also check the space left between the end of the last element
- * and the end of the disk.
- * Notice that there are at least 2 objects in the table at every moment: the
- * super block and the objects table itself. Also, the super block is located
- * at address 0, hence we don't check the "empty space" before it because
- * there is no such space.
+ * Walks the objects from the end of the device backwards, starting from the
+ * compaction cursor, and slides each one to the object after it. Visits at
+ * most `max_objects` objects. Returns 1 when the whole store is compacted.
+ * The disk lock should be held by the caller.
+ */
+static uint compact_store(struct obj_device_private* device,
+                          uint max_objects) {
+  struct objects_space_map* map = space_map(device);
+  uint i = map->order_prev[map->compact_cursor];
+
+  for (uint visited = 0; i != 0 && visited < max_objects; visited++) {
+    if (gap_size(device, i) > 0) {
+      slide_object(device, i);
+    }
+    map->compact_cursor = i;
+    i = map->order_prev[i];
+  }
+
+  if (i == 0) {
+    map->compact_cursor = 0;
+    return 1;
+  }
+  return 0;
+}
+
+// Gathers all the free space before the first object, when it is fragmented
+// and would fit `size` more bytes once gathered. Returns 1 if it did, an
+// allocation of `size` bytes is then guaranteed to succeed.
+static uint gather_free_space(struct obj_device_private* device, uint size) {
+  if (space_map(device)->holes == 0 ||
+      device->sb.storage_device_size - device->sb.bytes_occupied < size) {
+    return 0;
+  }
+  compact_store(device, OBJECTS_TABLE_MAX_ENTRIES);
+  return 1;
+}
+
+/**
+ * Gives `needed` bytes of the unused entries at the end of the objects table
+ * back to the store. The table keeps at least `min_entries` entries.
+ * Returns whether there were enough unused entries.
+ */
+static int shrink_objects_table(struct obj_device_private* device, uint needed,
+                                uint min_entries) {
+  uint entries = get_object_table_size(device);
+  while (entries > min_entries &&
+         !get_objects_table_entry(device, entries - 1)->occupied) {
+    entries--;
+  }
+  if (entry_index_to_entry_offset(device, entries) + needed >
+      device->sb.store_offset) {
+    return 0;
+  }
+
+  device->sb.store_offset -= needed;
+  device->sb.bytes_occupied -= needed;
+  return 1;
+}
+
+/**
+ * The method finds a sequence of empty bytes of length `size`. On success,
+ * `offset` is set to its disk offset and `prev` to the entry whose gap
+ * contains it, so the caller can link the new extent after it.
  *
- * Smarter implementation can be used in future work such as saving free
- * blocks in a list. Read "malloc internals" for details.
+ * The gaps are searched by size, starting from the bin of `size`. The object
+ * is placed at the end of the gap, so the rest of the gap stays contiguous.
+ * The gap between the objects table and the first object is used only when
+ * no other gap is large enough, as the table grows into it. As a last resort,
+ * the unused entries at the end of the objects table are given back to the
+ * store. The table keeps at least `min_entries` entries.
  */
-static void* find_empty_space(struct obj_device_private* device, uint size) {
-  // 1. put all occupied entries in an array
-  uint current_table_size =
-      min((device->sb.store_offset -  // NOLINT(build/include_what_you_use)
-           device->sb.objects_table_offset),
-          STORAGE_DEVICE_SIZE) /
-      sizeof(objects_table_entry);
-  const uint entries_arr_size = current_table_size - 2;
-  /* Be aware: Variable-length arrays are usually bad habit */
-  uint entries_indices[entries_arr_size];  // NOLINT
-  uint* current = entries_indices;
-  uint populated_size = 0;
-  for (uint i = 2; i < get_object_table_size(device); ++i) {
-    if (get_objects_table_entry(device, i)->occupied) {
-      *current = i;
-      current++;
-      populated_size++;
-      if (current - entries_indices > entries_arr_size) {
-        panic("found too much entries vs expected");
+static uint find_empty_space(struct obj_device_private* device, uint size,
+                             uint min_entries, uint* offset, uint* prev) {
+  struct objects_space_map* map = space_map(device);
+
+  for (uint bin = gap_bin_of(size); bin < OBJECTS_GAP_BINS; bin++) {
+    for (uint i = map->gap_bins[bin]; i != 0; i = map->gap_next[i]) {
+      if (gap_size(device, i) >= size) {
+        *prev = i;
+        goto found;
       }
     }
   }
 
-  if (populated_size == 0 &&
-      STORAGE_DEVICE_SIZE - size >= device->sb.store_offset) {
-    return &device->storage_holder->memory_storage[STORAGE_DEVICE_SIZE - size];
-  }
-
-  uint last_occupied_entry = entries_indices[entries_arr_size - 1];
-  // 2. sort it by objects disk-offset. smaller first.
-  bubble_sort(device, entries_indices, populated_size);
-  // 3. Check for rightmost spot
-  objects_table_entry* last_entry =
-      get_objects_table_entry(device, entries_indices[populated_size - 1]);
-  uint space_left = device->sb.storage_device_size - last_entry->disk_offset -
-                    last_entry->size;
-  if (space_left >= size) {
-    return &device->storage_holder->memory_storage[STORAGE_DEVICE_SIZE - size];
-  }
-  // 4. for each occupied entry, measure space between this entry to the next.
-  // if an appropriate space is found, return the rightmost memory chunk for
-  // allocation.
-  if (populated_size >= 2) {
-    for (uint i = populated_size - 1; i > 0; i--) {
-      objects_table_entry* current_entry =
-          get_objects_table_entry(device, entries_indices[i]);
-      objects_table_entry* prev_entry =
-          get_objects_table_entry(device, entries_indices[i - 1]);
-      space_left = current_entry->disk_offset - prev_entry->disk_offset -
-                   prev_entry->size;
-      if (space_left >= size) {
-        return &device->storage_holder
-                    ->memory_storage[current_entry->disk_offset - size];
-      }
+  *prev = 0;
+  uint leading_gap = gap_size(device, 0);
+  if (leading_gap < size &&
+      !shrink_objects_table(device, size - leading_gap, min_entries)) {
+    // No solution without defragmentation.
+    return NO_DISK_SPACE_FOUND;
+  }
+
+found:
+  *offset = extent_start(device, map->order_next[*prev]) - size;
+  return NO_ERR;
+}
+
+void rebuild_objects_table_index(struct obj_device_private* device) {
+  memset(device->storage_holder->objects_index, 0,
+         sizeof(device->storage_holder->objects_index));
+  memset(device->storage_holder->content_index, 0,
+         sizeof(device->storage_holder->content_index));
+  for (uint i = 0; i < get_object_table_size(device); ++i) {
+    objects_table_entry* entry = get_objects_table_entry(device, i);
+    if (!entry->occupied) {
+      continue;
+    }
+    objects_index_insert(device, i);
+    if ((device->sb.flags & OBJ_FS_DEDUP) && i >= OBJ_ROOTINO - 1 &&
+        entry->shared_with == 0 && entry->size > 0 &&
+        !entry_in_base(device, entry)) {
+      content_index_insert(device, i);
     }
   }
-  // 5. could not find any space, consider moving the store space limit.
-  objects_table_entry* earliest_occupied_entry =
-      get_objects_table_entry(device, entries_indices[0]);
-  if (earliest_occupied_entry->disk_offset - device->sb.store_offset >= size) {
-    return &device->storage_holder
-                ->memory_storage[earliest_occupied_entry->disk_offset - size];
+  rebuild_space_map(device);
+}
+
+/**
+ * Deduplication.
+ * The content index holds the entries which hold their content, with the hash
+ * of the content, while deduplication is enabled. An entry is removed from the
+ * index before its content is changed, and looked up again after the change
+ * by `dedup_object`.
+ */
+
+// Returns an entry other than `i` with the same content, or 0 if there is
+// none.
+static uint content_index_find_twin(struct obj_device_private* device,
+                                    uint i, char* scratch) {
+  ushort* index = device->storage_holder->content_index;
+  objects_table_entry* entry = get_objects_table_entry(device, i);
+
+  for (uint slot = content_index_home_slot(entry->content_hash);
+       index[slot] != 0; slot = objects_index_next_slot(slot)) {
+    uint j = index[slot] - 1;
+    objects_table_entry* other = get_objects_table_entry(device, j);
+    if (j != i && other->content_hash == entry->content_hash &&
+        other->size == entry->size && other->codec == entry->codec &&
+        store_equal(device, other->disk_offset, entry->disk_offset,
+                    entry->size, scratch)) {
+      return j;
+    }
+  }
+  return 0;
+}
+
+/**
+ * Shares the content of entry `i` with an identical object if there is one,
+ * releasing the extent of `i`. Otherwise, indexes `i` for the objects written
+ * later. Entry `i` should hold its content and not be in the content index.
+ * The disk lock should be held by the caller.
+ */
+static void dedup_object(struct obj_device_private* device, uint i) {
+  objects_table_entry* entry = get_objects_table_entry(device, i);
+  char* scratch = NULL;
+  uint twin;
+
+  if (!(device->sb.flags & OBJ_FS_DEDUP) || entry->size == 0) {
+    return;
+  }
+  if (device->backing_dev != NULL && (scratch = kalloc()) == NULL) {
+    return;
+  }
+
+  entry->content_hash =
+      store_hash(device, entry->disk_offset, entry->size, scratch);
+  twin = content_index_find_twin(device, i, scratch);
+  // An entry whose content is already shared stays as it is.
+  if (twin == 0 || entry->refs > 0) {
+    content_index_insert(device, i);
   } else {
-    uint needed_space =
-        size - (earliest_occupied_entry->disk_offset - device->sb.store_offset);
-    uint offset_after_last_entry =
-        entry_index_to_entry_offset(device, last_occupied_entry + 1);
-    if (offset_after_last_entry < device->sb.store_offset - needed_space) {
-      device->sb.store_offset = device->sb.store_offset - needed_space;
-      return &device->storage_holder->memory_storage[device->sb.store_offset];
+    space_map_unlink(device, i);
+    device->sb.bytes_occupied -= entry->size;
+    device->sb.shared_bytes += entry->size;
+    entry->shared_with = twin + 1;
+    get_objects_table_entry(device, twin)->refs++;
+    flush_objects_table_entry(device, twin);
+  }
+  flush_objects_table_entry(device, i);
+
+  if (scratch != NULL) {
+    kfree(scratch);
+  }
+}
+
+/**
+ * Hands the content held by entry `i` over to one of the objects sharing it.
+ * That object then holds the content for the rest of them, and for `i`.
+ * The disk lock should be held by the caller.
+ */
+static void hand_over_content(struct obj_device_private* device, uint i) {
+  objects_table_entry* entry = get_objects_table_entry(device, i);
+  uint heir = 0;
+
+  for (uint j = OBJ_ROOTINO - 1; j < get_object_table_size(device); j++) {
+    objects_table_entry* other = get_objects_table_entry(device, j);
+    if (!other->occupied || other->shared_with != i + 1) {
+      continue;
+    }
+    if (heir == 0) {
+      heir = j;
+      continue;
+    }
+    other->shared_with = heir + 1;
+    flush_objects_table_entry(device, j);
+  }
+
+  objects_table_entry* heir_entry = get_objects_table_entry(device, heir);
+  heir_entry->shared_with = 0;
+  heir_entry->disk_offset = entry->disk_offset;
+  heir_entry->content_hash = entry->content_hash;
+  heir_entry->refs = entry->refs;
+  space_map_replace(device, i, heir);
+  if (content_index_remove(device, i)) {
+    content_index_insert(device, heir);
+  }
+  entry->shared_with = heir + 1;
+  entry->refs = 0;
+  flush_objects_table_entry(device, heir);
+  flush_objects_table_entry(device, i);
+}
+
+// Stops entry `i` from sharing its content. The disk lock should be held by
+// the caller.
+static void release_shared_content(struct obj_device_private* device,
+                                   uint i) {
+  objects_table_entry* entry = get_objects_table_entry(device, i);
+  uint content = entry->shared_with - 1;
+
+  get_objects_table_entry(device, content)->refs--;
+  flush_objects_table_entry(device, content);
+  device->sb.shared_bytes -= entry->size;
+  entry->shared_with = 0;
+}
+
+// Gives entry `i`, whose content is in the base snapshot, an extent of its
+// own of `size` bytes holding the first `keep` bytes of the content.
+static uint detach_from_base(struct obj_device_private* device, uint i,
+                             uint size, uint keep) {
+  objects_table_entry* entry = get_objects_table_entry(device, i);
+  struct obj_device_private* base = dev_private(device->base);
+  char* chunk = NULL;
+  uint offset, prev;
+
+  if (keep > 0 && (chunk = kalloc()) == NULL) {
+    return NO_MEMORY;
+  }
+  if (find_empty_space(device, size, 0, &offset, &prev) != NO_ERR &&
+      (!gather_free_space(device, size) ||
+       find_empty_space(device, size, 0, &offset, &prev) != NO_ERR)) {
+    if (chunk != NULL) {
+      kfree(chunk);
     }
+    return NO_DISK_SPACE_FOUND;
+  }
+  uint src = content_entry(base, i)->disk_offset;
+  for (uint copied = 0; copied < keep;) {
+    uint bytes = min(PGSIZE, keep - copied);
+    store_read(base, src + copied, chunk, bytes);
+    store_write(device, offset + copied, chunk, bytes);
+    copied += bytes;
   }
-  // 6. no solution without defragmentation.
-  return NULL;
+  device->sb.bytes_occupied += size;
+  entry->disk_offset = offset;
+  entry->size = size;
+  entry->generation = device->sb.generation;
+  flush_objects_table_entry(device, i);
+  space_map_link(device, i, prev);
+  if (chunk != NULL) {
+    kfree(chunk);
+  }
+  return NO_ERR;
+}
+
+/**
+ * Copy on write. Should be called before the content of entry `i` is changed.
+ * If the content is shared or in the base snapshot, `i` gets an extent of its
+ * own of `size` bytes, holding the first `keep` bytes of the content. The
+ * disk lock should be held by the caller.
+ */
+static uint unshare_object(struct obj_device_private* device, uint i,
+                           uint size, uint keep) {
+  objects_table_entry* entry = get_objects_table_entry(device, i);
+  uint offset, prev;
+
+  if (entry_in_base(device, entry)) {
+    return detach_from_base(device, i, size, keep);
+  }
+  if (entry->refs > 0) {
+    hand_over_content(device, i);
+  } else {
+    content_index_remove(device, i);
+  }
+  if (entry->shared_with == 0) {
+    return NO_ERR;
+  }
+
+  if (find_empty_space(device, size, 0, &offset, &prev) != NO_ERR &&
+      (!gather_free_space(device, size) ||
+       find_empty_space(device, size, 0, &offset, &prev) != NO_ERR)) {
+    return NO_DISK_SPACE_FOUND;
+  }
+  // The compaction might have moved the content, take its offset only now.
+  store_move(device, offset, content_entry(device, i)->disk_offset, keep);
+  release_shared_content(device, i);
+  device->sb.bytes_occupied += size;
+  entry->disk_offset = offset;
+  entry->size = size;
+  flush_objects_table_entry(device, i);
+  space_map_link(device, i, prev);
+  return NO_ERR;
 }
 
 static void initialize_super_block_entry(struct obj_device_private* device) {
@@ -192,8 +929,7 @@ static void initialize_objects_table_entry(struct obj_device_private* device) {
 
 // the disk lock should be held by the caller
 static void write_super_block(struct obj_device_private* device) {
-  memmove(device->storage_holder->memory_storage, &device->sb,
-          sizeof(device->sb));
+  store_write(device, 0, (char*)&device->sb, sizeof(device->sb));
 }
 
 uint get_object_table_size(struct obj_device_private* device) {
@@ -201,7 +937,8 @@ uint get_object_table_size(struct obj_device_private* device) {
          sizeof(objects_table_entry);
 }
 
-static void copy_bufs_vector_to_disk(char* address, vector bufs, uint size) {
+static void copy_bufs_vector_to_disk(struct obj_device_private* device,
+                                     uint offset, vector bufs, uint size) {
   uint copied_bytes = 0;
   struct buf* curr_buf;
 
@@ -209,13 +946,241 @@ static void copy_bufs_vector_to_disk(char* address, vector bufs, uint size) {
     for (uint buf_index = 0; buf_index < bufs.vectorsize; buf_index++) {
       uint block_size = min(BUF_DATA_SIZE, size - copied_bytes);
       memmove_from_vector((char*)&curr_buf, bufs, buf_index, 1);
-      memmove(address + copied_bytes, curr_buf->data, block_size);
+      store_write(device, offset + copied_bytes, (char*)curr_buf->data,
+                  block_size);
       curr_buf->flags &= ~B_DIRTY;
       copied_bytes += block_size;
     }
   }
 }
 
+static void copy_disk_to_bufs_vector(struct obj_device_private* device,
+                                     uint offset, vector bufs, uint size) {
+  uint copied_bytes = 0;
+  struct buf* curr_buf;
+
+  for (uint buf_index = 0; copied_bytes < size; buf_index++) {
+    uint block_size = min(BUF_DATA_SIZE, size - copied_bytes);
+    memmove_from_vector((char*)&curr_buf, bufs, buf_index, 1);
+    store_read(device, offset + copied_bytes, (char*)curr_buf->data,
+               block_size);
+    curr_buf->flags |= B_VALID;
+    copied_bytes += block_size;
+  }
+}
+
+// CRC32C of `size` bytes of `bufs`, starting at byte `start`, continuing the
+// CRC32C `crc`.
+static uint bufs_checksum(uint crc, vector bufs, uint start, uint size) {
+  struct buf* curr_buf;
+
+  for (uint buf_index = start / BUF_DATA_SIZE; size > 0; buf_index++) {
+    uint block_offset = start % BUF_DATA_SIZE;
+    uint block_size = min(BUF_DATA_SIZE - block_offset, size);
+    memmove_from_vector((char*)&curr_buf, bufs, buf_index, 1);
+    crc = obj_crc32c(crc, (char*)curr_buf->data + block_offset, block_size);
+    start += block_size;
+    size -= block_size;
+  }
+  return crc;
+}
+
+// Compares the checksum `crc`, computed for the content of `entry`, with the
+// one in the entry. A mismatch is counted in the checksum errors of `device`.
+static uint check_content(struct obj_device_private* device,
+                          objects_table_entry* entry, uint crc) {
+  if (crc == entry->checksum) {
+    return NO_ERR;
+  }
+  __sync_fetch_and_add(&device->checksum_errors, 1);
+  return CORRUPTED_OBJECT;
+}
+
+/**
+ * Verifies the content of the raw object `i` after `size` bytes at `offset`
+ * of it were read into `bufs`, when the device verifies the reads. The rest of
+ * the content is read from the store of `holder`. On a mismatch, the bufs are
+ * marked as invalid. The disk lock should be held by the caller.
+ */
+static uint verify_read(struct obj_device_private* device,
+                        struct obj_device_private* holder, uint i,
+                        objects_table_entry* entry, uint offset, uint size,
+                        vector bufs) {
+  struct buf* curr_buf;
+  uint crc;
+
+  if (!device->verify || i < OBJ_ROOTINO - 1) {
+    return NO_ERR;
+  }
+  crc = store_checksum(holder, 0, entry->disk_offset, offset);
+  crc = bufs_checksum(crc, bufs, 0, size);
+  crc = store_checksum(holder, crc, entry->disk_offset + offset + size,
+                       entry->size - offset - size);
+  if (check_content(device, entry, crc) == NO_ERR) {
+    return NO_ERR;
+  }
+  for (uint buf_index = 0; buf_index * BUF_DATA_SIZE < size; buf_index++) {
+    memmove_from_vector((char*)&curr_buf, bufs, buf_index, 1);
+    curr_buf->flags &= ~B_VALID;
+  }
+  return CORRUPTED_OBJECT;
+}
+
+/**
+ * Compression.
+ * A content is encoded in a scratch page: the raw content is gathered into
+ * its first half and compressed into the second. When the device doesn't
+ * compress, the content is written from the bufs without a scratch page.
+ */
+struct encoded_content {
+  uint codec;
+  uint raw_size;
+  uint size;
+  const char* data;  // the content to write, or NULL to write the bufs
+  char* page;        // the scratch page, or NULL
+};
+
+static uint object_raw_size(objects_table_entry* entry) {
+  return entry->codec == OBJ_CODEC_NONE ? entry->size : entry->raw_size;
+}
+
+static void copy_bufs_vector_to_buffer(vector bufs, char* dst, uint size) {
+  uint copied_bytes = 0;
+  struct buf* curr_buf;
+
+  for (uint buf_index = 0; copied_bytes < size; buf_index++) {
+    uint block_size = min(BUF_DATA_SIZE, size - copied_bytes);
+    memmove_from_vector((char*)&curr_buf, bufs, buf_index, 1);
+    memmove(dst + copied_bytes, curr_buf->data, block_size);
+    curr_buf->flags &= ~B_DIRTY;
+    copied_bytes += block_size;
+  }
+}
+
+static void copy_buffer_to_bufs_vector(const char* src, vector bufs,
+                                       uint size) {
+  uint copied_bytes = 0;
+  struct buf* curr_buf;
+
+  for (uint buf_index = 0; copied_bytes < size; buf_index++) {
+    uint block_size = min(BUF_DATA_SIZE, size - copied_bytes);
+    memmove_from_vector((char*)&curr_buf, bufs, buf_index, 1);
+    memmove(curr_buf->data, src + copied_bytes, block_size);
+    curr_buf->flags |= B_VALID;
+    copied_bytes += block_size;
+  }
+}
+
+// Compresses the `size` bytes in the first half of `page`, if the device
+// compresses and the content shrinks. Otherwise, the raw content is written.
+static void encode_page(struct obj_device_private* device, char* page,
+                        uint size, struct encoded_content* content) {
+  uint compressed = 0;
+  ushort* table;
+
+  content->codec = OBJ_CODEC_NONE;
+  content->raw_size = size;
+  content->size = size;
+  content->data = page;
+  if ((device->sb.flags & OBJ_FS_COMPRESS) && size > 0 &&
+      (table = (ushort*)kalloc()) != NULL) {
+    compressed = obj_lz_compress(page, size, page + OBJ_CODEC_MAX_SIZE,
+                                 size - 1, table);
+    kfree((char*)table);
+  }
+  if (compressed > 0) {
+    content->codec = OBJ_CODEC_LZ;
+    content->size = compressed;
+    content->data = page + OBJ_CODEC_MAX_SIZE;
+  }
+}
+
+// Encodes `size` bytes of `bufs`. The content is released by
+// `release_content`.
+static void encode_bufs(struct obj_device_private* device, vector bufs,
+                        uint size, struct encoded_content* content) {
+  content->page = NULL;
+  if ((device->sb.flags & OBJ_FS_COMPRESS) && size > 0 &&
+      size <= OBJ_CODEC_MAX_SIZE) {
+    content->page = kalloc();
+  }
+  if (content->page == NULL) {
+    content->codec = OBJ_CODEC_NONE;
+    content->raw_size = size;
+    content->size = size;
+    content->data = NULL;
+    return;
+  }
+  copy_bufs_vector_to_buffer(bufs, content->page, size);
+  encode_page(device, content->page, size, content);
+}
+
+static void release_content(struct encoded_content* content) {
+  if (content->page != NULL) {
+    kfree(content->page);
+  }
+}
+
+// Writes the content into the extent of entry `i`, which should be of the
+// content size.
+static void write_content(struct obj_device_private* device, uint i,
+                          vector bufs, struct encoded_content* content) {
+  objects_table_entry* entry = get_objects_table_entry(device, i);
+
+  if (content->data != NULL) {
+    store_write(device, entry->disk_offset, content->data, content->size);
+    entry->checksum = obj_crc32c(0, content->data, content->size);
+  } else {
+    copy_bufs_vector_to_disk(device, entry->disk_offset, bufs, content->size);
+    entry->checksum = bufs_checksum(0, bufs, 0, content->size);
+  }
+  entry->codec = content->codec;
+  entry->raw_size = content->raw_size;
+  flush_objects_table_entry(device, i);
+}
+
+// Decompresses the content of the compressed object `i` into the first half
+// of `page`. The compressed content is verified first, when the device
+// verifies the reads.
+static uint decode_object(struct obj_device_private* device, uint i,
+                          char* page) {
+  struct obj_device_private* holder = device;
+  objects_table_entry* entry = content_location(&holder, i);
+  uint size = entry->size;
+  // The compressed content is smaller than a scan chunk, a single peek.
+  const char* src = store_peek(holder, entry->disk_offset, &size,
+                               page + OBJ_CODEC_MAX_SIZE);
+
+  if (device->verify &&
+      check_content(device, entry, obj_crc32c(0, src, entry->size)) !=
+          NO_ERR) {
+    return CORRUPTED_OBJECT;
+  }
+  if (obj_lz_decompress(src, entry->size, page, OBJ_CODEC_MAX_SIZE) !=
+      (int)entry->raw_size) {
+    return CORRUPTED_OBJECT;
+  }
+  return NO_ERR;
+}
+
+// Reads `size` bytes at `offset` of the compressed object `i` into `bufs`.
+// The disk lock should be held by the caller.
+static uint read_compressed_range(struct obj_device_private* device, uint i,
+                                  uint offset, uint size, vector bufs) {
+  char* page = kalloc();
+  uint err;
+
+  if (page == NULL) {
+    return NO_MEMORY;
+  }
+  err = decode_object(device, i, page);
+  if (err == NO_ERR) {
+    copy_buffer_to_bufs_vector(page + offset, bufs, size);
+  }
+  kfree(page);
+  return err;
+}
+
 static struct memory_storage_holder memory_storage_holders[MAX_OBJ_DEVS_NUM] = {
     {.is_used = false},
     {.is_used = false},
@@ -225,13 +1190,27 @@ static void obj_dev_destroy(struct device* dev) {
   buf_cache_invalidate_blocks(dev);
   struct obj_device_private* device = dev_private(dev);
   device->storage_holder->is_used = false;
+  if (device->backing_dev != NULL) {
+    deviceput(device->backing_dev);
+  }
+  if (device->base != NULL) {
+    deviceput(device->base);
+  }
 }
 
-void init_obj_device(struct device* dev) {
+static const struct device_ops obj_dev_ops = {.destroy = obj_dev_destroy};
+
+// Allocates the private data of a new device. The devices lock should be held
+// by the caller, it protects the memory storages.
+static struct obj_device_private* new_obj_device_private(
+    struct device* backing_dev) {
   struct obj_device_private* device = (struct obj_device_private*)kalloc();
-  dev->private = device;
-  // with real device, we would read the block form the disk.
-  initsleeplock(&device->disklock, "disklock");
+  initrwsleeplock(&device->disklock, "disklock");
+  device->backing_dev = backing_dev;
+  device->frozen = 0;
+  device->base = NULL;
+  device->verify = 1;
+  device->checksum_errors = 0;
 
   // find a free memory_storage:
   device->storage_holder = NULL;
@@ -245,8 +1224,15 @@ void init_obj_device(struct device* dev) {
 
   // should always find a free memory_storage!
   XV6_ASSERT(device->storage_holder != NULL);
+  return device;
+}
+
+void init_obj_device(struct device* dev) {
+  struct obj_device_private* device = new_obj_device_private(NULL);
+  dev->private = device;
 
   // Super block initializing
+  device->sb.magic = OBJ_FS_MAGIC;
   device->sb.storage_device_size = STORAGE_DEVICE_SIZE;
   device->sb.objects_table_offset = sizeof(struct objsuperblock);
   device->sb.store_offset =
@@ -258,37 +1244,130 @@ void init_obj_device(struct device* dev) {
   device->sb.occupied_objects = 2;
   // Inode counter starts from 3, when 3 reserved to root dir object.
   device->sb.last_inode = 2;
+  device->sb.flags = 0;
+  device->sb.shared_bytes = 0;
+  device->sb.generation = 0;
   // Inode initializing
 
   // To keep consistency, we write the super block to the disk and sets the
-  // table state. This part should be read from the device and be created
-  // when initializing the disk.
+  // table state. A store on a block device is created by `mkfs_objfs`
+  // instead, and loaded by `load_obj_device`.
   for (uint i = 0; i < get_object_table_size(device); ++i) {
     get_objects_table_entry(device, i)->occupied = 0;
   }
   write_super_block(device);
   initialize_super_block_entry(device);
   initialize_objects_table_entry(device);
+  rebuild_objects_table_index(device);
+
+  dev->ops = &obj_dev_ops;
+}
+
+// Whether the super block describes a store the driver can hold.
+static int is_valid_super_block(const struct objsuperblock* sb) {
+  return sb->magic == OBJ_FS_MAGIC &&
+         sb->objects_table_offset == sizeof(struct objsuperblock) &&
+         sb->objects_table_offset <= sb->store_offset &&
+         sb->store_offset <= STORAGE_DEVICE_SIZE &&
+         sb->store_offset <= sb->storage_device_size &&
+         sb->bytes_occupied <= sb->storage_device_size;
+}
+
+uint load_obj_device(struct device* dev, struct device* backing_dev) {
+  acquire(&dev_holder.lock);
+  struct obj_device_private* device = new_obj_device_private(backing_dev);
+  release(&dev_holder.lock);
+
+  store_read(device, 0, (char*)&device->sb, sizeof(device->sb));
+  if (!is_valid_super_block(&device->sb)) {
+    device->storage_holder->is_used = false;
+    kfree((char*)device);
+    return BAD_SUPER_BLOCK;
+  }
+  store_read(device, device->sb.objects_table_offset,
+             device->storage_holder->memory_storage +
+                 device->sb.objects_table_offset,
+             device->sb.store_offset - device->sb.objects_table_offset);
+  rebuild_objects_table_index(device);
+
+  deviceget(backing_dev);
+  dev->private = device;
+  dev->ops = &obj_dev_ops;
+  return NO_ERR;
+}
+
+void freeze_obj_device(struct device* dev) {
+  struct obj_device_private* device = dev_private(dev);
+
+  acquirewritesleep(&device->disklock);
+  device->frozen = 1;
+  releasewritesleep(&device->disklock);
+}
 
-  static const struct device_ops obj_dev_ops = {.destroy = obj_dev_destroy};
+void init_obj_clone_device(struct device* dev, struct device* base) {
+  struct obj_device_private* snapshot = dev_private(base);
+  acquire(&dev_holder.lock);
+  struct obj_device_private* device = new_obj_device_private(NULL);
+  release(&dev_holder.lock);
+
+  XV6_ASSERT(snapshot->frozen);
+  // The objects table is mirrored in the memory storage of the snapshot.
+  memmove(device->storage_holder->memory_storage,
+          snapshot->storage_holder->memory_storage,
+          snapshot->sb.store_offset);
+  device->sb = snapshot->sb;
+  device->sb.storage_device_size = STORAGE_DEVICE_SIZE;
+  device->sb.bytes_occupied = device->sb.store_offset;
+  device->sb.shared_bytes = 0;
+  device->sb.generation = snapshot->sb.generation + 1;
+  for (uint i = 0; i < get_object_table_size(device); i++) {
+    objects_table_entry* entry = get_objects_table_entry(device, i);
+    // The objects sharing a content in the snapshot read it from there.
+    entry->shared_with = 0;
+    entry->refs = 0;
+    if (i < OBJ_ROOTINO - 1) {
+      entry->generation = device->sb.generation;
+    }
+  }
+  write_super_block(device);
+  device->base = base;
+  rebuild_objects_table_index(device);
 
+  deviceget(base);
+  dev->private = device;
   dev->ops = &obj_dev_ops;
 }
 
 uint find_space_and_populate_entry(struct obj_device_private* device,
-                                   objects_table_entry* entry, const char* name,
+                                   uint entry_index, const char* name,
                                    vector bufs, uint size) {
-  void* address = find_empty_space(device, size);
-  if (!address) {
+  objects_table_entry* entry = get_objects_table_entry(device, entry_index);
+  struct encoded_content content;
+  uint offset, prev;
+
+  encode_bufs(device, bufs, size, &content);
+  if (find_empty_space(device, content.size, entry_index + 1, &offset,
+                       &prev) != NO_ERR &&
+      (!gather_free_space(device, content.size) ||
+       find_empty_space(device, content.size, entry_index + 1, &offset,
+                        &prev) != NO_ERR)) {
+    release_content(&content);
     return NO_DISK_SPACE_FOUND;
   }
   memmove(entry->object_id, name, obj_id_bytes(name));
-  entry->disk_offset = address - (void*)device->storage_holder->memory_storage;
-  entry->size = size;
-  copy_bufs_vector_to_disk(address, bufs, size);
+  entry->disk_offset = offset;
+  entry->size = content.size;
+  entry->shared_with = 0;
+  entry->refs = 0;
+  entry->generation = device->sb.generation;
   entry->occupied = 1;
-  device->sb.bytes_occupied += size;
+  write_content(device, entry_index, bufs, &content);
+  release_content(&content);
+  objects_index_insert(device, entry_index);
+  space_map_link(device, entry_index, prev);
+  device->sb.bytes_occupied += entry->size;
   device->sb.occupied_objects += 1;
+  dedup_object(device, entry_index);
   write_super_block(device);
 
   return NO_ERR;
@@ -297,102 +1376,300 @@ uint find_space_and_populate_entry(struct obj_device_private* device,
 uint add_object(struct device* dev, const char* name, vector bufs, uint size) {
   uint err = NO_ERR;
   struct obj_device_private* device = dev_private(dev);
+  struct objects_space_map* map = space_map(device);
 
-  // 1. check if the object is already present in disk
+  // 1. check if the object is already present in disk. The check is under
+  // the disk lock, so that two adds of a name can't both pass it.
+  acquirewritesleep(&device->disklock);
   err = check_add_object_validity(device, size, name);
   if (err != NO_ERR) {
-    goto end;
+    goto unlock;
   }
 
   // 2. find first unoccupied entry of the objects table
   // then occupy it and allocate space for the new object.
-  acquiresleep(&device->disklock);
-  uint leftmost_disk_allocation_offset = STORAGE_DEVICE_SIZE;
-  // We start to search after the superblock and entries table,
-  // minus 1 since indexing starts in 0
   uint i;
-  for (i = OBJ_ROOTINO - 1; i < get_object_table_size(device); i++) {
-    objects_table_entry* entry = get_objects_table_entry(device, i);
-    if (entry->disk_offset < leftmost_disk_allocation_offset)
-      leftmost_disk_allocation_offset = entry->disk_offset;
-    if (!entry->occupied) {
-      err = find_space_and_populate_entry(device, entry, name, bufs, size);
-      goto unlock;
+  for (i = map->first_free_entry; i < get_object_table_size(device); i++) {
+    if (!get_objects_table_entry(device, i)->occupied) {
+      break;
     }
   }
-  // 3. all entries are occupied. is it possible to extend the table?
-  // find offset of the first object.
-  if (leftmost_disk_allocation_offset - device->sb.store_offset >=
-      sizeof(objects_table_entry)) {
+  map->first_free_entry = i;
+
+  if (i == get_object_table_size(device)) {
+    // 3. all entries are occupied. is it possible to extend the table?
+    // The table grows into the gap before the first object, and must fit the
+    // memory storage, which mirrors it when the store is on a block device.
+    if (gap_size(device, 0) < sizeof(objects_table_entry) ||
+        entry_index_to_entry_offset(device, i + 1) > STORAGE_DEVICE_SIZE) {
+      err = OBJECTS_TABLE_FULL;
+      goto unlock;
+    }
     device->sb.store_offset =
         device->sb.store_offset + sizeof(objects_table_entry);
     device->sb.bytes_occupied += sizeof(objects_table_entry);
-    objects_table_entry* entry = get_objects_table_entry(device, i);
-    err = find_space_and_populate_entry(device, entry, name, bufs, size);
-    goto unlock;
+    get_objects_table_entry(device, i)->occupied = 0;
+    flush_objects_table_entry(device, i);
   }
 
-  err = OBJECTS_TABLE_FULL;
+  err = find_space_and_populate_entry(device, i, name, bufs, size);
+  if (err == NO_ERR) {
+    map->first_free_entry = i + 1;
+  }
 
 unlock:
-  releasesleep(&device->disklock);
-end:
+  releasewritesleep(&device->disklock);
   return err;
 }
 
+/**
+ * Resizes the extent of object `i` to `size` bytes, keeping its first `keep`
+ * bytes. A shrinking object stays in place. A growing one first releases its
+ * extent, merged with the gaps around it, it might be large enough.
+ * The disk lock should be held by the caller.
+ */
+static uint resize_object(struct obj_device_private* device, uint i, uint size,
+                          uint keep) {
+  objects_table_entry* entry = get_objects_table_entry(device, i);
+  uint old_prev = space_map(device)->order_prev[i];
+  uint offset, prev;
+
+  if (entry->size >= size) {
+    // The released tail joins the gap after the object.
+    device->sb.bytes_occupied -= entry->size - size;
+    entry->size = size;
+    flush_objects_table_entry(device, i);
+    space_map_resize(device, i);
+    return NO_ERR;
+  }
+
+  space_map_unlink(device, i);
+  if (find_empty_space(device, size, 0, &offset, &prev) != NO_ERR) {
+    // The free space might be fragmented. A kept content should be moved by
+    // the compaction as well, so the object is linked back meanwhile.
+    // Otherwise, the compaction may run over its old extent.
+    if (keep > 0) {
+      space_map_link(device, i, old_prev);
+    }
+    if (!gather_free_space(device, size - entry->size)) {
+      if (keep == 0) {
+        space_map_link(device, i, old_prev);
+      }
+      return NO_DISK_SPACE_FOUND;
+    }
+    if (keep > 0) {
+      old_prev = space_map(device)->order_prev[i];
+      space_map_unlink(device, i);
+    }
+    if (find_empty_space(device, size, 0, &offset, &prev) != NO_ERR) {
+      space_map_link(device, i, old_prev);
+      return NO_DISK_SPACE_FOUND;
+    }
+  }
+  store_move(device, offset, entry->disk_offset, keep);
+  device->sb.bytes_occupied += size - entry->size;
+  entry->size = size;
+  entry->disk_offset = offset;
+  flush_objects_table_entry(device, i);
+  space_map_link(device, i, prev);
+  return NO_ERR;
+}
+
 uint write_object(struct device* dev, const char* name, vector bufs,
                   uint objectsize) {
   uint err;
   struct obj_device_private* device = dev_private(dev);
-  char* obj_addr;
 
   // 1. check for name contraints validity
-  err = check_rewrite_object_validality(objectsize, name);
+  err = check_rewrite_object_validality(device, objectsize, name);
   if (err != NO_ERR) {
     goto end;
   }
   // 2. name is ok. get the index off the object's entry
-  acquiresleep(&device->disklock);
+  acquirewritesleep(&device->disklock);
   uint i;
   err = get_objects_table_index(device, name, &i);
   if (err != NO_ERR) {
     goto unlock;
   }
+  // 3. Get an extent of the encoded size, of its own if the content is
+  // shared
+  struct encoded_content content;
+  encode_bufs(device, bufs, objectsize, &content);
+  err = unshare_object(device, i, content.size, 0);
+  if (err == NO_ERR) {
+    err = resize_object(device, i, content.size, 0);
+  }
+  if (err == NO_ERR) {
+    // 4. Write the object content
+    write_content(device, i, bufs, &content);
+    dedup_object(device, i);
+    write_super_block(device);
+  }
+  release_content(&content);
+
+unlock:
+  releasewritesleep(&device->disklock);
+end:
+  return err;
+}
+
+/**
+ * Writes `size` bytes of `bufs` at `offset` of the compressed object `i`. The
+ * object is decompressed, patched and compressed again, unless it grows
+ * beyond `OBJ_CODEC_MAX_SIZE`, and then it is stored raw. The disk lock
+ * should be held by the caller.
+ */
+static uint write_compressed_range(struct obj_device_private* device, uint i,
+                                   uint offset, uint size, vector bufs) {
   objects_table_entry* entry = get_objects_table_entry(device, i);
-  device->sb.bytes_occupied -= entry->size;
-  if (entry->size >= objectsize) {
-    // 3.A - the new object written is smaller or equals the the original.
-    obj_addr = device->storage_holder->memory_storage + entry->disk_offset;
-    entry->size = objectsize;
+  uint old_raw_size = entry->raw_size;
+  uint raw_size = max(offset + size, old_raw_size);
+  struct encoded_content content;
+  uint err;
+
+  content.page = kalloc();
+  if (content.page == NULL) {
+    return NO_MEMORY;
+  }
+  err = decode_object(device, i, content.page);
+  if (err != NO_ERR) {
+    goto end;
+  }
+  if (raw_size <= OBJ_CODEC_MAX_SIZE) {
+    copy_bufs_vector_to_buffer(bufs, content.page + offset, size);
+    encode_page(device, content.page, raw_size, &content);
   } else {
-    // 3.B - the new object is larger
-    entry->occupied = 0;
-    device->sb.occupied_objects -= 1;
-    obj_addr = find_empty_space(device, objectsize);
-    entry->occupied = 1;
-    device->sb.occupied_objects += 1;
-    if (!obj_addr) {
-      releasesleep(&device->disklock);
-      return NO_DISK_SPACE_FOUND;
-    }
-    entry->size = objectsize;
-    entry->disk_offset =
-        (void*)obj_addr - (void*)device->storage_holder->memory_storage;
+    // The old content is written back raw, followed by the range.
+    content.codec = OBJ_CODEC_NONE;
+    content.raw_size = raw_size;
+    content.size = raw_size;
+    content.data = NULL;
   }
+  err = unshare_object(device, i, content.size, 0);
+  if (err == NO_ERR) {
+    err = resize_object(device, i, content.size, 0);
+  }
+  if (err != NO_ERR) {
+    goto end;
+  }
+  if (content.data != NULL) {
+    write_content(device, i, bufs, &content);
+    goto end;
+  }
+  store_write(device, entry->disk_offset, content.page, old_raw_size);
+  copy_bufs_vector_to_disk(device, entry->disk_offset + offset, bufs, size);
+  // The range reaches beyond the old content, nothing of it is left after.
+  entry->checksum =
+      bufs_checksum(obj_crc32c(0, content.page, offset), bufs, 0, size);
+  entry->codec = OBJ_CODEC_NONE;
+  entry->raw_size = raw_size;
+  flush_objects_table_entry(device, i);
+
+end:
+  release_content(&content);
+  return err;
+}
 
-  // 4. Write the object content
-  copy_bufs_vector_to_disk(obj_addr, bufs, objectsize);
+uint write_object_range(struct device* dev, const char* name, uint offset,
+                        uint size, vector bufs) {
+  uint err;
+  struct obj_device_private* device = dev_private(dev);
+
+  err = check_rewrite_object_validality(device, offset + size, name);
+  if (err != NO_ERR) {
+    goto end;
+  }
+  acquirewritesleep(&device->disklock);
+  uint i;
+  err = get_objects_table_index(device, name, &i);
+  if (err != NO_ERR) {
+    goto unlock;
+  }
+  objects_table_entry* entry = get_objects_table_entry(device, i);
+  if (offset > object_raw_size(entry)) {
+    err = RANGE_OUT_OF_OBJECT;
+    goto unlock;
+  }
+  if (entry->codec != OBJ_CODEC_NONE) {
+    err = write_compressed_range(device, i, offset, size, bufs);
+    if (err != NO_ERR) {
+      goto unlock;
+    }
+    dedup_object(device, i);
+    write_super_block(device);
+    goto unlock;
+  }
+  uint old_size = entry->size;
+  err = unshare_object(device, i, max(offset + size, old_size), old_size);
+  if (err != NO_ERR) {
+    goto unlock;
+  }
+  if (offset + size > entry->size) {
+    err = resize_object(device, i, offset + size, old_size);
+    if (err != NO_ERR) {
+      goto unlock;
+    }
+  }
+  // Patch the checksum with the overwritten bytes, then extend it with the
+  // appended ones.
+  uint overwritten = min(size, old_size - offset);
+  uint delta =
+      store_checksum(device, 0, entry->disk_offset + offset, overwritten) ^
+      bufs_checksum(0, bufs, 0, overwritten);
+  entry->checksum = obj_crc32c_patch(entry->checksum, delta,
+                                     old_size - offset - overwritten);
+  entry->checksum =
+      bufs_checksum(entry->checksum, bufs, overwritten, size - overwritten);
+  copy_bufs_vector_to_disk(device, entry->disk_offset + offset, bufs, size);
+  flush_objects_table_entry(device, i);
+  dedup_object(device, i);
 
-  device->sb.bytes_occupied += objectsize;
   write_super_block(device);
   err = NO_ERR;
 
 unlock:
-  releasesleep(&device->disklock);
+  releasewritesleep(&device->disklock);
 end:
   return err;
 }
 
+uint compact_objects(struct device* dev, uint max_objects) {
+  struct obj_device_private* device = dev_private(dev);
+  uint done;
+
+  acquirewritesleep(&device->disklock);
+  // The clones read a frozen device without its lock, it must not move.
+  done = device->frozen || compact_store(device, max_objects);
+  releasewritesleep(&device->disklock);
+
+  return done;
+}
+
+uint scrub_objects(struct device* dev, uint* cursor, uint max_objects) {
+  struct obj_device_private* device = dev_private(dev);
+  uint done;
+
+  acquirereadsleep(&device->disklock);
+  *cursor = max(*cursor, OBJ_ROOTINO - 1);
+  for (uint visited = 0;
+       *cursor < get_object_table_size(device) && visited < max_objects;
+       visited++, (*cursor)++) {
+    objects_table_entry* entry = get_objects_table_entry(device, *cursor);
+    // A shared content is verified once, with the entry holding it.
+    if (!entry->occupied || entry->shared_with != 0 ||
+        entry_in_base(device, entry)) {
+      continue;
+    }
+    check_content(device, entry,
+                  store_checksum(device, 0, entry->disk_offset, entry->size));
+  }
+  done = *cursor >= get_object_table_size(device);
+  releasereadsleep(&device->disklock);
+
+  return done;
+}
+
 uint object_size(struct device* dev, const char* name, uint* output) {
   uint err = NO_ERR;
   struct obj_device_private* device = dev_private(dev);
@@ -401,18 +1678,18 @@ uint object_size(struct device* dev, const char* name, uint* output) {
     err = OBJECT_NAME_TOO_LONG;
     goto end;
   }
-  acquiresleep(&device->disklock);
+  acquirereadsleep(&device->disklock);
   uint i;
   err = get_objects_table_index(device, name, &i);
   if (err != NO_ERR) {
     goto unlock;
   }
   objects_table_entry* entry = get_objects_table_entry(device, i);
-  *output = entry->size;
+  *output = object_raw_size(entry);
   err = NO_ERR;
 
 unlock:
-  releasesleep(&device->disklock);
+  releasereadsleep(&device->disklock);
 end:
   return err;
 }
@@ -420,7 +1697,6 @@ end:
 uint get_object(struct device* dev, const char* name, vector bufs) {
   uint err = NO_ERR;
   struct obj_device_private* device = dev_private(dev);
-  char* obj_addr;
   struct buf* curr_buf;
   uint copied_bytes = 0;
 
@@ -431,7 +1707,7 @@ uint get_object(struct device* dev, const char* name, vector bufs) {
   }
   // 2. try to locate the object in the object-table
   // return an index i or an error code
-  acquiresleep(&device->disklock);
+  acquirereadsleep(&device->disklock);
   uint i;
   err = get_objects_table_index(device, name, &i);
   if (err != NO_ERR) {
@@ -439,26 +1715,71 @@ uint get_object(struct device* dev, const char* name, vector bufs) {
   }
   // 3. read the objects offset in disk, then read the object into
   // the output bufs
-  objects_table_entry* entry = get_objects_table_entry(device, i);
-  if (entry->size > (bufs.vectorsize * BUF_DATA_SIZE)) {
-    releasesleep(&device->disklock);
+  struct obj_device_private* holder = device;
+  objects_table_entry* entry = content_location(&holder, i);
+  if (object_raw_size(entry) > (bufs.vectorsize * BUF_DATA_SIZE)) {
+    releasereadsleep(&device->disklock);
     return BUFFER_TOO_SMALL;
   }
+  if (entry->codec != OBJ_CODEC_NONE) {
+    err = read_compressed_range(device, i, 0, entry->raw_size, bufs);
+    goto unlock;
+  }
 
-  obj_addr = device->storage_holder->memory_storage + entry->disk_offset;
   for (uint buf_index = 0; buf_index < bufs.vectorsize; buf_index++) {
     uint block_size = min(BUF_DATA_SIZE,  // NOLINT(build/include_what_you_use)
                           entry->size - copied_bytes);
     memmove_from_vector((char*)&curr_buf, bufs, buf_index, 1);
-    memmove(curr_buf->data, obj_addr + copied_bytes, block_size);
+    store_read(holder, entry->disk_offset + copied_bytes,
+               (char*)curr_buf->data, block_size);
     curr_buf->flags |= B_VALID;
     copied_bytes += block_size;
   }
 
-  err = NO_ERR;
+  err = verify_read(device, holder, i, entry, 0, entry->size, bufs);
+
+unlock:
+  releasereadsleep(&device->disklock);
+end:
+  return err;
+}
+
+uint get_object_range(struct device* dev, const char* name, uint offset,
+                      uint size, vector bufs) {
+  uint err = NO_ERR;
+  struct obj_device_private* device = dev_private(dev);
+
+  if (strlen(name) > MAX_OBJECT_NAME_LENGTH) {
+    err = OBJECT_NAME_TOO_LONG;
+    goto end;
+  }
+  if (size > (bufs.vectorsize * BUF_DATA_SIZE)) {
+    err = BUFFER_TOO_SMALL;
+    goto end;
+  }
+  acquirereadsleep(&device->disklock);
+  uint i;
+  err = get_objects_table_index(device, name, &i);
+  if (err != NO_ERR) {
+    goto unlock;
+  }
+  struct obj_device_private* holder = device;
+  objects_table_entry* entry = content_location(&holder, i);
+  uint raw_size = object_raw_size(entry);
+  if (offset > raw_size || size > raw_size - offset) {
+    err = RANGE_OUT_OF_OBJECT;
+    goto unlock;
+  }
+  if (entry->codec != OBJ_CODEC_NONE) {
+    err = read_compressed_range(device, i, offset, size, bufs);
+    goto unlock;
+  }
+
+  copy_disk_to_bufs_vector(holder, entry->disk_offset + offset, bufs, size);
+  err = verify_read(device, holder, i, entry, offset, size, bufs);
 
 unlock:
-  releasesleep(&device->disklock);
+  releasereadsleep(&device->disklock);
 end:
   return err;
 }
@@ -468,52 +1789,73 @@ uint delete_object(struct device* dev, const char* name) {
   struct obj_device_private* device = dev_private(dev);
 
   err = check_delete_object_validality(name);
+  if (err == NO_ERR && device->frozen) {
+    err = DEVICE_FROZEN;
+  }
   if (err != NO_ERR) {
     goto end;
   }
-  acquiresleep(&device->disklock);
+  acquirewritesleep(&device->disklock);
   uint i;
   err = get_objects_table_index(device, name, &i);
   if (err != NO_ERR) {
     goto unlock;
   }
   objects_table_entry* entry = get_objects_table_entry(device, i);
+  objects_index_remove(device, name);
+  if (entry->refs > 0) {
+    hand_over_content(device, i);
+  } else {
+    content_index_remove(device, i);
+  }
+  if (entry->shared_with != 0) {
+    release_shared_content(device, i);
+  } else if (!entry_in_base(device, entry)) {
+    space_map_unlink(device, i);
+    device->sb.bytes_occupied -= entry->size;
+  }
+  if (i < space_map(device)->first_free_entry) {
+    space_map(device)->first_free_entry = i;
+  }
   entry->occupied = 0;
+  flush_objects_table_entry(device, i);
   device->sb.occupied_objects -= 1;
-  device->sb.bytes_occupied -= entry->size;
   write_super_block(device);
   err = NO_ERR;
 
 unlock:
-  releasesleep(&device->disklock);
+  releasewritesleep(&device->disklock);
 end:
   return err;
 }
 
 uint check_add_object_validity(struct obj_device_private* device, uint size,
                                const char* name) {
-  // currently, because we don't use hash function, we must first scan the
-  // table and check if the object already exists.
+  uint i;
+  if (device->frozen) {
+    return DEVICE_FROZEN;
+  }
   if (strlen(name) > MAX_OBJECT_NAME_LENGTH) {
     return OBJECT_NAME_TOO_LONG;
   }
-  if (STORAGE_DEVICE_SIZE < size) {
+  if (device->sb.storage_device_size < size) {
     return NO_DISK_SPACE_FOUND;
   }
-  for (uint i = 0; i < get_object_table_size(device); ++i) {
-    if (get_objects_table_entry(device, i)->occupied &&
-        obj_id_cmp(get_objects_table_entry(device, i)->object_id, name) == 0) {
-      return OBJECT_EXISTS;
-    }
+  if (get_objects_table_index(device, name, &i) == NO_ERR) {
+    return OBJECT_EXISTS;
   }
   return NO_ERR;
 }
 
-uint check_rewrite_object_validality(uint size, const char* name) {
+uint check_rewrite_object_validality(struct obj_device_private* device,
+                                     uint size, const char* name) {
+  if (device->frozen) {
+    return DEVICE_FROZEN;
+  }
   if (strlen(name) > MAX_OBJECT_NAME_LENGTH) {
     return OBJECT_NAME_TOO_LONG;
   }
-  if (STORAGE_DEVICE_SIZE < size) {
+  if (device->sb.storage_device_size < size) {
     return NO_DISK_SPACE_FOUND;
   }
   return NO_ERR;
@@ -530,10 +1872,10 @@ uint new_inode_number(struct device* dev) {
   uint new_inode;
   struct obj_device_private* device = dev_private(dev);
 
-  acquiresleep(&device->disklock);
+  acquirewritesleep(&device->disklock);
   new_inode = ++device->sb.last_inode;
   write_super_block(device);
-  releasesleep(&device->disklock);
+  releasewritesleep(&device->disklock);
 
   return new_inode;
 }
@@ -541,38 +1883,38 @@ uint new_inode_number(struct device* dev) {
 uint occupied_objects(struct obj_device_private* device) {
   uint occupied_objects = 0;
 
-  acquiresleep(&device->disklock);
+  acquirereadsleep(&device->disklock);
   occupied_objects = device->sb.occupied_objects;
-  releasesleep(&device->disklock);
+  releasereadsleep(&device->disklock);
 
   return occupied_objects;
 }
 
 void set_occupied_objects(struct obj_device_private* device, uint value) {
   int acquired = 0;
-  if (!holdingsleep(&device->disklock)) {
+  if (!holdingrwsleep(&device->disklock)) {
     acquired = 1;
-    acquiresleep(&device->disklock);
+    acquirewritesleep(&device->disklock);
   }
 
   device->sb.occupied_objects = value;
   write_super_block(device);
 
   if (acquired) {
-    releasesleep(&device->disklock);
+    releasewritesleep(&device->disklock);
   }
 }
 
 void set_store_offset(struct obj_device_private* device, uint new_offset) {
   int acquired = 0;
-  if (!holdingsleep(&device->disklock)) {
+  if (!holdingrwsleep(&device->disklock)) {
     acquired = 1;
-    acquiresleep(&device->disklock);
+    acquirewritesleep(&device->disklock);
   }
   device->sb.store_offset = new_offset;
   write_super_block(device);
   if (acquired) {
-    releasesleep(&device->disklock);
+    releasewritesleep(&device->disklock);
   }
 }
 
@@ -580,15 +1922,15 @@ uint device_size(struct obj_device_private* device) {
   uint size = 0;
   int acquired = 0;
 
-  if (!holdingsleep(&device->disklock)) {
+  if (!holdingrwsleep(&device->disklock)) {
     acquired = 1;
-    acquiresleep(&device->disklock);
+    acquirereadsleep(&device->disklock);
   }
 
   size = device->sb.storage_device_size;
 
   if (acquired) {
-    releasesleep(&device->disklock);
+    releasereadsleep(&device->disklock);
   }
 
   return size;
@@ -597,9 +1939,91 @@ uint device_size(struct obj_device_private* device) {
 uint occupied_bytes(struct obj_device_private* device) {
   uint bytes = 0;
 
-  acquiresleep(&device->disklock);
+  acquirereadsleep(&device->disklock);
   bytes = device->sb.bytes_occupied;
-  releasesleep(&device->disklock);
+  releasereadsleep(&device->disklock);
 
   return bytes;
 }
+
+void fragmentation_stats(struct obj_device_private* device,
+                         struct obj_fragmentation_stats* stats) {
+  struct objects_space_map* map = space_map(device);
+
+  acquirereadsleep(&device->disklock);
+  stats->free_bytes =
+      device->sb.storage_device_size - device->sb.bytes_occupied;
+  stats->holes = map->holes;
+  stats->largest_free_extent = gap_size(device, 0);
+  // Only the highest non-empty bin can hold the largest gap.
+  for (uint bin = OBJECTS_GAP_BINS; bin > 0; bin--) {
+    if (map->gap_bins[bin - 1] == 0) {
+      continue;
+    }
+    for (uint i = map->gap_bins[bin - 1]; i != 0; i = map->gap_next[i]) {
+      stats->largest_free_extent =
+          max(stats->largest_free_extent, gap_size(device, i));
+    }
+    break;
+  }
+  releasereadsleep(&device->disklock);
+}
+
+void set_objects_dedup(struct obj_device_private* device, uint enable) {
+  acquirewritesleep(&device->disklock);
+  if (device->frozen) {
+    releasewritesleep(&device->disklock);
+    return;
+  }
+  if (enable && !(device->sb.flags & OBJ_FS_DEDUP)) {
+    device->sb.flags |= OBJ_FS_DEDUP;
+    for (uint i = OBJ_ROOTINO - 1; i < get_object_table_size(device); i++) {
+      objects_table_entry* entry = get_objects_table_entry(device, i);
+      if (entry->occupied && entry->shared_with == 0 &&
+          !entry_in_base(device, entry)) {
+        dedup_object(device, i);
+      }
+    }
+  } else if (!enable && (device->sb.flags & OBJ_FS_DEDUP)) {
+    device->sb.flags &= ~OBJ_FS_DEDUP;
+    memset(device->storage_holder->content_index, 0,
+           sizeof(device->storage_holder->content_index));
+  }
+  write_super_block(device);
+  releasewritesleep(&device->disklock);
+}
+
+uint shared_bytes(struct obj_device_private* device) {
+  uint shared;
+
+  acquirereadsleep(&device->disklock);
+  shared = device->sb.shared_bytes;
+  releasereadsleep(&device->disklock);
+
+  return shared;
+}
+
+void set_objects_compression(struct obj_device_private* device, uint enable) {
+  acquirewritesleep(&device->disklock);
+  if (device->frozen) {
+    releasewritesleep(&device->disklock);
+    return;
+  }
+  if (enable) {
+    device->sb.flags |= OBJ_FS_COMPRESS;
+  } else {
+    device->sb.flags &= ~OBJ_FS_COMPRESS;
+  }
+  write_super_block(device);
+  releasewritesleep(&device->disklock);
+}
+
+void set_objects_verify(struct obj_device_private* device, uint enable) {
+  acquirewritesleep(&device->disklock);
+  device->verify = enable;
+  releasewritesleep(&device->disklock);
+}
+
+uint checksum_errors(struct obj_device_private* device) {
+  return device->checksum_errors;
+}
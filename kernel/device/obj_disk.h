@@ -3,6 +3,7 @@
 
 #include "device.h"
 #include "fs/obj_fs.h"
+#include "fsdefs.h"
 #include "kvector.h"
 #include "sleeplock.h"
 #include "types.h"
@@ -34,43 +35,119 @@
  * is saved in the super-block of the file system as well as the position of
  * it.
  *
- * Hardware Mock
- * =============
- * In the current implementation, we use a "mock" storage device which saves
- * the data in the RAM. In future projcets, we can integrate with real
- * hardware and only this file would change. It would become asynchrony and
- * handle hardware interrupts. The output interface this layer exports is
- * object based only. Hence, it doesn't matter for upper layers, if the
- * storage device handle the objects table itself or the kernel does it.
- * When changing to interrupt-implemented driver, we could extend upper levels
- * in the file system as well. For example, the logbook layer - more details
- * on that in the relevant files.
+ * Storage backends
+ * ================
+ * The store is kept either in the memory or on a block device. The memory
+ * backend saves the data in a RAM array, and an access to it completes at
+ * once. The block device backend is described below. The output interface
+ * this layer exports is object based only. Hence, it doesn't matter for upper
+ * layers which backend holds the store, or if the storage device handles the
+ * objects table itself or the kernel does it.
  *
- * As we mentioned before, each transaction has a maximum size. Hence, when
- * writing large objects to the disk (or reading them) we need to split them
- * into smaller requests. This implementation depends on the interrupt
- * handling flow that communicates with the hardware. Hence, we didn't add
- * such logic to the mock implementation. We do the transaction from start to
- * end in a single operation.
+ * As we mentioned before, each transaction has a maximum size. Object reads
+ * from the cache go through the request queue of `obj_queue.h`, which splits
+ * them into transactions of at most `OBJ_MAX_TRANSFER_SIZE` bytes and serves
+ * several of them at a time. The completions of the queue are driven by the
+ * timer interrupt. As the memory backend has no real latency, the queue
+ * simulates one, which is set through procfs. Writes, and the reads made
+ * through the methods of this file, are done from start to end in a single
+ * operation.
  *
- * The inner implementation has the following structure:
+ * The inner implementation of the memory backend has the following structure:
  * The memory is an array of size `STORAGE_DEVICE_SIZE` which must be defined.
  * The super block is located at offset 0 and the table right after it.
  *
+ * Block device backend
+ * ====================
+ * The store can be kept on a block device, an IDE disk or a loop device,
+ * instead of the memory. The device is then accessed through `bread` and
+ * `bwrite`, and its layout is the same as the memory one: byte `x` of the
+ * store is byte `x % BSIZE` of block `x / BSIZE`. The memory array mirrors
+ * the super block and the objects table, so lookups don't read the disk, and
+ * every change of them is written through. Hence, the objects table is
+ * limited to `STORAGE_DEVICE_SIZE` bytes, while the store is limited only by
+ * the device size. The store format is defined in `fsdefs.h`, created by
+ * `mkfs_objfs` and loaded when mounting by `load_obj_device`.
+ *
+ * Objects lookup
+ * ==============
+ * The objects table stores the object's name as its id. To avoid scanning
+ * the whole table on every lookup, the driver keeps an in-memory hash index
+ * from the object id to its entry in the table. The index is built when the
+ * device is initialized and is updated whenever an entry is occupied or
+ * freed. It is not part of the on-disk format.
+ *
+ * Deduplication
+ * =============
+ * When the `OBJ_FS_DEDUP` flag of the super block is set, identical objects
+ * share a single copy of their content. After an object is written, its
+ * content is hashed and looked up in an in-memory index of the content
+ * hashes. If an object with the same content is found, the written object
+ * releases its extent and points to the entry of the found object instead
+ * (`shared_with`), which counts the objects sharing its content (`refs`).
+ * A shared content is copied on write: the written object gets a private
+ * extent first. When the entry holding a shared content is deleted or
+ * written, it hands the content over to one of the objects sharing it.
+ * The hashes are kept in the objects table, so the index is rebuilt on load
+ * without reading the store.
+ *
+ * Compression
+ * ===========
+ * When the `OBJ_FS_COMPRESS` flag of the super block is set, objects of up to
+ * `OBJ_CODEC_MAX_SIZE` bytes are compressed by the LZ codec (`obj_codec.h`)
+ * as they are written, which covers the file extents and the inodes. An
+ * object is kept compressed only if it shrinks, and its entry records the
+ * codec and the decompressed size (`raw_size`), while `size` remains the size
+ * of its extent, so the space management and the deduplication work on the
+ * compressed content. Reads decompress the whole object into a scratch page.
+ * A range write decompresses the object, patches it and compresses it again;
+ * an object which grows beyond `OBJ_CODEC_MAX_SIZE` is stored raw from then
+ * on. Objects written while the flag is clear are stored raw, and the flag
+ * applies per device, so each mount chooses whether to compress.
+ *
+ * Snapshots and clones
+ * ====================
+ * A device can be frozen as a read-only snapshot, and then cloned. A clone is
+ * a writable memory device whose objects table starts as a copy of the
+ * snapshot's one, so cloning costs the size of the table, no matter how much
+ * data the objects hold. The clone's generation is the snapshot's one plus 1,
+ * and every object the clone writes is stamped with it. An object of an older
+ * generation was not written since the clone was made, and its content is
+ * read from the snapshot (`base`). It is copied into the clone's store on its
+ * first write, like a shared content of the deduplication. The snapshot is
+ * frozen for as long as the device lives, so the clones can read it without
+ * its lock.
+ *
+ * Checksums
+ * =========
+ * Every entry holds the CRC32C (`obj_checksum.h`) of its content as it is in
+ * the store, that is the compressed content of a compressed object. The
+ * checksum is computed as the content is written. A range write updates it
+ * from the checksums of the overwritten bytes before and after the write, so
+ * its cost doesn't depend on the object size. Reads verify the checksum of
+ * the whole content, also when they read only a range of it, and fail with
+ * `CORRUPTED_OBJECT` on a mismatch; the file extents are at most a block, so
+ * a range read checks a few more bytes only. The verification is switched
+ * per device, and so per mount, and is on by default. `scrub_objects` walks
+ * the store and verifies all the objects, in slices like the compaction.
+ * The mismatches found by both are counted in `checksum_errors`. The super
+ * block and the objects table are not checksummed.
+ *
  * Futher improvments
  * ==================
- * Currently, the objects table is implemented in a naive way of storing the
- * object's name as it's id. In the future, better implementation can be
- * implemented. One such implementation would use hash method on the name.
- * This hash method should be collision-free (sha256 would be sufficient
- * here). This would provide us the abillity to find the object without
- * full scanning the objects-table. In addition, this method would set all
- * the ids to be with the same length in bytes.
+ * The ids themselves could be replaced by a collision-free hash of the name
+ * (sha256 would be sufficient here). This would set all the ids to be with
+ * the same length in bytes.
  * Because we currently doesn't use such method, we set an upper length for
  * the objects name. Hence, a relevant error can occour when calling
  *
- * In the current version, the disk is NOT thread safe.
- * TODO make it a thread safe.
+ *
+ * Concurrency
+ * ===========
+ * The device is guarded by a reader-writer sleep lock. Lookups and data
+ * copies, such as `get_object` and `object_size`, share it, so readers of the
+ * same device don't wait for each other. Allocation and any mutation of the
+ * objects table or the store, including compaction, take it exclusively.
  */
 
 // Set default storage device size
@@ -78,13 +155,6 @@
 #define STORAGE_DEVICE_SIZE 327680
 #endif
 
-// The object table is of variable size.
-// However, this is its default initial size.
-// During the creation and deletion of files
-// this table can grow in otder to index many files,
-// Or shrink, making room for content storage.
-#define INITIAL_OBJECT_TABLE_SIZE 200
-
 // Possible errors:
 #define NO_ERR 0
 #define OBJECT_EXISTS 1
@@ -93,57 +163,123 @@
 #define OBJECTS_TABLE_FULL 4
 #define NO_DISK_SPACE_FOUND 5
 #define BUFFER_TOO_SMALL 6
+#define RANGE_OUT_OF_OBJECT 7
+#define BAD_SUPER_BLOCK 8
+#define NO_MEMORY 9
+#define CORRUPTED_OBJECT 10
+#define DEVICE_FROZEN 11
 
-// In the future, this can be set the size of SHA256 digest.
-#define OBJECT_ID_LENGTH MAX_OBJECT_NAME_LENGTH
-
-struct objsuperblock {
-  uint storage_device_size;
-  uint objects_table_offset;
-  // the last inode added
-  uint last_inode;
-  // variables to trace the file-system state
-  uint bytes_occupied;
-  uint occupied_objects;
-  struct vfs_superblock vfs_sb;
-  // determines the limit between object table space and the store itself
-  uint store_offset;
+// The maximal size of a compressed object. Its raw content and the compressed
+// one fit together in a scratch page.
+#define OBJ_CODEC_MAX_SIZE (2 * BSIZE)
+
+/**
+ * The objects table can grow until it takes the whole memory storage. The
+ * in-memory structures below are sized for that upper bound so they never
+ * have to be resized. Entry indices are kept as `ushort` to save kernel memory.
+ */
+#define OBJECTS_TABLE_MAX_ENTRIES \
+  (STORAGE_DEVICE_SIZE / sizeof(objects_table_entry))
+#define OBJECTS_INDEX_SIZE (2 * OBJECTS_TABLE_MAX_ENTRIES)
+
+// Free space is binned by the floor of the log2 of the gap size.
+#define OBJECTS_GAP_BINS 32
+#define OBJECTS_GAP_NOT_BINNED 0xff
+
+/**
+ * In-memory map of the store space.
+ * The free space is never stored explicitly, it is the gaps between
+ * consecutive occupied objects. All the objects with data are linked by their
+ * disk offset, and each non-empty gap is linked, by the entry preceding it,
+ * into a list of gaps of similar size (segregated free lists). Entry 0 (the
+ * super block) is the head of the offset ordered list, its gap is the free
+ * space between the objects table and the first object. That gap is not
+ * binned as it is kept for the objects table growth.
+ */
+struct objects_space_map {
+  ushort order_prev[OBJECTS_TABLE_MAX_ENTRIES];
+  ushort order_next[OBJECTS_TABLE_MAX_ENTRIES];
+  ushort gap_prev[OBJECTS_TABLE_MAX_ENTRIES];
+  ushort gap_next[OBJECTS_TABLE_MAX_ENTRIES];
+  uchar gap_bin[OBJECTS_TABLE_MAX_ENTRIES];
+  ushort gap_bins[OBJECTS_GAP_BINS];
+  // The amount of binned gaps.
+  uint holes;
+  // All the entries below this index are occupied.
+  uint first_free_entry;
+  // The objects from this entry to the end of the device are compacted. 0 if
+  // the compaction should start over from the end of the device.
+  uint compact_cursor;
 };
 
 struct memory_storage_holder {
+  // The store, or only its super block and objects table when the store is on
+  // a block device.
   char memory_storage[STORAGE_DEVICE_SIZE];
+  /*
+   * Open-addressing hash index from object id to its objects table entry.
+   * Each slot holds the entry index plus one, zero marks an empty slot.
+   */
+  ushort objects_index[OBJECTS_INDEX_SIZE];
+  /*
+   * Open-addressing hash index from content hash to the entries holding the
+   * content, when deduplication is enabled. Each slot holds the entry index
+   * plus one, zero marks an empty slot.
+   */
+  ushort content_index[OBJECTS_INDEX_SIZE];
+  struct objects_space_map space_map;
   bool is_used;
 };
 
 struct obj_device_private {
-  struct sleeplock disklock;
+  struct rwsleeplock disklock;
+  // The block device holding the store, NULL when it is kept in the memory.
+  struct device* backing_dev;
   struct memory_storage_holder* storage_holder;
   struct objsuperblock sb;
+  // A frozen device is a read-only snapshot.
+  uint frozen;
+  // The snapshot the device was cloned from, or NULL.
+  struct device* base;
+  // Whether the reads verify the checksums of the objects.
+  uint verify;
+  uint checksum_errors;
 };
 
-typedef struct objects_table_entry {
-  /*
-   * If the object's name is exactly `MAX_OBJECT_NAME_LENGTH` we don't store
-   * the null terminator.
-   */
-  char object_id[OBJECT_ID_LENGTH];
-  uint disk_offset;
-  uint size;
-  int occupied;
-} objects_table_entry;
-
 int obj_id_cmp(const char* p, const char* q);
 uint obj_id_bytes(const char* object_id);
 
 /**
- * Loads the super-block struct from the disk and set the state of the driver.
- *
- * In the current implementation, because we don't use real device, we
- * initialize the state of the super block manually to compilation known
- * values. In addition, we set the in-memory disk array.
+ * Initializes a device whose store is kept in the memory. As there is nothing
+ * to load, the super block and the objects table are set to the initial state
+ * of an empty store.
  */
 void init_obj_device(struct device* dev);
 
+/**
+ * Initializes a device whose store is kept on the block device `backing_dev`.
+ * The super block and the objects table are read from the block device, and
+ * the in-memory index and space map are built from them. The device keeps a
+ * reference to `backing_dev`. Reads the disk, hence it might sleep.
+ * The method returns a code indicates the error occured.
+ *   NO_ERR          - no error occured.
+ *   BAD_SUPER_BLOCK - the block device doesn't hold a valid store.
+ */
+uint load_obj_device(struct device* dev, struct device* backing_dev);
+
+/**
+ * Freezes the device as a read-only snapshot, for the rest of its life. The
+ * modifications of a frozen device fail with `DEVICE_FROZEN`.
+ */
+void freeze_obj_device(struct device* dev);
+
+/**
+ * Initializes a writable clone of the frozen device `base`. The clone's store
+ * is kept in the memory, and it shares the content of the objects with `base`
+ * until they are written. The device keeps a reference to `base`.
+ */
+void init_obj_clone_device(struct device* dev, struct device* base);
+
 /**
  * Writes a new object of size `size` to the disk.
  * The name of the object is specified by the parameter `name` using a null
@@ -173,6 +309,19 @@ uint add_object(struct device* dev, const char* name, vector bufs, uint size);
 uint write_object(struct device* dev, const char* name, vector bufs,
                   uint objectsize);
 
+/**
+ * Writes `size` bytes from the buf pointers vector to the object, starting at
+ * byte `offset` of the object. The rest of the object content is kept. If the
+ * range ends after the object end, the object grows and might be moved.
+ * The method returns a code indicates the error occured.
+ *   NO_ERR              - no error occured.
+ *   OBJECT_NOT_EXISTS   - no object with this name exists.
+ *   RANGE_OUT_OF_OBJECT - `offset` is after the end of the object.
+ *   NO_DISK_SPACE_FOUND - the object can't grow to the range end.
+ */
+uint write_object_range(struct device* dev, const char* name, uint offset,
+                        uint size, vector bufs);
+
 /**
  * Delete the specific object from the objects table. The bytes on the disk
  * does not change.
@@ -197,9 +346,52 @@ uint object_size(struct device* dev, const char* name, uint* output);
  *   NO_ERR            - no error occured.
  *   OBJECT_NOT_EXISTS - no object with this name exists.
  *   BUFFER_TOO_SMALL  - the given buffer is too small
+ *   CORRUPTED_OBJECT  - the content doesn't match its checksum.
  */
 uint get_object(struct device* dev, const char* name, vector bufs);
 
+/**
+ * Copy `size` bytes of the object, starting at byte `offset` of the object,
+ * to the output buf pointers vector. Only the bufs covering the range are
+ * filled and marked as valid.
+ * The method returns a code indicates the error occured.
+ *   NO_ERR              - no error occured.
+ *   OBJECT_NOT_EXISTS   - no object with this name exists.
+ *   BUFFER_TOO_SMALL    - the given buffer is too small
+ *   RANGE_OUT_OF_OBJECT - the range exceeds the object end.
+ *   CORRUPTED_OBJECT    - the content doesn't match its checksum.
+ */
+uint get_object_range(struct device* dev, const char* name, uint offset,
+                      uint size, vector bufs);
+
+/**
+ * Compacts the store by sliding objects towards the end of the device, so the
+ * free space gathers in a single extent before the first object. Each call
+ * moves at most `max_objects` objects and keeps its progress for the next
+ * call, so the compaction can run in bounded slices between other operations.
+ * The compaction also runs, as a whole, when an allocation fails only
+ * because the free space is fragmented.
+ * Returns 1 when the store is fully compacted, 0 otherwise.
+ */
+uint compact_objects(struct device* dev, uint max_objects);
+
+// The amount of objects `compact_objects` should move in a single slice.
+#define COMPACTION_SLICE_OBJECTS 32
+
+/**
+ * Verifies the checksums of the objects, starting from entry `*cursor`, which
+ * should be 0 on the first call. Each call visits at most `max_objects`
+ * entries and advances the cursor, so the scrub can run in bounded slices
+ * between other operations. The corrupted objects are counted in the
+ * checksum errors of the device. The objects whose content is in the base
+ * snapshot are left to the scrub of the snapshot.
+ * Returns 1 when all the objects were visited, 0 otherwise.
+ */
+uint scrub_objects(struct device* dev, uint* cursor, uint max_objects);
+
+// The amount of objects `scrub_objects` should verify in a single slice.
+#define SCRUB_SLICE_OBJECTS 32
+
 /**
  * The following methods are utility methods to help restore the disk in case
  * of state failures. The usages are fixing a corrupted disk by utility
@@ -222,6 +414,13 @@ uint get_objects_table_index(struct obj_device_private* device,
 objects_table_entry* get_objects_table_entry(struct obj_device_private* device,
                                              uint entry_index);
 
+/**
+ * Rebuilds the in-memory objects index and space map from the objects table.
+ * Must be called after the table entries were changed directly and not by the
+ * methods of this file.
+ */
+void rebuild_objects_table_index(struct obj_device_private* device);
+
 /** Validation methods to ensure safe operations. They are automaticaly used by
  * the main operations. You can use them when you want to do some logic before
  * adding/changing the objects and want to make sure the operation would
@@ -231,7 +430,8 @@ objects_table_entry* get_objects_table_entry(struct obj_device_private* device,
 //@{
 uint check_add_object_validity(struct obj_device_private* device, uint size,
                                const char* name);
-uint check_rewrite_object_validality(uint size, const char* name);
+uint check_rewrite_object_validality(struct obj_device_private* device,
+                                     uint size, const char* name);
 uint check_delete_object_validality(const char* name);
 //@}
 
@@ -276,6 +476,50 @@ uint device_size(struct obj_device_private* device);
  */
 uint occupied_bytes(struct obj_device_private* device);
 
+struct obj_fragmentation_stats {
+  uint free_bytes;
+  // The largest object that can be added without compaction.
+  uint largest_free_extent;
+  // The amount of free extents between objects.
+  uint holes;
+};
+
+/**
+ * Fills `stats` with the fragmentation state of the store.
+ */
+void fragmentation_stats(struct obj_device_private* device,
+                         struct obj_fragmentation_stats* stats);
+
+/**
+ * Enables or disables the deduplication of objects written from now on.
+ * Enabling hashes the content of all the objects, and so reads the store.
+ */
+void set_objects_dedup(struct obj_device_private* device, uint enable);
+
+/**
+ * Returns the bytes saved by the deduplication, that is the total size of the
+ * objects sharing the content of another object.
+ */
+uint shared_bytes(struct obj_device_private* device);
+
+/**
+ * Enables or disables the compression of objects written from now on. The
+ * objects already written are kept as they are.
+ */
+void set_objects_compression(struct obj_device_private* device, uint enable);
+
+/**
+ * Enables or disables the verification of the checksums of the objects read
+ * from the device.
+ */
+void set_objects_verify(struct obj_device_private* device, uint enable);
+
+/**
+ * Returns the amount of checksum mismatches found by the reads and the scrubs
+ * of the device.
+ */
+uint checksum_errors(struct obj_device_private* device);
+
 /**
  * Resize the object table and the store itself
  * by setting the limit between them to a specified value.
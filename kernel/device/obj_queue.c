@@ -0,0 +1,171 @@
+#include "obj_queue.h"
+
+#include "buf.h"
+#include "defs.h"
+#include "obj_disk.h"
+#include "spinlock.h"
+
+#define OBJ_MAX_TRANSFER_BUFS (OBJ_MAX_TRANSFER_SIZE / BUF_DATA_SIZE)
+
+struct obj_transaction {
+  struct obj_request* req;
+  uint deadline;
+};
+
+struct obj_queue {
+  struct spinlock lock;
+  // Requests with transactions the device did not start yet, in FIFO order.
+  struct obj_request* head;
+  struct obj_request* tail;
+  struct obj_transaction inflight[OBJ_QUEUE_DEPTH];
+  struct obj_queue_stats stats;
+};
+
+static struct obj_queue obj_queue;
+
+static uint obj_request_is_buf_valid(struct obj_request* req, uint index) {
+  struct buf* curr_buf;
+
+  memmove_from_vector((char*)&curr_buf, req->bufs, index, 1);
+  return curr_buf->flags & B_VALID;
+}
+
+// Reads `count` bufs of the request, starting at `index`, from the device.
+static uint obj_request_transfer(struct obj_request* req, uint index,
+                                 uint count) {
+  struct buf* curr_buf;
+  vector range_bufs = newvector(count, sizeof(struct buf*));
+  uint offset = index * BUF_DATA_SIZE;
+  uint size = min(count * BUF_DATA_SIZE, req->size - offset);
+  uint err;
+
+  for (uint range_index = 0; range_index < count; range_index++) {
+    memmove_from_vector((char*)&curr_buf, req->bufs, index + range_index, 1);
+    memmove_into_vector_elements(range_bufs, range_index, (char*)&curr_buf,
+                                 1);
+  }
+  err = get_object_range(req->dev, req->name, req->offset + offset, size,
+                         range_bufs);
+  freevector(&range_bufs);
+
+  return err;
+}
+
+// Must be called with obj_queue.lock held.
+static void obj_request_done(struct obj_request* req) {
+  req->done = 1;
+  if (req->complete) {
+    req->complete(req);
+  }
+  wakeup(req);
+}
+
+// Starts the queued transactions, as long as the device has free slots.
+// Must be called with obj_queue.lock held.
+static void obj_queue_start_transactions(void) {
+  for (uint slot = 0; slot < OBJ_QUEUE_DEPTH && obj_queue.head; slot++) {
+    struct obj_transaction* transaction = &obj_queue.inflight[slot];
+    if (transaction->req) {
+      continue;
+    }
+    transaction->req = obj_queue.head;
+    transaction->deadline = ticks + obj_queue.stats.latency;
+    obj_queue.stats.in_flight++;
+    if (++obj_queue.head->started == obj_queue.head->transactions) {
+      obj_queue.head = obj_queue.head->qnext;
+    }
+  }
+}
+
+void obj_queue_init(void) {
+  initlock(&obj_queue.lock, "obj_queue");
+  obj_queue.head = 0;
+  obj_queue.tail = 0;
+  memset(obj_queue.inflight, 0, sizeof(obj_queue.inflight));
+  memset(&obj_queue.stats, 0, sizeof(obj_queue.stats));
+}
+
+void obj_submit(struct obj_request* req) {
+  struct obj_device_private* device = dev_private(req->dev);
+
+  req->err = NO_ERR;
+  req->done = 0;
+  req->transactions = 0;
+  req->started = 0;
+  req->completed = 0;
+  req->qnext = 0;
+
+  // Transfer every run of invalid bufs, in chunks of the maximal size.
+  for (uint index = 0; index < req->bufs.vectorsize && NO_ERR == req->err;) {
+    if (obj_request_is_buf_valid(req, index)) {
+      index++;
+      continue;
+    }
+    uint count = 1;
+    while (index + count < req->bufs.vectorsize &&
+           count < OBJ_MAX_TRANSFER_BUFS &&
+           !obj_request_is_buf_valid(req, index + count)) {
+      count++;
+    }
+    req->err = obj_request_transfer(req, index, count);
+    req->transactions++;
+    index += count;
+  }
+
+  acquire(&obj_queue.lock);
+  obj_queue.stats.requests++;
+  obj_queue.stats.transactions += req->transactions;
+  if (NO_ERR != req->err || 0 == req->transactions ||
+      0 == obj_queue.stats.latency || device->backing_dev) {
+    obj_request_done(req);
+  } else {
+    if (obj_queue.head) {
+      obj_queue.tail->qnext = req;
+    } else {
+      obj_queue.head = req;
+    }
+    obj_queue.tail = req;
+    obj_queue_start_transactions();
+  }
+  release(&obj_queue.lock);
+}
+
+uint obj_wait(struct obj_request* req) {
+  acquire(&obj_queue.lock);
+  while (!req->done) {
+    sleep(req, &obj_queue.lock);
+  }
+  release(&obj_queue.lock);
+
+  return req->err;
+}
+
+void obj_queue_intr(void) {
+  acquire(&obj_queue.lock);
+  for (uint slot = 0; slot < OBJ_QUEUE_DEPTH; slot++) {
+    struct obj_transaction* transaction = &obj_queue.inflight[slot];
+    struct obj_request* req = transaction->req;
+    if (!req || (int)(ticks - transaction->deadline) < 0) {
+      continue;
+    }
+    transaction->req = 0;
+    obj_queue.stats.in_flight--;
+    if (++req->completed == req->transactions) {
+      obj_request_done(req);
+    }
+  }
+  obj_queue_start_transactions();
+  release(&obj_queue.lock);
+}
+
+void obj_queue_set_latency(uint latency) {
+  acquire(&obj_queue.lock);
+  obj_queue.stats.latency = latency;
+  release(&obj_queue.lock);
+}
+
+void obj_queue_get_stats(struct obj_queue_stats* stats) {
+  acquire(&obj_queue.lock);
+  *stats = obj_queue.stats;
+  release(&obj_queue.lock);
+}
@@ -0,0 +1,80 @@
+#ifndef XV6_DEVICE_OBJ_QUEUE_H
+#define XV6_DEVICE_OBJ_QUEUE_H
+
+/**
+ * Objfs request queue module.
+ * Reads object data asynchronously, so several reads can be in flight and
+ * every process sleeps only on its own requests.
+ *
+ * Implementation details:
+ * ~~~~~~~~~~~~~~~~~~~~~~~
+ * A request reads a byte range of an object into a vector of bufs. Bufs which
+ * are already valid are skipped, and every run of invalid bufs is split to
+ * transactions of at most `OBJ_MAX_TRANSFER_SIZE` bytes.
+ *
+ * The device serves up to `OBJ_QUEUE_DEPTH` transactions at a time, in the
+ * order they were submitted. The memory store has no real latency, so the
+ * queue simulates one: a transaction completes `latency` timer ticks after
+ * the device starts it, and the completions are driven by the timer
+ * interrupt. The data itself is copied when the request is submitted, and the
+ * bufs are owned by the submitter until the request completes.
+ *
+ * With no latency set, and for block backed devices (which already wait for
+ * the disk), requests complete as part of `obj_submit`.
+ */
+
+#include "fsdefs.h"
+#include "kvector.h"
+#include "types.h"
+
+/* The maximal size of a single transaction. */
+#define OBJ_MAX_TRANSFER_SIZE (4 * BSIZE)
+/* The maximal amount of transactions the device serves at a time. */
+#define OBJ_QUEUE_DEPTH (8)
+
+struct device;
+
+struct obj_request {
+  /* Set by the submitter. The name is used only by `obj_submit`. */
+  struct device* dev;
+  const char* name;
+  uint offset;
+  uint size;
+  vector bufs;
+  /* Called when the request completes, with the queue lock held. That is in
+   * the timer interrupt, unless the request completes as part of
+   * `obj_submit`. Must not sleep nor submit requests. May be NULL. */
+  void (*complete)(struct obj_request*);
+  void* context;
+
+  /* Set by the queue. */
+  uint err;
+  uint done;
+  uint transactions;
+  uint started;
+  uint completed;
+  struct obj_request* qnext;
+};
+
+struct obj_queue_stats {
+  uint latency;
+  uint in_flight;
+  uint requests;
+  uint transactions;
+};
+
+void obj_queue_init(void);
+
+/* Starts reading the request. The request must stay alive until completed. */
+void obj_submit(struct obj_request* req);
+
+/* Sleeps until the request completes, and returns its error code. */
+uint obj_wait(struct obj_request* req);
+
+/* Completes the transactions whose latency passed. Called on timer ticks. */
+void obj_queue_intr(void);
+
+void obj_queue_set_latency(uint latency);
+void obj_queue_get_stats(struct obj_queue_stats* stats);
+
+#endif /* XV6_DEVICE_OBJ_QUEUE_H */
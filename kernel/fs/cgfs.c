@@ -373,6 +373,7 @@ static int unsafe_cg_open_file(char* filename, struct cgroup* cgp, int omode) {
     case MEM_STAT:
       if (cgp == cgroup_root()) return -1;
       f->mem.stat.active = cgp->mem_controller_enabled;
+      f->mem.stat.file = cgp->mem_stat_file;
       f->mem.stat.file_dirty = cgp->mem_stat_file_dirty;
       f->mem.stat.file_dirty_aggregated = cgp->mem_stat_file_dirty_aggregated;
       f->mem.stat.pgfault = cgp->mem_stat_pgfault;
@@ -826,6 +827,7 @@ static int read_file_io_stat(struct vfs_file* f, char* addr, int n) {
 }
 
 static int read_file_mem_stat(struct vfs_file* f, char* addr, int n) {
+  char file_buf[11] = {0};
   char file_dirty_buf[10] = {0};
   char file_dirty_aggregated_buf[10] = {0};
   char pgfault_buf[10] = {0};
@@ -833,6 +835,7 @@ static int read_file_mem_stat(struct vfs_file* f, char* addr, int n) {
   char kernel_buf[10] = {0};
 
   uint stattext_size =
+      strlen("file - ") + utoa(file_buf, f->mem.stat.file) + 1 +
       strlen("file_dirty - ") + utoa(file_dirty_buf, f->mem.stat.file_dirty) +
       1 + strlen("file_dirty_aggregated - ") +
       utoa(file_dirty_aggregated_buf, f->mem.stat.file_dirty_aggregated) + 1 +
@@ -844,6 +847,10 @@ static int read_file_mem_stat(struct vfs_file* f, char* addr, int n) {
   char* stattextp = stattext;
   memset(stattext, '\0', stattext_size);
 
+  copy_and_move_buffer(&stattextp, "file - ", strlen("file - "));
+  copy_and_move_buffer(&stattextp, file_buf, strlen(file_buf));
+  copy_and_move_buffer(&stattextp, "\n", strlen("\n"));
+
   copy_and_move_buffer(&stattextp, "file_dirty - ", strlen("file_dirty - "));
   copy_and_move_buffer(&stattextp, file_dirty_buf, strlen(file_dirty_buf));
   copy_and_move_buffer(&stattextp, "\n", strlen("\n"));
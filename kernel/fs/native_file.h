@@ -9,7 +9,7 @@
 // that also keeps one to one correspondence between a physical inode and it's
 // vfs_inode counterpart
 struct native_inode {
-  uint addrs[NDIRECT + 1];
+  uint addrs[NDIRECT + 3];
   struct vfs_inode vfs_inode;
 };
 
@@ -39,6 +39,25 @@ static inline struct buf *fs_bread(struct vfs_superblock *vfs_sb,
   return bread(sb->dev, blockno);
 }
 
+static inline void fs_bread_multi(struct vfs_superblock *vfs_sb,
+                                  const uint *blocknos, uint n,
+                                  struct buf **bufs) {
+  struct native_superblock_private *sb = sb_private(vfs_sb);
+  bread_multi(sb->dev, blocknos, n, bufs);
+}
+
+static inline void fs_log_write(struct vfs_superblock *vfs_sb,
+                                struct buf *b) {
+  struct native_superblock_private *sb = sb_private(vfs_sb);
+  log_write(&sb->log, b);
+}
+
+// Join the FS op to the log of the inode's file system.
+static inline void fs_log_join(struct vfs_inode *ip) {
+  struct native_superblock_private *sb = sb_private(ip->sb);
+  log_join(&sb->log);
+}
+
 // Read the super block.
 static void readsb(struct vfs_superblock *vfs_sb,
                    struct native_superblock *sb) {
@@ -50,36 +69,87 @@ static void readsb(struct vfs_superblock *vfs_sb,
 }
 
 // Zero a block.
+// Its old content is not read from the disk.
 static void bzero(struct vfs_superblock *vfs_sb, int bno) {
+  struct native_superblock_private *sbp = sb_private(vfs_sb);
+  union buf_id id = {.blockno = bno};
   struct buf *bp;
 
-  bp = fs_bread(vfs_sb, bno);
+  bp = buf_cache_get(sbp->dev, &id, 0);
   memset(bp->data, 0, BSIZE);
-  log_write(bp);
+  bp->flags |= B_VALID;
+  fs_log_write(vfs_sb, bp);
   buf_cache_release(bp);
 }
 
 // Blocks.
 
-// Allocate a zeroed disk block.
-static uint balloc(struct vfs_superblock *vfs_sb) {
-  int b, bi, m;
+// Count the free blocks of each bitmap block.
+static void bsummarize(struct vfs_superblock *vfs_sb) {
+  int b, bi, free;
   struct buf *bp;
 
-  bp = 0;
   struct native_superblock_private *sbp = sb_private(vfs_sb);
   struct native_superblock *sb = &sbp->sb;
 
+  // native_fs_check() rejects larger file systems.
+  if (sb->size > NATIVE_MAX_BMAP_BLOCKS * BPB)
+    panic("bsummarize: file system too large");
   for (b = 0; b < sb->size; b += BPB) {
     bp = fs_bread(vfs_sb, BBLOCK(b, *sb));
+    free = 0;
     for (bi = 0; bi < BPB && b + bi < sb->size; bi++) {
+      if ((bp->data[bi / 8] & (1 << (bi % 8))) == 0) free++;
+    }
+    sbp->bmap_free[b / BPB] = free;
+    buf_cache_release(bp);
+  }
+  sbp->alloc_cursor = 0;
+}
+
+// Allocate a zeroed disk block.
+// Takes the first free block from goal on, so that the blocks
+// of a file written sequentially are contiguous, or from where
+// the last allocation ended if goal is 0. Bitmap blocks without
+// free blocks are skipped.
+static uint balloc(struct vfs_superblock *vfs_sb, uint goal) {
+  int i, k, nbmap, bi, end, m;
+  struct buf *bp;
+
+  struct native_superblock_private *sbp = sb_private(vfs_sb);
+  struct native_superblock *sb = &sbp->sb;
+
+  acquire(&sbp->alloc_lock);
+  if (goal == 0 || goal >= sb->size) goal = sbp->alloc_cursor;
+  release(&sbp->alloc_lock);
+
+  // The bitmap blocks from the one of goal on, then back to it
+  // for the blocks before goal.
+  nbmap = (sb->size + BPB - 1) / BPB;
+  for (i = 0; i <= nbmap; i++) {
+    k = (goal / BPB + i) % nbmap;
+    if (sbp->bmap_free[k] == 0) continue;  // A hint, read unlocked.
+
+    bp = fs_bread(vfs_sb, sb->bmapstart + k);
+    bi = (i == 0) ? goal % BPB : 0;
+    end = (i == nbmap) ? goal % BPB : BPB;
+    if (end > sb->size - k * BPB) end = sb->size - k * BPB;
+    for (; bi < end; bi++) {
+      if (bp->data[bi / 8] == 0xff) {  // Skip a full byte.
+        bi |= 7;
+        continue;
+      }
       m = 1 << (bi % 8);
       if ((bp->data[bi / 8] & m) == 0) {  // Is block free?
         bp->data[bi / 8] |= m;            // Mark block in use.
-        log_write(bp);
+        fs_log_write(vfs_sb, bp);
+        acquire(&sbp->alloc_lock);
+        sbp->bmap_free[k]--;
+        sbp->alloc_cursor = k * BPB + bi + 1;
+        release(&sbp->alloc_lock);
         buf_cache_release(bp);
-        bzero(vfs_sb, b + bi);
-        return b + bi;
+        bzero(vfs_sb, k * BPB + bi);
+        return k * BPB + bi;
       }
     }
     buf_cache_release(bp);
@@ -95,13 +165,15 @@ static void bfree(struct vfs_superblock *vfs_sb, uint b) {
 
   struct native_superblock_private *sbp = sb_private(vfs_sb);
   struct native_superblock *sb = &sbp->sb;
-  readsb(vfs_sb, sb);
   bp = fs_bread(vfs_sb, BBLOCK(b, *sb));
   bi = b % BPB;
   m = 1 << (bi % 8);
   if ((bp->data[bi / 8] & m) == 0) panic("freeing free block");
   bp->data[bi / 8] &= ~m;
-  log_write(bp);
+  fs_log_write(vfs_sb, bp);
+  acquire(&sbp->alloc_lock);
+  sbp->bmap_free[b / BPB]++;
+  release(&sbp->alloc_lock);
   buf_cache_release(bp);
 }
 
@@ -242,7 +314,7 @@ static struct vfs_inode *ialloc(struct vfs_superblock *vfs_sb, file_type type) {
     if (dip->base_dinode.type == 0) {  // a free inode
       memset(dip, 0, sizeof(*dip));
       dip->base_dinode.type = type;
-      log_write(bp);  // mark it allocated on the disk
+      fs_log_write(vfs_sb, bp);  // mark it allocated on the disk
       buf_cache_release(bp);
       return iget(vfs_sb, inum);
     }
@@ -274,19 +346,38 @@ static void iupdate(struct vfs_inode *vfs_ip) {
   dip->base_dinode.nlink = ip->vfs_inode.nlink;
   dip->size = ip->vfs_inode.size;
   memmove(dip->addrs, ip->addrs, sizeof(ip->addrs));
-  log_write(bp);
+  fs_log_write(vfs_sb, bp);
   buf_cache_release(bp);
 }
 
+// Free the indirect block addr and the blocks it lists,
+// which are themselves indirect blocks of levels - 1 levels.
+static void itrunc_indirect(struct vfs_superblock *sb, uint addr,
+                            int levels) {
+  int j;
+  struct buf *bp;
+  uint *a;
+
+  bp = fs_bread(sb, addr);
+  a = (uint *)bp->data;
+  for (j = 0; j < NINDIRECT; j++) {
+    if (a[j] == 0) continue;
+    if (levels > 1)
+      itrunc_indirect(sb, a[j], levels - 1);
+    else
+      bfree(sb, a[j]);
+  }
+  buf_cache_release(bp);
+  bfree(sb, addr);
+}
+
 // Truncate inode (discard contents).
 // Only called when the inode has no links
 // to it (no directory entries referring to it)
 // and has no in-memory reference to it (is
 // not an open file or current directory).
 static void itrunc(struct vfs_inode *vfs_ip) {
-  int i, j;
-  struct buf *bp;
-  uint *a;
+  int i;
   struct native_inode *ip =
       container_of(vfs_ip, struct native_inode, vfs_inode);
 
@@ -297,15 +388,12 @@ static void itrunc(struct vfs_inode *vfs_ip) {
     }
   }
 
-  if (ip->addrs[NDIRECT]) {
-    bp = fs_bread(ip->vfs_inode.sb, ip->addrs[NDIRECT]);
-    a = (uint *)bp->data;
-    for (j = 0; j < NINDIRECT; j++) {
-      if (a[j]) bfree(ip->vfs_inode.sb, a[j]);
+  // The single, double and triple indirect trees.
+  for (i = NDIRECT; i < NDIRECT + 3; i++) {
+    if (ip->addrs[i]) {
+      itrunc_indirect(ip->vfs_inode.sb, ip->addrs[i], i - NDIRECT + 1);
+      ip->addrs[i] = 0;
     }
-    buf_cache_release(bp);
-    bfree(ip->vfs_inode.sb, ip->addrs[NDIRECT]);
-    ip->addrs[NDIRECT] = 0;
   }
 
   ip->vfs_inode.size = 0;
@@ -319,9 +407,9 @@ static void fsstart(struct vfs_superblock *vfs_sb) {
   struct native_superblock *sb = &sbp->sb;
   readsb(vfs_sb, sb);
 
-  if (sbp->dev->type != DEVICE_TYPE_LOOP) {
-    initlog(vfs_sb);
-  }
+  initlog(vfs_sb);
+  // After the log recovery, which may change the bitmap.
+  bsummarize(vfs_sb);
 }
 
 // Increment reference count for ip.
@@ -343,6 +431,7 @@ static void ilock(struct vfs_inode *vfs_ip) {
 
   if (ip == 0 || ip->vfs_inode.ref < 1) panic("ilock");
 
+  fs_log_join(&ip->vfs_inode);
   acquiresleep(&ip->vfs_inode.lock);
 
   if (ip->vfs_inode.valid == 0) {
@@ -378,6 +467,7 @@ static void iunlock(struct vfs_inode *ip) {
 // All calls to iput() must be inside a transaction in
 // case it has to free the inode.
 static void iput(struct vfs_inode *ip) {
+  fs_log_join(ip);
   acquiresleep(&ip->lock);
   if (ip->valid && ip->nlink == 0) {
     acquire(&icache.lock);
@@ -415,36 +505,111 @@ static void iunlockput(struct vfs_inode *ip) {
 //  The content (data) associated with each inode is stored
 //  in blocks on the disk. The first NDIRECT block numbers
 //  are listed in ip->addrs[].  The next NINDIRECT blocks are
-//  listed in block ip->addrs[NDIRECT].
+//  listed in block ip->addrs[NDIRECT].  The next NDINDIRECT
+//  and NTINDIRECT blocks are listed in the double and triple
+//  indirect trees rooted at ip->addrs[NDIRECT + 1] and
+//  ip->addrs[NDIRECT + 2]: each of their blocks lists the
+//  blocks of the level below.
 
 // Return the disk block address of the nth block in inode ip.
-// If there is no such block, bmap allocates one.
+// If there is no such block, bmap allocates one, next to the
+// block before it.
 static uint bmap(struct native_inode *ip, uint bn) {
-  uint addr, *a;
+  uint addr, *a, levels, span, goal;
   struct buf *bp;
 
   if (bn < NDIRECT) {
-    if ((addr = ip->addrs[bn]) == 0)
-      ip->addrs[bn] = addr = balloc(ip->vfs_inode.sb);
+    if ((addr = ip->addrs[bn]) == 0) {
+      goal = (bn > 0 && ip->addrs[bn - 1]) ? ip->addrs[bn - 1] + 1 : 0;
+      ip->addrs[bn] = addr = balloc(ip->vfs_inode.sb, goal);
+    }
     return addr;
   }
   bn -= NDIRECT;
 
-  if (bn < NINDIRECT) {
-    // Load indirect block, allocating if necessary.
-    if ((addr = ip->addrs[NDIRECT]) == 0)
-      ip->addrs[NDIRECT] = addr = balloc(ip->vfs_inode.sb);
+  // Find the tree of the block, and the amount of blocks it spans.
+  for (levels = 1, span = NINDIRECT; bn >= span;
+       levels++, span *= NINDIRECT) {
+    if (levels == 3) panic("bmap: out of range");
+    bn -= span;
+  }
+
+  if ((addr = ip->addrs[NDIRECT + levels - 1]) == 0) {
+    goal = ip->addrs[NDIRECT - 1] ? ip->addrs[NDIRECT - 1] + 1 : 0;
+    ip->addrs[NDIRECT + levels - 1] = addr = balloc(ip->vfs_inode.sb, goal);
+  }
+  for (; levels > 0; levels--) {
+    // Load indirect block, allocating the next one if necessary,
+    // after the block of the previous entry or else after this one.
+    span /= NINDIRECT;
     bp = fs_bread(ip->vfs_inode.sb, addr);
     a = (uint *)bp->data;
-    if ((addr = a[bn]) == 0) {
-      a[bn] = addr = balloc(ip->vfs_inode.sb);
-      log_write(bp);
+    if ((addr = a[bn / span]) == 0) {
+      goal = (bn / span > 0 && a[bn / span - 1]) ? a[bn / span - 1] + 1
+                                                  : bp->id.blockno + 1;
+      a[bn / span] = addr = balloc(ip->vfs_inode.sb, goal);
+      fs_log_write(ip->vfs_inode.sb, bp);
     }
     buf_cache_release(bp);
-    return addr;
+    bn %= span;
+  }
+  return addr;
+}
+
+// Return the disk block address of the nth block in inode ip,
+// or 0 if there is no such block. Unlike bmap, allocates nothing.
+static uint bmapped(struct native_inode *ip, uint bn) {
+  uint addr, levels, span;
+  struct buf *bp;
+
+  if (bn < NDIRECT) return ip->addrs[bn];
+  bn -= NDIRECT;
+
+  for (levels = 1, span = NINDIRECT; bn >= span;
+       levels++, span *= NINDIRECT) {
+    if (levels == 3) return 0;
+    bn -= span;
   }
 
-  panic("bmap: out of range");
+  addr = ip->addrs[NDIRECT + levels - 1];
+  for (; addr != 0 && levels > 0; levels--) {
+    span /= NINDIRECT;
+    bp = fs_bread(ip->vfs_inode.sb, addr);
+    addr = ((uint *)bp->data)[bn / span];
+    buf_cache_release(bp);
+    bn %= span;
+  }
+  return addr;
+}
+
+// Are all the blocks of [off, off + n) allocated?
+// Caller must hold ip->lock.
+static int isallocated(struct vfs_inode *vfs_ip, uint off, uint n) {
+  struct native_inode *ip =
+      container_of(vfs_ip, struct native_inode, vfs_inode);
+
+  for (uint bn = off / BSIZE; bn * BSIZE < off + n; bn++) {
+    if (bmapped(ip, bn) == 0) return 0;
+  }
+  return 1;
+}
+
+// Read the blocks of ip that hold [off, off + n) into bufs,
+// as one batch of at most BIO_MULTI_MAX blocks.
+// Returns the amount of blocks read.
+static uint bread_range(struct native_inode *ip, uint off, uint n,
+                        struct buf **bufs) {
+  uint blocknos[BIO_MULTI_MAX];
+  uint first = off / BSIZE;
+  uint nblocks = (off + n - 1) / BSIZE - first + 1;
+  uint i;
+
+  if (nblocks > BIO_MULTI_MAX) nblocks = BIO_MULTI_MAX;
+  for (i = 0; i < nblocks; i++) {
+    blocknos[i] = bmap(ip, first + i);
+  }
+  fs_bread_multi(ip->vfs_inode.sb, blocknos, nblocks, bufs);
+  return nblocks;
 }
 
 // Copy stat information from inode.
@@ -467,7 +632,8 @@ static void stati(struct vfs_inode *vfs_ip, struct stat *st) {
 static int readi(struct vfs_inode *vfs_ip, uint off, uint n,
                  vector *dstvector) {
   uint tot, m;
-  struct buf *bp;
+  uint i, nblocks;
+  struct buf *bufs[BIO_MULTI_MAX];
   struct native_inode *ip =
       container_of(vfs_ip, struct native_inode, vfs_inode);
 
@@ -490,15 +656,15 @@ static int readi(struct vfs_inode *vfs_ip, uint off, uint n,
   if (off + n > ip->vfs_inode.size) n = ip->vfs_inode.size - off;
 
   unsigned int dstoffset = 0;
-  for (tot = 0; tot < n; tot += m, off += m, dstoffset += m) {
-    bp = fs_bread(ip->vfs_inode.sb, bmap(ip, off / BSIZE));
-    m = min(n - tot,
-            BSIZE - off % BSIZE);  // NOLINT(build/include_what_you_use)
-    memmove_into_vector_bytes(*dstvector, dstoffset,
-                              (char *)(bp->data + off % BSIZE), m);
-    // vectormemcmp("readi", *dstvector, dstoffset, (char*)(bp->data + off %
-    // BSIZE), m);
-    buf_cache_release(bp);
+  for (tot = 0; tot < n;) {
+    nblocks = bread_range(ip, off, n - tot, bufs);
+    for (i = 0; i < nblocks; i++, tot += m, off += m, dstoffset += m) {
+      m = min(n - tot,
+              BSIZE - off % BSIZE);  // NOLINT(build/include_what_you_use)
+      memmove_into_vector_bytes(*dstvector, dstoffset,
+                                (char *)(bufs[i]->data + off % BSIZE), m);
+      buf_cache_release(bufs[i]);
+    }
   }
   struct cgroup *cgroup = myproc()->cgroup;
   update_io_stat(cgroup, ip->vfs_inode.major, ip->vfs_inode.minor, n, 0);
@@ -510,7 +676,8 @@ static int readi(struct vfs_inode *vfs_ip, uint off, uint n,
 // Caller must hold ip->lock.
 static int writei(struct vfs_inode *vfs_ip, char *src, uint off, uint n) {
   uint tot, m;
-  struct buf *bp;
+  uint i, nblocks;
+  struct buf *bufs[BIO_MULTI_MAX];
   struct native_inode *ip =
       container_of(vfs_ip, struct native_inode, vfs_inode);
 
@@ -528,15 +695,17 @@ static int writei(struct vfs_inode *vfs_ip, char *src, uint off, uint n) {
   }
 
   if (off > ip->vfs_inode.size || off + n < off) return -1;
-  if (off + n > MAXFILE * BSIZE) return -1;
-
-  for (tot = 0; tot < n; tot += m, off += m, src += m) {
-    bp = fs_bread(ip->vfs_inode.sb, bmap(ip, off / BSIZE));
-    m = min(n - tot,  // NOLINT(build/include_what_you_use)
-            BSIZE - off % BSIZE);
-    memmove(bp->data + off % BSIZE, src, m);
-    log_write(bp);
-    buf_cache_release(bp);
+  if (n > 0 && (off + n - 1) / BSIZE >= MAXFILE) return -1;
+
+  for (tot = 0; tot < n;) {
+    nblocks = bread_range(ip, off, n - tot, bufs);
+    for (i = 0; i < nblocks; i++, tot += m, off += m, src += m) {
+      m = min(n - tot,  // NOLINT(build/include_what_you_use)
+              BSIZE - off % BSIZE);
+      memmove(bufs[i]->data + off % BSIZE, src, m);
+      fs_log_write(ip->vfs_inode.sb, bufs[i]);
+      buf_cache_release(bufs[i]);
+    }
   }
 
   if (n > 0 && off > ip->vfs_inode.size) {
@@ -549,6 +718,42 @@ static int writei(struct vfs_inode *vfs_ip, char *src, uint off, uint n) {
   return n;
 }
 
+// Write data to an inode in place, bypassing the log.
+// The range must lie within the file, and its blocks must be
+// allocated, since allocating one would need a transaction.
+// The file system of a loop device writes its blocks so, as it
+// journals them in its own log. Takes ip->lock, but not through
+// ilock, which would join the log of the file system of ip.
+static int overwritei(struct vfs_inode *vfs_ip, char *src, uint off,
+                      uint n) {
+  uint tot, m;
+  uint i, nblocks;
+  struct buf *bufs[BIO_MULTI_MAX];
+  struct native_inode *ip =
+      container_of(vfs_ip, struct native_inode, vfs_inode);
+
+  acquiresleep(&ip->vfs_inode.lock);
+  if (ip->vfs_inode.type == T_DEV || off + n < off ||
+      off + n > ip->vfs_inode.size || !isallocated(vfs_ip, off, n)) {
+    releasesleep(&ip->vfs_inode.lock);
+    return -1;
+  }
+
+  for (tot = 0; tot < n;) {
+    nblocks = bread_range(ip, off, n - tot, bufs);
+    for (i = 0; i < nblocks; i++, tot += m, off += m, src += m) {
+      m = min(n - tot,  // NOLINT(build/include_what_you_use)
+              BSIZE - off % BSIZE);
+      memmove(bufs[i]->data + off % BSIZE, src, m);
+    }
+    bwrite_multi(bufs, nblocks);
+    for (i = 0; i < nblocks; i++) buf_cache_release(bufs[i]);
+  }
+  releasesleep(&ip->vfs_inode.lock);
+
+  return n;
+}
+
 // PAGEBREAK!
 //  Directories
 
@@ -645,13 +850,20 @@ void native_iinit() {
   for (i = 0; i < NINODE; i++) {
     initsleeplock(&icache.inode[i].vfs_inode.lock, "inode");
   }
+  loginit();
 }
 
+// The private part of a superblock is a page.
+_Static_assert(sizeof(struct native_superblock_private) <= PGSIZE,
+               "native_superblock_private is larger than a page");
+
 void native_fs_init(struct vfs_superblock *vfs_sb, struct device *dev) {
   struct native_superblock_private *sbp =
       (struct native_superblock_private *)kalloc();
+  memset(sbp, 0, sizeof(*sbp));
   deviceget(dev);
   sbp->dev = dev;
+  initlock(&sbp->alloc_lock, "native_alloc");
 
   vfs_sb->private = sbp;
   vfs_sb->ops = &native_ops;
@@ -663,9 +875,31 @@ void native_fs_init(struct vfs_superblock *vfs_sb, struct device *dev) {
       sb->inodestart, sb->bmapstart);*/
 }
 
+int native_fs_check(struct device *dev) {
+  struct native_superblock sb;
+  struct buf *bp;
+
+  bp = bread(dev, 1);
+  memmove(&sb, bp->data, sizeof(sb));
+  buf_cache_release(bp);
+  // The free counts of the bitmap blocks must fit the superblock.
+  if (sb.size > NATIVE_MAX_BMAP_BLOCKS * BPB) {
+    cprintf("file system of %d blocks is too large\n", sb.size);
+    return -1;
+  }
+  // A loop device writes its blocks in place, within the backing file.
+  struct vfs_inode *backing = getinodefordevice(dev);
+  if (backing != NULL && sb.size > backing->size / BSIZE) {
+    cprintf("file system of %d blocks past the end of its file\n", sb.size);
+    return -1;
+  }
+  return 0;
+}
+
 static void fsdestroy(struct vfs_superblock *vfs_sb) {
   struct native_superblock_private *sbp = sb_private(vfs_sb);
   iput(vfs_sb->root_ip);
+  log_destroy(&sbp->log);
   // Invalidate all inodes in the cache.
   for (int i = 0; i < NINODE; i++) {
     acquire(&icache.lock);
@@ -680,8 +914,17 @@ static void fsdestroy(struct vfs_superblock *vfs_sb) {
   kfree((char *)sbp);
 }
 
-static const struct sb_ops native_ops = {
-    .ialloc = ialloc, .iget = iget, .destroy = fsdestroy, .start = fsstart};
+// Commit the log.
+static void fssync(struct vfs_superblock *vfs_sb) {
+  struct native_superblock_private *sbp = sb_private(vfs_sb);
+  log_sync(&sbp->log);
+}
+
+static const struct sb_ops native_ops = {.ialloc = ialloc,
+                                         .iget = iget,
+                                         .destroy = fsdestroy,
+                                         .start = fsstart,
+                                         .sync = fssync};
 
 static const struct inode_operations native_inode_ops = {
     .idup = &idup,
@@ -696,4 +939,6 @@ static const struct inode_operations native_inode_ops = {
     .writei = &writei,
     .iunlockput = &iunlockput,
     .isdirempty = &isdirempty,
+    .overwritei = &overwritei,
+    .isallocated = &isallocated,
 };
@@ -3,14 +3,51 @@
 
 #include "device/device.h"
 #include "fsdefs.h"
+#include "param.h"
+#include "spinlock.h"
 #include "vfs_fs.h"
 
 void native_iinit();
 void native_fs_init(struct vfs_superblock*, struct device*);
+// Returns 0 if the device holds a file system which can be mounted,
+// or -1.
+int native_fs_check(struct device*);
+
+// The most bitmap blocks of a native file system, each covering BPB blocks.
+#define NATIVE_MAX_BMAP_BLOCKS 1024
+
+// Contents of the header block, used for both the on-disk header block
+// and to keep track in memory of logged block# before commit.
+struct logheader {
+  int n;
+  int block[LOGSIZE];
+};
+
+// The log of a file system, protected by lock. See native_log.c.
+struct log {
+  struct spinlock lock;
+  int start;
+  int size;
+  int capacity;     // how many blocks a transaction may hold.
+  int outstanding;  // how many FS sys calls joined the log.
+  int committing;   // in commit(), please wait.
+  int syncing;      // how many log_sync() wait for a commit.
+  int requested;    // ops wait for the commit thread to commit.
+  uint commits;     // how many commits completed.
+  struct device* dev;
+  struct log* next;  // the next log of the commit thread.
+  struct logheader lh;
+};
 
 struct native_superblock_private {
   struct native_superblock sb;  // in memory copy of superblock for the fs.
   struct device* dev;           // device for the fs.
+  // The state of the block allocator, protected by alloc_lock.
+  // A bitmap block's free count changes while holding its buf.
+  struct spinlock alloc_lock;
+  uint alloc_cursor;  // where the last allocation ended.
+  ushort bmap_free[NATIVE_MAX_BMAP_BLOCKS];  // free blocks per bitmap block.
+  struct log log;  // the journal of the fs.
 };
 
 #endif  // XV6_FS_NATIVE_FS_H
@@ -13,17 +13,38 @@
 
 // Simple logging that allows concurrent FS system calls.
 //
+// Every native file system has its own log, which commits
+// independently of the logs of the other file systems.
 // A log transaction contains the updates of multiple FS system
-// calls. The logging system only commits when there are
-// no FS system calls active. Thus there is never
+// calls. The logging system only commits when no system call
+// that joined the log is active. Thus there is never
 // any reasoning required about whether a commit might
 // write an uncommitted system call's updates to disk.
 //
 // A system call should call begin_op()/end_op() to mark
-// its start and end. Usually begin_op() just increments
-// the count of in-progress FS system calls and returns.
-// But if it thinks the log is close to running out, it
-// sleeps until the last outstanding end_op() commits.
+// its start and end. It joins the log of a file system with
+// log_join() before it locks an inode of the file system.
+// Usually log_join() just increments the count of in-progress
+// FS system calls and returns. But if it thinks the log is
+// close to running out, it asks the commit thread to commit,
+// and sleeps until it has.
+//
+// When a system call joins a log, say as its path crosses a mount
+// point, it leaves the logs it has not written to. A system call
+// which wrote to another log joins nested: it keeps that log.
+// The logs are ordered by the ids of their devices. A nested join
+// in that order may wait as a first join does. A nested join out
+// of order must not wait for the system calls of the log, which may
+// be waiting for the log it holds: it takes the last MAXOPBLOCKS
+// blocks of the log, which are kept for it.
+//
+// The commit is grouped and asynchronous: only the commit thread
+// commits. end_op() returns without committing, and the transaction
+// collects the updates of the following system calls, until the log
+// is close to running out, until log_sync() asks for the updates to
+// be on the disk, or every LOG_COMMIT_INTERVAL ticks. Then the log
+// is requested: system calls which join it first wait, and the
+// last outstanding end_op() wakes the commit thread to commit.
 //
 // The log is a physical re-do log containing disk blocks.
 // The on-disk log format:
@@ -32,69 +53,96 @@
 //   block B
 //   block C
 //   ...
-// Log appends are synchronous.
-
-// Contents of the header block, used for both the on-disk header block
-// and to keep track in memory of logged block# before commit.
-struct logheader {
-  int n;
-  int block[LOGSIZE];
-};
-
-struct log {
-  struct spinlock lock;
-  int start;
-  int size;
-  int outstanding;  // how many FS sys calls are executing.
-  int committing;   // in commit(), please wait.
-  struct device *dev;
-  struct logheader lh;
-};
-struct log log;
-
-static void recover_from_log(void);
-static void commit();
+// Log appends are synchronous, at commit.
+// A loop device writes its blocks in place, into its backing file,
+// so its log commits without the log of the backing file system.
+
+// The ticks between the commits of the commit thread.
+#define LOG_COMMIT_INTERVAL 100
+
+// The log space of the system calls that join in order.
+#define LOG_FIRST_JOIN_SIZE(log) ((log)->capacity - MAXOPBLOCKS)
+
+// The logs of the mounted file systems, which the commit thread commits.
+// pending is protected by tickslock, on which the commit thread sleeps.
+static struct {
+  struct sleeplock lock;
+  struct log *head;
+  int committer_started;
+  int pending;  // a log may be ready to commit.
+} logs;
+
+static void recover_from_log(struct log *log);
+static void commit(struct log *log);
+static void wake_committer(void);
+static void log_leave(struct log *log);
+static void log_committer(void);
+
+void loginit(void) { initsleeplock(&logs.lock, "logs"); }
 
 void initlog(struct vfs_superblock *vfs_sb) {
   XV6_ASSERT(vfs_sb->private != NULL);
 
-  struct native_superblock_private *sb = sb_private(vfs_sb);
+  struct native_superblock_private *sbp = sb_private(vfs_sb);
+  struct log *log = &sbp->log;
   if (sizeof(struct logheader) >= BSIZE) panic("initlog: too big logheader");
 
-  struct native_superblock_private *sbp = sb_private(vfs_sb);
   deviceget(sbp->dev);
 
-  initlock(&log.lock, "log");
-  log.start = sb->sb.logstart;
-  log.size = sb->sb.nlog;
-  log.dev = sbp->dev;
-  recover_from_log();
+  initlock(&log->lock, "log");
+  log->start = sbp->sb.logstart;
+  log->size = sbp->sb.nlog;
+  // The header takes a block of the log, small file systems have small logs.
+  log->capacity = log->size - 1 < LOGSIZE ? log->size - 1 : LOGSIZE;
+  if (log->capacity < 2 * MAXOPBLOCKS) panic("initlog: too small log");
+  log->dev = sbp->dev;
+  recover_from_log(log);
+
+  acquiresleep(&logs.lock);
+  log->next = logs.head;
+  logs.head = log;
+  // The commit thread is started with the first log.
+  if (!logs.committer_started) {
+    logs.committer_started = 1;
+    kthread_create("logcommit", log_committer);
+  }
+  releasesleep(&logs.lock);
 }
 
 // Copy committed blocks from log to their home location
-static void install_trans(void) {
-  int tail;
+static void install_trans(struct log *log) {
+  uint blocknos[BIO_MULTI_MAX];
+  struct buf *lbufs[BIO_MULTI_MAX];
+  struct buf *dbufs[BIO_MULTI_MAX];
+  int tail, n, i;
 
-  for (tail = 0; tail < log.lh.n; tail++) {
-    struct buf *lbuf = bread(log.dev, log.start + tail + 1);  // read log block
-    struct buf *dbuf = bread(log.dev, log.lh.block[tail]);    // read dst
-    memmove(dbuf->data, lbuf->data, BSIZE);  // copy block to dst
-    bwrite(dbuf);                            // write dst to disk
-    cgroup_mem_stat_file_dirty_decr(dbuf->cgroup);
-    cgroup_mem_stat_file_dirty_aggregated_incr(dbuf->cgroup);
-    buf_cache_release(lbuf);
-    buf_cache_release(dbuf);
+  for (tail = 0; tail < log->lh.n; tail += n) {
+    n = min(log->lh.n - tail, BIO_MULTI_MAX);
+    for (i = 0; i < n; i++) blocknos[i] = log->start + tail + i + 1;
+    bread_multi(log->dev, blocknos, n, lbufs);  // read log blocks
+    for (i = 0; i < n; i++) blocknos[i] = log->lh.block[tail + i];
+    bread_multi(log->dev, blocknos, n, dbufs);  // read dsts
+    for (i = 0; i < n; i++) {
+      memmove(dbufs[i]->data, lbufs[i]->data, BSIZE);  // copy block to dst
+    }
+    bwrite_multi(dbufs, n);  // write dsts to disk
+    for (i = 0; i < n; i++) {
+      cgroup_mem_stat_file_dirty_decr(dbufs[i]->cgroup);
+      cgroup_mem_stat_file_dirty_aggregated_incr(dbufs[i]->cgroup);
+      buf_cache_release(lbufs[i]);
+      buf_cache_release(dbufs[i]);
+    }
   }
 }
 
 // Read the log header from disk into the in-memory log header
-static void read_head(void) {
-  struct buf *buf = bread(log.dev, log.start);
+static void read_head(struct log *log) {
+  struct buf *buf = bread(log->dev, log->start);
   struct logheader *lh = (struct logheader *)(buf->data);
   int i;
-  log.lh.n = lh->n;
-  for (i = 0; i < log.lh.n; i++) {
-    log.lh.block[i] = lh->block[i];
+  log->lh.n = lh->n;
+  for (i = 0; i < log->lh.n; i++) {
+    log->lh.block[i] = lh->block[i];
   }
   buf_cache_release(buf);
 }
@@ -102,93 +150,261 @@ static void read_head(void) {
 // Write in-memory log header to disk.
 // This is the true point at which the
 // current transaction commits.
-static void write_head(void) {
-  struct buf *buf = bread(log.dev, log.start);
+static void write_head(struct log *log) {
+  struct buf *buf = bread(log->dev, log->start);
   struct logheader *hb = (struct logheader *)(buf->data);
   int i;
-  hb->n = log.lh.n;
-  for (i = 0; i < log.lh.n; i++) {
-    hb->block[i] = log.lh.block[i];
+  hb->n = log->lh.n;
+  for (i = 0; i < log->lh.n; i++) {
+    hb->block[i] = log->lh.block[i];
   }
   bwrite(buf);
   buf_cache_release(buf);
 }
 
-static void recover_from_log(void) {
-  read_head();
-  install_trans();  // if committed, copy from log to disk
-  log.lh.n = 0;
-  write_head();  // clear the log
+static void recover_from_log(struct log *log) {
+  read_head(log);
+  install_trans(log);  // if committed, copy from log to disk
+  log->lh.n = 0;
+  write_head(log);  // clear the log
+}
+
+// Commit the transaction in the context of the caller, which
+// holds log->lock and saw no outstanding op and no commit.
+// Only the commit thread commits, but for the rare join of
+// log_join() which can't wait for it.
+static void commit_locked(struct log *log) {
+  log->committing = 1;
+  // call commit w/o holding locks, since not allowed
+  // to sleep with locks.
+  release(&log->lock);
+  commit(log);
+  acquire(&log->lock);
+  log->committing = 0;
+  log->requested = 0;
+  log->commits++;
+  wakeup(log);
+}
+
+// Returns the slot of log among the logs joined by the FS op of p,
+// or -1.
+static int oplog_slot(struct proc *p, struct log *log) {
+  int i;
+
+  for (i = 0; i < NOPLOGS; i++) {
+    if (p->fslogs[i] == log) return i;
+  }
+  return -1;
 }
 
 // called at the start of each FS system call.
-void begin_op(void) {
-  acquire(&log.lock);
+void begin_op(void) { myproc()->fsop++; }
+
+// Join the FS system call of the current process to log, before
+// it locks an inode of the log's file system. Does nothing outside
+// of a system call, which only reads.
+void log_join(struct log *log) {
+  struct proc *p = myproc();
+  int i, slot = -1, nested = 0, ordered = 1;
+
+  if (p == 0 || p->fsop == 0) return;
+  if (oplog_slot(p, log) >= 0) return;
+  for (i = 0; i < NOPLOGS; i++) {
+    if (p->fslogs[i] == 0) continue;
+    if (p->fslogs_written & (1 << i)) {
+      nested = 1;
+      if (p->fslogs[i]->dev->id > log->dev->id) ordered = 0;
+    } else {
+      log_leave(p->fslogs[i]);  // the op only read it
+    }
+  }
+  if ((slot = oplog_slot(p, 0)) < 0) panic("log_join: too many logs");
+
+  acquire(&log->lock);
   while (1) {
-    if (log.committing) {
-      sleep(&log, &log.lock);
-    } else if (log.lh.n + (log.outstanding + 1) * MAXOPBLOCKS > LOGSIZE) {
-      // this op might exhaust log space; wait for commit.
-      sleep(&log, &log.lock);
+    if (log->committing ||
+        (!nested && (log->syncing || log->requested))) {
+      // The commit waits for the outstanding ops to end.
+      sleep(log, &log->lock);
+    } else if (log->lh.n + (log->outstanding + 1) * MAXOPBLOCKS >
+               (ordered ? LOG_FIRST_JOIN_SIZE(log) : log->capacity)) {
+      // this op might exhaust log space; wait for the commit
+      // thread to commit, once the outstanding ops end.
+      if (ordered) {
+        log->requested = 1;
+        if (log->outstanding == 0) wake_committer();
+        sleep(log, &log->lock);
+      } else if (log->outstanding == 0) {
+        // While it waited for the commit thread, nested joins
+        // could take the log, and wait for the log this op holds.
+        commit_locked(log);
+      } else {
+        // Another op out of order holds the kept blocks. No system
+        // call writes to a file system after writing to another.
+        panic("log_join: out of order");
+      }
     } else {
-      log.outstanding += 1;
-      release(&log.lock);
+      log->outstanding += 1;
       break;
     }
   }
+  release(&log->lock);
+  p->fslogs[slot] = log;
 }
 
-// called at the end of each FS system call.
-// commits if this was the last outstanding operation.
-void end_op(void) {
-  int do_commit = 0;
-
-  acquire(&log.lock);
-  log.outstanding -= 1;
-  if (log.committing) panic("log.committing");
-  if (log.outstanding == 0) {
-    do_commit = 1;
-    log.committing = 1;
+// Leave log at the end of the FS system call of the current process.
+// Wakes the commit thread if this was the last outstanding operation,
+// and a commit is asked for.
+static void log_leave(struct log *log) {
+  struct proc *p = myproc();
+  int slot = oplog_slot(p, log);
+
+  if (slot < 0) return;
+  p->fslogs[slot] = 0;
+  p->fslogs_written &= ~(1 << slot);
+
+  acquire(&log->lock);
+  log->outstanding -= 1;
+  if (log->committing) panic("log.committing");
+  if (log->outstanding == 0 && (log->syncing || log->requested)) {
+    wake_committer();
   } else {
-    // begin_op() may be waiting for log space,
-    // and decrementing log.outstanding has decreased
+    // log_join() may be waiting for log space,
+    // and decrementing log->outstanding has decreased
     // the amount of reserved space.
-    wakeup(&log);
+    wakeup(log);
   }
-  release(&log.lock);
+  release(&log->lock);
+}
+
+// called at the end of each FS system call.
+// leaves the logs that the system call joined.
+void end_op(void) {
+  struct proc *p = myproc();
+  int i;
+
+  if (p->fsop < 1) panic("end_op");
+  if (--p->fsop > 0) return;
+  for (i = 0; i < NOPLOGS; i++) {
+    if (p->fslogs[i] != 0) log_leave(p->fslogs[i]);
+  }
+}
+
+// Commit the updates of the ended FS system calls, and wait
+// until they are on the disk.
+void log_sync(struct log *log) {
+  acquire(&log->lock);
+  // A commit in progress holds all the ended ops.
+  uint target = log->commits + 1;
+  if (log->committing || log->lh.n > 0) {
+    log->syncing++;
+    if (log->outstanding == 0) wake_committer();
+    while ((int)(log->commits - target) < 0) sleep(log, &log->lock);
+    log->syncing--;
+    wakeup(log);
+  }
+  release(&log->lock);
+}
+
+// Tell the commit thread a log may be ready to commit.
+static void wake_committer(void) {
+  acquire(&tickslock);
+  logs.pending = 1;
+  wakeup(&ticks);
+  release(&tickslock);
+}
+
+// Commit the log if it is requested, or if periodic, and its
+// outstanding ops have ended.
+static void log_commit_ready(struct log *log, int periodic) {
+  acquire(&log->lock);
+  if (periodic && log->lh.n > 0) log->requested = 1;
+  if ((log->syncing || log->requested) && log->outstanding == 0 &&
+      !log->committing) {
+    commit_locked(log);
+  }
+  release(&log->lock);
+}
+
+// The body of the commit thread, which never returns.
+// It never waits for the ops of a log, which may wait for
+// another log to commit.
+static void log_committer(void) {
+  struct log *log;
+  uint last;
+
+  acquire(&tickslock);
+  last = ticks;
+  release(&tickslock);
+  for (;;) {
+    acquire(&tickslock);
+    while (!logs.pending && ticks - last < LOG_COMMIT_INTERVAL) {
+      sleep(&ticks, &tickslock);
+    }
+    int periodic = ticks - last >= LOG_COMMIT_INTERVAL;
+    if (periodic) last = ticks;
+    logs.pending = 0;
+    release(&tickslock);
 
-  if (do_commit) {
-    // call commit w/o holding locks, since not allowed
-    // to sleep with locks.
-    commit();
-    acquire(&log.lock);
-    log.committing = 0;
-    wakeup(&log);
-    release(&log.lock);
+    acquiresleep(&logs.lock);
+    for (log = logs.head; log != 0; log = log->next) {
+      log_commit_ready(log, periodic);
+    }
+    releasesleep(&logs.lock);
   }
 }
 
+// Commit the log of a file system that is being destroyed, and
+// forget it. The caller holds the last reference to the file system.
+void log_destroy(struct log *log) {
+  struct log **pp;
+
+  // The op that destroys the file system may have joined its log.
+  // The commit thread commits it before it is forgotten.
+  log_leave(log);
+  log_sync(log);
+
+  acquiresleep(&logs.lock);
+  for (pp = &logs.head; *pp != log; pp = &(*pp)->next) {
+    if (*pp == 0) panic("log_destroy");
+  }
+  *pp = log->next;
+  releasesleep(&logs.lock);
+
+  deviceput(log->dev);
+}
+
 // Copy modified blocks from cache to log.
-static void write_log(void) {
-  int tail;
+static void write_log(struct log *log) {
+  uint blocknos[BIO_MULTI_MAX];
+  struct buf *to[BIO_MULTI_MAX];
+  struct buf *from[BIO_MULTI_MAX];
+  int tail, n, i;
 
-  for (tail = 0; tail < log.lh.n; tail++) {
-    struct buf *to = bread(log.dev, log.start + tail + 1);  // log block
-    struct buf *from = bread(log.dev, log.lh.block[tail]);  // cache block
-    memmove(to->data, from->data, BSIZE);
-    bwrite(to);  // write the log
-    buf_cache_release(from);
-    buf_cache_release(to);
+  for (tail = 0; tail < log->lh.n; tail += n) {
+    n = min(log->lh.n - tail, BIO_MULTI_MAX);
+    for (i = 0; i < n; i++) blocknos[i] = log->start + tail + i + 1;
+    bread_multi(log->dev, blocknos, n, to);  // log blocks
+    for (i = 0; i < n; i++) blocknos[i] = log->lh.block[tail + i];
+    bread_multi(log->dev, blocknos, n, from);  // cache blocks
+    for (i = 0; i < n; i++) {
+      memmove(to[i]->data, from[i]->data, BSIZE);
+    }
+    bwrite_multi(to, n);  // write the log
+    for (i = 0; i < n; i++) {
+      buf_cache_release(from[i]);
+      buf_cache_release(to[i]);
+    }
   }
 }
 
-static void commit() {
-  if (log.lh.n > 0) {
-    write_log();      // Write modified blocks from cache to log
-    write_head();     // Write header to disk -- the real commit
-    install_trans();  // Now install writes to home locations
-    log.lh.n = 0;
-    write_head();  // Erase the transaction from the log
+static void commit(struct log *log) {
+  if (log->lh.n > 0) {
+    write_log(log);      // Write modified blocks from cache to log
+    write_head(log);     // Write header to disk -- the real commit
+    install_trans(log);  // Now install writes to home locations
+    log->lh.n = 0;
+    write_head(log);  // Erase the transaction from the log
   }
 }
 
@@ -199,32 +415,28 @@ static void commit() {
 // log_write() replaces bwrite(); a typical use is:
 //   bp = bread(...)
 //   modify bp->data[]
-//   log_write(bp)
+//   log_write(log, bp)
 //   buf_cache_release(bp)
-void log_write(struct buf *b) {
+void log_write(struct log *log, struct buf *b) {
   int i;
 
-  if (log.lh.n >= LOGSIZE || log.lh.n >= log.size - 1)
-    panic("too big a transaction");
-  if (log.outstanding < 1) panic("log_write outside of trans");
-
-  if (b->dev->type == DEVICE_TYPE_LOOP) {
-    // disable journaling for loop devices.
-    bwrite(b);
-    return;
-  }
+  if (log->lh.n >= log->capacity) panic("too big a transaction");
+  struct proc *p = myproc();
+  int slot = oplog_slot(p, log);
+  if (slot < 0) panic("log_write outside of trans");
+  p->fslogs_written |= 1 << slot;
 
-  acquire(&log.lock);
-  for (i = 0; i < log.lh.n; i++) {
-    if (log.lh.block[i] == b->id.blockno)  // log absorbtion
+  acquire(&log->lock);
+  for (i = 0; i < log->lh.n; i++) {
+    if (log->lh.block[i] == b->id.blockno)  // log absorbtion
       break;
   }
-  log.lh.block[i] = b->id.blockno;
-  if (i == log.lh.n) {
-    log.lh.n++;
-    b->cgroup = proc_get_cgroup();
+  log->lh.block[i] = b->id.blockno;
+  if (i == log->lh.n) {
+    log->lh.n++;
+    buf_cache_charge(b, proc_get_cgroup());
     cgroup_mem_stat_file_dirty_incr(b->cgroup);
   }
   b->flags |= B_DIRTY;  // prevent eviction
-  release(&log.lock);
+  release(&log->lock);
 }
@@ -6,13 +6,17 @@
 #include "sleeplock.h"
 #include "vfs_file.h"
 
-#define MAX_INODE_OBJECT_DATA (1ull << 25)  // 32MB
+// Inode data is split into extent objects of this size, so a write touches
+// only the extents it covers.
+#define OBJ_EXTENT_SIZE (BSIZE)
 
 // in-memory copy of an inode
 // that also keeps the mapping between an object in our object store and it's
 // vfs_inode counterpart
 struct obj_inode {
   char data_object_name[MAX_OBJECT_NAME_LENGTH];
+  // Whether the inode was written since its objects were last flushed.
+  uint dirty;
   struct vfs_inode vfs_inode;
 };
 
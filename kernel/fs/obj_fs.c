@@ -7,6 +7,7 @@
 
 #include "defs.h"
 #include "device/buf.h"
+#include "device/buf_cache.h"
 #include "device/device.h"
 #include "device/obj_cache.h"
 #include "device/obj_disk.h"  // for error codes and `new_inode_number`
@@ -28,6 +29,8 @@ static const struct sb_ops obj_ops;
 struct {
   struct spinlock lock;
   struct obj_inode inode[NINODE];
+  // Whether the thread writing back the object cache was started.
+  uint flusher_started;
 } obj_icache;
 
 void obj_iinit() {
@@ -37,6 +40,7 @@ void obj_iinit() {
     obj_icache.inode[i].vfs_inode.ref = 0;
     obj_icache.inode[i].vfs_inode.valid = 0;
   }
+  obj_icache.flusher_started = 0;
 }
 
 void inode_name(char *output, uint inum) {
@@ -57,6 +61,21 @@ void file_name(char *output, uint inum) {
   output[sizeof(uint) + 1] = 0;  // null terminator
 }
 
+void extent_name(char *output, const char *data_object_name, uint extent) {
+  uint prefix_length = strlen(data_object_name);
+  memmove(output, data_object_name, prefix_length);
+  file_name(output + prefix_length, extent);
+}
+
+// The size of the given extent of an inode data of size `size`.
+static uint extent_size(uint size, uint extent) {
+  uint extent_start = extent * OBJ_EXTENT_SIZE;
+  if (size <= extent_start) {
+    return 0;
+  }
+  return min(size - extent_start, OBJ_EXTENT_SIZE);
+}
+
 void obj_fs_init(void) {
   obj_cache_init();
   obj_iinit();
@@ -84,12 +103,6 @@ static struct vfs_inode *obj_ialloc(struct vfs_superblock *sb, file_type type) {
     panic("obj_ialloc: failed adding inode to disk");
   }
 
-  if (type != T_DEV) {
-    if (obj_cache_add(dev, di.data_object_name, 0, 0) != NO_ERR) {
-      panic("obj_ialloc: failed adding object to disk");
-    }
-  }
-
   ip = obj_ops.iget(sb, inum);
 
   return ip;
@@ -109,11 +122,13 @@ void obj_iupdate(struct vfs_inode *vfs_ip) {
   di.base_dinode.major = ip->vfs_inode.major;
   di.base_dinode.minor = ip->vfs_inode.minor;
   di.base_dinode.nlink = ip->vfs_inode.nlink;
+  di.size = ip->vfs_inode.size;
   memmove(di.data_object_name, ip->data_object_name, MAX_OBJECT_NAME_LENGTH);
   if (obj_cache_write(dev, iname, (void *)&di, sizeof(di), 0, sizeof(di)) !=
       NO_ERR) {
     panic("obj_iupdate: failed writing dinode to the disk");
   }
+  ip->dirty = 1;
 }
 
 // Find the inode with number inum on device dev
@@ -148,6 +163,7 @@ static struct vfs_inode *obj_iget(struct vfs_superblock *sb, uint inum) {
 
   ip->data_object_name[0] = 0;
   file_name(ip->data_object_name, inum);
+  ip->dirty = 0;
 
   struct device *const dev = sb_private(sb);
   deviceget(dev);
@@ -165,12 +181,21 @@ void obj_iput(struct vfs_inode *vfs_ip);
 static void obj_fsdestroy(struct vfs_superblock *vfs_sb) {
   struct vfs_inode *root_ip = vfs_sb->root_ip;
   obj_iput(root_ip);
+  if (obj_cache_sync(vfs_sb->private) != NO_ERR) {
+    panic("obj_fsdestroy: failed writing back the cache");
+  }
   deviceput(vfs_sb->private);
   vfs_sb->root_ip = NULL;
   vfs_sb->ops = NULL;
   vfs_sb->private = NULL;
 }
 
+static void obj_fssync(struct vfs_superblock *vfs_sb) {
+  if (obj_cache_sync(vfs_sb->private) != NO_ERR) {
+    panic("obj_fssync: failed writing back the cache");
+  }
+}
+
 // Increment reference count for ip.
 // Returns ip to enable ip = idup(ip1) idiom.
 struct vfs_inode *obj_idup(struct vfs_inode *ip) {
@@ -201,14 +226,7 @@ void obj_ilock(struct vfs_inode *vfs_ip) {
     ip->vfs_inode.major = di.base_dinode.major;
     ip->vfs_inode.minor = di.base_dinode.minor;
     ip->vfs_inode.nlink = di.base_dinode.nlink;
-    if (di.base_dinode.type == T_DEV) {
-      ip->vfs_inode.size = 0;
-    } else {
-      if (object_size(dev, di.data_object_name, &ip->vfs_inode.size) !=
-          NO_ERR) {
-        panic("object doesn't exists in the disk");
-      }
-    }
+    ip->vfs_inode.size = di.size;
     memmove(ip->data_object_name, di.data_object_name, MAX_OBJECT_NAME_LENGTH);
     ip->vfs_inode.valid = 1;
     if (ip->vfs_inode.type == 0) panic("obj_ilock: no type");
@@ -219,9 +237,14 @@ void obj_ilock(struct vfs_inode *vfs_ip) {
 static void idelete(struct obj_inode *ip) {
   if (ip->data_object_name[0] != 0) {
     struct device *const dev = sb_private(ip->vfs_inode.sb);
-    if (obj_cache_delete(dev, ip->data_object_name, ip->vfs_inode.size) !=
-        NO_ERR) {
-      panic("idelete: failed to delete content object");
+    char ename[EXTENT_NAME_LENGTH];
+    for (uint extent = 0; extent_size(ip->vfs_inode.size, extent) > 0;
+         extent++) {
+      extent_name(ename, ip->data_object_name, extent);
+      if (obj_cache_delete(dev, ename,
+                           extent_size(ip->vfs_inode.size, extent)) != NO_ERR) {
+        panic("idelete: failed to delete content object");
+      }
     }
     ip->data_object_name[0] = 0;
   }
@@ -234,6 +257,29 @@ static void idelete(struct obj_inode *ip) {
   }
 }
 
+// Writes back the inode objects. The extents are written before the dinode,
+// so its size never covers data which is not on the disk.
+static void obj_iflush(struct obj_inode *ip) {
+  struct device *const dev = sb_private(ip->vfs_inode.sb);
+  char ename[EXTENT_NAME_LENGTH];
+  char iname[INODE_NAME_LENGTH];
+
+  if (ip->data_object_name[0] != 0) {
+    for (uint extent = 0; extent_size(ip->vfs_inode.size, extent) > 0;
+         extent++) {
+      extent_name(ename, ip->data_object_name, extent);
+      if (obj_cache_flush(dev, ename) != NO_ERR) {
+        panic("obj_iflush: failed writing back content object");
+      }
+    }
+  }
+  inode_name(iname, ip->vfs_inode.inum);
+  if (obj_cache_flush(dev, iname) != NO_ERR) {
+    panic("obj_iflush: failed writing back inode object");
+  }
+  ip->dirty = 0;
+}
+
 // Unlock the given inode.
 void obj_iunlock(struct vfs_inode *ip) {
   if (ip == 0 || !holdingsleep(&ip->lock) || ip->ref < 1) panic("obj_iunlock");
@@ -245,22 +291,25 @@ void obj_iunlock(struct vfs_inode *ip) {
 // If that was the last reference, the inode cache entry can
 // be recycled.
 // If that was the last reference and the inode has no links
-// to it, free the inode (and its content) on disk.
+// to it, free the inode (and its content) on disk. Otherwise,
+// write back its objects, like closing a file does.
 // All calls to iput() must be inside a transaction in
 // case it has to free the inode.
 void obj_iput(struct vfs_inode *vfs_ip) {
   struct obj_inode *ip = container_of(vfs_ip, struct obj_inode, vfs_inode);
 
   acquiresleep(&ip->vfs_inode.lock);
-  if (ip->vfs_inode.valid && ip->vfs_inode.nlink == 0) {
+  if (ip->vfs_inode.valid && (ip->vfs_inode.nlink == 0 || ip->dirty)) {
     acquire(&obj_icache.lock);
     int r = ip->vfs_inode.ref;
     release(&obj_icache.lock);
-    if (r == 1) {
+    if (r == 1 && ip->vfs_inode.nlink == 0) {
       // inode has no links and no other references: truncate and free.
       idelete(ip);
       ip->vfs_inode.type = 0;
       ip->vfs_inode.valid = 0;
+    } else if (r == 1) {
+      obj_iflush(ip);
     }
   }
   releasesleep(&ip->vfs_inode.lock);
@@ -295,6 +344,51 @@ void obj_stati(struct vfs_inode *vfs_ip, struct stat *st) {
   st->size = ip->vfs_inode.size;
 }
 
+// Reads [off, off + n) of the inode content into `dstvector`, or only into
+// the cache if `dstvector` is null. Keeps several extent reads in flight, so
+// the device serves them together instead of one after the other.
+static uint obj_read_extents(struct obj_inode *ip, uint off, uint n,
+                             vector *dstvector) {
+  struct device *const dev = sb_private(ip->vfs_inode.sb);
+  uint size = ip->vfs_inode.size;
+  struct obj_cache_read reads[OBJ_READ_WINDOW];
+  uint dst_offsets[OBJ_READ_WINDOW];
+  uint started = 0;
+  uint ended = 0;
+  char ename[EXTENT_NAME_LENGTH];
+  uint err = NO_ERR;
+  // After a failure, only wait for the reads in flight.
+  for (uint done = 0; (err == NO_ERR && done < n) || ended < started;) {
+    if (err == NO_ERR && done < n && started - ended < OBJ_READ_WINDOW) {
+      uint extent = (off + done) / OBJ_EXTENT_SIZE;
+      uint extent_off = (off + done) % OBJ_EXTENT_SIZE;
+      uint len = min(n - done, OBJ_EXTENT_SIZE - extent_off);
+      uint slot = started % OBJ_READ_WINDOW;
+      extent_name(ename, ip->data_object_name, extent);
+      dst_offsets[slot] = done;
+      if (dstvector) {
+        obj_cache_read_start(&reads[slot], dev, ename, len, extent_off,
+                             extent_size(size, extent));
+      } else {
+        obj_cache_readahead_start(&reads[slot], dev, ename, len, extent_off,
+                                  extent_size(size, extent));
+      }
+      started++;
+      done += len;
+    } else {
+      uint slot = ended % OBJ_READ_WINDOW;
+      uint read_err =
+          obj_cache_read_end(&reads[slot], dstvector, dst_offsets[slot]);
+      if (err == NO_ERR) {
+        err = read_err;
+      }
+      ended++;
+    }
+  }
+
+  return err;
+}
+
 // PAGEBREAK!
 //  Read data from inode.
 //  Caller must hold ip->lock.
@@ -317,14 +411,32 @@ int obj_readi(struct vfs_inode *vfs_ip, uint off, uint n, vector *dstvector) {
   if (off + n > vfs_ip->size) n = vfs_ip->size - off;
   if (0 == n) return 0;
 
-  struct device *const dev = sb_private(ip->vfs_inode.sb);
-  if (obj_cache_read(dev, ip->data_object_name, dstvector, n, off,
-                     vfs_ip->size) != NO_ERR) {
+  uint err = obj_read_extents(ip, off, n, dstvector);
+  // A corrupted extent fails the read, any other failure is a bug.
+  if (err == CORRUPTED_OBJECT) {
+    return -1;
+  }
+  if (err != NO_ERR) {
     panic("obj_readi failed reading object content");
   }
   return n;
 }
 
+// Reads ahead of a sequential reader. A failure is left to the read of the
+// failed extent to report. Nothing is read ahead while the cache is disabled,
+// as the bufs would be dropped at once.
+// Caller must hold ip->lock.
+static void obj_readahead(struct vfs_inode *vfs_ip, uint off, uint n) {
+  struct obj_inode *ip = container_of(vfs_ip, struct obj_inode, vfs_inode);
+
+  if (ip->vfs_inode.type == T_DEV || ip->data_object_name[0] == 0 ||
+      off >= vfs_ip->size || !buf_cache_is_cache_enabled()) {
+    return;
+  }
+  if (n > vfs_ip->size - off) n = vfs_ip->size - off;
+  obj_read_extents(ip, off, n, 0);
+}
+
 // PAGEBREAK!
 // Write data to inode.
 // Caller must hold ip->lock.
@@ -343,16 +455,36 @@ int obj_writei(struct vfs_inode *vfs_ip, char *src, uint off, uint n) {
   }
 
   if (off > vfs_ip->size || off + n < off) return -1;
-  if (off + n > MAX_INODE_OBJECT_DATA) return -1;
 
+  // Only the extents covering the written range are touched. As there are no
+  // holes, an extent past the current size starts with the written data.
   struct device *const dev = sb_private(ip->vfs_inode.sb);
-  if (obj_cache_write(dev, ip->data_object_name, src, n, off, vfs_ip->size) !=
-      NO_ERR) {
-    panic("obj_writei failed to write object content");
+  char ename[EXTENT_NAME_LENGTH];
+  for (uint done = 0; done < n;) {
+    uint extent = (off + done) / OBJ_EXTENT_SIZE;
+    uint extent_off = (off + done) % OBJ_EXTENT_SIZE;
+    uint len = min(n - done, OBJ_EXTENT_SIZE - extent_off);
+    uint prev_extent_size = extent_size(vfs_ip->size, extent);
+    uint err;
+    extent_name(ename, ip->data_object_name, extent);
+    if (prev_extent_size == 0) {
+      err = obj_cache_add(dev, ename, src + done, len);
+    } else {
+      err = obj_cache_write(dev, ename, src + done, len, extent_off,
+                            prev_extent_size);
+    }
+    if (err != NO_ERR) {
+      panic("obj_writei failed to write object content");
+    }
+    done += len;
   }
 
-  if (vfs_ip->size < off + n) {
+  if (n > 0) {
+    ip->dirty = 1;
+  }
+  if (n > 0 && vfs_ip->size < off + n) {
     vfs_ip->size = off + n;
+    obj_iupdate(vfs_ip);
   }
 
   return n;
@@ -468,11 +600,23 @@ void obj_fs_init_dev(struct vfs_superblock *vfs_sb, struct device *dev) {
   struct vfs_inode *root_inode;
   struct dirent de;
   uint off = 0;
+  char iname[INODE_NAME_LENGTH];
+  uint size;
 
   deviceget(dev);
   vfs_sb->private = dev;
   vfs_sb->ops = &obj_ops;
 
+  // The writes are written back by a kernel thread, started with the first
+  // mount as it needs a process to run in.
+  acquire(&obj_icache.lock);
+  uint start_flusher = !obj_icache.flusher_started;
+  obj_icache.flusher_started = 1;
+  release(&obj_icache.lock);
+  if (start_flusher) {
+    kthread_create("objflush", obj_cache_flusher);
+  }
+
   acquire(&obj_icache.lock);
   for (uint i = 0; i < NINODE; i++) {
     if (obj_icache.inode[i].vfs_inode.sb == vfs_sb) {
@@ -483,6 +627,13 @@ void obj_fs_init_dev(struct vfs_superblock *vfs_sb, struct device *dev) {
   }
   release(&obj_icache.lock);
 
+  /* A store loaded from a block device might already have a root dir */
+  inode_name(iname, OBJ_ROOTINO);
+  if (object_size(dev, iname, &size) == NO_ERR) {
+    vfs_sb->root_ip = obj_iget(vfs_sb, OBJ_ROOTINO);
+    return;
+  }
+
   /* Initiate root dir */
   root_inode = obj_ialloc(vfs_sb, T_DIR);
   obj_ilock(root_inode);
@@ -538,7 +689,8 @@ void obj_fs_init_dev(struct vfs_superblock *vfs_sb, struct device *dev) {
 static const struct sb_ops obj_ops = {.ialloc = obj_ialloc,
                                       .iget = obj_iget,
                                       .destroy = obj_fsdestroy,
-                                      .start = NULL};
+                                      .start = NULL,
+                                      .sync = obj_fssync};
 
 static const struct inode_operations obj_inode_ops = {
     .idup = &obj_idup,
@@ -553,4 +705,5 @@ static const struct inode_operations obj_inode_ops = {
     .writei = &obj_writei,
     .iunlockput = &obj_iunlockput,
     .isdirempty = &obj_isdirempty,
+    .readahead = &obj_readahead,
 };
@@ -7,17 +7,16 @@
 #include "vfs_fs.h"
 
 // Other parameters:
-#define MAX_OBJECT_NAME_LENGTH 20
-#define SUPER_BLOCK_ID "\x01"
-#define OBJECT_TABLE_ID "\x02"
 #define ROOT_ID "\x03"
 #define OBJ_ROOTINO 3
 
 /**
  * On-disk inode structure
- * Currently, all the inode data is located inside a single object. We can
- * improve the implementation by implementing an indirect structure as in the
- * original xv6 file system.
+ * The inode data is split into fixed-size extent objects, so writing a part
+ * of a large file doesn't rewrite all of it. The extents are named after the
+ * data object name followed by the extent index, encoded like the inode
+ * number. As there are no holes in files, the extents of an inode are the ones
+ * covering its size, hence no extent map has to be stored.
  *
  * Inodes object names are "inode" and then the object id as 4 bytes. Because
  * part of the bytes can be zero we must change them so the id won't be cut in
@@ -35,7 +34,8 @@
  */
 struct obj_dinode {
   struct base_dinode base_dinode;
-  // the object containning the data of this inode
+  uint size;  // Size of file (bytes)
+  // the prefix of the extent objects containning the data of this inode
   char data_object_name[MAX_OBJECT_NAME_LENGTH];
 };
 
@@ -46,6 +46,15 @@ struct obj_dinode {
  */
 #define INODE_NAME_LENGTH (5 + sizeof(uint) + 1 + 1)
 
+/**
+ * The data object name and the extent index are both counters of size
+ * sizeof(uint) + 1, and 1 for null terminator
+ */
+#define EXTENT_NAME_LENGTH (2 * (sizeof(uint) + 1) + 1)
+
+/* The maximal amount of extent reads `obj_readi` keeps in flight. */
+#define OBJ_READ_WINDOW (8)
+
 void obj_fs_init(void);
 void obj_fs_init_dev(struct vfs_superblock*, struct device*);
 
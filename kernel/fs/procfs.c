@@ -3,6 +3,9 @@
 #include "defs.h"
 #include "device/buf_cache.h"
 #include "device/device.h"
+#include "device/obj_cache.h"
+#include "device/obj_disk.h"
+#include "device/obj_queue.h"
 #include "fcntl.h"
 #include "kalloc.h"
 #include "mount_ns.h"
@@ -112,6 +115,8 @@ static proc_file_name_t get_file_name_constant(char* filename) {
 
   if (strcmp(filename, PROCFS_KMEMTEST) == 0) return PROC_KMEMTEST;
 
+  if (strcmp(filename, PROCFS_OBJFS) == 0) return PROC_OBJFS;
+
   return NONE;
 }
 
@@ -168,6 +173,18 @@ int unsafe_proc_open_file(char* filename, int omode) {
     case PROC_KMEMTEST:
       break;
 
+    case PROC_OBJFS:
+      acquire(&dev_holder.lock);
+      f->count = 0;
+      for (int i = 0; i < NMAXDEVS; i++) {
+        if (dev_holder.devs[i].type == DEVICE_TYPE_OBJ &&
+            dev_holder.devs[i].ref != 0)
+          f->count++;
+      }
+      release(&dev_holder.lock);
+      file_writeable = 1;
+      break;
+
     default:
       break;
   }
@@ -301,16 +318,108 @@ static int read_file_proc_devices(struct vfs_file* f, char* addr, int n) {
   return copy_buffer(addr, f->off, n);
 }
 
+// The names of the buffer cache policies, by policy.
+static char* const cache_policies[BUF_CACHE_POLICIES] = {
+    [BUF_CACHE_POLICY_CLOCK] = CACHE_POLICY_CLOCK,
+    [BUF_CACHE_POLICY_2Q] = CACHE_POLICY_2Q,
+};
+
+// Returns `part` as a percentage of `whole`, without 64 bit division.
+static uint percent(uint part, uint whole) {
+  if (whole == 0) return 0;
+  if (part <= (uint)-1 / 100) return part * 100 / whole;
+  return part / (whole / 100);
+}
+
 static int read_file_proc_cache(struct vfs_file* f, char* addr, int n) {
+  char* bufp = buf;
+  uint hits, misses;
+  uint size, min, max;
+
+  memset(buf, 0, sizeof(buf));
+
   if (buf_cache_is_cache_enabled()) {
-    strncpy(buf, CACHE_ENABLED, sizeof(CACHE_ENABLED));
+    copy_and_move_buffer(&bufp, CACHE_ENABLED, sizeof(CACHE_ENABLED));
   } else {
-    strncpy(buf, CACHE_DISABLED, sizeof(CACHE_DISABLED));
+    copy_and_move_buffer(&bufp, CACHE_DISABLED, sizeof(CACHE_DISABLED));
+  }
+
+  copy_and_move_buffer(&bufp, CACHE_POLICY, sizeof(CACHE_POLICY));
+  copy_and_move_buffer(&bufp, cache_policies[buf_cache_policy()],
+                       MAX_PROC_FILE_NAME_LENGTH);
+  *bufp++ = '\n';
+
+  buf_cache_limits(&size, &min, &max);
+  copy_and_move_buffer(&bufp, CACHE_SIZE, sizeof(CACHE_SIZE));
+  bufp += utoa(bufp, size);
+  copy_and_move_buffer(&bufp, CACHE_MIN, sizeof(CACHE_MIN));
+  bufp += utoa(bufp, min);
+  copy_and_move_buffer(&bufp, CACHE_MAX, sizeof(CACHE_MAX));
+  bufp += utoa(bufp, max);
+  *bufp++ = '\n';
+
+  for (uint policy = 0; policy < BUF_CACHE_POLICIES; policy++) {
+    buf_cache_policy_stats(policy, &hits, &misses);
+
+    copy_and_move_buffer(&bufp, cache_policies[policy],
+                         MAX_PROC_FILE_NAME_LENGTH);
+    copy_and_move_buffer(&bufp, CACHE_HITS, sizeof(CACHE_HITS));
+    bufp += utoa(bufp, hits);
+
+    copy_and_move_buffer(&bufp, CACHE_MISSES, sizeof(CACHE_MISSES));
+    bufp += utoa(bufp, misses);
+
+    copy_and_move_buffer(&bufp, CACHE_HIT_RATIO, sizeof(CACHE_HIT_RATIO));
+    bufp += utoa(bufp, percent(hits, hits + misses));
+    *bufp++ = '%';
+    *bufp++ = '\n';
   }
 
   return copy_buffer(addr, f->off, n);
 }
 
+// Sets the buffer cache policy by a "policy <name>\n" command.
+static int write_cache_policy(char* addr, int n) {
+  char* name = addr + sizeof(CACHE_POLICY) - 1;
+  int len = n - (sizeof(CACHE_POLICY) - 1) - 1;
+
+  if (addr[n - 1] != '\n') return RESULT_ERROR;
+  for (uint policy = 0; policy < BUF_CACHE_POLICIES; policy++) {
+    if (len == strlen(cache_policies[policy]) &&
+        0 == memcmp(name, cache_policies[policy], len)) {
+      buf_cache_set_policy(policy);
+      return n;
+    }
+  }
+
+  return RESULT_ERROR;
+}
+
+// Sets a limit of the amount of buffer cache buffers by a "min <count>\n" or
+// "max <count>\n" command.
+static int write_cache_limit(char* addr, int n) {
+  uint size, min, max;
+  uint count = 0;
+  // Both commands are of the same length.
+  int i = sizeof(CACHE_SET_MIN) - 1;
+
+  for (; i < n && addr[i] >= '0' && addr[i] <= '9'; i++) {
+    count = count * 10 + (addr[i] - '0');
+  }
+  if (i == sizeof(CACHE_SET_MIN) - 1 || i != n - 1 || addr[i] != '\n')
+    return RESULT_ERROR;
+
+  buf_cache_limits(&size, &min, &max);
+  if (0 == memcmp(addr, CACHE_SET_MIN, sizeof(CACHE_SET_MIN) - 1)) {
+    min = count;
+  } else {
+    max = count;
+  }
+  if (buf_cache_set_limits(min, max) != RESULT_SUCCESS) return RESULT_ERROR;
+
+  return n;
+}
+
 static int write_file_proc_cache(struct vfs_file* f, char* addr, int n) {
   if ((n == (sizeof(CACHE_ENABLED) - 1)) &&
       (0 == memcmp(addr, CACHE_ENABLED, n))) {
@@ -320,6 +429,13 @@ static int write_file_proc_cache(struct vfs_file* f, char* addr, int n) {
              (0 == memcmp(addr, CACHE_DISABLED, n))) {
     buf_cache_disable_cache();
     return sizeof(CACHE_DISABLED) - 1;
+  } else if ((n > (sizeof(CACHE_POLICY) - 1)) &&
+             (0 == memcmp(addr, CACHE_POLICY, sizeof(CACHE_POLICY) - 1))) {
+    return write_cache_policy(addr, n);
+  } else if ((n > (sizeof(CACHE_SET_MIN) - 1)) &&
+             ((0 == memcmp(addr, CACHE_SET_MIN, sizeof(CACHE_SET_MIN) - 1)) ||
+              (0 == memcmp(addr, CACHE_SET_MAX, sizeof(CACHE_SET_MAX) - 1)))) {
+    return write_cache_limit(addr, n);
   }
 
   return RESULT_ERROR;
@@ -346,6 +462,222 @@ static int read_file_proc_kmemtest(struct vfs_file* f, char* addr, int n) {
   return copy_buffer(addr, f->off, n);
 }
 
+/**
+ * Takes a reference to every object device, so they can be used without
+ * holding dev_holder.lock. Returns the amount of devices found.
+ */
+static uint get_obj_devices(struct device* devs[MAX_OBJ_DEVS_NUM]) {
+  uint count = 0;
+
+  acquire(&dev_holder.lock);
+  for (int i = 0; i < NMAXDEVS && count < MAX_OBJ_DEVS_NUM; i++) {
+    if (dev_holder.devs[i].type != DEVICE_TYPE_OBJ ||
+        dev_holder.devs[i].ref == 0)
+      continue;
+    dev_holder.devs[i].ref++;
+    devs[count++] = &dev_holder.devs[i];
+  }
+  release(&dev_holder.lock);
+
+  return count;
+}
+
+static void put_obj_devices(struct device* devs[MAX_OBJ_DEVS_NUM],
+                            uint count) {
+  for (uint i = 0; i < count; i++) deviceput(devs[i]);
+}
+
+static int read_file_proc_objfs(struct vfs_file* f, char* addr, int n) {
+  struct device* devs[MAX_OBJ_DEVS_NUM];
+  struct obj_fragmentation_stats stats;
+  struct obj_queue_stats queue_stats;
+  char* bufp = buf;
+  uint count = get_obj_devices(devs);
+
+  memset(buf, 0, sizeof(buf));
+
+  for (uint i = 0; i < count; i++) {
+    fragmentation_stats(dev_private(devs[i]), &stats);
+
+    copy_and_move_buffer(&bufp, OBJFS_DEVICE, sizeof(OBJFS_DEVICE));
+    bufp += utoa(bufp, devs[i]->id);
+
+    copy_and_move_buffer(&bufp, OBJFS_FREE_BYTES, sizeof(OBJFS_FREE_BYTES));
+    bufp += utoa(bufp, stats.free_bytes);
+
+    copy_and_move_buffer(&bufp, OBJFS_LARGEST_FREE_EXTENT,
+                         sizeof(OBJFS_LARGEST_FREE_EXTENT));
+    bufp += utoa(bufp, stats.largest_free_extent);
+
+    copy_and_move_buffer(&bufp, OBJFS_HOLES, sizeof(OBJFS_HOLES));
+    bufp += utoa(bufp, stats.holes);
+
+    copy_and_move_buffer(&bufp, OBJFS_SHARED_BYTES,
+                         sizeof(OBJFS_SHARED_BYTES));
+    bufp += utoa(bufp, shared_bytes(dev_private(devs[i])));
+
+    copy_and_move_buffer(&bufp, OBJFS_CHECKSUM_ERRORS,
+                         sizeof(OBJFS_CHECKSUM_ERRORS));
+    bufp += utoa(bufp, checksum_errors(dev_private(devs[i])));
+
+    *bufp++ = '\n';
+  }
+  put_obj_devices(devs, count);
+
+  obj_queue_get_stats(&queue_stats);
+  copy_and_move_buffer(&bufp, OBJFS_QUEUE_LATENCY,
+                       sizeof(OBJFS_QUEUE_LATENCY));
+  bufp += utoa(bufp, queue_stats.latency);
+  copy_and_move_buffer(&bufp, OBJFS_QUEUE_IN_FLIGHT,
+                       sizeof(OBJFS_QUEUE_IN_FLIGHT));
+  bufp += utoa(bufp, queue_stats.in_flight);
+  copy_and_move_buffer(&bufp, OBJFS_QUEUE_REQUESTS,
+                       sizeof(OBJFS_QUEUE_REQUESTS));
+  bufp += utoa(bufp, queue_stats.requests);
+  copy_and_move_buffer(&bufp, OBJFS_QUEUE_TRANSACTIONS,
+                       sizeof(OBJFS_QUEUE_TRANSACTIONS));
+  bufp += utoa(bufp, queue_stats.transactions);
+  *bufp++ = '\n';
+
+  copy_and_move_buffer(&bufp, OBJFS_CACHE_HITS, sizeof(OBJFS_CACHE_HITS));
+  bufp += utoa(bufp, objects_cache_hits());
+  copy_and_move_buffer(&bufp, OBJFS_CACHE_MISSES, sizeof(OBJFS_CACHE_MISSES));
+  bufp += utoa(bufp, objects_cache_misses());
+  copy_and_move_buffer(&bufp, OBJFS_CACHE_READAHEAD_HITS,
+                       sizeof(OBJFS_CACHE_READAHEAD_HITS));
+  bufp += utoa(bufp, objects_cache_readahead_hits());
+  copy_and_move_buffer(&bufp, OBJFS_CACHE_READAHEAD_MISSES,
+                       sizeof(OBJFS_CACHE_READAHEAD_MISSES));
+  bufp += utoa(bufp, objects_cache_readahead_misses());
+  *bufp++ = '\n';
+
+  copy_and_move_buffer(&bufp, OBJFS_CACHE_DIRTY, sizeof(OBJFS_CACHE_DIRTY));
+  bufp += utoa(bufp, objects_cache_dirty());
+  copy_and_move_buffer(&bufp, OBJFS_CACHE_WRITES, sizeof(OBJFS_CACHE_WRITES));
+  bufp += utoa(bufp, objects_cache_writes());
+  copy_and_move_buffer(&bufp, OBJFS_CACHE_WRITEBACKS,
+                       sizeof(OBJFS_CACHE_WRITEBACKS));
+  bufp += utoa(bufp, objects_cache_writebacks());
+  *bufp++ = '\n';
+
+  return copy_buffer(addr, f->off, n);
+}
+
+// Sets the simulated latency of the object devices from "latency <ticks>\n".
+static int write_objfs_latency(char* addr, int n) {
+  uint latency = 0;
+  int i = sizeof(OBJFS_LATENCY) - 1;
+
+  for (; i < n && addr[i] >= '0' && addr[i] <= '9'; i++) {
+    latency = latency * 10 + (addr[i] - '0');
+  }
+  if (i == sizeof(OBJFS_LATENCY) - 1 || i != n - 1 || addr[i] != '\n')
+    return RESULT_ERROR;
+
+  obj_queue_set_latency(latency);
+  return n;
+}
+
+// Enables or disables a feature, such as the deduplication, on all the object
+// devices.
+static int write_objfs_feature(void (*set)(struct obj_device_private*, uint),
+                               uint enable, int n) {
+  struct device* devs[MAX_OBJ_DEVS_NUM];
+  uint count = get_obj_devices(devs);
+
+  for (uint i = 0; i < count; i++) {
+    set(dev_private(devs[i]), enable);
+  }
+  put_obj_devices(devs, count);
+
+  return n;
+}
+
+// Enables or disables the verification of the checksums on a single object
+// device, from "verify <device id> <0|1>\n".
+static int write_objfs_verify(char* addr, int n) {
+  struct device* devs[MAX_OBJ_DEVS_NUM];
+  uint id = 0;
+  uint count;
+  int i = sizeof(OBJFS_VERIFY) - 1;
+
+  for (; i < n && addr[i] >= '0' && addr[i] <= '9'; i++) {
+    id = id * 10 + (addr[i] - '0');
+  }
+  if (i == sizeof(OBJFS_VERIFY) - 1 || i != n - 3 || addr[i] != ' ' ||
+      (addr[i + 1] != '0' && addr[i + 1] != '1') || addr[i + 2] != '\n')
+    return RESULT_ERROR;
+
+  count = get_obj_devices(devs);
+  for (uint d = 0; d < count; d++) {
+    if (devs[d]->id == id) {
+      set_objects_verify(dev_private(devs[d]), addr[i + 1] - '0');
+      put_obj_devices(devs, count);
+      return n;
+    }
+  }
+  put_obj_devices(devs, count);
+
+  return RESULT_ERROR;
+}
+
+// Verifies all the objects of the object devices. The scrub runs in slices
+// and lets the waiting operations run in between, so it can be left running
+// in the background.
+static int write_objfs_scrub(int n) {
+  struct device* devs[MAX_OBJ_DEVS_NUM];
+  uint count = get_obj_devices(devs);
+
+  for (uint i = 0; i < count; i++) {
+    uint cursor = 0;
+    while (!scrub_objects(devs[i], &cursor, SCRUB_SLICE_OBJECTS)) yield();
+  }
+  put_obj_devices(devs, count);
+
+  return n;
+}
+
+static int write_file_proc_objfs(struct vfs_file* f, char* addr, int n) {
+  struct device* devs[MAX_OBJ_DEVS_NUM];
+  uint count;
+
+  if ((n == (sizeof(OBJFS_DEDUP_ON) - 1)) &&
+      (0 == memcmp(addr, OBJFS_DEDUP_ON, n)))
+    return write_objfs_feature(set_objects_dedup, 1, n);
+  if ((n == (sizeof(OBJFS_DEDUP_OFF) - 1)) &&
+      (0 == memcmp(addr, OBJFS_DEDUP_OFF, n)))
+    return write_objfs_feature(set_objects_dedup, 0, n);
+  if ((n == (sizeof(OBJFS_COMPRESS_ON) - 1)) &&
+      (0 == memcmp(addr, OBJFS_COMPRESS_ON, n)))
+    return write_objfs_feature(set_objects_compression, 1, n);
+  if ((n == (sizeof(OBJFS_COMPRESS_OFF) - 1)) &&
+      (0 == memcmp(addr, OBJFS_COMPRESS_OFF, n)))
+    return write_objfs_feature(set_objects_compression, 0, n);
+  if ((n > (sizeof(OBJFS_VERIFY) - 1)) &&
+      (0 == memcmp(addr, OBJFS_VERIFY, sizeof(OBJFS_VERIFY) - 1)))
+    return write_objfs_verify(addr, n);
+  if ((n == (sizeof(OBJFS_SCRUB) - 1)) && (0 == memcmp(addr, OBJFS_SCRUB, n)))
+    return write_objfs_scrub(n);
+  // Writes back the object cache, like sync(1).
+  if ((n == (sizeof(OBJFS_SYNC) - 1)) && (0 == memcmp(addr, OBJFS_SYNC, n)))
+    return obj_cache_sync(0) == NO_ERR ? n : RESULT_ERROR;
+  if ((n > (sizeof(OBJFS_LATENCY) - 1)) &&
+      (0 == memcmp(addr, OBJFS_LATENCY, sizeof(OBJFS_LATENCY) - 1)))
+    return write_objfs_latency(addr, n);
+  if ((n != (sizeof(OBJFS_COMPACT) - 1)) ||
+      (0 != memcmp(addr, OBJFS_COMPACT, n)))
+    return RESULT_ERROR;
+
+  // Compact in slices and let the waiting operations run in between.
+  count = get_obj_devices(devs);
+  for (uint i = 0; i < count; i++) {
+    while (!compact_objects(devs[i], COMPACTION_SLICE_OBJECTS)) yield();
+  }
+  put_obj_devices(devs, count);
+
+  return sizeof(OBJFS_COMPACT) - 1;
+}
+
 int unsafe_proc_read(struct vfs_file* f, char* addr, int n) {
   int result = RESULT_ERROR;
   char* bufp = buf;
@@ -375,6 +707,10 @@ int unsafe_proc_read(struct vfs_file* f, char* addr, int n) {
         result = read_file_proc_kmemtest(f, addr, n);
         break;
 
+      case PROC_OBJFS:
+        result = read_file_proc_objfs(f, addr, n);
+        break;
+
       default:
         return RESULT_ERROR;
     }
@@ -390,6 +726,7 @@ int unsafe_proc_read(struct vfs_file* f, char* addr, int n) {
       copy_and_move_buffer_max_len(&bufp, PROCFS_DEVICES);
       copy_and_move_buffer_max_len(&bufp, PROCFS_CACHE);
       copy_and_move_buffer_max_len(&bufp, PROCFS_KMEMTEST);
+      copy_and_move_buffer_max_len(&bufp, PROCFS_OBJFS);
 
       *bufp++ = '\0';
 
@@ -418,6 +755,10 @@ int unsafe_proc_write(struct vfs_file* f, char* addr, int n) {
         result = write_file_proc_cache(f, addr, n);
         break;
 
+      case PROC_OBJFS:
+        result = write_file_proc_objfs(f, addr, n);
+        break;
+
       default:
         return RESULT_ERROR;
     }
@@ -464,7 +805,26 @@ static int proc_file_size(struct vfs_file* f) {
       break;
 
     case PROC_CACHE:
-      size = CACHE_STATUS_LEN;
+      size += sizeof(CACHE_POLICY_CLOCK);  // The longest name.
+      size += sizeof(CACHE_HITS);
+      size += sizeof(uint);
+      size += sizeof(CACHE_MISSES);
+      size += sizeof(uint);
+      size += sizeof(CACHE_HIT_RATIO);
+      size += sizeof(uint);
+      size += 2;  // %\n.
+      size *= BUF_CACHE_POLICIES;
+      size += CACHE_STATUS_LEN;
+      size += sizeof(CACHE_SIZE);
+      size += sizeof(uint);
+      size += sizeof(CACHE_MIN);
+      size += sizeof(uint);
+      size += sizeof(CACHE_MAX);
+      size += sizeof(uint);
+      size += 1;  // \n.
+      size += sizeof(CACHE_POLICY);
+      size += sizeof(CACHE_POLICY_CLOCK);
+      size += 1;  // \n.
       break;
 
     case PROC_KMEMTEST:
@@ -477,6 +837,48 @@ static int proc_file_size(struct vfs_file* f) {
               1;  // \n.
       break;
 
+    case PROC_OBJFS:
+      size += sizeof(OBJFS_DEVICE);
+      size += sizeof(uint);  // id.
+      size += sizeof(OBJFS_FREE_BYTES);
+      size += sizeof(uint);
+      size += sizeof(OBJFS_LARGEST_FREE_EXTENT);
+      size += sizeof(uint);
+      size += sizeof(OBJFS_HOLES);
+      size += sizeof(uint);
+      size += sizeof(OBJFS_SHARED_BYTES);
+      size += sizeof(uint);
+      size += sizeof(OBJFS_CHECKSUM_ERRORS);
+      size += sizeof(uint);
+      size += 1;  // \n.
+      size *= f->count;
+      size += sizeof(OBJFS_QUEUE_LATENCY);
+      size += sizeof(uint);
+      size += sizeof(OBJFS_QUEUE_IN_FLIGHT);
+      size += sizeof(uint);
+      size += sizeof(OBJFS_QUEUE_REQUESTS);
+      size += sizeof(uint);
+      size += sizeof(OBJFS_QUEUE_TRANSACTIONS);
+      size += sizeof(uint);
+      size += 1;  // \n.
+      size += sizeof(OBJFS_CACHE_HITS);
+      size += sizeof(uint);
+      size += sizeof(OBJFS_CACHE_MISSES);
+      size += sizeof(uint);
+      size += sizeof(OBJFS_CACHE_READAHEAD_HITS);
+      size += sizeof(uint);
+      size += sizeof(OBJFS_CACHE_READAHEAD_MISSES);
+      size += sizeof(uint);
+      size += 1;  // \n.
+      size += sizeof(OBJFS_CACHE_DIRTY);
+      size += sizeof(uint);
+      size += sizeof(OBJFS_CACHE_WRITES);
+      size += sizeof(uint);
+      size += sizeof(OBJFS_CACHE_WRITEBACKS);
+      size += sizeof(uint);
+      size += 1;  // \n.
+      break;
+
     default:
       break;
   }
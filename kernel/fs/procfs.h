@@ -13,6 +13,7 @@
 #define PROCFS_DEVICES "devices"
 #define PROCFS_CACHE "cache"
 #define PROCFS_KMEMTEST "kmemtest"
+#define PROCFS_OBJFS "objfs"
 
 /* /proc/mounts strings. */
 #define MOUNTS_TITLE "Mounts:"
@@ -30,6 +31,17 @@
 #define CACHE_ENABLED "1\n"
 #define CACHE_DISABLED "0\n"
 #define CACHE_STATUS_LEN (2)
+#define CACHE_POLICY "policy "
+#define CACHE_POLICY_CLOCK "clock"
+#define CACHE_POLICY_2Q "2q"
+#define CACHE_HITS " hits "
+#define CACHE_MISSES ", misses "
+#define CACHE_HIT_RATIO ", hit ratio "
+#define CACHE_SIZE "size "
+#define CACHE_MIN ", min "
+#define CACHE_MAX ", max "
+#define CACHE_SET_MIN "min "
+#define CACHE_SET_MAX "max "
 
 /* /proc/kmemtest strings. */
 #define KMEMTEST_TITLE "Free Memory Pages:"
@@ -37,6 +49,34 @@
 #define KMEMTEST_LIST "  list:    "
 #define KMEMTEST_ERRORS "  errors:  "
 
+/* /proc/objfs strings. */
+#define OBJFS_DEVICE "Device "
+#define OBJFS_FREE_BYTES ": free bytes "
+#define OBJFS_LARGEST_FREE_EXTENT ", largest free extent "
+#define OBJFS_HOLES ", holes "
+#define OBJFS_SHARED_BYTES ", shared bytes "
+#define OBJFS_CHECKSUM_ERRORS ", checksum errors "
+#define OBJFS_COMPACT "compact\n"
+#define OBJFS_LATENCY "latency "
+#define OBJFS_DEDUP_ON "dedup 1\n"
+#define OBJFS_DEDUP_OFF "dedup 0\n"
+#define OBJFS_COMPRESS_ON "compress 1\n"
+#define OBJFS_COMPRESS_OFF "compress 0\n"
+#define OBJFS_VERIFY "verify "
+#define OBJFS_SCRUB "scrub\n"
+#define OBJFS_SYNC "sync\n"
+#define OBJFS_QUEUE_LATENCY "Queue latency "
+#define OBJFS_QUEUE_IN_FLIGHT ", in flight "
+#define OBJFS_QUEUE_REQUESTS ", requests "
+#define OBJFS_QUEUE_TRANSACTIONS ", transactions "
+#define OBJFS_CACHE_HITS "Cache hits "
+#define OBJFS_CACHE_MISSES ", misses "
+#define OBJFS_CACHE_READAHEAD_HITS ", readahead hits "
+#define OBJFS_CACHE_READAHEAD_MISSES ", readahead misses "
+#define OBJFS_CACHE_DIRTY "Cache dirty blocks "
+#define OBJFS_CACHE_WRITES ", writes "
+#define OBJFS_CACHE_WRITEBACKS ", writebacks "
+
 typedef enum proc_file_name_e {
   NONE = -1,
   PROC_FILE_NAME_START = 0,
@@ -46,6 +86,7 @@ typedef enum proc_file_name_e {
   PROC_DEVICES,
   PROC_CACHE,
   PROC_KMEMTEST,
+  PROC_OBJFS,
 
   PROC_FILE_NAME_END,
   NON_WRITABLE,
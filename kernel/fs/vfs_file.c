@@ -78,6 +78,29 @@ int vfs_filestat(struct vfs_file *f, struct stat *st) {
   return -1;
 }
 
+// Detects a sequential reader of file f, after a read at `off`, and reads
+// ahead of it. The window doubles with every readahead, up to
+// VFS_READAHEAD_MAX, and collapses on a read at any other offset. The next
+// window is read once the reader gets into the second half of the current
+// one, so the reader rarely waits for it.
+static void vfs_readahead(struct vfs_file *f, uint off) {
+  struct vfs_readahead *ra = &f->ra;
+
+  if (off != ra->next) {
+    ra->window = 0;
+    ra->end = 0;
+  } else if (f->off + ra->window / 2 >= ra->end) {
+    uint start = ra->end > f->off ? ra->end : f->off;
+    ra->window = ra->window == 0 ? VFS_READAHEAD_MIN : 2 * ra->window;
+    if (ra->window > VFS_READAHEAD_MAX) {
+      ra->window = VFS_READAHEAD_MAX;
+    }
+    ra->end = f->off + ra->window;
+    f->ip->i_op->readahead(f->ip, start, ra->end - start);
+  }
+  ra->next = f->off;
+}
+
 // Read from file f.
 int vfs_fileread(struct vfs_file *f, int n, vector *dstvector) {
   int r;
@@ -88,9 +111,13 @@ int vfs_fileread(struct vfs_file *f, int n, vector *dstvector) {
     return piperesult;
   }
   if (f->type == FD_INODE) {
+    uint off = f->off;
     f->ip->i_op->ilock(f->ip);
     if ((r = f->ip->i_op->readi(f->ip, f->off, n, dstvector)) > 0) {
       f->off += r;
+      if (f->ip->i_op->readahead) {
+        vfs_readahead(f, off);
+      }
     }
     f->ip->i_op->iunlock(f->ip);
     return r;
@@ -109,11 +136,12 @@ int vfs_filewrite(struct vfs_file *f, char *addr, int n) {
   if (f->type == FD_INODE) {
     // write a few blocks at a time to avoid exceeding
     // the maximum log transaction size, including
-    // i-node, indirect block, allocation blocks,
-    // and 2 blocks of slop for non-aligned writes.
+    // i-node, 2 allocation blocks, the indirect blocks
+    // of 2 paths down the triple indirect tree (5), and
+    // 1 block of slop for non-aligned writes.
     // this really belongs lower down, since writei()
     // might be writing a device like the console.
-    int max = ((MAXOPBLOCKS - 1 - 1 - 2) / 2) * 512;
+    int max = (MAXOPBLOCKS - 1 - 2 - 5 - 1) * BSIZE;
     int i = 0;
     while (i < n) {
       int n1 = n - i;
@@ -11,6 +11,17 @@
 
 struct vfs_file;
 
+/* The bytes read ahead of a sequential reader, at first and at most. */
+#define VFS_READAHEAD_MIN (4 * BSIZE)
+#define VFS_READAHEAD_MAX (32 * BSIZE)
+
+// The sequential access detection of a file, see `vfs_fileread`.
+struct vfs_readahead {
+  uint next;    // The offset following the last read.
+  uint end;     // The offset up to which the file was read ahead.
+  uint window;  // The bytes to read ahead, 0 after a random access.
+};
+
 struct vfs_file {
   enum { FD_NONE, FD_PIPE, FD_INODE, FD_CG, FD_PROC } type;
   int ref;  // reference count
@@ -25,6 +36,7 @@ struct vfs_file {
     struct {
       struct vfs_inode *ip;
       struct mount *mnt;
+      struct vfs_readahead ra;
     };
 
     // FD_CG
@@ -82,6 +94,7 @@ struct vfs_file {
         union {
           struct {
             char active;
+            uint file;
             uint file_dirty;
             uint file_dirty_aggregated;
             uint pgfault;
@@ -140,6 +153,13 @@ struct inode_operations {
   void (*stati)(struct vfs_inode *, struct stat *);
   int (*writei)(struct vfs_inode *, char *, uint, uint);
   int (*isdirempty)(struct vfs_inode *);
+  // Optional. Reads the range into the cache, ahead of a sequential reader.
+  void (*readahead)(struct vfs_inode *, uint, uint);
+  // Optional. Writes over the allocated blocks of the range in place,
+  // outside of the log of the file system, as loop devices do.
+  int (*overwritei)(struct vfs_inode *, char *, uint, uint);
+  // Optional. Are all the blocks of the range allocated?
+  int (*isallocated)(struct vfs_inode *, uint, uint);
 };
 
 // in-memory copy of an inode
@@ -13,6 +13,8 @@ struct sb_ops {
   struct vfs_inode *(*iget)(struct vfs_superblock *sb, uint inum);
   void (*start)(struct vfs_superblock *sb);
   void (*destroy)(struct vfs_superblock *sb);
+  // Writes the updates of the file system to the disk. May be null.
+  void (*sync)(struct vfs_superblock *sb);
 };
 
 struct vfs_superblock {
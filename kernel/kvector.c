@@ -67,7 +67,9 @@ unsigned int countactualpages(vector v) {
 
 // vector operations
 char* getelementpointer(const vector v, unsigned int index) {
-  if (v.valid == 1 && v.vectorsize > index) {
+  if (v.valid == 1 && v.vectorsize > index && v.buffer != NULL) {
+    return &v.buffer[index * v.typesize];
+  } else if (v.valid == 1 && v.vectorsize > index) {
     unsigned int pageindex, pageoffset;
     getpageforindex(v, index, &pageindex, &pageoffset);
     int currentpageindex;
@@ -91,7 +93,10 @@ char* getelementpointer(const vector v, unsigned int index) {
 // }
 
 unsigned int setelement(vector v, unsigned int index, char* data) {
-  if (v.valid && v.vectorsize && v.vectorsize > index) {
+  if (v.valid && v.vectorsize > index && v.buffer != NULL) {
+    memmove(&v.buffer[index * v.typesize], data, v.typesize);
+    return 1;
+  } else if (v.valid && v.vectorsize && v.vectorsize > index) {
     unsigned int pageindex, pageoffset;
     getpageforindex(v, index, &pageindex, &pageoffset);
     int currentpageindex;
@@ -113,7 +118,10 @@ unsigned int setelement(vector v, unsigned int index, char* data) {
 }
 
 unsigned int setbyte(vector v, unsigned int index, char* databyte) {
-  if (v.valid && (v.vectorsize * v.typesize) > index) {
+  if (v.valid && (v.vectorsize * v.typesize) > index && v.buffer != NULL) {
+    v.buffer[index] = *databyte;
+    return 1;
+  } else if (v.valid && (v.vectorsize * v.typesize) > index) {
     unsigned int pageindex, pageoffset;
 
     unsigned int pointersspace = 2 * sizeof(char*);
@@ -180,6 +188,7 @@ vector newvector(unsigned int size, unsigned int typesize) {
   v.vectorsize = size;
   v.typesize = typesize;
   v.valid = 0;
+  v.buffer = NULL;
 
   // caching
   v.lastaccessed = NULL;
@@ -192,6 +201,26 @@ vector newvector(unsigned int size, unsigned int typesize) {
   return v;
 }
 
+/* Returns a vector of `size` elements which are stored in `buffer`,
+ * instead of in pages of its own. Reading into such a vector copies
+ * straight into the buffer, e.g. into the memory of a user process.
+ * freevector does not free the buffer. */
+vector vectorofbuffer(char* buffer, unsigned int size, unsigned int typesize) {
+  vector v;
+  v.vectorsize = size;
+  v.typesize = typesize;
+  v.valid = 1;
+  v.buffer = buffer;
+  v.head = NULL;
+  v.tail = NULL;
+
+  // caching
+  v.lastaccessed = NULL;
+  v.lastindexaccessed = -1;
+
+  return v;
+}
+
 void freevector(vector* v) {
   char* currentpage = v->head;
   while (currentpage != NULL) {
@@ -202,11 +231,20 @@ void freevector(vector* v) {
   v->valid = 0;
   v->head = NULL;
   v->tail = NULL;
+  v->buffer = NULL;
 }
 
 void memmove_into_vector_bytes(vector dstvec, unsigned int dstbyteoffset,
                                char* src, unsigned int size) {
   int i;
+  if (dstvec.valid && dstvec.buffer != NULL) {
+    // The bytes out of the vector are dropped, as by setbyte.
+    unsigned int bytes = dstvec.vectorsize * dstvec.typesize;
+    if (dstbyteoffset >= bytes) return;
+    if (size > bytes - dstbyteoffset) size = bytes - dstbyteoffset;
+    memmove(dstvec.buffer + dstbyteoffset, src, size);
+    return;
+  }
   for (i = 0; i < size; i++) {
     setbyte(dstvec, i + dstbyteoffset, &(src[i]));
   }
@@ -226,6 +264,12 @@ void memmove_into_vector_elements(vector dstvec, unsigned int dstelementoffset,
 void memmove_from_vector(char* dst, vector vec, unsigned int elementoffset,
                          unsigned int elementcount) {
   int counter;
+  if (vec.valid && vec.buffer != NULL &&
+      elementoffset + elementcount <= vec.vectorsize) {
+    memmove(dst, vec.buffer + elementoffset * vec.typesize,
+            elementcount * vec.typesize);
+    return;
+  }
   for (counter = 0; counter < elementcount; counter++) {
     memmove(dst + counter * vec.typesize,
             getelementpointer(vec, elementoffset + counter), vec.typesize);
@@ -12,6 +12,8 @@ typedef struct kvec {
   unsigned int lastindexaccessed;  // The index of the first link accessed
                                    // (counting from 0)
   int valid;  // 1 if the initialization function succeeds. 0 if it fails.
+  char* buffer;  // The memory of a vector made by vectorofbuffer, or NULL.
+                 // The vector does not own it.
 } vector;
 
 #endif /* XV6_KVEC_H */
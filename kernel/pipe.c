@@ -86,6 +86,7 @@ int pipewrite(struct pipe *p, char *addr, int n) {
 
 int piperead(struct pipe *p, int n, vector *outputvector) {
   int i;
+  uint m;
 
   acquire(&p->lock);
   while (p->nread == p->nwrite && p->writeopen) {  // DOC: pipe-empty
@@ -95,10 +96,14 @@ int piperead(struct pipe *p, int n, vector *outputvector) {
     }
     sleep(&p->nread, &p->lock);  // DOC: piperead-sleep
   }
-  for (i = 0; i < n; i++) {  // DOC: piperead-copy
+  for (i = 0; i < n; i += m) {  // DOC: piperead-copy
     if (p->nread == p->nwrite) break;
-    char current_read = p->data[p->nread++ % PIPESIZE];
-    memmove_into_vector_bytes(*outputvector, i, (char *)&current_read, 1);
+    // Copy the bytes up to the end of the ring at once.
+    m = min(n - i, p->nwrite - p->nread);
+    m = min(m, PIPESIZE - p->nread % PIPESIZE);
+    memmove_into_vector_bytes(*outputvector, i, &p->data[p->nread % PIPESIZE],
+                              m);
+    p->nread += m;
   }
   wakeup(&p->nwrite);  // DOC: piperead-wakeup
   release(&p->lock);
@@ -2,6 +2,7 @@
 
 #include "cpu_account.h"
 #include "defs.h"
+#include "device/buf_cache.h"
 #include "fs/procfs.h"
 #include "memlayout.h"
 #include "mmu.h"
@@ -189,6 +190,45 @@ void userinit(void) {
   release(&ptable.lock);
 }
 
+// A kernel thread's very first scheduling by scheduler() will swtch here.
+// The thread has no user space to return to, its trap frame only holds the
+// thread entry.
+static void kthread_start(void) {
+  // Still holding ptable.lock from scheduler.
+  release(&ptable.lock);
+
+  ((void (*)(void))myproc()->tf->eip)();
+  panic("kthread_start: kernel thread returned");
+}
+
+// Start a kernel thread running `entry`, which must never return. The thread
+// belongs to the root cgroup and to the namespaces of the first process, so
+// it must be started after userinit().
+void kthread_create(char *name, void (*entry)(void)) {
+  struct proc *p = allocproc();
+
+  if (p == 0) panic("kthread_create: no procs");
+  if ((p->pgdir = setupkvm()) == 0) panic("kthread_create: out of memory?");
+  p->sz = 0;
+  p->parent = 0;
+  memset(p->tf, 0, sizeof(*p->tf));
+  p->tf->eip = (uint)entry;
+  p->context->eip = (uint)kthread_start;
+
+  safestrcpy(p->name, name, sizeof(p->name));
+  p->nsproxy = namespacedup(initproc->nsproxy);
+  p->child_pid_ns = 0;
+  memset(p->pids, 0, sizeof(p->pids));
+  p->ns_pid = pid_ns_next_pid(p->nsproxy->pid_ns);
+  p->pids[0].pid = p->ns_pid;
+  p->pids[0].pid_ns = p->nsproxy->pid_ns;
+
+  acquire(&ptable.lock);
+  cgroup_insert(cgroup_root(), p);
+  p->state = RUNNABLE;
+  release(&ptable.lock);
+}
+
 // Grow current process's memory by n bytes.
 // Return 0 on success, -1 on failure.
 int growproc(int n) {
@@ -197,10 +237,13 @@ int growproc(int n) {
   struct cgroup *cgroup = curproc->cgroup;
 
   // In case trying to grow process's memory over memory limit, and
-  // given memory controller is enabled, return failure
+  // given memory controller is enabled, reclaim the cached blocks of the
+  // cgroup, or return failure
   if (n > 0) {
-    if (curproc->cgroup->mem_controller_enabled &&
-        (curproc->cgroup->current_mem + n) > curproc->cgroup->max_mem) {
+    if (cgroup_mem_over_max(cgroup, n)) {
+      buf_cache_reclaim(cgroup, cgroup->current_mem + n - cgroup->max_mem);
+    }
+    if (cgroup_mem_over_max(cgroup, n)) {
       cgroup_incr_mem_failcnt(curproc->cgroup);
       return -1;
     }
@@ -266,9 +309,14 @@ int fork(void) {
     return -1;
 
   // In case trying to fork a new process and the cgroup reached its memory
-  // limit, given memory controller is enabled, return failure
-  if (curproc->cgroup->mem_controller_enabled &&
-      (curproc->cgroup->current_mem + curproc->sz) > curproc->cgroup->max_mem) {
+  // limit, given memory controller is enabled, reclaim the cached blocks of
+  // the cgroup, or return failure
+  if (cgroup_mem_over_max(curproc->cgroup, curproc->sz)) {
+    buf_cache_reclaim(curproc->cgroup,
+                      curproc->cgroup->current_mem + curproc->sz -
+                          curproc->cgroup->max_mem);
+  }
+  if (cgroup_mem_over_max(curproc->cgroup, curproc->sz)) {
     cgroup_incr_mem_failcnt(curproc->cgroup);
     return -1;
   }
@@ -69,6 +69,9 @@ struct proc {
   struct vfs_file *ofile[NOFILE];  // Open files
   struct vfs_inode *cwd;           // Current directory
   struct mount *cwdmount;          // Mount in which current directory lies
+  int fsop;                        // Depth of begin_op() calls
+  struct log *fslogs[NOPLOGS];     // Logs joined by the FS op
+  uint fslogs_written;             // Bits of the fslogs written by the op
   char name[16];                   // Process name (debugging)
   struct nsproxy *nsproxy;         // Namespace proxy object
   struct pid_ns *child_pid_ns;     // PID namespace for child procs
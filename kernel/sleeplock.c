@@ -45,3 +45,63 @@ int holdingsleep(struct sleeplock *lk) {
   release(&lk->lk);
   return r;
 }
+
+void initrwsleeplock(struct rwsleeplock *lk, char *name) {
+  initlock(&lk->lk, "rw sleep lock");
+  lk->name = name;
+  lk->readers = 0;
+  lk->writer = 0;
+  lk->waiting_writers = 0;
+  lk->pid = 0;
+  lk->owner = 0;
+}
+
+void acquirereadsleep(struct rwsleeplock *lk) {
+  acquire(&lk->lk);
+  while (lk->writer || lk->waiting_writers > 0) {
+    sleep(lk, &lk->lk);
+  }
+  lk->readers++;
+  release(&lk->lk);
+}
+
+void releasereadsleep(struct rwsleeplock *lk) {
+  acquire(&lk->lk);
+  lk->readers--;
+  if (lk->readers == 0) {
+    wakeup(lk);
+  }
+  release(&lk->lk);
+}
+
+void acquirewritesleep(struct rwsleeplock *lk) {
+  acquire(&lk->lk);
+  lk->waiting_writers++;
+  while (lk->writer || lk->readers > 0) {
+    sleep(lk, &lk->lk);
+  }
+  lk->waiting_writers--;
+  lk->writer = 1;
+  lk->pid = myproc()->ns_pid;
+  lk->owner = myproc();
+  release(&lk->lk);
+}
+
+void releasewritesleep(struct rwsleeplock *lk) {
+  acquire(&lk->lk);
+  lk->writer = 0;
+  lk->pid = 0;
+  lk->owner = 0;
+  wakeup(lk);
+  release(&lk->lk);
+}
+
+// Does the current process hold the lock as a writer?
+int holdingrwsleep(struct rwsleeplock *lk) {
+  int r;
+
+  acquire(&lk->lk);
+  r = lk->writer && lk->owner == myproc();
+  release(&lk->lk);
+  return r;
+}
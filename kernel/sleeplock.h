@@ -13,4 +13,19 @@ struct sleeplock {
   int pid;     // Process holding lock
 };
 
+// Long-term reader-writer locks for processes.
+// Many readers can hold the lock together, or a single writer. Waiting writers
+// are preferred over new readers, so readers can't starve them.
+struct rwsleeplock {
+  uint readers;          // Amount of readers holding the lock
+  uint writer;           // Is the lock held by a writer?
+  uint waiting_writers;  // Amount of writers waiting for the lock
+  struct spinlock lk;    // spinlock protecting this sleep lock
+  struct proc *owner;    // Process holding the lock as a writer
+
+  // For debugging:
+  char *name;  // Name of lock.
+  int pid;     // Process holding lock as a writer
+};
+
 #endif /* XV6_SLEEPLOCK_H */
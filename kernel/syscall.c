@@ -97,6 +97,7 @@ extern int sys_ioctl(void);
 extern int sys_getppid(void);
 extern int sys_getcpu(void);
 extern int sys_pivot_root(void);
+extern int sys_fsync(void);
 
 static int (*syscalls[])(void) = {
     [SYS_fork] sys_fork,
@@ -128,6 +129,7 @@ static int (*syscalls[])(void) = {
     [SYS_getppid] sys_getppid,
     [SYS_getcpu] sys_getcpu,
     [SYS_pivot_root] sys_pivot_root,
+    [SYS_fsync] sys_fsync,
 };
 
 void syscall(void) {
@@ -73,10 +73,10 @@ int sys_read(void) {
   } else if (f->type == FD_PROC) {
     return proc_read(f, p, n);
   } else {
+    // Read straight into the user memory, which argptr checked.
     vector pv;
-    pv = newvector(n, 1);
+    pv = vectorofbuffer(p, n, 1);
     int vfs_read_result = vfs_fileread(f, n, &pv);
-    memmove_from_vector(p, pv, 0, n);
     freevector(&pv);
     return vfs_read_result;
   }
@@ -125,6 +125,18 @@ int sys_fstat(void) {
   return vfs_filestat(f, st);
 }
 
+// Write the updates of the file system of the file to the disk.
+int sys_fsync(void) {
+  struct vfs_file *f;
+
+  if (argfd(0, 0, &f) < 0) return -1;
+  if (f->type != FD_INODE) return -1;
+
+  struct vfs_superblock *sb = f->ip->sb;
+  if (sb->ops->sync) sb->ops->sync(sb);
+  return 0;
+}
+
 // Create the path new as a link to the same inode as old.
 int sys_link(void) {
   char name[DIRSIZ], *new, *old;
@@ -144,14 +156,25 @@ int sys_link(void) {
     end_op();
     return -1;
   }
+  ip->i_op->iunlock(ip);
+
+  // The new parent is looked up before ip is written, so that the
+  // op never writes to a file system and then joins the log of
+  // another one.
+  if ((dp = vfs_nameiparent(new, name)) == 0 || dp->sb != ip->sb) {
+    if (dp != 0) dp->i_op->iput(dp);
+    ip->i_op->iput(ip);
+    end_op();
+    return -1;
+  }
 
+  ip->i_op->ilock(ip);
   ip->nlink++;
   ip->i_op->iupdate(ip);
   ip->i_op->iunlock(ip);
 
-  if ((dp = vfs_nameiparent(new, name)) == 0) goto bad;
   dp->i_op->ilock(dp);
-  if (dp->sb != ip->sb || dp->i_op->dirlink(dp, name, ip->inum) < 0) {
+  if (dp->i_op->dirlink(dp, name, ip->inum) < 0) {
     dp->i_op->iunlockput(dp);
     goto bad;
   }
@@ -351,6 +374,7 @@ int sys_open(void) {
   f->ip = ip;
   f->off = 0;
   f->mnt = mnt;
+  f->ra = (struct vfs_readahead){0};
   f->readable = !(omode & O_WRONLY);
   f->writable = (omode & O_WRONLY) || (omode & O_RDWR);
 
@@ -9,6 +9,7 @@
 #include "device/ide_device.h"
 #include "device/loop_device.h"
 #include "device/obj_device.h"
+#include "fs/native_fs.h"
 #include "mmu.h"
 #include "mount.h"
 #include "param.h"
@@ -28,7 +29,9 @@ int sys_mount(void) {
 
   // Mount objfs file system
   if (strcmp(fstype, "objfs") == 0) {
-    return handle_objfs_mounts();
+    return handle_objfs_mounts(false);
+  } else if (strcmp(fstype, "objclone") == 0) {
+    return handle_objfs_mounts(true);
   } else if (strcmp(fstype, "cgroup") == 0) {
     return handle_cgroup_mounts();
   } else if (strcmp(fstype, "proc") == 0) {
@@ -95,44 +98,92 @@ end:
   return res;
 }
 
-int handle_objfs_mounts() {
+// Mounts an objfs store. A clone mounts a writable clone of a snapshot of the
+// store in the image, instead of the store itself.
+int handle_objfs_mounts(bool clone) {
+  char *device_path = NULL;
   char *mount_path = NULL;
   struct mount *parent = NULL;
-  struct vfs_inode *mount_dir = NULL;
+  struct vfs_inode *loop_inode = NULL, *mount_dir = NULL;
+  struct device *loop_dev = NULL;
   struct device *objdev = NULL;
   int res = -1;
 
-  if (argstr(1, &mount_path) < 0) {
+  if (argstr(0, &device_path) < 0 || argstr(1, &mount_path) < 0 ||
+      (clone && device_path == 0)) {
     cprintf("badargs\n");
     return -1;
   }
 
   begin_op();
 
+  // Without a device path, the store is kept in the memory.
+  if (device_path != 0 && (loop_inode = vfs_namei(device_path)) == 0) {
+    cprintf("bad device_path\n");
+    goto end;
+  }
+
   if ((mount_dir = vfs_nameimount(mount_path, &parent)) == 0) {
     goto end;
   }
 
+  if (loop_inode != NULL) {
+    loop_inode->i_op->ilock(loop_inode);
+  }
   mount_dir->i_op->ilock(mount_dir);
 
-  objdev = create_obj_device();
+  if (loop_inode == NULL) {
+    objdev = create_obj_device();
+  } else {
+    loop_dev = get_loop_device(loop_inode);
+    if (loop_dev == NULL) {
+      loop_dev = create_loop_device(loop_inode);
+    }
+    // The clones of an image share a single snapshot of its store.
+    if (loop_dev != NULL && clone) {
+      objdev = get_obj_snapshot_device(loop_dev);
+    }
+    if (loop_dev != NULL && objdev == NULL) {
+      objdev = create_backed_obj_device(loop_dev);
+    }
+    if (clone && objdev != NULL) {
+      struct device *snapshot = objdev;
+      objdev = create_obj_clone_device(snapshot);
+      deviceput(snapshot);
+    }
+  }
   if (objdev == NULL) {
     cprintf("failed to create ObjFS device\n");
     goto end_locked;
   }
 
+  // The store writes its blocks to the loop device, which locks its file.
+  if (loop_inode != NULL) {
+    loop_inode->i_op->iunlock(loop_inode);
+  }
   res = mount(mount_dir, objdev, NULL, parent);
+  mount_dir->i_op->iunlock(mount_dir);
+  goto end;
 
 end_locked:
   mount_dir->i_op->iunlock(mount_dir);
+  if (loop_inode != NULL) {
+    loop_inode->i_op->iunlock(loop_inode);
+  }
 
 end:
+  if (loop_inode != NULL) {
+    loop_inode->i_op->iput(loop_inode);
+  }
   if (mount_dir) {
     mount_dir->i_op->iput(mount_dir);
   }
   if (objdev) {
     deviceput(objdev);
   }
+  if (loop_dev != NULL) {
+    deviceput(loop_dev);
+  }
   if (parent) {
     mntput(parent);
   }
@@ -300,11 +351,15 @@ int handle_nativefs_mounts() {
     loop_dev = create_loop_device(loop_inode);
   }
 
-  if (loop_dev == NULL) {
+  if (loop_dev == NULL || native_fs_check(loop_dev) != 0) {
     goto end_locked;
   }
 
+  // Recovering the log writes to the loop device, which locks its file.
+  loop_inode->i_op->iunlock(loop_inode);
   res = mount(mount_dir, loop_dev, NULL, parent);
+  mount_dir->i_op->iunlock(mount_dir);
+  goto end;
 
 end_locked:
   loop_inode->i_op->iunlock(loop_inode);
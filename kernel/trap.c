@@ -1,6 +1,7 @@
 #include "cgroup.h"
 #include "defs.h"
 #include "device/ide.h"
+#include "device/obj_queue.h"
 #include "memlayout.h"
 #include "mmu.h"
 #include "param.h"
@@ -44,6 +45,7 @@ void trap(struct trapframe *tf) {
         ticks++;
         wakeup(&ticks);
         release(&tickslock);
+        obj_queue_intr();
       }
       lapiceoi();
       break;
@@ -26,7 +26,7 @@
 // [ boot block | sb block | log | inode blocks | free bit map | data blocks ]
 
 int ninodeblocks = NINODES / IPB + 1;
-int nlog = LOGSIZE;
+int nlog;
 int nmeta;    // Number of meta blocks (boot, sb, nlog, inode, bitmap)
 int nblocks;  // Number of data blocks
 
@@ -43,6 +43,7 @@ void rinode(uint inum, struct native_dinode *ip);
 void rsect(uint sec, void *buf);
 uint ialloc(file_type type);
 void iappend(uint inum, void *p, int n);
+uint bmap(struct native_dinode *din, uint fbn);
 
 // convert to intel byte order
 ushort xshort(ushort x) {
@@ -90,6 +91,12 @@ int main(int argc, char *argv[]) {
   int fssize = is_internal ? INT_FSSIZE : FSSIZE;
   int nbitmap = fssize / (BSIZE * 8) + 1;
 
+  // A small file system gets a smaller log, so its files still fit. The log
+  // holds the header and the blocks of two ops at least (see native_log.c).
+  nlog = fssize / 6;
+  if (nlog > LOGSIZE) nlog = LOGSIZE;
+  if (nlog < 2 * MAXOPBLOCKS + 1) nlog = 2 * MAXOPBLOCKS + 1;
+
   assert((BSIZE % sizeof(struct native_dinode)) == 0);
   assert((BSIZE % sizeof(struct dirent)) == 0);
 
@@ -255,12 +262,48 @@ void balloc(int used) {
 
 #define min(a, b) ((a) < (b) ? (a) : (b))
 
+// Returns the block holding block fbn of the file, allocating it and the
+// indirect blocks leading to it if needed.
+uint bmap(struct native_dinode *din, uint fbn) {
+  uint indirect[NINDIRECT];
+  uint levels, span, x;
+
+  if (fbn < NDIRECT) {
+    if (xint(din->addrs[fbn]) == 0) {
+      din->addrs[fbn] = xint(freeblock++);
+    }
+    return xint(din->addrs[fbn]);
+  }
+  fbn -= NDIRECT;
+
+  // Find the indirect tree of the block, and the amount of blocks it spans.
+  for (levels = 1, span = NINDIRECT; fbn >= span;
+       levels++, span *= NINDIRECT) {
+    assert(levels < 3);
+    fbn -= span;
+  }
+  if (xint(din->addrs[NDIRECT + levels - 1]) == 0) {
+    din->addrs[NDIRECT + levels - 1] = xint(freeblock++);
+  }
+  x = xint(din->addrs[NDIRECT + levels - 1]);
+  for (; levels > 0; levels--) {
+    span /= NINDIRECT;
+    rsect(x, (char *)indirect);
+    if (indirect[fbn / span] == 0) {
+      indirect[fbn / span] = xint(freeblock++);
+      wsect(x, (char *)indirect);
+    }
+    x = xint(indirect[fbn / span]);
+    fbn %= span;
+  }
+  return x;
+}
+
 void iappend(uint inum, void *xp, int n) {
   char *p = (char *)xp;
   uint fbn, off, n1;
   struct native_dinode din;
   char buf[BSIZE];
-  uint indirect[NINDIRECT];
   uint x;
 
   rinode(inum, &din);
@@ -269,22 +312,7 @@ void iappend(uint inum, void *xp, int n) {
   while (n > 0) {
     fbn = off / BSIZE;
     assert(fbn < MAXFILE);
-    if (fbn < NDIRECT) {
-      if (xint(din.addrs[fbn]) == 0) {
-        din.addrs[fbn] = xint(freeblock++);
-      }
-      x = xint(din.addrs[fbn]);
-    } else {
-      if (xint(din.addrs[NDIRECT]) == 0) {
-        din.addrs[NDIRECT] = xint(freeblock++);
-      }
-      rsect(xint(din.addrs[NDIRECT]), (char *)indirect);
-      if (indirect[fbn - NDIRECT] == 0) {
-        indirect[fbn - NDIRECT] = xint(freeblock++);
-        wsect(xint(din.addrs[NDIRECT]), (char *)indirect);
-      }
-      x = xint(indirect[fbn - NDIRECT]);
-    }
+    x = bmap(&din, fbn);
     n1 = min(n, (fbn + 1) * BSIZE - off);
     rsect(x, buf);
     bcopy(p, buf + off - (fbn * BSIZE), n1);
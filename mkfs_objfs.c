@@ -0,0 +1,93 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "include/fsdefs.h"
+#include "include/param.h"
+#include "include/types.h"
+
+// Builds an empty obj-fs store, to be mounted from a block device.
+// Disk layout:
+// [ super block | objects table | store ]
+//
+// The objects table holds the entries of the super block and of the table
+// itself. The root directory is created by the kernel on the first mount.
+
+int fsfd;
+char zeroes[BSIZE];
+
+void printusageexit(void) {
+  fprintf(stderr, "Usage: mkfs_objfs objfs.img [size in blocks]\n");
+  exit(1);
+}
+
+void wbytes(uint offset, const void *buf, uint size) {
+  if (lseek(fsfd, offset, SEEK_SET) != offset) {
+    perror("lseek");
+    exit(1);
+  }
+  if (write(fsfd, buf, size) != size) {
+    perror("write");
+    exit(1);
+  }
+}
+
+void wentry(uint index, const char *id, uint disk_offset, uint size) {
+  objects_table_entry entry;
+
+  memset(&entry, 0, sizeof(entry));
+  memmove(entry.object_id, id, strlen(id) + 1);
+  entry.disk_offset = disk_offset;
+  entry.size = size;
+  entry.occupied = 1;
+  wbytes(sizeof(struct objsuperblock) + index * sizeof(entry), &entry,
+         sizeof(entry));
+}
+
+int main(int argc, char *argv[]) {
+  struct objsuperblock sb;
+  uint table_bytes = INITIAL_OBJECT_TABLE_SIZE * sizeof(objects_table_entry);
+  uint fssize = OBJFS_SIZE;
+
+  if (argc != 2 && argc != 3) {
+    printusageexit();
+  }
+  if (argc == 3 && (fssize = atoi(argv[2])) == 0) {
+    printusageexit();
+  }
+  if (fssize * BSIZE < sizeof(sb) + table_bytes) {
+    fprintf(stderr, "mkfs_objfs: %u blocks can't hold the objects table\n",
+            fssize);
+    exit(1);
+  }
+
+  fsfd = open(argv[1], O_RDWR | O_CREAT | O_TRUNC, 0666);
+  if (fsfd < 0) {
+    perror(argv[1]);
+    exit(1);
+  }
+
+  for (uint i = 0; i < fssize; i++) wbytes(i * BSIZE, zeroes, BSIZE);
+
+  memset(&sb, 0, sizeof(sb));
+  sb.magic = OBJ_FS_MAGIC;
+  sb.storage_device_size = fssize * BSIZE;
+  sb.objects_table_offset = sizeof(sb);
+  sb.store_offset = sb.objects_table_offset + table_bytes;
+  sb.bytes_occupied = sizeof(sb) + table_bytes;
+  sb.occupied_objects = 2;
+  // Inode counter starts from 3, when 3 reserved to root dir object.
+  sb.last_inode = 2;
+  wbytes(0, &sb, sizeof(sb));
+
+  wentry(0, SUPER_BLOCK_ID, 0, sizeof(sb));
+  wentry(1, OBJECT_TABLE_ID, sb.objects_table_offset, table_bytes);
+
+  printf("objfs: store offset %u, total %u bytes\n", sb.store_offset,
+         sb.storage_device_size);
+
+  close(fsfd);
+  exit(0);
+}
@@ -1,14 +1,30 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include "common_mocks.h"
 #include "framework/test.h"
+#include "kernel/cgroup.h"
 #include "kernel/defs.h"
 #include "kernel/device/buf.h"
 #include "kernel/device/buf_cache.h"
+#include "kernel/mmu.h"
 #include "param.h"
 
+/* A lookup which would wait for a buffer panics, the tests run in a single
+ * thread. */
+void sleep(void* chan, struct spinlock* lk) { panic("sleep"); }
+
+void wakeup(void* chan) {}
+
+/* Splits the cache into a single shard of NBUF buffers, so the tests of the
+ * policies don't depend on how the blocks hash to shards. */
+static void pin_single_shard(void) {
+  buf_cache_init_shards(1);
+  buf_cache_set_limits(NBUF, NBUF);
+}
+
 /* Verify buffers remain valid upon release. */
 TEST(buffer_validity) {
   struct device tested_dev = {0};
@@ -34,7 +50,7 @@ TEST(no_used_allocated) {
     buf_cache_get(&tested_dev, &id, 0);
   }
 
-  /* Try to allocate one more buffer and expect to fail since all are dirty. */
+  /* Try to allocate one more buffer and expect to wait since all are used. */
   EXPECT_PANIC(id.blockno = NBUF + 1; buf_cache_get(&tested_dev, &id, 0););
 }
 
@@ -56,44 +72,42 @@ TEST(no_dirty_allocated) {
     buf_cache_release(buffers[i]);
   }
 
-  /* Try to allocate one more buffer and expect to fail since all are dirty. */
+  /* Try to allocate one more buffer and expect to wait since all are dirty. */
   EXPECT_PANIC(id.blockno = NBUF + 1; buf_cache_get(&tested_dev, &id, 0););
 }
 
-TEST(lru_mechanism) {
+/* Verify buffers used since the CLOCK hand passed them are recycled after the
+ * unused ones. */
+TEST(clock_mechanism) {
   struct device tested_dev = {0};
   struct device tested_dev2 = {0};
-  uint seed = 0x1337;
-  union buf_id id;
+  union buf_id id = {0};
   struct buf* buffers[NBUF] = {0};
 
-  /* Allocate all buffers. */
+  pin_single_shard();
+  /* Allocate all buffers, only the odd ones to be cached. */
   for (uint i = 0; i < NBUF; i++) {
     id.blockno = i;
-    buffers[i] = buf_cache_get(&tested_dev, &id, 0);
-  }
-
-  /* Mix the allocated buffers. */
-  for (uint i = 0; i < 1000; i++) {
-    uint first_index = rand_r(&seed) % NBUF;
-    uint sec_index = rand_r(&seed) % NBUF;
-    struct buf* tmp = buffers[first_index];
-    buffers[first_index] = buffers[sec_index];
-    buffers[sec_index] = tmp;
+    buffers[i] =
+        buf_cache_get(&tested_dev, &id, (i % 2) ? 0 : BUF_ALLOC_NO_CACHE);
+    buffers[i]->flags |= B_VALID;
   }
-
-  /* Free all buffers. */
   for (uint i = 0; i < NBUF; i++) {
     buf_cache_release(buffers[i]);
   }
 
-  /* Allocate all buffers again and verify we get them according to the free()
-   * order, thus validating the LRU policy. */
-  for (uint i = 0; i < NBUF; i++) {
-    // Allocate different buffers (not same device)
+  /* Allocate buffers for as many other blocks as there are buffers which are
+   * not cached, and verify they recycle all of these. */
+  for (uint i = 0; i < NBUF / 2; i++) {
+    id.blockno = i;
+    buf_cache_get(&tested_dev2, &id, 0);
+  }
+  for (uint i = 1; i < NBUF; i += 2) {
     id.blockno = i;
-    struct buf* tmp = buf_cache_get(&tested_dev2, &id, 0);
+    struct buf* tmp = buf_cache_get(&tested_dev, &id, 0);
     EXPECT_TRUE(tmp == buffers[i]);
+    EXPECT_TRUE(tmp->flags & B_VALID);
+    buf_cache_release(tmp);
   }
 }
 
@@ -105,13 +119,12 @@ TEST(allocation_hint) {
   struct buf* cached_buffers[NBUF / 2];
   struct buf* not_cached_buffers[NBUF / 2];
 
-  /* Allocate and then free buffers with default caching hint. */
+  /* Allocate buffers with default caching hint. They are held until all the
+   * buffers are allocated, so the cache doesn't recycle them meanwhile. */
   for (uint i = 0; i < ARRAY_LEN(cached_buffers); i++) {
     id.blockno = i;
     cached_buffers[i] = buf_cache_get(&tested_dev, &id, 0);
-  }
-  for (uint i = 0; i < ARRAY_LEN(cached_buffers); i++) {
-    buf_cache_release(cached_buffers[i]);
+    cached_buffers[i]->flags |= B_VALID;
   }
 
   /* Allocate buffers with "no cache" hint. */
@@ -120,6 +133,9 @@ TEST(allocation_hint) {
     not_cached_buffers[i] =
         buf_cache_get(&tested_dev2, &id, BUF_ALLOC_NO_CACHE);
   }
+  for (uint i = 0; i < ARRAY_LEN(cached_buffers); i++) {
+    buf_cache_release(cached_buffers[i]);
+  }
   for (uint i = 0; i < ARRAY_LEN(not_cached_buffers); i++) {
     buf_cache_release(not_cached_buffers[i]);
   }
@@ -138,12 +154,347 @@ TEST(allocation_hint) {
   EXPECT_UINT_EQ(1, is_not_cached_buf);
 }
 
+static void read_block(const struct device* dev, uint blockno) {
+  union buf_id id = {.blockno = blockno};
+  struct buf* buffer = buf_cache_get(dev, &id, 0);
+
+  buffer->flags |= B_VALID;
+  buf_cache_release(buffer);
+}
+
+/* Reads a few hot blocks a few times between passes over other blocks, then a
+ * single long pass over other blocks, and returns how many of the hot blocks
+ * are still cached in their buffers. */
+static uint hot_blocks_after_scan(void) {
+  struct device hot_dev = {0};
+  struct device scan_dev = {0};
+  union buf_id id = {0};
+  struct buf* hot_buffers[NBUF / 16];
+  uint scanned = 0;
+  uint cached = 0;
+
+  for (uint round = 0; round < 4; round++) {
+    for (uint i = 0; i < ARRAY_LEN(hot_buffers); i++) {
+      read_block(&hot_dev, i);
+    }
+    for (uint i = 0; i < NBUF / 2; i++) {
+      read_block(&scan_dev, scanned++);
+    }
+  }
+  for (uint i = 0; i < ARRAY_LEN(hot_buffers); i++) {
+    id.blockno = i;
+    hot_buffers[i] = buf_cache_get(&hot_dev, &id, 0);
+    buf_cache_release(hot_buffers[i]);
+  }
+
+  for (uint i = 0; i < 4 * NBUF; i++) {
+    read_block(&scan_dev, scanned++);
+  }
+  for (uint i = 0; i < ARRAY_LEN(hot_buffers); i++) {
+    id.blockno = i;
+    struct buf* buffer = buf_cache_get(&hot_dev, &id, 0);
+    if (buffer == hot_buffers[i] && (buffer->flags & B_VALID)) {
+      cached++;
+    }
+    buf_cache_release(buffer);
+  }
+
+  return cached;
+}
+
+/* Verify a long pass over blocks read once flushes the hot blocks under
+ * CLOCK. */
+TEST(clock_scan) {
+  pin_single_shard();
+  EXPECT_UINT_EQ(0, hot_blocks_after_scan());
+}
+
+/* Verify a long pass over blocks read once keeps the hot blocks under 2Q, and
+ * the lookups are counted for 2Q only. */
+TEST(two_queues_scan_resistance) {
+  uint hits, misses;
+
+  pin_single_shard();
+  buf_cache_set_policy(BUF_CACHE_POLICY_2Q);
+  EXPECT_UINT_EQ(BUF_CACHE_POLICY_2Q, buf_cache_policy());
+  EXPECT_UINT_EQ(NBUF / 16, hot_blocks_after_scan());
+
+  buf_cache_policy_stats(BUF_CACHE_POLICY_CLOCK, &hits, &misses);
+  EXPECT_UINT_EQ(0, hits);
+  EXPECT_UINT_EQ(0, misses);
+  buf_cache_policy_stats(BUF_CACHE_POLICY_2Q, &hits, &misses);
+  EXPECT_TRUE(hits >= 2 * (NBUF / 16));
+  EXPECT_TRUE(misses >= 6 * NBUF);
+}
+
+/* Verify the buffers of the 2Q cold queue are kept when switching to CLOCK. */
+TEST(policy_switch) {
+  static struct device tested_dev;
+  union buf_id id = {0};
+  struct buf* buffers[NBUF / 8];
+
+  buf_cache_set_policy(BUF_CACHE_POLICY_2Q);
+  for (uint i = 0; i < ARRAY_LEN(buffers); i++) {
+    id.blockno = i;
+    buffers[i] = buf_cache_get(&tested_dev, &id, 0);
+    buffers[i]->flags |= B_VALID;
+    buf_cache_release(buffers[i]);
+  }
+
+  buf_cache_set_policy(BUF_CACHE_POLICY_CLOCK);
+  for (uint i = 0; i < ARRAY_LEN(buffers); i++) {
+    id.blockno = i;
+    struct buf* buffer = buf_cache_get(&tested_dev, &id, 0);
+    EXPECT_TRUE(buffer == buffers[i]);
+    buf_cache_release(buffer);
+  }
+  /* All the buffers can be recycled. */
+  for (uint i = 0; i < NBUF; i++) {
+    id.blockno = NBUF + i;
+    buf_cache_get(&tested_dev, &id, 0);
+  }
+}
+
+#define PAGE_BUFS (PGSIZE / sizeof(struct buf))
+
+static uint cache_size(void) {
+  uint size, min, max;
+
+  buf_cache_limits(&size, &min, &max);
+  return size;
+}
+
+/* Verify the cache grows beyond NBUF buffers by pages of buffers up to its
+ * max limit, and waits for a buffer beyond it. */
+TEST(grows_to_max) {
+  struct device tested_dev = {0};
+  union buf_id id = {0};
+  uint held = 0;
+
+  EXPECT_UINT_EQ(RESULT_SUCCESS, buf_cache_set_limits(NBUF, 2 * NBUF));
+  for (; held < 2 * NBUF - PAGE_BUFS; held++) {
+    id.blockno = held;
+    buf_cache_get(&tested_dev, &id, 0);
+  }
+  uint size = cache_size();
+  EXPECT_TRUE(size > 2 * NBUF - PAGE_BUFS && size <= 2 * NBUF);
+
+  for (; held < size; held++) {
+    id.blockno = held;
+    buf_cache_get(&tested_dev, &id, 0);
+  }
+  EXPECT_PANIC(id.blockno = held; buf_cache_get(&tested_dev, &id, 0););
+}
+
+/* Verify lowering the max limit frees the pages of buffers not in use, and
+ * the pages in use are freed by later lookups. */
+TEST(shrinks_to_max) {
+  struct device tested_dev = {0};
+  union buf_id id = {0};
+  struct buf* buffers[2 * NBUF];
+
+  EXPECT_UINT_EQ(RESULT_SUCCESS, buf_cache_set_limits(NBUF, NBUF_MAX));
+  for (uint i = 0; i < ARRAY_LEN(buffers); i++) {
+    id.blockno = i;
+    buffers[i] = buf_cache_get(&tested_dev, &id, 0);
+  }
+  for (uint i = 0; i < ARRAY_LEN(buffers) - 1; i++) {
+    buf_cache_release(buffers[i]);
+  }
+
+  /* The last buffer allocated is held, and so is its page. */
+  EXPECT_UINT_EQ(RESULT_SUCCESS, buf_cache_set_limits(NBUF, NBUF));
+  EXPECT_TRUE(cache_size() > NBUF);
+  EXPECT_TRUE(cache_size() < 2 * NBUF);
+  buf_cache_release(buffers[ARRAY_LEN(buffers) - 1]);
+  id.blockno = ARRAY_LEN(buffers);
+  buf_cache_release(buf_cache_get(&tested_dev, &id, 0));
+  EXPECT_UINT_EQ(NBUF, cache_size());
+
+  EXPECT_UINT_EQ(RESULT_ERROR_ARGUMENT, buf_cache_set_limits(NBUF - 1, NBUF));
+  EXPECT_UINT_EQ(RESULT_ERROR_ARGUMENT,
+                 buf_cache_set_limits(NBUF, NBUF_MAX + 1));
+}
+
+/* Verify the cache shrinks to its min limit when the memory runs low. */
+TEST(shrinks_under_memory_pressure) {
+  struct device tested_dev = {0};
+  union buf_id id = {0};
+
+  EXPECT_UINT_EQ(RESULT_SUCCESS,
+                 buf_cache_set_limits(NBUF + NBUF / 2, NBUF_MAX));
+  for (uint i = 0; i < 4 * NBUF; i++) {
+    id.blockno = i;
+    buf_cache_release(buf_cache_get(&tested_dev, &id, 0));
+  }
+  EXPECT_TRUE(cache_size() >= 4 * NBUF);
+
+  /* Leave memory low even after the cache frees its pages. */
+  while (get_total_memory() >= BUF_CACHE_SHRINK_FREE_PAGES / 2) {
+    kalloc();
+  }
+  for (uint i = 0; i < 4 * NBUF; i++) {
+    id.blockno = 4 * NBUF + i;
+    buf_cache_release(buf_cache_get(&tested_dev, &id, 0));
+  }
+  EXPECT_TRUE(cache_size() >= NBUF + NBUF / 2);
+  EXPECT_TRUE(cache_size() < NBUF + NBUF / 2 + PAGE_BUFS);
+}
+
+/* Verify a cgroup over its memory limit recycles its own buffers, and keeps
+ * the blocks of another cgroup cached. */
+TEST(cgroup_over_max_recycles_own_blocks) {
+  static struct device work_dev;
+  static struct device thrash_dev;
+  static struct cgroup work;
+  static struct cgroup thrash;
+  uint hits, misses;
+
+  thrash.mem_controller_enabled = 1;
+  thrash.max_mem = 8 * BSIZE;
+  set_mock_cgroup(&work);
+  for (uint i = 0; i < NBUF / 8; i++) {
+    read_block(&work_dev, i);
+  }
+  EXPECT_UINT_EQ(NBUF / 8 * BSIZE, work.current_mem);
+  EXPECT_UINT_EQ(NBUF / 8 * BSIZE, work.mem_stat_file);
+
+  set_mock_cgroup(&thrash);
+  for (uint i = 0; i < 4 * NBUF; i++) {
+    read_block(&thrash_dev, i);
+  }
+  EXPECT_UINT_EQ(8 * BSIZE, thrash.current_mem);
+  EXPECT_UINT_EQ(8 * BSIZE, thrash.mem_stat_file);
+
+  set_mock_cgroup(&work);
+  buf_cache_policy_stats(BUF_CACHE_POLICY_CLOCK, &hits, &misses);
+  for (uint i = 0; i < NBUF / 8; i++) {
+    read_block(&work_dev, i);
+  }
+  EXPECT_UINT_EQ(NBUF / 8 * BSIZE, work.current_mem);
+  uint misses_before = misses;
+  buf_cache_policy_stats(BUF_CACHE_POLICY_CLOCK, &hits, &misses);
+  EXPECT_UINT_EQ(misses_before, misses);
+}
+
+/* Verify the charges of the buffers move to the writer, are reclaimed and are
+ * forgotten with the cgroup, in the cgroup and its ancestors. */
+TEST(cgroup_charges) {
+  struct device tested_dev = {0};
+  static struct cgroup parent;
+  static struct cgroup child;
+  static struct cgroup writer;
+  union buf_id id = {.blockno = 0};
+
+  child.parent = &parent;
+  set_mock_cgroup(&child);
+  for (uint i = 0; i < 16; i++) {
+    read_block(&tested_dev, i);
+  }
+  EXPECT_UINT_EQ(16 * BSIZE, child.mem_stat_file);
+  EXPECT_UINT_EQ(16 * BSIZE, parent.current_mem);
+
+  struct buf* buffer = buf_cache_get(&tested_dev, &id, 0);
+  EXPECT_TRUE(buffer->cgroup == &child);
+  buf_cache_charge(buffer, &writer);
+  EXPECT_TRUE(buffer->cgroup == &writer);
+  buf_cache_release(buffer);
+  EXPECT_UINT_EQ(BSIZE, writer.current_mem);
+  EXPECT_UINT_EQ(15 * BSIZE, parent.current_mem);
+
+  /* A buffer in use is not reclaimed, but is forgotten. */
+  id.blockno = 15;
+  buffer = buf_cache_get(&tested_dev, &id, 0);
+  EXPECT_UINT_EQ(4 * BSIZE, buf_cache_reclaim(&child, 4 * BSIZE));
+  EXPECT_UINT_EQ(11 * BSIZE, child.current_mem);
+  EXPECT_UINT_EQ(11 * BSIZE, parent.mem_stat_file);
+
+  buf_cache_forget_cgroup(&child);
+  EXPECT_UINT_EQ(0, child.current_mem);
+  EXPECT_UINT_EQ(0, parent.current_mem);
+  EXPECT_UINT_EQ(BSIZE, writer.current_mem);
+  EXPECT_TRUE(buffer->cgroup == 0);
+  buf_cache_release(buffer);
+}
+
+/* Buffers of different devices and objects with the same block number are
+ * different buffers. */
+TEST(lookup_by_device_and_id) {
+  struct device tested_dev = {0};
+  struct device tested_dev2 = {0};
+  union buf_id id = {0};
+  union buf_id id2 = {0};
+  struct buf* buffers[3];
+
+  strncpy(id.obj_id.object_name, "object", MAX_OBJECT_NAME_LENGTH);
+  strncpy(id2.obj_id.object_name, "object2", MAX_OBJECT_NAME_LENGTH);
+  buffers[0] = buf_cache_get(&tested_dev, &id, 0);
+  buffers[1] = buf_cache_get(&tested_dev2, &id, 0);
+  buffers[2] = buf_cache_get(&tested_dev, &id2, 0);
+  for (uint i = 0; i < ARRAY_LEN(buffers); i++) {
+    buffers[i]->flags |= B_VALID;
+    buffers[i]->data[0] = i;
+    buf_cache_release(buffers[i]);
+  }
+
+  EXPECT_TRUE(buffers[0] != buffers[1] && buffers[0] != buffers[2] &&
+              buffers[1] != buffers[2]);
+  struct buf* buffer = buf_cache_get(&tested_dev2, &id, 0);
+  EXPECT_TRUE(buffer == buffers[1]);
+  EXPECT_UINT_EQ(1, buffer->data[0]);
+  buf_cache_release(buffer);
+  buffer = buf_cache_get(&tested_dev, &id2, 0);
+  EXPECT_TRUE(buffer == buffers[2]);
+  EXPECT_UINT_EQ(2, buffer->data[0]);
+}
+
+static ulong elapsed_ns(const struct timespec* start,
+                        const struct timespec* end) {
+  return (end->tv_sec - start->tv_sec) * 1000000000ul + end->tv_nsec -
+         start->tv_nsec;
+}
+
+/* Measures the lookups of cached buffers, with more and more of the cache
+ * holding other blocks. Lookups hash the device and id, so their time doesn't
+ * grow with the cached blocks. */
+TEST(lookup_benchmark) {
+  const uint cached_counts[] = {NBUF / 8, NBUF / 2, NBUF};
+  const uint lookups = 1000000;
+  struct device tested_dev = {0};
+  union buf_id id = {0};
+  uint seed = 0x1337;
+  uint cached = 0;
+
+  for (uint i = 0; i < ARRAY_LEN(cached_counts); i++) {
+    for (; cached < cached_counts[i]; cached++) {
+      snprintf(id.obj_id.object_name, MAX_OBJECT_NAME_LENGTH, "lookup_%u",
+               cached);
+      buf_cache_release(buf_cache_get(&tested_dev, &id, 0));
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint j = 0; j < lookups; j++) {
+      snprintf(id.obj_id.object_name, MAX_OBJECT_NAME_LENGTH, "lookup_%u",
+               rand_r(&seed) % cached);
+      buf_cache_release(buf_cache_get(&tested_dev, &id, 0));
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    PRINT("\n\t%u cached buffers: %lu ns per lookup", cached,
+          elapsed_ns(&start, &end) / lookups);
+  }
+  PRINT("\n");
+}
+
 INIT_TESTS_PLATFORM();
 
 // Should be called before each test
 void init_test() {
   init_mocks_environment();
   buf_cache_init();
+  /* Most tests are about a cache of NBUF buffers. */
+  buf_cache_set_limits(NBUF, NBUF);
 }
 
 int main() {
@@ -152,8 +503,18 @@ int main() {
   run_test(buffer_validity);
   run_test(no_used_allocated);
   run_test(no_dirty_allocated);
-  run_test(lru_mechanism);
+  run_test(clock_mechanism);
   run_test(allocation_hint);
+  run_test(clock_scan);
+  run_test(two_queues_scan_resistance);
+  run_test(policy_switch);
+  run_test(grows_to_max);
+  run_test(shrinks_to_max);
+  run_test(shrinks_under_memory_pressure);
+  run_test(cgroup_over_max_recycles_own_blocks);
+  run_test(cgroup_charges);
+  run_test(lookup_by_device_and_id);
+  run_test(lookup_benchmark);
 
   PRINT_TESTS_RESULT("BUF_CACHE_TESTS");
   return CURRENT_TESTS_RESULT();
@@ -7,6 +7,7 @@
 #include <sys/wait.h>
 
 #include "framework/test.h"
+#include "kernel/cgroup.h"
 #include "kernel/defs.h"
 #include "kernel/mmu.h"
 #include "kernel/sleeplock.h"
@@ -14,17 +15,21 @@
 
 static char g_memory[NUMBER_OF_PAGES][PGSIZE] = {0};
 static int g_availability_index[NUMBER_OF_PAGES];
+static uint g_free_pages = 0;
 static int g_expect_panic = 0;
 static int g_expect_panic_is_child = 0;
+static struct cgroup *g_cgroup = 0;
 
 void init_mocks_environment() {
   g_expect_panic = 0;
   g_expect_panic_is_child = 0;
+  g_cgroup = 0;
 
   // setup memory
   for (int i = 0; i < NUMBER_OF_PAGES; i++) {
     g_availability_index[i] = 1;
   }
+  g_free_pages = NUMBER_OF_PAGES;
 }
 
 int is_panic_handler_process() { return g_expect_panic_is_child; }
@@ -101,6 +106,22 @@ void releasesleep(struct sleeplock *lk) {
 
 int holdingsleep(struct sleeplock *lk) { return lk->locked; }
 
+void initrwsleeplock(struct rwsleeplock *lk, char *name) {
+  // NOTE: no need in locks in tests as we run them in a single thread
+  lk->readers = 0;
+  lk->writer = 0;
+}
+
+void acquirereadsleep(struct rwsleeplock *lk) { lk->readers++; }
+
+void releasereadsleep(struct rwsleeplock *lk) { lk->readers--; }
+
+void acquirewritesleep(struct rwsleeplock *lk) { lk->writer = 1; }
+
+void releasewritesleep(struct rwsleeplock *lk) { lk->writer = 0; }
+
+int holdingrwsleep(struct rwsleeplock *lk) { return lk->writer; }
+
 void initlock(struct spinlock *lk, char *name) {
   // NOTE: no need in locks in tests as we run them in a single thread
   lk->name = name;
@@ -120,16 +141,39 @@ int holding(struct spinlock *lk) {
 
 void release(struct spinlock *lk) { lk->locked = 0; }
 
-struct cgroup *proc_get_cgroup(void) { return 0; }
+void set_mock_cgroup(struct cgroup *cgroup) { g_cgroup = cgroup; }
+
+struct cgroup *proc_get_cgroup(void) { return g_cgroup; }
+
+void cgroup_mem_charge_file(struct cgroup *cgroup) {
+  for (; cgroup != 0; cgroup = cgroup->parent) {
+    cgroup->current_mem += BSIZE;
+    cgroup->mem_stat_file += BSIZE;
+  }
+}
+
+void cgroup_mem_uncharge_file(struct cgroup *cgroup) {
+  for (; cgroup != 0; cgroup = cgroup->parent) {
+    cgroup->current_mem -= BSIZE;
+    cgroup->mem_stat_file -= BSIZE;
+  }
+}
 
 void cgroup_mem_stat_pgfault_incr(struct cgroup *cgroup) {}
 
 void cgroup_mem_stat_pgmajfault_incr(struct cgroup *cgroup) {}
 
+void cgroup_mem_stat_file_dirty_incr(struct cgroup *cgroup) {}
+
+void cgroup_mem_stat_file_dirty_decr(struct cgroup *cgroup) {}
+
+void cgroup_mem_stat_file_dirty_aggregated_incr(struct cgroup *cgroup) {}
+
 char *kalloc() {
   for (int i = 0; i < NUMBER_OF_PAGES; i++) {
     if (g_availability_index[i] == 1) {
       g_availability_index[i] = 0;
+      g_free_pages--;
       return g_memory[i];
     }
   }
@@ -139,11 +183,15 @@ char *kalloc() {
 void kfree(char *ptr) {
   for (int i = 0; i < NUMBER_OF_PAGES; i++) {
     if (ptr == &g_memory[i][0]) {
-      g_availability_index[i] = 0;
+      g_availability_index[i] = 1;
+      g_free_pages++;
+      return;
     }
   }
 }
 
+uint get_total_memory() { return g_free_pages; }
+
 void cprintf(char *format, ...) {
   va_list args;
   va_start(args, format);
@@ -3,8 +3,13 @@
 
 #define NUMBER_OF_PAGES 10000
 
+struct cgroup;
+
 void init_mocks_environment();
 
+/* The cgroup of the current process, 0 by default. */
+void set_mock_cgroup(struct cgroup *cgroup);
+
 void start_expect_panic(void);
 
 void stop_expect_panic(void);
@@ -12,6 +12,7 @@
 
 // API BEING TESTED
 vector newvector(unsigned int size, unsigned int typesize);
+vector vectorofbuffer(char* buffer, unsigned int size, unsigned int typesize);
 void freevector(vector* v);
 void memmove_into_vector_bytes(vector dstvec, unsigned int dstbyteoffset,
                                char* src, unsigned int size);
@@ -106,6 +107,28 @@ TEST(test_move_elements_with_offset) {
   }
 }
 
+TEST(test_vector_of_buffer) {
+  char buffer[9] = {0};
+  vector v = vectorofbuffer(buffer, 4, 2);
+  ASSERT_TRUE(v.valid);
+
+  // The bytes out of the vector are dropped.
+  memmove_into_vector_bytes(v, 2, "abcdefghij", 10);
+  ASSERT_TRUE(!memcmp(buffer, "\0\0abcdef\0", 9));
+
+  *getelementpointer(v, 0) = 'x';
+  ASSERT_TRUE(buffer[0] == 'x');
+
+  char str[5] = {0};
+  memmove_from_vector(str, v, 1, 2);
+  ASSERT_TRUE(!strcmp(str, "abcd"));
+
+  // The buffer is not freed.
+  freevector(&v);
+  ASSERT_TRUE(!v.valid);
+  ASSERT_TRUE(!memcmp(buffer, "x\0abcdef", 8));
+}
+
 // Should be called before each test
 void init_test() { init_mocks_environment(); }
 
@@ -120,6 +143,7 @@ int main() {
   run_test(test_move_bytes_with_offset);
   run_test(test_move_elements);
   run_test(test_move_elements_with_offset);
+  run_test(test_vector_of_buffer);
 
   PRINT_TESTS_RESULT("KVECTOR_TESTS");
   return CURRENT_TESTS_RESULT();
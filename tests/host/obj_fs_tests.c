@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include "common_mocks.h"
 #include "framework/test.h"
@@ -9,7 +10,9 @@
 #include "kernel/device/buf_cache.h"
 #include "kernel/device/device.h"
 #include "kernel/device/obj_cache.h"
+#include "kernel/device/obj_checksum.h"
 #include "kernel/device/obj_disk.h"
+#include "kernel/device/obj_queue.h"
 #include "param.h"
 
 struct device mock_device = {
@@ -22,8 +25,52 @@ struct device mock_device = {
 
 #define TESTED_DEVICE (&mock_device)
 
+struct dev_holder_s dev_holder;
+
+void deviceget(struct device* dev) {}
 void deviceput(struct device* dev) {}
 
+uint ticks;
+struct spinlock tickslock;
+
+// The timer is mocked by letting a tick pass whenever a process sleeps.
+void sleep(void* chan, struct spinlock* lk) {
+  ticks++;
+  obj_queue_intr();
+}
+
+void wakeup(void* chan) {}
+
+/**
+ * Block device mock, the blocks are kept in an array.
+ */
+#define MOCK_BLOCK_DEVICE_BLOCKS 64
+
+struct device mock_block_device = {
+    .id = 2,
+    .type = DEVICE_TYPE_IDE,
+    .private = NULL,
+    .ref = 1,
+    .ops = NULL,
+};
+
+static char mock_block_device_data[MOCK_BLOCK_DEVICE_BLOCKS * BSIZE];
+
+struct buf* bread(const struct device* const dev, uint blockno) {
+  union buf_id id = {.blockno = blockno};
+  struct buf* b = buf_cache_get(dev, &id, 0);
+
+  if ((b->flags & B_VALID) == 0) {
+    memmove(b->data, mock_block_device_data + blockno * BSIZE, BSIZE);
+    b->flags |= B_VALID;
+  }
+  return b;
+}
+
+void bwrite(struct buf* b) {
+  memmove(mock_block_device_data + b->id.blockno * BSIZE, b->data, BSIZE);
+}
+
 /**
  * Utility test functions
  */
@@ -420,6 +467,30 @@ TEST(reusing_freed_space) {
   freevector(&bufs_vec);
 }
 
+/**
+ * Validates that freed neighbour extents are merged, so an object larger than
+ * each of them is placed in the merged space.
+ */
+TEST(coalescing_freed_space) {
+  const uint object_size = 1000;
+  struct buf bufs[SIZE_TO_NUM_OF_BUFS(2 * object_size)];
+  vector bufs_vec = new_bufs_vector(bufs, ARRAY_LEN(bufs));
+
+  ASSERT_NO_ERR(add_object(TESTED_DEVICE, "coalesce 1", bufs_vec, object_size));
+  ASSERT_NO_ERR(add_object(TESTED_DEVICE, "coalesce 2", bufs_vec, object_size));
+  ASSERT_NO_ERR(add_object(TESTED_DEVICE, "coalesce 3", bufs_vec, object_size));
+  uint obj_2_offset = find_object_offset("coalesce 2");
+  ASSERT_UINT_EQ(obj_2_offset + object_size, find_object_offset("coalesce 1"));
+
+  ASSERT_NO_ERR(delete_object(TESTED_DEVICE, "coalesce 1"));
+  ASSERT_NO_ERR(delete_object(TESTED_DEVICE, "coalesce 2"));
+  ASSERT_NO_ERR(
+      add_object(TESTED_DEVICE, "coalesce 4", bufs_vec, 2 * object_size));
+  ASSERT_UINT_EQ(obj_2_offset, find_object_offset("coalesce 4"));
+
+  freevector(&bufs_vec);
+}
+
 TEST(add_when_there_is_no_more_disk_left) {
   struct buf bufs[1];
   vector bufs_vec = new_bufs_vector(bufs, ARRAY_LEN(bufs));
@@ -429,6 +500,850 @@ TEST(add_when_there_is_no_more_disk_left) {
                             STORAGE_DEVICE_SIZE + 1));
 }
 
+TEST(get_range_of_object) {
+  const uint object_size = 3000;
+  char data[3000];
+  char actual[BUF_DATA_SIZE];
+  struct buf bufs[SIZE_TO_NUM_OF_BUFS(object_size)];
+  vector bufs_vec = new_bufs_vector(bufs, ARRAY_LEN(bufs));
+  vector range_vec = new_bufs_vector(bufs, 1);
+
+  for (uint i = 0; i < object_size; i++) {
+    data[i] = i % 251;
+  }
+  copy_buffer_to_bufs_vector(bufs_vec, data, object_size);
+  ASSERT_NO_ERR(add_object(TESTED_DEVICE, "range", bufs_vec, object_size));
+
+  memset(bufs, 0, sizeof(bufs));
+  ASSERT_NO_ERR(get_object_range(TESTED_DEVICE, "range", 1500,
+                                 BUF_DATA_SIZE, range_vec));
+  copy_bufs_vector_to_buffer(actual, range_vec, BUF_DATA_SIZE);
+  ASSERT_UINT_EQ(0, memcmp(actual, data + 1500, BUF_DATA_SIZE));
+  ASSERT_FALSE(bufs[1].flags & B_VALID);
+
+  ASSERT_UINT_EQ(BUFFER_TOO_SMALL,
+                 get_object_range(TESTED_DEVICE, "range", 0,
+                                  BUF_DATA_SIZE + 1, range_vec));
+  ASSERT_UINT_EQ(RANGE_OUT_OF_OBJECT,
+                 get_object_range(TESTED_DEVICE, "range", object_size - 10,
+                                  11, range_vec));
+
+  freevector(&range_vec);
+  freevector(&bufs_vec);
+}
+
+TEST(write_range_of_object) {
+  const uint initial_size = 3000;
+  const uint range_offset = 2500, range_size = 1000;
+  char data[3500];
+  char actual[3500];
+  struct buf bufs[SIZE_TO_NUM_OF_BUFS(sizeof(data))];
+  vector bufs_vec = new_bufs_vector(bufs, ARRAY_LEN(bufs));
+
+  memset(data, 'a', initial_size);
+  copy_buffer_to_bufs_vector(bufs_vec, data, initial_size);
+  ASSERT_NO_ERR(add_object(TESTED_DEVICE, "range", bufs_vec, initial_size));
+  // Push the object to move when it grows.
+  ASSERT_NO_ERR(add_object(TESTED_DEVICE, "after range", bufs_vec, 1));
+
+  // Rewrite the tail and grow the object.
+  memset(data + range_offset, 'b', range_size);
+  copy_buffer_to_bufs_vector(bufs_vec, data + range_offset, range_size);
+  ASSERT_NO_ERR(write_object_range(TESTED_DEVICE, "range", range_offset,
+                                   range_size, bufs_vec));
+
+  uint size;
+  ASSERT_NO_ERR(object_size(TESTED_DEVICE, "range", &size));
+  ASSERT_UINT_EQ(range_offset + range_size, size);
+  ASSERT_NO_ERR(get_object(TESTED_DEVICE, "range", bufs_vec));
+  copy_bufs_vector_to_buffer(actual, bufs_vec, size);
+  ASSERT_UINT_EQ(0, memcmp(actual, data, size));
+
+  ASSERT_UINT_EQ(RANGE_OUT_OF_OBJECT,
+                 write_object_range(TESTED_DEVICE, "range", size + 1, 1,
+                                    bufs_vec));
+
+  freevector(&bufs_vec);
+}
+
+// Returns whether the first `size` bytes of the object are all `c`.
+static uint object_filled_with(const char* object_name, vector bufs, char c,
+                               uint size) {
+  char data[3000];
+
+  vector_bufs_memset(bufs, 0, size);
+  if (get_object(TESTED_DEVICE, object_name, bufs) != NO_ERR) {
+    return 0;
+  }
+  copy_bufs_vector_to_buffer(data, bufs, size);
+  for (uint i = 0; i < size; i++) {
+    if (data[i] != c) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+TEST(compacting_in_slices) {
+  const uint object_size = 1000;
+  const char* objects_name[4] = {"compact 1", "compact 2", "compact 3",
+                                 "compact 4"};
+  struct buf bufs[SIZE_TO_NUM_OF_BUFS(object_size)];
+  vector bufs_vec = new_bufs_vector(bufs, ARRAY_LEN(bufs));
+  struct obj_device_private* device = dev_private(TESTED_DEVICE);
+  struct obj_fragmentation_stats stats;
+
+  for (uint i = 0; i < 4; ++i) {
+    vector_bufs_memset(bufs_vec, 'a' + i, object_size);
+    ASSERT_NO_ERR(
+        add_object(TESTED_DEVICE, objects_name[i], bufs_vec, object_size));
+  }
+  ASSERT_NO_ERR(delete_object(TESTED_DEVICE, "compact 1"));
+  ASSERT_NO_ERR(delete_object(TESTED_DEVICE, "compact 3"));
+
+  fragmentation_stats(device, &stats);
+  ASSERT_UINT_EQ(2, stats.holes);
+  ASSERT_UINT_EQ(device_size(device) - occupied_bytes(device),
+                 stats.free_bytes);
+  ASSERT_UINT_EQ(stats.free_bytes - 2 * object_size,
+                 stats.largest_free_extent);
+
+  // With a slice of a single object, each call moves one of the remaining.
+  ASSERT_UINT_EQ(0, compact_objects(TESTED_DEVICE, 1));
+  ASSERT_UINT_EQ(STORAGE_DEVICE_SIZE - object_size,
+                 find_object_offset("compact 2"));
+  ASSERT_UINT_EQ(1, compact_objects(TESTED_DEVICE, 1));
+
+  fragmentation_stats(device, &stats);
+  ASSERT_UINT_EQ(0, stats.holes);
+  ASSERT_UINT_EQ(stats.free_bytes, stats.largest_free_extent);
+  ASSERT_UINT_EQ(STORAGE_DEVICE_SIZE - object_size,
+                 find_object_offset("compact 2"));
+  ASSERT_UINT_EQ(STORAGE_DEVICE_SIZE - 2 * object_size,
+                 find_object_offset("compact 4"));
+  ASSERT_TRUE(object_filled_with("compact 2", bufs_vec, 'b', object_size));
+  ASSERT_TRUE(object_filled_with("compact 4", bufs_vec, 'd', object_size));
+
+  freevector(&bufs_vec);
+}
+
+TEST(add_to_fragmented_disk) {
+  const uint object_size = 1000;
+  const char* objects_name[4] = {"fragmented 1", "fragmented 2",
+                                 "fragmented 3", "fragmented 4"};
+  struct buf bufs[SIZE_TO_NUM_OF_BUFS(3 * object_size)];
+  vector bufs_vec = new_bufs_vector(bufs, ARRAY_LEN(bufs));
+  struct obj_device_private* device = dev_private(TESTED_DEVICE);
+  struct obj_fragmentation_stats stats;
+
+  for (uint i = 0; i < 4; ++i) {
+    vector_bufs_memset(bufs_vec, 'a' + i, object_size);
+    ASSERT_NO_ERR(
+        add_object(TESTED_DEVICE, objects_name[i], bufs_vec, object_size));
+  }
+  // Leave only a small gap before the first object.
+  fragmentation_stats(device, &stats);
+  vector free_vec = newvector(SIZE_TO_NUM_OF_BUFS(stats.free_bytes),
+                              sizeof(struct buf*));
+  struct buf* filler_bufs =
+      malloc(SIZE_TO_NUM_OF_BUFS(stats.free_bytes) * sizeof(struct buf));
+  ASSERT_TRUE(NULL != filler_bufs);
+  for (uint i = 0; i < free_vec.vectorsize; i++) {
+    struct buf* current_buf = filler_bufs + i;
+    memmove_into_vector_elements(free_vec, i, (char*)&current_buf, 1);
+  }
+  ASSERT_NO_ERR(add_object(TESTED_DEVICE, "filler", free_vec,
+                           stats.largest_free_extent - object_size / 2));
+  ASSERT_NO_ERR(delete_object(TESTED_DEVICE, "fragmented 1"));
+  ASSERT_NO_ERR(delete_object(TESTED_DEVICE, "fragmented 3"));
+
+  // No free extent fits the new object until the holes are gathered.
+  fragmentation_stats(device, &stats);
+  ASSERT_TRUE(stats.largest_free_extent < 2 * object_size);
+  vector_bufs_memset(bufs_vec, 'e', 2 * object_size);
+  ASSERT_NO_ERR(
+      add_object(TESTED_DEVICE, "fragmented 5", bufs_vec, 2 * object_size));
+
+  // Growing an object gathers the holes as well.
+  ASSERT_NO_ERR(delete_object(TESTED_DEVICE, "fragmented 4"));
+  vector_bufs_memset(bufs_vec, 'f', 3 * object_size);
+  ASSERT_NO_ERR(write_object(TESTED_DEVICE, "fragmented 5", bufs_vec,
+                             3 * object_size));
+
+  ASSERT_TRUE(object_filled_with("fragmented 2", bufs_vec, 'b', object_size));
+  ASSERT_TRUE(
+      object_filled_with("fragmented 5", bufs_vec, 'f', 3 * object_size));
+
+  freevector(&free_vec);
+  free(filler_bufs);
+  freevector(&bufs_vec);
+}
+
+static ulong elapsed_ns(const struct timespec* start,
+                        const struct timespec* end) {
+  return (end->tv_sec - start->tv_sec) * 1000000000ul + end->tv_nsec -
+         start->tv_nsec;
+}
+
+/**
+ * Writes an empty store to the block device mock, like `mkfs_objfs` does.
+ */
+static void format_mock_block_device(void) {
+  struct objsuperblock sb = {0};
+  objects_table_entry* table =
+      (objects_table_entry*)(mock_block_device_data + sizeof(sb));
+
+  memset(mock_block_device_data, 0, sizeof(mock_block_device_data));
+  sb.magic = OBJ_FS_MAGIC;
+  sb.storage_device_size = sizeof(mock_block_device_data);
+  sb.objects_table_offset = sizeof(sb);
+  sb.store_offset = sizeof(sb) + initial_objects_table_bytes;
+  sb.bytes_occupied = sizeof(sb) + initial_objects_table_bytes;
+  sb.occupied_objects = 2;
+  sb.last_inode = 2;
+  memmove(mock_block_device_data, &sb, sizeof(sb));
+
+  strcpy(table[0].object_id, SUPER_BLOCK_ID);
+  table[0].size = sizeof(sb);
+  table[0].occupied = 1;
+  strcpy(table[1].object_id, OBJECT_TABLE_ID);
+  table[1].disk_offset = sizeof(sb);
+  table[1].size = initial_objects_table_bytes;
+  table[1].occupied = 1;
+}
+
+TEST(load_unformatted_block_device) {
+  struct device dev = {.id = 3, .type = DEVICE_TYPE_OBJ, .ref = 1};
+
+  memset(mock_block_device_data, 0, sizeof(mock_block_device_data));
+  ASSERT_UINT_EQ(BAD_SUPER_BLOCK, load_obj_device(&dev, &mock_block_device));
+}
+
+TEST(objects_persist_on_block_device) {
+  struct device dev = {.id = 3, .type = DEVICE_TYPE_OBJ, .ref = 1};
+  char data[3500];
+  char actual[3500];
+  struct buf bufs[SIZE_TO_NUM_OF_BUFS(sizeof(data))];
+  vector bufs_vec = new_bufs_vector(bufs, ARRAY_LEN(bufs));
+  uint size;
+
+  format_mock_block_device();
+  ASSERT_NO_ERR(load_obj_device(&dev, &mock_block_device));
+  ASSERT_UINT_EQ(sizeof(mock_block_device_data),
+                 device_size(dev_private(&dev)));
+
+  memset(data, 'a', 3000);
+  copy_buffer_to_bufs_vector(bufs_vec, data, 3000);
+  ASSERT_NO_ERR(add_object(&dev, "persistent", bufs_vec, 3000));
+  ASSERT_NO_ERR(add_object(&dev, "deleted", bufs_vec, 100));
+  ASSERT_NO_ERR(add_object(&dev, "moved", bufs_vec, 3000));
+  // Grow the first object, then make the compaction slide the last one over
+  // its own extent.
+  memset(data + 2500, 'b', 1000);
+  copy_buffer_to_bufs_vector(bufs_vec, data + 2500, 1000);
+  ASSERT_NO_ERR(write_object_range(&dev, "persistent", 2500, 1000, bufs_vec));
+  ASSERT_NO_ERR(delete_object(&dev, "deleted"));
+  ASSERT_UINT_EQ(1, compact_objects(&dev, COMPACTION_SLICE_OBJECTS));
+  dev.ops->destroy(&dev);
+  buf_cache_invalidate_blocks(&mock_block_device);
+
+  ASSERT_NO_ERR(load_obj_device(&dev, &mock_block_device));
+  ASSERT_UINT_EQ(4, occupied_objects(dev_private(&dev)));
+  ASSERT_UINT_EQ(OBJECT_NOT_EXISTS, object_size(&dev, "deleted", &size));
+  ASSERT_NO_ERR(object_size(&dev, "persistent", &size));
+  ASSERT_UINT_EQ(3500, size);
+  ASSERT_NO_ERR(get_object(&dev, "persistent", bufs_vec));
+  copy_bufs_vector_to_buffer(actual, bufs_vec, size);
+  ASSERT_UINT_EQ(0, memcmp(actual, data, size));
+  ASSERT_NO_ERR(get_object(&dev, "moved", bufs_vec));
+  copy_bufs_vector_to_buffer(actual, bufs_vec, 3000);
+  memset(data, 'a', 3000);
+  ASSERT_UINT_EQ(0, memcmp(actual, data, 3000));
+  dev.ops->destroy(&dev);
+
+  freevector(&bufs_vec);
+}
+
+TEST(dedup_identical_objects) {
+  const uint object_size = 2000;
+  struct buf bufs[SIZE_TO_NUM_OF_BUFS(object_size)];
+  vector bufs_vec = new_bufs_vector(bufs, ARRAY_LEN(bufs));
+  struct obj_device_private* device = dev_private(&mock_device);
+  uint occupied = occupied_bytes(device);
+
+  set_objects_dedup(device, 1);
+  vector_bufs_memset(bufs_vec, 'd', object_size);
+  ASSERT_NO_ERR(add_object(TESTED_DEVICE, "first", bufs_vec, object_size));
+  ASSERT_NO_ERR(add_object(TESTED_DEVICE, "second", bufs_vec, object_size));
+  ASSERT_NO_ERR(add_object(TESTED_DEVICE, "third", bufs_vec, object_size));
+  ASSERT_UINT_EQ(occupied + object_size, occupied_bytes(device));
+  ASSERT_UINT_EQ(2 * object_size, shared_bytes(device));
+
+  // The object holding the content hands it over when deleted
+  ASSERT_NO_ERR(delete_object(TESTED_DEVICE, "first"));
+  ASSERT_TRUE(object_filled_with("second", bufs_vec, 'd', object_size));
+  ASSERT_TRUE(object_filled_with("third", bufs_vec, 'd', object_size));
+  ASSERT_UINT_EQ(occupied + object_size, occupied_bytes(device));
+  ASSERT_UINT_EQ(object_size, shared_bytes(device));
+
+  ASSERT_NO_ERR(delete_object(TESTED_DEVICE, "second"));
+  ASSERT_NO_ERR(delete_object(TESTED_DEVICE, "third"));
+  ASSERT_UINT_EQ(occupied, occupied_bytes(device));
+  ASSERT_UINT_EQ(0, shared_bytes(device));
+
+  freevector(&bufs_vec);
+}
+
+TEST(dedup_copy_on_write) {
+  const uint object_size = 2000;
+  char data[2000];
+  struct buf bufs[SIZE_TO_NUM_OF_BUFS(object_size)];
+  vector bufs_vec = new_bufs_vector(bufs, ARRAY_LEN(bufs));
+  struct obj_device_private* device = dev_private(&mock_device);
+  uint occupied = occupied_bytes(device);
+
+  set_objects_dedup(device, 1);
+  vector_bufs_memset(bufs_vec, 'o', object_size);
+  ASSERT_NO_ERR(add_object(TESTED_DEVICE, "original", bufs_vec, object_size));
+  ASSERT_NO_ERR(add_object(TESTED_DEVICE, "copy", bufs_vec, object_size));
+  ASSERT_UINT_EQ(object_size, shared_bytes(device));
+
+  // A write to the shared content is done on a private copy
+  vector_bufs_memset(bufs_vec, 'w', 10);
+  ASSERT_NO_ERR(write_object_range(TESTED_DEVICE, "copy", 100, 10, bufs_vec));
+  ASSERT_TRUE(object_filled_with("original", bufs_vec, 'o', object_size));
+  ASSERT_NO_ERR(get_object(TESTED_DEVICE, "copy", bufs_vec));
+  copy_bufs_vector_to_buffer(data, bufs_vec, object_size);
+  for (uint i = 0; i < object_size; i++) {
+    ASSERT_UINT_EQ((100 <= i && i < 110) ? 'w' : 'o', data[i]);
+  }
+  ASSERT_UINT_EQ(occupied + 2 * object_size, occupied_bytes(device));
+  ASSERT_UINT_EQ(0, shared_bytes(device));
+
+  // Writing the original content back shares it again
+  vector_bufs_memset(bufs_vec, 'o', 10);
+  ASSERT_NO_ERR(write_object_range(TESTED_DEVICE, "copy", 100, 10, bufs_vec));
+  ASSERT_UINT_EQ(occupied + object_size, occupied_bytes(device));
+  ASSERT_UINT_EQ(object_size, shared_bytes(device));
+
+  // The content is handed over when the object holding it is rewritten
+  vector_bufs_memset(bufs_vec, 'r', object_size);
+  ASSERT_NO_ERR(write_object(TESTED_DEVICE, "original", bufs_vec, object_size));
+  ASSERT_TRUE(object_filled_with("copy", bufs_vec, 'o', object_size));
+  ASSERT_TRUE(object_filled_with("original", bufs_vec, 'r', object_size));
+  ASSERT_UINT_EQ(0, shared_bytes(device));
+
+  freevector(&bufs_vec);
+}
+
+TEST(dedup_persists_on_block_device) {
+  struct device dev = {.id = 3, .type = DEVICE_TYPE_OBJ, .ref = 1};
+  const uint object_size = 3000;
+  struct buf bufs[SIZE_TO_NUM_OF_BUFS(object_size)];
+  vector bufs_vec = new_bufs_vector(bufs, ARRAY_LEN(bufs));
+
+  format_mock_block_device();
+  ASSERT_NO_ERR(load_obj_device(&dev, &mock_block_device));
+  set_objects_dedup(dev_private(&dev), 1);
+  vector_bufs_memset(bufs_vec, 'p', object_size);
+  ASSERT_NO_ERR(add_object(&dev, "first", bufs_vec, object_size));
+  ASSERT_NO_ERR(add_object(&dev, "second", bufs_vec, object_size));
+  dev.ops->destroy(&dev);
+  buf_cache_invalidate_blocks(&mock_block_device);
+
+  ASSERT_NO_ERR(load_obj_device(&dev, &mock_block_device));
+  ASSERT_UINT_EQ(object_size, shared_bytes(dev_private(&dev)));
+  // The content index is rebuilt, new copies are shared as well
+  ASSERT_NO_ERR(add_object(&dev, "third", bufs_vec, object_size));
+  ASSERT_UINT_EQ(2 * object_size, shared_bytes(dev_private(&dev)));
+  ASSERT_NO_ERR(delete_object(&dev, "first"));
+  ASSERT_NO_ERR(get_object(&dev, "third", bufs_vec));
+  for (uint i = 0; i < ARRAY_LEN(bufs); i++) {
+    ASSERT_UINT_EQ('p', bufs[i].data[0]);
+  }
+  dev.ops->destroy(&dev);
+
+  freevector(&bufs_vec);
+}
+
+// Fills `data` with text-like content, lines of a few words and numbers.
+static void fill_text(char* data, uint size, uint seed) {
+  static const char* const words[] = {"inode",  "block", "extent", "object",
+                                      "cache",  "table", "device", "write"};
+  char line[64];
+
+  for (uint pos = 0; pos < size;) {
+    uint bytes =
+        snprintf(line, sizeof(line), "%s %s %u\n",
+                 words[rand_r(&seed) % ARRAY_LEN(words)],
+                 words[rand_r(&seed) % ARRAY_LEN(words)], rand_r(&seed) % 100);
+    bytes = min(bytes, size - pos);
+    memmove(data + pos, line, bytes);
+    pos += bytes;
+  }
+}
+
+// Returns whether the object holds exactly the `size` bytes of `expected`.
+static uint object_holds(struct device* dev, const char* object_name,
+                         vector bufs, const char* expected, uint size) {
+  static char actual[4096];
+  uint object_size_value;
+
+  if (object_size(dev, object_name, &object_size_value) != NO_ERR ||
+      object_size_value != size ||
+      get_object(dev, object_name, bufs) != NO_ERR) {
+    return 0;
+  }
+  copy_bufs_vector_to_buffer(actual, bufs, size);
+  return memcmp(actual, expected, size) == 0;
+}
+
+TEST(compress_small_objects) {
+  const uint object_size = 2000;
+  char data[3000];
+  char range[100];
+  struct buf bufs[SIZE_TO_NUM_OF_BUFS(sizeof(data))];
+  vector bufs_vec = new_bufs_vector(bufs, ARRAY_LEN(bufs));
+  struct obj_device_private* device = dev_private(&mock_device);
+  uint occupied = occupied_bytes(device);
+  uint seed = 7;
+
+  set_objects_compression(device, 1);
+  fill_text(data, object_size, 1);
+  copy_buffer_to_bufs_vector(bufs_vec, data, object_size);
+  ASSERT_NO_ERR(add_object(TESTED_DEVICE, "text", bufs_vec, object_size));
+  ASSERT_TRUE(occupied_bytes(device) < occupied + object_size / 2);
+  ASSERT_TRUE(
+      object_holds(TESTED_DEVICE, "text", bufs_vec, data, object_size));
+  ASSERT_NO_ERR(get_object_range(TESTED_DEVICE, "text", 1000, 100, bufs_vec));
+  copy_bufs_vector_to_buffer(range, bufs_vec, 100);
+  ASSERT_UINT_EQ(0, memcmp(range, data + 1000, 100));
+
+  // Content which doesn't shrink is stored raw
+  for (uint i = 0; i < object_size; i++) {
+    data[i] = rand_r(&seed);
+  }
+  copy_buffer_to_bufs_vector(bufs_vec, data, object_size);
+  occupied = occupied_bytes(device);
+  ASSERT_NO_ERR(add_object(TESTED_DEVICE, "random", bufs_vec, object_size));
+  ASSERT_UINT_EQ(occupied + object_size, occupied_bytes(device));
+  ASSERT_TRUE(
+      object_holds(TESTED_DEVICE, "random", bufs_vec, data, object_size));
+
+  // A range write patches the compressed content
+  fill_text(data, object_size, 1);
+  memset(data + 500, 'w', 100);
+  copy_buffer_to_bufs_vector(bufs_vec, data + 500, 100);
+  ASSERT_NO_ERR(write_object_range(TESTED_DEVICE, "text", 500, 100, bufs_vec));
+  ASSERT_TRUE(
+      object_holds(TESTED_DEVICE, "text", bufs_vec, data, object_size));
+
+  // Growing beyond the compression limit stores the object raw
+  occupied = occupied_bytes(device);
+  fill_text(data + object_size, 1000, 2);
+  copy_buffer_to_bufs_vector(bufs_vec, data + object_size, 1000);
+  ASSERT_NO_ERR(
+      write_object_range(TESTED_DEVICE, "text", object_size, 1000, bufs_vec));
+  ASSERT_TRUE(occupied_bytes(device) > occupied + object_size);
+  ASSERT_TRUE(object_holds(TESTED_DEVICE, "text", bufs_vec, data, 3000));
+
+  // Objects written while the compression is off are stored raw
+  set_objects_compression(device, 0);
+  occupied = occupied_bytes(device);
+  copy_buffer_to_bufs_vector(bufs_vec, data, object_size);
+  ASSERT_NO_ERR(add_object(TESTED_DEVICE, "raw", bufs_vec, object_size));
+  ASSERT_UINT_EQ(occupied + object_size, occupied_bytes(device));
+
+  freevector(&bufs_vec);
+}
+
+TEST(compression_persists_on_block_device) {
+  struct device dev = {.id = 3, .type = DEVICE_TYPE_OBJ, .ref = 1};
+  const uint object_size = 1500;
+  char data[1500];
+  struct buf bufs[SIZE_TO_NUM_OF_BUFS(object_size)];
+  vector bufs_vec = new_bufs_vector(bufs, ARRAY_LEN(bufs));
+  uint occupied;
+
+  format_mock_block_device();
+  ASSERT_NO_ERR(load_obj_device(&dev, &mock_block_device));
+  set_objects_compression(dev_private(&dev), 1);
+  fill_text(data, object_size, 3);
+  copy_buffer_to_bufs_vector(bufs_vec, data, object_size);
+  ASSERT_NO_ERR(add_object(&dev, "compressed", bufs_vec, object_size));
+  occupied = occupied_bytes(dev_private(&dev));
+  dev.ops->destroy(&dev);
+  buf_cache_invalidate_blocks(&mock_block_device);
+
+  ASSERT_NO_ERR(load_obj_device(&dev, &mock_block_device));
+  ASSERT_UINT_EQ(occupied, occupied_bytes(dev_private(&dev)));
+  ASSERT_TRUE(object_holds(&dev, "compressed", bufs_vec, data, object_size));
+  // The device keeps compressing the objects written after the load
+  ASSERT_NO_ERR(add_object(&dev, "after_load", bufs_vec, object_size));
+  ASSERT_TRUE(occupied_bytes(dev_private(&dev)) < occupied + object_size);
+  ASSERT_TRUE(object_holds(&dev, "after_load", bufs_vec, data, object_size));
+  dev.ops->destroy(&dev);
+
+  freevector(&bufs_vec);
+}
+
+TEST(clone_shares_snapshot_objects) {
+  struct device snapshot = {.id = 3, .type = DEVICE_TYPE_OBJ, .ref = 1};
+  struct device clone = {.id = 4, .type = DEVICE_TYPE_OBJ, .ref = 1};
+  const uint raw_size = 3000;
+  char data[3000];
+  struct buf bufs[SIZE_TO_NUM_OF_BUFS(raw_size)];
+  vector bufs_vec = new_bufs_vector(bufs, ARRAY_LEN(bufs));
+  uint size;
+
+  format_mock_block_device();
+  ASSERT_NO_ERR(load_obj_device(&snapshot, &mock_block_device));
+  set_objects_compression(dev_private(&snapshot), 1);
+  memset(data, 's', raw_size);
+  copy_buffer_to_bufs_vector(bufs_vec, data, raw_size);
+  ASSERT_NO_ERR(add_object(&snapshot, "raw", bufs_vec, raw_size));
+  fill_text(data, 1500, 4);
+  copy_buffer_to_bufs_vector(bufs_vec, data, 1500);
+  ASSERT_NO_ERR(add_object(&snapshot, "compressed", bufs_vec, 1500));
+  ASSERT_NO_ERR(add_object(&snapshot, "deleted", bufs_vec, 100));
+
+  freeze_obj_device(&snapshot);
+  ASSERT_UINT_EQ(DEVICE_FROZEN,
+                 add_object(&snapshot, "frozen", bufs_vec, 100));
+  ASSERT_UINT_EQ(DEVICE_FROZEN,
+                 write_object(&snapshot, "raw", bufs_vec, 100));
+  ASSERT_UINT_EQ(DEVICE_FROZEN, delete_object(&snapshot, "deleted"));
+
+  // The clone holds no content until its objects are written
+  init_obj_clone_device(&clone, &snapshot);
+  struct obj_device_private* device = dev_private(&clone);
+  uint occupied = occupied_bytes(device);
+  ASSERT_UINT_EQ(device->sb.store_offset, occupied);
+  ASSERT_TRUE(object_holds(&clone, "compressed", bufs_vec, data, 1500));
+  memset(data, 's', raw_size);
+  ASSERT_TRUE(object_holds(&clone, "raw", bufs_vec, data, raw_size));
+
+  // Written objects are copied into the clone
+  memset(data + 1000, 'c', 10);
+  copy_buffer_to_bufs_vector(bufs_vec, data + 1000, 10);
+  ASSERT_NO_ERR(write_object_range(&clone, "raw", 1000, 10, bufs_vec));
+  ASSERT_UINT_EQ(occupied + raw_size, occupied_bytes(device));
+  ASSERT_TRUE(object_holds(&clone, "raw", bufs_vec, data, raw_size));
+  memset(data + 1000, 's', 10);
+  ASSERT_TRUE(object_holds(&snapshot, "raw", bufs_vec, data, raw_size));
+
+  fill_text(data, 1500, 4);
+  ASSERT_TRUE(object_holds(&snapshot, "compressed", bufs_vec, data, 1500));
+  memset(data, 'w', 10);
+  copy_buffer_to_bufs_vector(bufs_vec, data, 10);
+  ASSERT_NO_ERR(write_object_range(&clone, "compressed", 0, 10, bufs_vec));
+  ASSERT_TRUE(object_holds(&clone, "compressed", bufs_vec, data, 1500));
+  ASSERT_NO_ERR(get_object(&snapshot, "compressed", bufs_vec));
+  ASSERT_TRUE(bufs[0].data[0] != 'w');
+
+  // Deletes and additions don't reach the snapshot
+  occupied = occupied_bytes(device);
+  ASSERT_NO_ERR(delete_object(&clone, "deleted"));
+  ASSERT_UINT_EQ(occupied, occupied_bytes(device));
+  ASSERT_UINT_EQ(OBJECT_NOT_EXISTS, object_size(&clone, "deleted", &size));
+  ASSERT_NO_ERR(object_size(&snapshot, "deleted", &size));
+  copy_buffer_to_bufs_vector(bufs_vec, data, 10);
+  ASSERT_NO_ERR(add_object(&clone, "added", bufs_vec, 10));
+  ASSERT_UINT_EQ(OBJECT_NOT_EXISTS, object_size(&snapshot, "added", &size));
+  ASSERT_UINT_EQ(1, compact_objects(&clone, COMPACTION_SLICE_OBJECTS));
+  ASSERT_TRUE(object_holds(&clone, "added", bufs_vec, data, 10));
+
+  clone.ops->destroy(&clone);
+  snapshot.ops->destroy(&snapshot);
+
+  freevector(&bufs_vec);
+}
+
+TEST(crc32c_checksums) {
+  const char check[] = "123456789";
+  char data[3000];
+  char patched[3000];
+  uint seed = 11;
+
+  ASSERT_UINT_EQ(0xe3069283, obj_crc32c(0, check, 9));
+  ASSERT_UINT_EQ(0xe3069283, obj_crc32c(obj_crc32c(0, check, 4), check + 4, 5));
+  ASSERT_UINT_EQ(0, obj_crc32c(0, check, 0));
+
+  // Patching the checksum of a range gives the checksum of the patched data
+  for (uint round = 0; round < 100; round++) {
+    uint size = 1 + rand_r(&seed) % sizeof(data);
+    uint offset = rand_r(&seed) % size;
+    uint length = rand_r(&seed) % (size - offset + 1);
+    for (uint i = 0; i < size; i++) {
+      data[i] = rand_r(&seed);
+    }
+    memmove(patched, data, size);
+    for (uint i = offset; i < offset + length; i++) {
+      patched[i] = rand_r(&seed);
+    }
+    uint delta = obj_crc32c(0, data + offset, length) ^
+                 obj_crc32c(0, patched + offset, length);
+    ASSERT_UINT_EQ(obj_crc32c(0, patched, size),
+                   obj_crc32c_patch(obj_crc32c(0, data, size), delta,
+                                    size - offset - length));
+  }
+}
+
+TEST(checksums_detect_corruption) {
+  const uint object_size = 3000;
+  char data[3000];
+  struct buf bufs[SIZE_TO_NUM_OF_BUFS(object_size)];
+  vector bufs_vec = new_bufs_vector(bufs, ARRAY_LEN(bufs));
+  struct obj_device_private* device = dev_private(&mock_device);
+  char* storage = device->storage_holder->memory_storage;
+  uint cursor = 0;
+
+  fill_text(data, object_size, 5);
+  copy_buffer_to_bufs_vector(bufs_vec, data, object_size);
+  ASSERT_NO_ERR(add_object(TESTED_DEVICE, "raw", bufs_vec, object_size));
+  set_objects_compression(device, 1);
+  ASSERT_NO_ERR(add_object(TESTED_DEVICE, "compressed", bufs_vec, 1500));
+  ASSERT_UINT_EQ(1, scrub_objects(TESTED_DEVICE, &cursor,
+                                  OBJECTS_TABLE_MAX_ENTRIES));
+  ASSERT_UINT_EQ(0, checksum_errors(device));
+
+  // Flip a bit of each object in the store
+  storage[find_object_offset("raw") + 2500] ^= 1;
+  storage[find_object_offset("compressed") + 10] ^= 1;
+  ASSERT_UINT_EQ(CORRUPTED_OBJECT, get_object(TESTED_DEVICE, "raw", bufs_vec));
+  ASSERT_FALSE(bufs[0].flags & B_VALID);
+  // A range read verifies the whole object
+  ASSERT_UINT_EQ(CORRUPTED_OBJECT,
+                 get_object_range(TESTED_DEVICE, "raw", 0, 100, bufs_vec));
+  ASSERT_UINT_EQ(CORRUPTED_OBJECT, get_object_range(TESTED_DEVICE,
+                                                    "compressed", 0, 100,
+                                                    bufs_vec));
+  ASSERT_UINT_EQ(3, checksum_errors(device));
+
+  // The scrub finds both objects
+  cursor = 0;
+  while (!scrub_objects(TESTED_DEVICE, &cursor, 1)) {
+  }
+  ASSERT_UINT_EQ(5, checksum_errors(device));
+
+  // Without the verification, the corrupted content is read as it is
+  set_objects_verify(device, 0);
+  ASSERT_NO_ERR(get_object_range(TESTED_DEVICE, "raw", 2500, 1, bufs_vec));
+  ASSERT_TRUE((char)bufs[0].data[0] == (char)(data[2500] ^ 1));
+  set_objects_verify(device, 1);
+
+  // Rewriting the object fixes its checksum
+  copy_buffer_to_bufs_vector(bufs_vec, data, object_size);
+  ASSERT_NO_ERR(write_object(TESTED_DEVICE, "raw", bufs_vec, object_size));
+  ASSERT_TRUE(
+      object_holds(TESTED_DEVICE, "raw", bufs_vec, data, object_size));
+  ASSERT_UINT_EQ(5, checksum_errors(device));
+
+  freevector(&bufs_vec);
+}
+
+TEST(range_writes_keep_checksums) {
+  struct device dev = {.id = 3, .type = DEVICE_TYPE_OBJ, .ref = 1};
+  char data[4000];
+  struct buf bufs[SIZE_TO_NUM_OF_BUFS(sizeof(data))];
+  vector bufs_vec = new_bufs_vector(bufs, ARRAY_LEN(bufs));
+  uint size = 1000;
+  uint seed = 13;
+  uint cursor = 0;
+
+  format_mock_block_device();
+  ASSERT_NO_ERR(load_obj_device(&dev, &mock_block_device));
+  fill_text(data, size, 6);
+  copy_buffer_to_bufs_vector(bufs_vec, data, size);
+  ASSERT_NO_ERR(add_object(&dev, "object", bufs_vec, size));
+
+  // Overwrite, extend and append, the checksum is patched each time
+  for (uint round = 0; round < 50; round++) {
+    uint offset = rand_r(&seed) % size;
+    uint length = 1 + rand_r(&seed) % (sizeof(data) - offset);
+    fill_text(data + offset, length, round);
+    copy_buffer_to_bufs_vector(bufs_vec, data + offset, length);
+    ASSERT_NO_ERR(
+        write_object_range(&dev, "object", offset, length, bufs_vec));
+    size = max(size, offset + length);
+    ASSERT_TRUE(object_holds(&dev, "object", bufs_vec, data, size));
+  }
+  ASSERT_UINT_EQ(1,
+                 scrub_objects(&dev, &cursor, OBJECTS_TABLE_MAX_ENTRIES));
+  ASSERT_UINT_EQ(0, checksum_errors(dev_private(&dev)));
+
+  // The checksums persist
+  dev.ops->destroy(&dev);
+  buf_cache_invalidate_blocks(&mock_block_device);
+  ASSERT_NO_ERR(load_obj_device(&dev, &mock_block_device));
+  ASSERT_TRUE(object_holds(&dev, "object", bufs_vec, data, size));
+  dev.ops->destroy(&dev);
+
+  freevector(&bufs_vec);
+}
+
+/**
+ * Benchmark of the checksums. Reads extents through the objects cache, the
+ * way the file system does, with the buffer cache disabled so every read
+ * reaches the device. Prints the throughput with the verification off and on,
+ * for a store in the memory and on a block device, and of the CRC32C itself.
+ */
+TEST(checksum_benchmark) {
+  const uint objects = 32;
+  const uint rounds = 200;
+  static char object_ids[32][OBJECT_ID_LENGTH];
+  static char data[32][BSIZE];
+  struct device block_dev = {.id = 3, .type = DEVICE_TYPE_OBJ, .ref = 1};
+  struct device* devs[] = {TESTED_DEVICE, &block_dev};
+  const char* const stores[] = {"memory", "block device"};
+  vector dst = newvector(BSIZE, 1);
+  const ulong bytes = (ulong)objects * rounds * BSIZE;
+  struct timespec start, end;
+  uint crc = 0;
+
+  format_mock_block_device();
+  ASSERT_NO_ERR(load_obj_device(&block_dev, &mock_block_device));
+  buf_cache_disable_cache();
+  for (uint store = 0; store < ARRAY_LEN(devs); store++) {
+    ulong read_ns[2];
+    for (uint i = 0; i < objects; i++) {
+      snprintf(object_ids[i], OBJECT_ID_LENGTH, "extent_%u", i);
+      fill_text(data[i], BSIZE, i);
+      ASSERT_NO_ERR(obj_cache_add(devs[store], object_ids[i], data[i], BSIZE));
+    }
+    for (uint verify = 0; verify <= 1; verify++) {
+      set_objects_verify(dev_private(devs[store]), verify);
+      clock_gettime(CLOCK_MONOTONIC, &start);
+      for (uint round = 0; round < rounds; round++) {
+        for (uint i = 0; i < objects; i++) {
+          ASSERT_NO_ERR(obj_cache_read(devs[store], object_ids[i], &dst,
+                                       BSIZE, 0, BSIZE));
+        }
+      }
+      clock_gettime(CLOCK_MONOTONIC, &end);
+      read_ns[verify] = elapsed_ns(&start, &end);
+    }
+    ulong overhead = read_ns[1] > read_ns[0] ? read_ns[1] - read_ns[0] : 0;
+    PRINT("\n\t%s: read %lu MB/s, verified %lu MB/s (%lu%% slower)",
+          stores[store], bytes * 1000 / read_ns[0],
+          bytes * 1000 / read_ns[1], overhead * 100 / read_ns[0]);
+  }
+  buf_cache_enable_cache();
+  block_dev.ops->destroy(&block_dev);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (uint round = 0; round < rounds; round++) {
+    crc = obj_crc32c(crc, data[0], sizeof(data));
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  PRINT("\n\tcrc32c: %lu MB/s (%08x)\n",
+        bytes * 1000 / elapsed_ns(&start, &end), crc);
+
+  freevector(&dst);
+}
+
+/**
+ * Benchmark of the compression. Writes and reads text-like extents with the
+ * compression off and on, and prints the throughput and the store space the
+ * extents take in each mode.
+ */
+TEST(compression_benchmark) {
+  const uint objects = 128;
+  const uint rounds = 20;
+  static char object_ids[128][OBJECT_ID_LENGTH];
+  static char data[128][BSIZE];
+  struct buf bufs[1];
+  vector bufs_vec = new_bufs_vector(bufs, ARRAY_LEN(bufs));
+  struct obj_device_private* device = dev_private(&mock_device);
+  const ulong bytes = (ulong)objects * rounds * BSIZE;
+
+  for (uint i = 0; i < objects; i++) {
+    snprintf(object_ids[i], OBJECT_ID_LENGTH, "extent_%u", i);
+    fill_text(data[i], BSIZE, i);
+  }
+  for (uint compress = 0; compress <= 1; compress++) {
+    struct timespec start, end;
+    uint occupied = occupied_bytes(device);
+    ulong write_ns, read_ns;
+
+    set_objects_compression(device, compress);
+    for (uint i = 0; i < objects; i++) {
+      copy_buffer_to_bufs_vector(bufs_vec, data[i], BSIZE);
+      ASSERT_NO_ERR(add_object(TESTED_DEVICE, object_ids[i], bufs_vec, BSIZE));
+    }
+    occupied = occupied_bytes(device) - occupied;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint round = 0; round < rounds; round++) {
+      for (uint i = 0; i < objects; i++) {
+        memmove(bufs[0].data, data[i], BSIZE);
+        ASSERT_NO_ERR(
+            write_object(TESTED_DEVICE, object_ids[i], bufs_vec, BSIZE));
+      }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    write_ns = elapsed_ns(&start, &end);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint round = 0; round < rounds; round++) {
+      for (uint i = 0; i < objects; i++) {
+        ASSERT_NO_ERR(get_object(TESTED_DEVICE, object_ids[i], bufs_vec));
+      }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    read_ns = elapsed_ns(&start, &end);
+    ASSERT_UINT_EQ(0, memcmp(bufs[0].data, data[objects - 1], BSIZE));
+
+    PRINT("\n\t%s: write %lu MB/s, read %lu MB/s, %u bytes for %u bytes",
+          compress ? "compressed" : "raw", bytes * 1000 / write_ns,
+          bytes * 1000 / read_ns, occupied, objects * BSIZE);
+    for (uint i = 0; i < objects; i++) {
+      ASSERT_NO_ERR(delete_object(TESTED_DEVICE, object_ids[i]));
+    }
+  }
+  PRINT("\n");
+
+  freevector(&bufs_vec);
+}
+
+/**
+ * Benchmark of the objects lookup. Grows the objects table and measures the
+ * average `object_size` time at each size. As lookups use the objects index,
+ * the cost should stay flat and not grow with the amount of objects.
+ */
+TEST(objects_lookup_benchmark) {
+  const uint table_sizes[] = {64, 512, 2048};
+  const uint lookups = 200000;
+  static char object_ids[2048][OBJECT_ID_LENGTH];
+  uint data = 0;
+  struct buf bufs[SIZE_TO_NUM_OF_BUFS(sizeof(data))];
+  vector bufs_vec = new_bufs_vector(bufs, ARRAY_LEN(bufs));
+  uint seed = 0x1337;
+  uint added = 0;
+
+  for (uint i = 0; i < ARRAY_LEN(table_sizes); i++) {
+    for (; added < table_sizes[i]; added++) {
+      snprintf(object_ids[added], OBJECT_ID_LENGTH, "lookup_%u", added);
+      ASSERT_NO_ERR(add_object(TESTED_DEVICE, object_ids[added], bufs_vec, 1));
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint j = 0; j < lookups; j++) {
+      uint size;
+      const char* object_id = object_ids[rand_r(&seed) % added];
+      ASSERT_NO_ERR(object_size(TESTED_DEVICE, object_id, &size));
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    PRINT("\n\t%u objects: %lu ns per lookup", added,
+          elapsed_ns(&start, &end) / lookups);
+  }
+  PRINT("\n");
+
+  freevector(&bufs_vec);
+}
+
 /**
  * The following tests validate the correctness of the cache layer.
  * The tests use the `objects_cache_hits` and `objects_cache_misses` methods
@@ -612,6 +1527,138 @@ TEST(cache_write_big_object) {
   free(obj_data);
 }
 
+/* Write into the middle of a big object that is not cached. Only the edge
+ * blocks of the written range should be read, and the rest of the object
+ * should be kept. */
+TEST(cache_write_middle_of_big_object) {
+  const char* obj_name = "big_object";
+  uint obj_size = 100 * BUF_DATA_SIZE;
+  char* obj_data = malloc(obj_size);
+  char tmp_obj_name[] = "tmp_obj_000";
+  char tmp_obj_data[BUF_DATA_SIZE] = {0};
+
+  ASSERT_NE(0, obj_data);
+  for (uint i = 0; i < obj_size; i++) {
+    obj_data[i] = i % 251;
+  }
+  ASSERT_NO_ERR(obj_cache_add(TESTED_DEVICE, obj_name, obj_data, obj_size));
+
+  /* Remove the object from cache by inserting other objects */
+  for (uint i = 0; i < NBUF; i++) {
+    sprintf(tmp_obj_name, "tmp_obj_%d", i);
+    ASSERT_NO_ERR(obj_cache_add(TESTED_DEVICE, tmp_obj_name, tmp_obj_data,
+                                sizeof(tmp_obj_data)));
+    ASSERT_NO_ERR(
+        obj_cache_delete(TESTED_DEVICE, tmp_obj_name, sizeof(tmp_obj_data)));
+  }
+
+  uint write_offset = obj_size / 2 + 100;
+  uint write_size = 2 * BUF_DATA_SIZE;
+  memset(obj_data + write_offset, 'w', write_size);
+  uint misses_at_start = objects_cache_misses();
+  ASSERT_NO_ERR(obj_cache_write(TESTED_DEVICE, obj_name,
+                                obj_data + write_offset, write_size,
+                                write_offset, obj_size));
+  ASSERT_UINT_EQ(1, objects_cache_misses() - misses_at_start);
+
+  vector read_data = newvector(obj_size, 1);
+  ASSERT_NO_ERR(obj_cache_read(TESTED_DEVICE, obj_name, &read_data, obj_size,
+                               0, obj_size));
+  ASSERT_UINT_EQ(0, vectormemcmp(read_data, obj_data, obj_size));
+
+  freevector(&read_data);
+  free(obj_data);
+}
+
+// Adds an object of `size` bytes, all `c`, without caching it.
+static uint add_object_filled_with(const char* object_name, char c,
+                                   uint size) {
+  static struct buf bufs[SIZE_TO_NUM_OF_BUFS(64 * BUF_DATA_SIZE)];
+  vector bufs_vec = new_bufs_vector(bufs, SIZE_TO_NUM_OF_BUFS(size));
+  uint err;
+
+  vector_bufs_memset(bufs_vec, c, size);
+  err = add_object(TESTED_DEVICE, object_name, bufs_vec, size);
+  freevector(&bufs_vec);
+
+  return err;
+}
+
+/* Start two reads on a device with latency. Both are in flight together, and
+ * complete after the latency passes. */
+TEST(cache_reads_in_flight) {
+  const uint obj_size = 6 * BUF_DATA_SIZE;
+  struct obj_cache_read reads[2];
+  vector read_data = newvector(2 * obj_size, 1);
+  char* expected = malloc(2 * obj_size);
+
+  ASSERT_NE(0, expected);
+  memset(expected, 'a', obj_size);
+  memset(expected + obj_size, 'b', obj_size);
+  ASSERT_NO_ERR(add_object_filled_with("obj_a", 'a', obj_size));
+  ASSERT_NO_ERR(add_object_filled_with("obj_b", 'b', obj_size));
+  obj_queue_set_latency(2);
+
+  obj_cache_read_start(&reads[0], TESTED_DEVICE, "obj_a", obj_size, 0,
+                       obj_size);
+  obj_cache_read_start(&reads[1], TESTED_DEVICE, "obj_b", obj_size, 0,
+                       obj_size);
+  // Each read is split to a maximal transaction and the rest of it
+  ASSERT_UINT_EQ(2, reads[0].request.transactions);
+  ASSERT_UINT_EQ(2, reads[1].request.transactions);
+
+  ticks++;
+  obj_queue_intr();
+  ASSERT_FALSE(reads[0].request.done);
+  ASSERT_FALSE(reads[1].request.done);
+  ticks++;
+  obj_queue_intr();
+  ASSERT_TRUE(reads[0].request.done);
+  ASSERT_TRUE(reads[1].request.done);
+
+  ASSERT_NO_ERR(obj_cache_read_end(&reads[1], &read_data, obj_size));
+  ASSERT_NO_ERR(obj_cache_read_end(&reads[0], &read_data, 0));
+  ASSERT_UINT_EQ(0, vectormemcmp(read_data, expected, 2 * obj_size));
+
+  // A cached read does not wait for the device
+  obj_cache_read_start(&reads[0], TESTED_DEVICE, "obj_a", obj_size, 0,
+                       obj_size);
+  ASSERT_UINT_EQ(0, reads[0].request.transactions);
+  ASSERT_TRUE(reads[0].request.done);
+  ASSERT_NO_ERR(obj_cache_read_end(&reads[0], &read_data, 0));
+
+  freevector(&read_data);
+  free(expected);
+}
+
+/* A read of more transactions than the device serves at a time waits for a
+ * latency per every `OBJ_QUEUE_DEPTH` transactions. */
+TEST(cache_read_deeper_than_queue) {
+  const uint transactions = OBJ_QUEUE_DEPTH + 2;
+  const uint obj_size = transactions * OBJ_MAX_TRANSFER_SIZE;
+  vector read_data = newvector(obj_size, 1);
+  char* expected = malloc(obj_size);
+
+  ASSERT_NE(0, expected);
+  memset(expected, 'c', obj_size);
+  ASSERT_NO_ERR(add_object_filled_with("deep", 'c', obj_size));
+  obj_queue_set_latency(3);
+
+  uint start = ticks;
+  ASSERT_NO_ERR(obj_cache_read(TESTED_DEVICE, "deep", &read_data, obj_size, 0,
+                               obj_size));
+  ASSERT_UINT_EQ(2 * 3, ticks - start);
+  ASSERT_UINT_EQ(0, vectormemcmp(read_data, expected, obj_size));
+
+  struct obj_queue_stats stats;
+  obj_queue_get_stats(&stats);
+  ASSERT_UINT_EQ(0, stats.in_flight);
+  ASSERT_UINT_EQ(transactions, stats.transactions);
+
+  freevector(&read_data);
+  free(expected);
+}
+
 /* Verify that when we delete an object it is deleted from cache as well. */
 TEST(cache_delete_coherency) {
   char obj_name[] = "deleted_object";
@@ -628,12 +1675,173 @@ TEST(cache_delete_coherency) {
   freevector(&read_data);
 }
 
+/* Writes only dirty the cache, and the writes to the same blocks are written
+ * back together. */
+TEST(cache_writes_back_coalesced) {
+  char data[3 * BUF_DATA_SIZE];
+  struct buf bufs[3];
+  vector bufs_vec = new_bufs_vector(bufs, ARRAY_LEN(bufs));
+  uint object_size_value;
+
+  // An extent written in two chunks, and its first chunk rewritten.
+  memset(data, 'a', BUF_DATA_SIZE / 2);
+  ASSERT_NO_ERR(obj_cache_add(TESTED_DEVICE, "chunks", data, 512));
+  uint writes_at_start = objects_cache_writes();
+  uint writebacks_at_start = objects_cache_writebacks();
+  memset(data + 512, 'b', 512);
+  ASSERT_NO_ERR(obj_cache_write(TESTED_DEVICE, "chunks", data + 512, 512, 512,
+                                512));
+  memset(data, 'c', 512);
+  ASSERT_NO_ERR(obj_cache_write(TESTED_DEVICE, "chunks", data, 512, 0, 1024));
+  ASSERT_UINT_EQ(2, objects_cache_writes() - writes_at_start);
+  ASSERT_UINT_EQ(1, objects_cache_dirty());
+
+  // Nothing reached the disk, but the cache reads the written data.
+  ASSERT_UINT_EQ(0, objects_cache_writebacks() - writebacks_at_start);
+  ASSERT_NO_ERR(object_size(TESTED_DEVICE, "chunks", &object_size_value));
+  ASSERT_UINT_EQ(512, object_size_value);
+  vector read_data = newvector(1024, 1);
+  ASSERT_NO_ERR(
+      obj_cache_read(TESTED_DEVICE, "chunks", &read_data, 1024, 0, 1024));
+  ASSERT_UINT_EQ(0, vectormemcmp(read_data, data, 1024));
+  freevector(&read_data);
+
+  ASSERT_NO_ERR(obj_cache_flush(TESTED_DEVICE, "chunks"));
+  ASSERT_UINT_EQ(1, objects_cache_writebacks() - writebacks_at_start);
+  ASSERT_UINT_EQ(0, objects_cache_dirty());
+  ASSERT_TRUE(object_holds(TESTED_DEVICE, "chunks", bufs_vec, data, 1024));
+  ASSERT_NO_ERR(obj_cache_flush(TESTED_DEVICE, "chunks"));
+  ASSERT_UINT_EQ(1, objects_cache_writebacks() - writebacks_at_start);
+
+  // Each run of dirty blocks is written at once, the object grows with the
+  // last one.
+  fill_text(data, sizeof(data), 3);
+  ASSERT_NO_ERR(obj_cache_add(TESTED_DEVICE, "runs", data, 2 * BUF_DATA_SIZE));
+  memset(data + 100, 'x', 10);
+  ASSERT_NO_ERR(obj_cache_write(TESTED_DEVICE, "runs", data + 100, 10, 100,
+                                2 * BUF_DATA_SIZE));
+  ASSERT_NO_ERR(obj_cache_write(TESTED_DEVICE, "runs",
+                                data + 2 * BUF_DATA_SIZE, BUF_DATA_SIZE,
+                                2 * BUF_DATA_SIZE, 2 * BUF_DATA_SIZE));
+  ASSERT_UINT_EQ(2, objects_cache_dirty());
+  ASSERT_NO_ERR(obj_cache_sync(TESTED_DEVICE));
+  ASSERT_UINT_EQ(3, objects_cache_writebacks() - writebacks_at_start);
+  ASSERT_TRUE(
+      object_holds(TESTED_DEVICE, "runs", bufs_vec, data, sizeof(data)));
+
+  freevector(&bufs_vec);
+}
+
+/* Deleting an object drops its dirty blocks. */
+TEST(cache_delete_drops_dirty_blocks) {
+  char data[] = "written but never written back";
+
+  ASSERT_NO_ERR(obj_cache_add(TESTED_DEVICE, "dropped", data, sizeof(data)));
+  ASSERT_NO_ERR(obj_cache_write(TESTED_DEVICE, "dropped", data, 7, 0,
+                                sizeof(data)));
+  ASSERT_UINT_EQ(1, objects_cache_dirty());
+  uint writebacks_at_start = objects_cache_writebacks();
+
+  ASSERT_NO_ERR(obj_cache_delete(TESTED_DEVICE, "dropped", sizeof(data)));
+  ASSERT_UINT_EQ(0, objects_cache_dirty());
+  ASSERT_NO_ERR(obj_cache_sync(0));
+  ASSERT_UINT_EQ(0, objects_cache_writebacks() - writebacks_at_start);
+}
+
+/* Blocks read ahead count a readahead hit when they are read, and a
+ * readahead miss when they are dropped before. */
+TEST(cache_readahead_hits_and_misses) {
+  const uint size = 4 * BUF_DATA_SIZE;
+  char* data = malloc(size);
+  struct obj_cache_read read;
+  vector actual = newvector(size, 1);
+
+  ASSERT_NE(0, data);
+  for (uint i = 0; i < size; i++) {
+    data[i] = i % 251;
+  }
+  ASSERT_NO_ERR(obj_cache_add(TESTED_DEVICE, "readahead", data, size));
+  // Drop the cached blocks.
+  buf_cache_disable_cache();
+  buf_cache_enable_cache();
+  uint hits_at_start = objects_cache_hits();
+  uint misses_at_start = objects_cache_misses();
+  uint readahead_hits_at_start = objects_cache_readahead_hits();
+  uint readahead_misses_at_start = objects_cache_readahead_misses();
+
+  obj_cache_readahead_start(&read, TESTED_DEVICE, "readahead",
+                            2 * BUF_DATA_SIZE, 0, size);
+  ASSERT_NO_ERR(obj_cache_read_end(&read, 0, 0));
+  ASSERT_NO_ERR(obj_cache_read(TESTED_DEVICE, "readahead", &actual,
+                               2 * BUF_DATA_SIZE, 0, size));
+  ASSERT_UINT_EQ(0, vectormemcmp(actual, data, 2 * BUF_DATA_SIZE));
+  EXPECT_UINT_EQ(1, objects_cache_hits() - hits_at_start);
+  EXPECT_UINT_EQ(0, objects_cache_misses() - misses_at_start);
+  EXPECT_UINT_EQ(2, objects_cache_readahead_hits() - readahead_hits_at_start);
+
+  // A block counts a single readahead hit.
+  ASSERT_NO_ERR(obj_cache_read(TESTED_DEVICE, "readahead", &actual,
+                               BUF_DATA_SIZE, 0, size));
+  EXPECT_UINT_EQ(2, objects_cache_readahead_hits() - readahead_hits_at_start);
+
+  // Blocks dropped before they are read are readahead misses.
+  obj_cache_readahead_start(&read, TESTED_DEVICE, "readahead",
+                            2 * BUF_DATA_SIZE, 2 * BUF_DATA_SIZE, size);
+  ASSERT_NO_ERR(obj_cache_read_end(&read, 0, 0));
+  buf_cache_disable_cache();
+  buf_cache_enable_cache();
+  ASSERT_NO_ERR(obj_cache_read(TESTED_DEVICE, "readahead", &actual,
+                               2 * BUF_DATA_SIZE, 2 * BUF_DATA_SIZE, size));
+  ASSERT_UINT_EQ(0, vectormemcmp(actual, data + 2 * BUF_DATA_SIZE,
+                                 2 * BUF_DATA_SIZE));
+  EXPECT_UINT_EQ(2, objects_cache_readahead_hits() - readahead_hits_at_start);
+  EXPECT_UINT_EQ(2,
+                 objects_cache_readahead_misses() - readahead_misses_at_start);
+
+  freevector(&actual);
+  free(data);
+}
+
+/* Writers flush the dirty objects once too many blocks are dirty. */
+TEST(cache_flushes_above_dirty_limit) {
+  const uint objects = OBJ_CACHE_DIRTY_LIMIT + 10;
+  char object_name[] = "limit_000";
+  char data[100];
+  struct buf bufs[1];
+  vector bufs_vec = new_bufs_vector(bufs, ARRAY_LEN(bufs));
+
+  for (uint i = 0; i < objects; i++) {
+    sprintf(object_name, "limit_%d", i);
+    memset(data, 'a' + i % 26, sizeof(data));
+    ASSERT_NO_ERR(obj_cache_add(TESTED_DEVICE, object_name, data, 50));
+    ASSERT_NO_ERR(
+        obj_cache_write(TESTED_DEVICE, object_name, data, sizeof(data), 0, 50));
+    ASSERT_TRUE(objects_cache_dirty() <= OBJ_CACHE_DIRTY_LIMIT);
+  }
+  // The flushed objects are on the disk, the rest are written by a sync.
+  ASSERT_TRUE(object_holds(TESTED_DEVICE, "limit_0", bufs_vec,
+                           memset(data, 'a', sizeof(data)), sizeof(data)));
+  ASSERT_NO_ERR(obj_cache_sync(0));
+  ASSERT_UINT_EQ(0, objects_cache_dirty());
+  for (uint i = 0; i < objects; i++) {
+    sprintf(object_name, "limit_%d", i);
+    memset(data, 'a' + i % 26, sizeof(data));
+    ASSERT_TRUE(object_holds(TESTED_DEVICE, object_name, bufs_vec, data,
+                             sizeof(data)));
+  }
+
+  freevector(&bufs_vec);
+}
+
 INIT_TESTS_PLATFORM();
 
 // Should be called before each test
 void init_test() {
   init_mocks_environment();
   buf_cache_init();
+  /* The cache tests count on a cache of NBUF buffers. */
+  buf_cache_set_limits(NBUF, NBUF);
+  obj_cache_init();
 
   init_obj_device(&mock_device);
 }
@@ -658,14 +1866,40 @@ int main() {
   run_test(get_non_existing_object);
   run_test(add_to_full_table);
   run_test(reusing_freed_space);
+  run_test(coalescing_freed_space);
   run_test(add_when_there_is_no_more_disk_left);
+  run_test(compacting_in_slices);
+  run_test(add_to_fragmented_disk);
+  run_test(get_range_of_object);
+  run_test(write_range_of_object);
+  run_test(load_unformatted_block_device);
+  run_test(objects_persist_on_block_device);
+  run_test(dedup_identical_objects);
+  run_test(dedup_copy_on_write);
+  run_test(dedup_persists_on_block_device);
+  run_test(compress_small_objects);
+  run_test(compression_persists_on_block_device);
+  run_test(compression_benchmark);
+  run_test(checksum_benchmark);
+  run_test(clone_shares_snapshot_objects);
+  run_test(crc32c_checksums);
+  run_test(checksums_detect_corruption);
+  run_test(range_writes_keep_checksums);
+  run_test(objects_lookup_benchmark);
 
   // Cache layer
   run_test(add_objects_to_cache);
   run_test(get_object_in_cache);
   run_test(write_cache_coherency);
   run_test(cache_write_big_object);
+  run_test(cache_write_middle_of_big_object);
+  run_test(cache_reads_in_flight);
+  run_test(cache_read_deeper_than_queue);
   run_test(cache_delete_coherency);
+  run_test(cache_writes_back_coalesced);
+  run_test(cache_delete_drops_dirty_blocks);
+  run_test(cache_readahead_hits_and_misses);
+  run_test(cache_flushes_above_dirty_limit);
 
   PRINT_TESTS_RESULT("OBJ_FS_TESTS");
   return CURRENT_TESTS_RESULT();
@@ -0,0 +1,200 @@
+// Test the block allocator of the native file system.
+// A small file system image is built and mounted. Its free space is left
+// with holes, and filled to about 90%, then a file is written sequentially.
+// Its blocks, read from the image once unmounted, must be contiguous, rather
+// than fill the holes. A file system too large to mount is rejected, and so
+// is one larger than its image.
+
+#include "fcntl.h"
+#include "fsdefs.h"
+#include "param.h"
+#include "stat.h"
+#include "types.h"
+#include "user/lib/user.h"
+
+#define IMAGE "balloc.img"
+#define MOUNT_POINT "balloc_mnt"
+
+#define FS_BLOCKS 1024
+#define NLOG LOGSIZE
+#define NINODES 64
+#define NINODEBLOCKS (NINODES / IPB + 1)
+#define NMETA (2 + NLOG + NINODEBLOCKS + 1)
+
+// Single block files, every other one of which is removed to leave holes.
+#define SMALL_FILES 40
+// The blocks of the file filling the file system to about 90%.
+#define FILLER_BLOCKS 770
+// The blocks of the file written sequentially, into its indirect block.
+#define SEQ_BLOCKS 40
+
+static char block[BSIZE];
+
+static void fail(const char* message) {
+  printf(stdout, "balloc_test: %s\n", message);
+  exit(1);
+}
+
+// Writes the first `written` blocks of a file system with an empty root
+// directory.
+static void make_image(uint written) {
+  struct native_superblock sb = {
+      .size = FS_BLOCKS,
+      .nblocks = FS_BLOCKS - NMETA,
+      .nlog = NLOG,
+      .logstart = 2,
+      .inodestart = 2 + NLOG,
+      .bmapstart = 2 + NLOG + NINODEBLOCKS,
+      .ninodes = NINODES,
+  };
+  // The data block of the root directory follows the metadata.
+  uint root_block = NMETA;
+
+  int fd = open(IMAGE, O_CREATE | O_RDWR);
+  if (fd < 0) fail("failed to create the image");
+  for (uint b = 0; b < written; b++) {
+    memset(block, 0, BSIZE);
+    if (b == 1) {
+      memmove(block, &sb, sizeof(sb));
+    } else if (b == IBLOCK(ROOTINO, sb)) {
+      struct native_dinode* dip = (struct native_dinode*)block + ROOTINO % IPB;
+      dip->base_dinode.type = T_DIR;
+      dip->base_dinode.nlink = 1;
+      dip->size = BSIZE;
+      dip->addrs[0] = root_block;
+    } else if (b == sb.bmapstart) {
+      for (uint used = 0; used <= root_block; used++) {
+        block[used / 8] |= 1 << (used % 8);
+      }
+    } else if (b == root_block) {
+      struct dirent* de = (struct dirent*)block;
+      de[0].inum = ROOTINO;
+      strcpy(de[0].name, ".");
+      de[1].inum = ROOTINO;
+      strcpy(de[1].name, "..");
+    }
+    if (write(fd, block, BSIZE) != BSIZE) fail("failed to write the image");
+  }
+  close(fd);
+}
+
+// Reads block b of the image.
+static void read_image_block(uint b) {
+  int fd = open(IMAGE, O_RDONLY);
+  if (fd < 0) fail("failed to open the image");
+  for (uint i = 0; i <= b; i++) {
+    if (read(fd, block, BSIZE) != BSIZE) fail("failed to read the image");
+  }
+  close(fd);
+}
+
+static void write_blocks(const char* name, int n) {
+  int fd = open(name, O_CREATE | O_RDWR);
+  if (fd < 0) fail("failed to create a file");
+  memset(block, 'b', BSIZE);
+  for (int i = 0; i < n; i++) {
+    if (write(fd, block, BSIZE) != BSIZE) fail("failed to write a file");
+  }
+  close(fd);
+}
+
+static void make_name(char* name, int i) {
+  strcpy(name, MOUNT_POINT "/s00");
+  name[sizeof(MOUNT_POINT) + 1] = '0' + i / 10;
+  name[sizeof(MOUNT_POINT) + 2] = '0' + i % 10;
+}
+
+// Leaves holes in the free space, and fills it to about 90%. Then writes a
+// file sequentially, and returns its inode number.
+static uint fill_and_write(void) {
+  char name[sizeof(MOUNT_POINT) + 4];
+  struct stat st;
+
+  for (int i = 0; i < SMALL_FILES; i++) {
+    make_name(name, i);
+    write_blocks(name, 1);
+  }
+  for (int i = 0; i < SMALL_FILES; i += 2) {
+    make_name(name, i);
+    if (unlink(name) < 0) fail("failed to remove a file");
+  }
+  write_blocks(MOUNT_POINT "/filler", FILLER_BLOCKS);
+
+  int start = uptime();
+  write_blocks(MOUNT_POINT "/seq", SEQ_BLOCKS);
+  printf(stdout, "balloc_test: %d blocks written in %d ticks\n", SEQ_BLOCKS,
+         uptime() - start);
+
+  if (stat(MOUNT_POINT "/seq", &st) < 0) fail("stat failed");
+  return st.ino;
+}
+
+// Checks the blocks of the file, its indirect block included, follow each
+// other, and reports how full the file system is.
+static void check_image(uint ino) {
+  struct native_superblock sb;
+  uint addrs[NDIRECT + 1];
+  uint used = 0;
+
+  read_image_block(1);
+  memmove(&sb, block, sizeof(sb));
+  read_image_block(sb.bmapstart);
+  for (uint b = 0; b < sb.size; b++) {
+    used += (block[b / 8] >> (b % 8)) & 1;
+  }
+  printf(stdout, "balloc_test: %d of %d blocks in use\n", used, sb.size);
+  if (used * 10 < sb.size * 8) fail("the file system is not full enough");
+
+  read_image_block(IBLOCK(ino, sb));
+  memmove(addrs, ((struct native_dinode*)block + ino % IPB)->addrs,
+          sizeof(addrs));
+  for (uint i = 1; i <= NDIRECT; i++) {
+    if (addrs[i] != addrs[i - 1] + 1) fail("direct blocks not contiguous");
+  }
+  read_image_block(addrs[NDIRECT]);
+  uint* indirect = (uint*)block;
+  uint prev = addrs[NDIRECT];
+  for (uint i = 0; i < SEQ_BLOCKS - NDIRECT; prev = indirect[i++]) {
+    if (indirect[i] != prev + 1) fail("indirect blocks not contiguous");
+  }
+}
+
+// Makes the superblock describe more blocks than the kernel can mount.
+static void grow_superblock(void) {
+  struct native_superblock sb;
+
+  read_image_block(1);
+  memmove(&sb, block, sizeof(sb));
+  sb.size = 0x10000000;
+  memmove(block, &sb, sizeof(sb));
+
+  int fd = open(IMAGE, O_RDWR);
+  if (fd < 0) fail("failed to open the image");
+  char boot[BSIZE];
+  if (read(fd, boot, BSIZE) != BSIZE) fail("failed to read the image");
+  if (write(fd, block, BSIZE) != BSIZE) fail("failed to write the image");
+  close(fd);
+}
+
+int main(void) {
+  printf(stdout, "balloc_test starting\n");
+
+  make_image(FS_BLOCKS);
+  if (mkdir(MOUNT_POINT) < 0) fail("mkdir failed");
+  if (mount(IMAGE, MOUNT_POINT, 0) != 0) fail("mount failed");
+  uint ino = fill_and_write();
+  if (umount(MOUNT_POINT) != 0) fail("umount failed");
+  check_image(ino);
+
+  grow_superblock();
+  if (mount(IMAGE, MOUNT_POINT, 0) == 0) fail("mounted a too large fs");
+
+  if (unlink(IMAGE) < 0) fail("failed to remove the image");
+  make_image(FS_BLOCKS / 2);
+  if (mount(IMAGE, MOUNT_POINT, 0) == 0) fail("mounted a truncated image");
+
+  if (unlink(MOUNT_POINT) < 0) fail("failed to remove the mount point");
+  if (unlink(IMAGE) < 0) fail("failed to remove the image");
+  printf(stdout, "balloc_test passed successfully\n");
+  exit(0);
+}
@@ -0,0 +1,91 @@
+// Test files larger than the direct and single indirect blocks can hold.
+// A multi-megabyte file, which reaches into the double indirect tree, is
+// written and read back sequentially, and the throughput of both is reported.
+
+#include "fcntl.h"
+#include "fsdefs.h"
+#include "param.h"
+#include "stat.h"
+#include "types.h"
+#include "user/lib/user.h"
+
+#define FILE_NAME "bigfile"
+#define FILE_SIZE (2 * 1024 * 1024)
+#define IO_SIZE (64 * 1024)
+
+static char buf[IO_SIZE];
+
+static void fail(const char* message) {
+  printf(stdout, "bigfile_test: %s\n", message);
+  exit(1);
+}
+
+// Every block starts with its number.
+static void fill(int off) {
+  for (int i = 0; i < IO_SIZE; i += BSIZE) {
+    memset(buf + i, (off + i) / BSIZE, BSIZE);
+    *(int*)(buf + i) = (off + i) / BSIZE;
+  }
+}
+
+static int check(int off) {
+  for (int i = 0; i < IO_SIZE; i += BSIZE) {
+    if (*(int*)(buf + i) != (off + i) / BSIZE ||
+        buf[i + BSIZE - 1] != (char)((off + i) / BSIZE))
+      return 0;
+  }
+  return 1;
+}
+
+// The amount of ticks in a second.
+static int ticks_per_second(void) {
+  int start = uptime();
+  if (usleep(1000000) < 0) fail("usleep failed");
+  int ticks = uptime() - start;
+  return ticks > 0 ? ticks : 1;
+}
+
+static void print_throughput(const char* name, int ticks, int hz) {
+  if (ticks == 0) ticks = 1;
+  int kb_per_second = (FILE_SIZE / 1024) * hz / ticks;
+
+  printf(stdout, "bigfile_test: %s %d KB in %d ticks, %d.%d MB/s\n", name,
+         FILE_SIZE / 1024, ticks, kb_per_second / 1024,
+         (kb_per_second % 1024) * 10 / 1024);
+}
+
+int main(void) {
+  struct stat st;
+
+  printf(stdout, "bigfile_test starting\n");
+  int hz = ticks_per_second();
+
+  int fd = open(FILE_NAME, O_CREATE | O_RDWR);
+  if (fd < 0) fail("failed to create the file");
+  int start = uptime();
+  for (int off = 0; off < FILE_SIZE; off += IO_SIZE) {
+    fill(off);
+    if (write(fd, buf, IO_SIZE) != IO_SIZE) fail("failed to write the file");
+  }
+  close(fd);
+  print_throughput("wrote", uptime() - start, hz);
+
+  if (stat(FILE_NAME, &st) < 0 || st.size != FILE_SIZE)
+    fail("wrong file size");
+
+  fd = open(FILE_NAME, O_RDONLY);
+  if (fd < 0) fail("failed to open the file");
+  start = uptime();
+  for (int off = 0; off < FILE_SIZE; off += IO_SIZE) {
+    if (read(fd, buf, IO_SIZE) != IO_SIZE) fail("failed to read the file");
+    if (!check(off)) fail("wrong file content");
+  }
+  if (read(fd, buf, 1) != 0) fail("read past the end of the file");
+  close(fd);
+  print_throughput("read", uptime() - start, hz);
+
+  if (unlink(FILE_NAME) < 0) fail("failed to remove the file");
+
+  printf(stdout, "bigfile_test passed successfully\n");
+  exit(0);
+}
@@ -0,0 +1,119 @@
+// Benchmark the buffer cache with concurrent readers.
+// Each reader reads its own cached file over and over, so every read is a
+// buffer cache hit and the readers only contend on the cache locks. The
+// aggregate throughput is measured with 1 to NCPU readers, which run on as
+// many CPUs as the machine has.
+
+#include "fcntl.h"
+#include "param.h"
+#include "stat.h"
+#include "types.h"
+#include "user/lib/user.h"
+
+#define FILE_SIZE (8 * 1024)
+#define READ_ROUNDS 200
+
+static char buf[FILE_SIZE];
+
+static void file_name(char* name, int reader) {
+  strcpy(name, "bufcache0");
+  name[8] = '0' + reader;
+}
+
+static void create_files(void) {
+  char name[10];
+
+  for (int reader = 0; reader < NCPU; reader++) {
+    file_name(name, reader);
+    int fd = open(name, O_CREATE | O_RDWR);
+    if (fd < 0) {
+      printf(stdout, "bufcache_bench: failed to create %s\n", name);
+      exit(1);
+    }
+    memset(buf, 'a' + reader, sizeof(buf));
+    if (write(fd, buf, sizeof(buf)) != sizeof(buf)) {
+      printf(stdout, "bufcache_bench: failed to write %s\n", name);
+      exit(1);
+    }
+    close(fd);
+  }
+}
+
+static void remove_files(void) {
+  char name[10];
+
+  for (int reader = 0; reader < NCPU; reader++) {
+    file_name(name, reader);
+    if (unlink(name) < 0) {
+      printf(stdout, "bufcache_bench: failed to remove %s\n", name);
+      exit(1);
+    }
+  }
+}
+
+static void read_file(int reader) {
+  char name[10];
+
+  file_name(name, reader);
+  int fd = open(name, O_RDONLY);
+  if (fd < 0) {
+    printf(stdout, "bufcache_bench: failed to open %s\n", name);
+    exit(1);
+  }
+  for (int round = 0; round < READ_ROUNDS; round++) {
+    if (read(fd, buf, sizeof(buf)) != sizeof(buf) || buf[0] != 'a' + reader ||
+        buf[sizeof(buf) - 1] != 'a' + reader) {
+      printf(stdout, "bufcache_bench: failed to read %s\n", name);
+      exit(1);
+    }
+    close(fd);
+    fd = open(name, O_RDONLY);
+  }
+  close(fd);
+}
+
+// Runs `readers` concurrent readers and prints the aggregate throughput.
+static void run_readers(int readers) {
+  int start, ticks, status;
+
+  start = uptime();
+  for (int reader = 0; reader < readers; reader++) {
+    int pid = fork();
+    if (pid < 0) {
+      printf(stdout, "bufcache_bench: fork failed\n");
+      exit(1);
+    }
+    if (pid == 0) {
+      read_file(reader);
+      exit(0);
+    }
+  }
+  for (int reader = 0; reader < readers; reader++) {
+    if (wait(&status) < 0 || status != 0) {
+      printf(stdout, "bufcache_bench: reader failed\n");
+      exit(1);
+    }
+  }
+  ticks = uptime() - start;
+  if (ticks == 0) ticks = 1;
+
+  printf(stdout, "bufcache_bench: %d readers, %d ticks, %d KB per tick\n",
+         readers, ticks, readers * READ_ROUNDS * (FILE_SIZE / 1024) / ticks);
+}
+
+int main(void) {
+  printf(stdout, "bufcache_bench starting\n");
+
+  create_files();
+  // Bring the files into the cache.
+  for (int reader = 0; reader < NCPU; reader++) {
+    read_file(reader);
+  }
+  for (int readers = 1; readers <= NCPU; readers *= 2) {
+    run_readers(readers);
+  }
+  remove_files();
+
+  printf(stdout, "bufcache_bench passed successfully\n");
+  exit(0);
+}
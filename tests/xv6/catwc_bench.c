@@ -0,0 +1,119 @@
+// Benchmark the read path with the loops of cat and wc.
+// A cached file is read in 512 byte reads, as cat and wc do, and then piped
+// by a cat child into a wc parent. Reads copy from the buffer cache or the
+// pipe straight into the memory of the reader.
+
+#include "fcntl.h"
+#include "param.h"
+#include "stat.h"
+#include "types.h"
+#include "user/lib/user.h"
+
+#define FILE_NAME "catwc"
+#define FILE_SIZE (64 * 1024)
+#define LINE_SIZE 64
+#define READ_ROUNDS 40
+// The buffer size of cat and wc.
+#define READ_SIZE 512
+
+static char buf[READ_SIZE];
+
+static void fail(const char* message) {
+  printf(stdout, "catwc_bench: %s\n", message);
+  exit(1);
+}
+
+static void create_file(void) {
+  int fd = open(FILE_NAME, O_CREATE | O_RDWR);
+  if (fd < 0) fail("failed to create the file");
+  for (int i = 0; i < READ_SIZE; i++) {
+    buf[i] = (i % LINE_SIZE == LINE_SIZE - 1) ? '\n' : 'a';
+  }
+  for (int off = 0; off < FILE_SIZE; off += READ_SIZE) {
+    if (write(fd, buf, READ_SIZE) != READ_SIZE)
+      fail("failed to write the file");
+  }
+  close(fd);
+}
+
+// Counts the lines read from fd, as wc does.
+static int count_lines(int fd) {
+  int lines = 0;
+  int n;
+
+  while ((n = read(fd, buf, sizeof(buf))) > 0) {
+    for (int i = 0; i < n; i++) {
+      if (buf[i] == '\n') lines++;
+    }
+  }
+  if (n < 0) fail("read failed");
+  return lines;
+}
+
+// Copies the file to fd, as cat does.
+static void cat_file(int out) {
+  int n;
+
+  int fd = open(FILE_NAME, O_RDONLY);
+  if (fd < 0) fail("failed to open the file");
+  while ((n = read(fd, buf, sizeof(buf))) > 0) {
+    if (write(out, buf, n) != n) fail("write failed");
+  }
+  if (n < 0) fail("read failed");
+  close(fd);
+}
+
+static void print_throughput(const char* name, int start) {
+  int ticks = uptime() - start;
+  if (ticks == 0) ticks = 1;
+
+  printf(stdout, "catwc_bench: %s, %d ticks, %d KB per tick\n", name, ticks,
+         READ_ROUNDS * (FILE_SIZE / 1024) / ticks);
+}
+
+static void run_wc(void) {
+  int start = uptime();
+  for (int round = 0; round < READ_ROUNDS; round++) {
+    int fd = open(FILE_NAME, O_RDONLY);
+    if (fd < 0) fail("failed to open the file");
+    if (count_lines(fd) != FILE_SIZE / LINE_SIZE) fail("wrong line count");
+    close(fd);
+  }
+  print_throughput("wc", start);
+}
+
+static void run_cat_to_wc(void) {
+  int fds[2];
+  int status;
+
+  int start = uptime();
+  if (pipe(fds) < 0) fail("pipe failed");
+  int pid = fork();
+  if (pid < 0) fail("fork failed");
+  if (pid == 0) {
+    close(fds[0]);
+    for (int round = 0; round < READ_ROUNDS; round++) {
+      cat_file(fds[1]);
+    }
+    close(fds[1]);
+    exit(0);
+  }
+  close(fds[1]);
+  if (count_lines(fds[0]) != READ_ROUNDS * (FILE_SIZE / LINE_SIZE))
+    fail("wrong line count");
+  close(fds[0]);
+  if (wait(&status) < 0 || status != 0) fail("cat failed");
+  print_throughput("cat | wc", start);
+}
+
+int main(void) {
+  printf(stdout, "catwc_bench starting\n");
+
+  create_file();
+  run_wc();
+  run_cat_to_wc();
+  if (unlink(FILE_NAME) < 0) fail("failed to remove the file");
+
+  printf(stdout, "catwc_bench passed successfully\n");
+  exit(0);
+}
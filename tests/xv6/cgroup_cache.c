@@ -0,0 +1,185 @@
+// Test the buffer cache isolation of cgroups.
+// A "thrash" cgroup scans a file much larger than the cache, while a "work"
+// cgroup keeps a small working set in it. While the thrash cgroup is limited
+// by its memory.max, its misses recycle its own blocks, and the working set
+// stays cached. Once the limit is lifted, the same scan flushes it.
+
+#include "fcntl.h"
+#include "fsdefs.h"
+#include "param.h"
+#include "stat.h"
+#include "types.h"
+#include "user/lib/user.h"
+
+#define CGROUP_DIR "/cgroup"
+#define WORK_CGROUP "/cgroup/cgcache_work"
+#define THRASH_CGROUP "/cgroup/cgcache_thrash"
+#define WORK_FILE "cgcache_work"
+#define SCAN_FILE "cgcache_scan"
+
+// The cache is kept at NBUF buffers during the test.
+#define WORK_BLOCKS 32
+#define SCAN_BLOCKS (NBUF + NBUF / 4)
+#define SCAN_ROUNDS 2
+// The cache the thrash cgroup may hold when it is limited.
+#define LIMIT_BLOCKS 8
+
+static char block[BSIZE];
+
+static void fail(const char* message) {
+  printf(stdout, "cgroup_cache: %s\n", message);
+  exit(1);
+}
+
+static void write_control(const char* path, const char* text, int size) {
+  int fd = open(path, O_WRONLY);
+  if (fd < 0) fail("failed to open a control file");
+  if (write(fd, text, size) < 0) fail("failed to write a control file");
+  close(fd);
+}
+
+// The cgroup files parse up to the terminating null.
+static void write_cgroup(const char* path, const char* text) {
+  write_control(path, text, strlen(text) + 1);
+}
+
+static void write_cgroup_number(const char* path, uint n) {
+  char text[16];
+
+  itoa(text, n);
+  write_cgroup(path, text);
+}
+
+static void set_cache_max(uint max) {
+  char text[16];
+
+  strcpy(text, "max ");
+  itoa(text + strlen(text), max);
+  strcat(text, "\n");
+  write_control("/proc/cache", text, strlen(text));
+}
+
+// Returns the value of the memory.stat entry of the cgroup.
+static int mem_stat(const char* cgroup, char* entry) {
+  char path[64];
+  char text[256];
+
+  strcpy(path, cgroup);
+  strcat(path, "/memory.stat");
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) fail("failed to open memory.stat");
+  memset(text, 0, sizeof(text));
+  if (read(fd, text, sizeof(text) - 1) < 0) fail("failed to read memory.stat");
+  close(fd);
+
+  char* value = strstr(text, entry);
+  if (value == 0) fail("no memory.stat entry");
+  return atoi(value + strlen(entry));
+}
+
+static void create_file(const char* name, int blocks) {
+  int fd = open(name, O_CREATE | O_RDWR);
+  if (fd < 0) fail("failed to create a file");
+  for (int i = 0; i < blocks; i++) {
+    memset(block, i, sizeof(block));
+    if (write(fd, block, sizeof(block)) != sizeof(block))
+      fail("failed to write a file");
+  }
+  close(fd);
+}
+
+static void read_file(const char* name, int blocks) {
+  int fd = open(name, O_RDONLY);
+  if (fd < 0) fail("failed to open a file");
+  for (int i = 0; i < blocks; i++) {
+    if (read(fd, block, sizeof(block)) != sizeof(block) ||
+        block[0] != (char)i)
+      fail("failed to read a file");
+  }
+  close(fd);
+}
+
+// Reads the file `rounds` times in a child in the cgroup.
+static void read_in_cgroup(const char* cgroup, const char* name, int blocks,
+                           int rounds) {
+  char procs[64];
+  int status;
+
+  int pid = fork();
+  if (pid < 0) fail("fork failed");
+  if (pid == 0) {
+    strcpy(procs, cgroup);
+    strcat(procs, "/cgroup.procs");
+    write_cgroup_number(procs, getpid());
+    for (int round = 0; round < rounds; round++) {
+      read_file(name, blocks);
+    }
+    exit(0);
+  }
+  if (wait(&status) < 0 || status != 0) fail("reader failed");
+}
+
+// Loads the working set, thrashes, and returns the amount of misses of the
+// working set after the thrash.
+static int work_misses_after_thrash(void) {
+  read_in_cgroup(WORK_CGROUP, WORK_FILE, WORK_BLOCKS, 2);
+  read_in_cgroup(THRASH_CGROUP, SCAN_FILE, SCAN_BLOCKS, SCAN_ROUNDS);
+
+  int before = mem_stat(WORK_CGROUP, "pgmajfault - ");
+  read_in_cgroup(WORK_CGROUP, WORK_FILE, WORK_BLOCKS, 1);
+  return mem_stat(WORK_CGROUP, "pgmajfault - ") - before;
+}
+
+int main(void) {
+  int mounted = 0;
+
+  printf(stdout, "cgroup_cache starting\n");
+
+  int fd = open(CGROUP_DIR, O_RDONLY);
+  if (fd < 0) {
+    if (mkdir(CGROUP_DIR) < 0 || mount(0, CGROUP_DIR, "cgroup") < 0)
+      fail("failed to mount the cgroup file system");
+    mounted = 1;
+  } else {
+    close(fd);
+  }
+  if (mkdir(WORK_CGROUP) < 0 || mkdir(THRASH_CGROUP) < 0)
+    fail("failed to create the cgroups");
+  write_cgroup(THRASH_CGROUP "/cgroup.subtree_control", "+mem");
+
+  // A cache of NBUF buffers recycled by CLOCK, which the scan flushes.
+  write_control("/proc/cache", "policy clock\n", strlen("policy clock\n"));
+  set_cache_max(NBUF);
+  create_file(WORK_FILE, WORK_BLOCKS);
+  create_file(SCAN_FILE, SCAN_BLOCKS);
+
+  // The reader forked in the thrash cgroup is as large as this process.
+  write_cgroup_number(THRASH_CGROUP "/memory.max",
+                      (uint)sbrk(0) + LIMIT_BLOCKS * BSIZE);
+  int limited_misses = work_misses_after_thrash();
+  int thrash_file = mem_stat(THRASH_CGROUP, "file - ");
+  printf(stdout, "cgroup_cache: limited thrash holds %d KB, %d work misses\n",
+         thrash_file / 1024, limited_misses);
+  if (thrash_file == 0 || thrash_file > LIMIT_BLOCKS * BSIZE)
+    fail("the thrash cgroup cache is not limited");
+  if (limited_misses > WORK_BLOCKS / 4)
+    fail("the thrash cgroup evicted the working set");
+
+  write_cgroup(THRASH_CGROUP "/memory.max", "2147483648");
+  int unlimited_misses = work_misses_after_thrash();
+  printf(stdout, "cgroup_cache: unlimited thrash, %d work misses\n",
+         unlimited_misses);
+  if (unlimited_misses < WORK_BLOCKS / 2)
+    fail("the unlimited thrash kept the working set");
+
+  if (unlink(WORK_FILE) < 0 || unlink(SCAN_FILE) < 0)
+    fail("failed to remove the files");
+  if (unlink(THRASH_CGROUP) < 0 || unlink(WORK_CGROUP) < 0)
+    fail("failed to remove the cgroups");
+  if (mounted && (umount(CGROUP_DIR) < 0 || unlink(CGROUP_DIR) < 0))
+    fail("failed to unmount the cgroup file system");
+  set_cache_max(NBUF_MAX);
+
+  printf(stdout, "cgroup_cache passed successfully\n");
+  exit(0);
+}
@@ -348,6 +348,13 @@ int get_val(char* buf, char* entry) {
   return -1;  // Assuming all values are supposed to be non-negative
 }
 
+// Returns the memory of the processes in "/cgroup/test1", that is its current
+// memory without the cached file blocks charged to it.
+static int get_test_1_procs_mem(void) {
+  int file = get_val(read_file(TEST_1_MEM_STAT, 0), "file - ");
+  return atoi(read_file(TEST_1_MEM_CURRENT, 0)) - file;
+}
+
 // Write into buffer the sequence of activating, disabling then activating a
 // given controller. Returns the buffer written.
 char* build_activate_disable_activate(int controller_type) {
@@ -970,14 +977,14 @@ TEST(test_mem_peak) {
   sbrk(100);
 
   // Save current process memory size.
-  char initial_proc_mem[10];
-  strcpy(initial_proc_mem, read_file(TEST_PROC_MEM, 0));
-  strcat(initial_proc_mem, "\n");
+  int initial_proc_mem = atoi(read_file(TEST_PROC_MEM, 0));
 
-  // Move the current process to "/cgroup/test1" cgroup and remove it
+  // Move the current process to "/cgroup/test1" cgroup and remove it. The
+  // cached file blocks charged to the cgroup are counted in both.
   ASSERT_TRUE(move_proc(TEST_1_CGROUP_PROCS, getpid()));
-  ASSERT_FALSE(strcmp(read_file(TEST_1_MEM_CURRENT, 0), initial_proc_mem));
-  ASSERT_FALSE(strcmp(read_file(TEST_1_MEM_PEAK, 0), initial_proc_mem));
+  int file = get_val(read_file(TEST_1_MEM_STAT, 0), "file - ");
+  ASSERT_EQ(get_test_1_procs_mem(), initial_proc_mem);
+  ASSERT_EQ(atoi(read_file(TEST_1_MEM_PEAK, 0)) - file, initial_proc_mem);
 
   // Move the process back to root cgroup and resize its memory out of the
   // cgroup
@@ -1007,11 +1014,7 @@ TEST(test_mem_peak) {
 // "/cgroup/test1" in order to simplify the testing.
 TEST(test_mem_current) {
   // Save current process memory size.
-  char proc_mem[10];
-  strcpy(proc_mem, read_file(TEST_PROC_MEM, 0));
-  strcat(proc_mem, "\n");
-  // Buffer to read contents from memory file.
-  char saved_mem[10];
+  int proc_mem = atoi(read_file(TEST_PROC_MEM, 0));
 
   // Move the current process to "/cgroup/test1" cgroup.
   ASSERT_TRUE(move_proc(TEST_1_CGROUP_PROCS, getpid()));
@@ -1019,11 +1022,8 @@ TEST(test_mem_current) {
   // Check that the process we moved is really in "/cgroup/test1" cgroup.
   ASSERT_TRUE(is_pid_in_group(TEST_1_CGROUP_PROCS, getpid()));
 
-  // Read the contents of current memory file and convert it for comparison.
-  strcpy(saved_mem, read_file(TEST_1_MEM_CURRENT, 0));
-
   // Check memory usaged updated correctly.
-  ASSERT_FALSE(strcmp(saved_mem, proc_mem));
+  ASSERT_EQ(get_test_1_procs_mem(), proc_mem);
 
   // Return the process to root cgroup.
   ASSERT_TRUE(move_proc(ROOT_CGROUP_PROCS, getpid()));
@@ -1033,11 +1033,6 @@ TEST(test_mem_current) {
 }
 
 TEST(test_correct_mem_account_of_growth_and_shrink) {
-  // Save current process memory size.
-  char proc_mem[10];
-  // Buffer to read contents from memory file.
-  char saved_mem[10];
-
   // Move the current process to "/cgroup/test1" cgroup.
   ASSERT_TRUE(move_proc(TEST_1_CGROUP_PROCS, getpid()));
 
@@ -1047,34 +1042,14 @@ TEST(test_correct_mem_account_of_growth_and_shrink) {
   // Grow the current process by 100 bytes.
   sbrk(100);
 
-  // Read the contents of current memory file and convert it for comparison.
-  strcpy(saved_mem, read_file(TEST_1_MEM_CURRENT, 0));
-
-  // Convert process memory to a string.
-  strcpy(proc_mem, read_file(TEST_PROC_MEM, 0));
-  strcat(proc_mem, "\n");
-
-  // Read the contents of current memory file and convert it for comparison.
-  strcpy(saved_mem, read_file(TEST_1_MEM_CURRENT, 0));
-
   // Check that the memory accounting correctly updated after memory growth.
-  ASSERT_FALSE(strcmp(saved_mem, proc_mem));
+  ASSERT_EQ(get_test_1_procs_mem(), atoi(read_file(TEST_PROC_MEM, 0)));
 
   // Decrease current proc by 100 bytes.
   sbrk(-100);
 
-  // Read the contents of current memory file and convert it for comparison.
-  strcpy(saved_mem, read_file(TEST_1_MEM_CURRENT, 0));
-
-  // Convert process memory to a string.
-  strcpy(proc_mem, read_file(TEST_PROC_MEM, 0));
-  strcat(proc_mem, "\n");
-
-  // Read the contents of current memory file and convert it for comparison.
-  strcpy(saved_mem, read_file(TEST_1_MEM_CURRENT, 0));
-
   // Check that the memory accounting correctly updated after memory growth.
-  ASSERT_FALSE(strcmp(saved_mem, proc_mem));
+  ASSERT_EQ(get_test_1_procs_mem(), atoi(read_file(TEST_PROC_MEM, 0)));
 
   // Return the process to root cgroup.
   ASSERT_TRUE(move_proc(ROOT_CGROUP_PROCS, getpid()));
@@ -0,0 +1,166 @@
+// Benchmark metadata operations in the file systems of two containers.
+// The images of two containers are mounted, as pouch mounts container
+// roots, and files and directories are created and removed in them,
+// first in one container at a time and then in both concurrently. Each
+// mounted file system has its own log, so the two commit independently.
+// Directories are also made through absolute paths, whose lookups cross
+// from the root file system into the containers. Last, files of each
+// container are linked into the other one, which must fail, while both
+// containers are written, so that ops cross the two logs both ways.
+
+#include "fcntl.h"
+#include "param.h"
+#include "stat.h"
+#include "types.h"
+#include "user/lib/user.h"
+
+#define CHURN_ROUNDS 150
+#define PATH_ROUNDS 30
+#define CROSS_ROUNDS 100
+#define NAMES 8
+
+static const char* const images[] = {"internal_fs_a", "internal_fs_b"};
+static char* roots[] = {"cfs_a", "cfs_b"};
+#define NCONTAINERS (sizeof(roots) / sizeof(roots[0]))
+
+static void fail(const char* message) {
+  printf(stdout, "containerfs_bench: %s\n", message);
+  exit(1);
+}
+
+static void make_name(char* name, char prefix, int i) {
+  name[0] = prefix;
+  name[1] = 'c';
+  name[2] = '0' + i % NAMES;
+  name[3] = '\0';
+}
+
+// Creates and removes files and directories in the container root,
+// 4 ops each round, and checks that fsync commits them.
+static void churn(char* root) {
+  char name[4];
+
+  if (chdir(root) < 0) fail("chdir failed");
+  for (int i = 0; i < CHURN_ROUNDS; i++) {
+    make_name(name, 'f', i);
+    int fd = open(name, O_CREATE | O_RDWR);
+    if (fd < 0) fail("failed to create a file");
+    close(fd);
+    if (unlink(name) < 0) fail("failed to remove a file");
+
+    make_name(name, 'd', i);
+    if (mkdir(name) < 0) fail("failed to create a directory");
+    if (unlink(name) < 0) fail("failed to remove a directory");
+  }
+
+  int fd = open("synced", O_CREATE | O_RDWR);
+  if (fd < 0) fail("failed to create a file");
+  if (fsync(fd) != 0) fail("fsync failed");
+  close(fd);
+  if (unlink("synced") < 0) fail("failed to remove a file");
+  if (chdir("/") < 0) fail("chdir failed");
+}
+
+// Makes and removes NAMES directories in the container root, each round,
+// through absolute paths.
+static void make_paths(char* root) {
+  char path[16];
+
+  strcpy(path, "/");
+  strcpy(path + 1, root);
+  char* name = path + strlen(path);
+  *name++ = '/';
+  for (int i = 0; i < PATH_ROUNDS; i++) {
+    for (int j = 0; j < NAMES; j++) {
+      make_name(name, 'p', j);
+      if (mkdir(path) < 0) fail("failed to create a directory by path");
+    }
+    for (int j = 0; j < NAMES; j++) {
+      make_name(name, 'p', j);
+      if (unlink(path) < 0) fail("failed to remove a directory by path");
+    }
+  }
+}
+
+// Creates a file in the container root, and links it into the root of
+// the other container, each round.
+static void cross_links(char* root) {
+  char from[16], to[16];
+
+  strcpy(from, root);
+  strcat(from, "/xf");
+  strcpy(to, strcmp(root, roots[0]) == 0 ? roots[1] : roots[0]);
+  strcat(to, "/xl");
+  for (int i = 0; i < CROSS_ROUNDS; i++) {
+    int fd = open(from, O_CREATE | O_RDWR);
+    if (fd < 0) fail("failed to create a file");
+    close(fd);
+    if (link(from, to) == 0) fail("linked across file systems");
+    if (unlink(from) < 0) fail("failed to remove a file");
+  }
+}
+
+// Runs work in the containers [first, last) concurrently.
+static void run_containers(void (*work)(char*), int first, int last) {
+  int status;
+
+  for (int c = first; c < last; c++) {
+    int pid = fork();
+    if (pid < 0) fail("fork failed");
+    if (pid == 0) {
+      work(roots[c]);
+      exit(0);
+    }
+  }
+  for (int c = first; c < last; c++) {
+    if (wait(&status) < 0 || status != 0) fail("container failed");
+  }
+}
+
+static void print_throughput(const char* name, int start, int ops) {
+  int ticks = uptime() - start;
+  if (ticks == 0) ticks = 1;
+
+  printf(stdout,
+         "containerfs_bench: %s, %d ops in %d ticks, %d ops per tick\n",
+         name, ops, ticks, ops / ticks);
+}
+
+int main(void) {
+  int ops = 4 * CHURN_ROUNDS * NCONTAINERS;
+
+  printf(stdout, "containerfs_bench starting\n");
+
+  for (int c = 0; c < NCONTAINERS; c++) {
+    mkdir(roots[c]);
+    if (mount(images[c], roots[c], 0) != 0) fail("mount failed");
+  }
+
+  int start = uptime();
+  for (int c = 0; c < NCONTAINERS; c++) {
+    run_containers(churn, c, c + 1);
+  }
+  print_throughput("one container at a time", start, ops);
+
+  start = uptime();
+  run_containers(churn, 0, NCONTAINERS);
+  print_throughput("containers concurrently", start, ops);
+
+  start = uptime();
+  run_containers(make_paths, 0, NCONTAINERS);
+  print_throughput("absolute paths", start,
+                   2 * NAMES * PATH_ROUNDS * NCONTAINERS);
+
+  start = uptime();
+  run_containers(cross_links, 0, NCONTAINERS);
+  print_throughput("links across containers", start,
+                   3 * CROSS_ROUNDS * NCONTAINERS);
+
+  for (int c = 0; c < NCONTAINERS; c++) {
+    if (umount(roots[c]) != 0) fail("umount failed");
+    if (unlink(roots[c]) < 0) fail("failed to remove a mount point");
+  }
+
+  printf(stdout, "containerfs_bench passed successfully\n");
+  exit(0);
+}
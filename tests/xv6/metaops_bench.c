@@ -0,0 +1,91 @@
+// Benchmark metadata operations of the native file system.
+// Files and directories are created and removed in a loop, as usertests and
+// pouch build do, and the throughput is reported. The updates of many system
+// calls are committed to the log together. fsync waits for their commit.
+
+#include "fcntl.h"
+#include "param.h"
+#include "stat.h"
+#include "types.h"
+#include "user/lib/user.h"
+
+#define OPS_ROUNDS 200
+#define NAMES 8
+
+static void fail(const char* message) {
+  printf(stdout, "metaops_bench: %s\n", message);
+  exit(1);
+}
+
+static void make_name(char* name, char prefix, int i) {
+  name[0] = prefix;
+  name[1] = 'm';
+  name[2] = '0' + i % NAMES;
+  name[3] = '\0';
+}
+
+static void print_throughput(const char* name, int start, int ops) {
+  int ticks = uptime() - start;
+  if (ticks == 0) ticks = 1;
+
+  printf(stdout, "metaops_bench: %s, %d ops in %d ticks, %d ops per tick\n",
+         name, ops, ticks, ops / ticks);
+}
+
+// Creates and removes files, 2 ops each.
+static void run_files(void) {
+  char name[4];
+
+  int start = uptime();
+  for (int i = 0; i < OPS_ROUNDS; i++) {
+    make_name(name, 'f', i);
+    int fd = open(name, O_CREATE | O_RDWR);
+    if (fd < 0) fail("failed to create a file");
+    close(fd);
+    if (unlink(name) < 0) fail("failed to remove a file");
+  }
+  print_throughput("create/unlink", start, 2 * OPS_ROUNDS);
+}
+
+// Creates and removes directories, 2 ops each.
+static void run_dirs(void) {
+  char name[4];
+
+  int start = uptime();
+  for (int i = 0; i < OPS_ROUNDS; i++) {
+    make_name(name, 'd', i);
+    if (mkdir(name) < 0) fail("failed to create a directory");
+    if (unlink(name) < 0) fail("failed to remove a directory");
+  }
+  print_throughput("mkdir/unlink", start, 2 * OPS_ROUNDS);
+}
+
+static void test_fsync(void) {
+  int fds[2];
+
+  int fd = open("metaops", O_CREATE | O_RDWR);
+  if (fd < 0) fail("failed to create a file");
+  if (write(fd, "data", 4) != 4) fail("failed to write a file");
+  if (fsync(fd) != 0) fail("fsync failed");
+  // Nothing left to commit.
+  if (fsync(fd) != 0) fail("fsync failed");
+  close(fd);
+  if (unlink("metaops") < 0) fail("failed to remove a file");
+
+  if (pipe(fds) < 0) fail("pipe failed");
+  if (fsync(fds[0]) != -1) fail("fsync of a pipe succeeded");
+  close(fds[0]);
+  close(fds[1]);
+  if (fsync(fds[0]) != -1) fail("fsync of a closed fd succeeded");
+}
+
+int main(void) {
+  printf(stdout, "metaops_bench starting\n");
+
+  run_files();
+  run_dirs();
+  test_fsync();
+
+  printf(stdout, "metaops_bench passed successfully\n");
+  exit(0);
+}
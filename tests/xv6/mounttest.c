@@ -386,6 +386,194 @@ static int devicefilestoretest(void) {
   return 0;
 }
 
+static int objfsdevicefilestoretest(void) {
+  mkdir("ccc");
+  int res = mount("objfs.img", "ccc", "objfs");
+  if (res != 0) {
+    printf(stdout, "objfsdevicefilestoretest: mount returned %d\n", res);
+    return 1;
+  }
+
+  if (createfile("ccc/objfsdevicefilestoretest", "cdcdcd") != 0) {
+    return 1;
+  }
+
+  res = umount("ccc");
+  if (res != 0) {
+    printf(stdout, "objfsdevicefilestoretest: umount returned %d\n", res);
+    return 1;
+  }
+
+  res = mount("objfs.img", "ccc", "objfs");
+  if (res != 0) {
+    printf(stdout, "objfsdevicefilestoretest: remount returned %d\n", res);
+    return 1;
+  }
+
+  if (verifyfilecontents("ccc/objfsdevicefilestoretest", "cdcdcd") != 0) {
+    return 1;
+  }
+
+  res = umount("ccc");
+  if (res != 0) {
+    printf(stdout, "objfsdevicefilestoretest: umount returned %d\n", res);
+    return 1;
+  }
+
+  unlink("ccc");
+
+  return 0;
+}
+
+// Relies on objfsdevicefilestoretest to leave a file in the image.
+static int objfsclonetest(void) {
+  mkdir("ccc");
+  int res = mount("objfs.img", "ccc", "objclone");
+  if (res != 0) {
+    printf(stdout, "objfsclonetest: mount returned %d\n", res);
+    return 1;
+  }
+
+  if (verifyfilecontents("ccc/objfsdevicefilestoretest", "cdcdcd") != 0 ||
+      createfile("ccc/objfsdevicefilestoretest", "efefef") != 0 ||
+      createfile("ccc/objfsclonetest", "clone") != 0 ||
+      verifyfilecontents("ccc/objfsdevicefilestoretest", "efefef") != 0) {
+    return 1;
+  }
+
+  // A second clone shares the snapshot, but not the writes of the first.
+  mkdir("ddd");
+  res = mount("objfs.img", "ddd", "objclone");
+  if (res != 0) {
+    printf(stdout, "objfsclonetest: second mount returned %d\n", res);
+    return 1;
+  }
+  if (verifyfilecontents("ddd/objfsdevicefilestoretest", "cdcdcd") != 0) {
+    return 1;
+  }
+  int fd = open("ddd/objfsclonetest", 0);
+  if (fd >= 0) {
+    printf(stdout, "objfsclonetest: a clone's file is in the other\n");
+    close(fd);
+    return 1;
+  }
+  res = umount("ddd");
+  if (res != 0) {
+    printf(stdout, "objfsclonetest: umount returned %d\n", res);
+    return 1;
+  }
+  unlink("ddd");
+
+  res = umount("ccc");
+  if (res != 0) {
+    printf(stdout, "objfsclonetest: umount returned %d\n", res);
+    return 1;
+  }
+
+  // The writes to the clone don't reach the image
+  res = mount("objfs.img", "ccc", "objfs");
+  if (res != 0) {
+    printf(stdout, "objfsclonetest: image mount returned %d\n", res);
+    return 1;
+  }
+
+  if (verifyfilecontents("ccc/objfsdevicefilestoretest", "cdcdcd") != 0) {
+    return 1;
+  }
+  fd = open("ccc/objfsclonetest", 0);
+  if (fd >= 0) {
+    printf(stdout, "objfsclonetest: the clone's file is in the image\n");
+    close(fd);
+    return 1;
+  }
+
+  res = umount("ccc");
+  if (res != 0) {
+    printf(stdout, "objfsclonetest: umount returned %d\n", res);
+    return 1;
+  }
+
+  unlink("ccc");
+
+  return 0;
+}
+
+// The size of a file larger than the memory store an obj-fs device used to be
+// limited to.
+#define OBJFS_BIG_FILE_SIZE (512 * 1024)
+
+// Writes the file, or checks its content, a block at a time. Every block is
+// filled with its number.
+static int objfsbigfile(const char *path, int write_file) {
+  char buf[BSIZE];
+  int fd = open(path, write_file ? O_WRONLY | O_CREATE : O_RDONLY);
+  if (fd < 0) {
+    printf(stdout, "objfsbigfile: cannot open %s\n", path);
+    return 1;
+  }
+
+  for (int i = 0; i < OBJFS_BIG_FILE_SIZE / BSIZE; i++) {
+    int res;
+    if (write_file) {
+      memset(buf, i, BSIZE);
+      res = write(fd, buf, BSIZE);
+    } else {
+      res = read(fd, buf, BSIZE);
+      for (int j = 0; j < BSIZE && res == BSIZE; j++) {
+        if (buf[j] != (char)i) res = -1;
+      }
+    }
+    if (res != BSIZE) {
+      printf(stdout, "objfsbigfile: block %d of %s differs\n", i, path);
+      close(fd);
+      return 1;
+    }
+  }
+
+  close(fd);
+  return 0;
+}
+
+// The image holds more than the memory store used to.
+static int objfsbigimagetest(void) {
+  mkdir("ccc");
+  int res = mount("objfs.img", "ccc", "objfs");
+  if (res != 0) {
+    printf(stdout, "objfsbigimagetest: mount returned %d\n", res);
+    return 1;
+  }
+  if (objfsbigfile("ccc/objfsbigimagetest", 1) != 0) {
+    return 1;
+  }
+  res = umount("ccc");
+  if (res != 0) {
+    printf(stdout, "objfsbigimagetest: umount returned %d\n", res);
+    return 1;
+  }
+
+  res = mount("objfs.img", "ccc", "objfs");
+  if (res != 0) {
+    printf(stdout, "objfsbigimagetest: remount returned %d\n", res);
+    return 1;
+  }
+  if (objfsbigfile("ccc/objfsbigimagetest", 0) != 0) {
+    return 1;
+  }
+  if (unlink("ccc/objfsbigimagetest") < 0) {
+    printf(stdout, "objfsbigimagetest: unlink failed\n");
+    return 1;
+  }
+  res = umount("ccc");
+  if (res != 0) {
+    printf(stdout, "objfsbigimagetest: umount returned %d\n", res);
+    return 1;
+  }
+
+  unlink("ccc");
+
+  return 0;
+}
+
 static int umountwithopenfiletest(void) {
   if (mounta() != 0) {
     return 1;
@@ -1065,6 +1253,9 @@ int main(int argc, char *argv[]) {
   run_test(directorywithintest, "directorywithintest");
   run_test(nestedmounttest, "nestedmounttest");
   run_test(devicefilestoretest, "devicefilestoretest");
+  run_test(objfsdevicefilestoretest, "objfsdevicefilestoretest");
+  run_test(objfsclonetest, "objfsclonetest");
+  run_test(objfsbigimagetest, "objfsbigimagetest");
   run_test(umountwithopenfiletest, "umountwithopenfiletest");
   run_test(errorondeletedevicetest, "errorondeletedevicetest");
   run_test(umountnonrootmount, "umountnonrootmount");
@@ -0,0 +1,291 @@
+// Stress the object device with concurrent readers.
+// Each reader reads its own file, like containers reading their own images
+// from a shared object device, and the throughput is measured with 1, 2 and 4
+// readers. The buffer cache is disabled so every read reaches the device.
+// The readers are run again with a simulated device latency, to measure how
+// well the reads in flight hide it. A file is then written in small chunks,
+// which the object cache must absorb, and read back in small chunks, which
+// readahead must serve. At last, the devices are scrubbed and must hold no
+// corrupted objects.
+
+#include "fcntl.h"
+#include "stat.h"
+#include "types.h"
+#include "user/lib/user.h"
+
+#define MAX_READERS 4
+#define FILE_SIZE (16 * 1024)
+#define READ_ROUNDS 20
+#define CHUNK_SIZE 256
+
+static char buf[FILE_SIZE];
+
+static void set_fs_cache_state(int enable) {
+  char* state = enable ? "1\n" : "0\n";
+  int fd = open("/proc/cache", O_RDWR);
+
+  if (fd < 0) {
+    printf(stdout, "objfs_stress: failed to open /proc/cache\n");
+    exit(1);
+  }
+  if (write(fd, state, 2) != 2) {
+    printf(stdout, "objfs_stress: failed to set fs cache to %d\n", enable);
+    exit(1);
+  }
+  close(fd);
+}
+
+static void set_objfs_latency(int latency) {
+  char* command = latency ? "latency 1\n" : "latency 0\n";
+  int fd = open("/proc/objfs", O_RDWR);
+
+  if (fd < 0) {
+    printf(stdout, "objfs_stress: failed to open /proc/objfs\n");
+    exit(1);
+  }
+  if (write(fd, command, strlen(command)) != strlen(command)) {
+    printf(stdout, "objfs_stress: failed to set latency to %d\n", latency);
+    exit(1);
+  }
+  close(fd);
+}
+
+// Verifies the checksums of all the objects, and checks none mismatched.
+static void scrub_objfs(void) {
+  static char stats[1024];
+  char* errors = stats;
+  int fd = open("/proc/objfs", O_RDWR);
+  int n;
+
+  if (fd < 0 || write(fd, "scrub\n", 6) != 6) {
+    printf(stdout, "objfs_stress: failed to scrub\n");
+    exit(1);
+  }
+  close(fd);
+  fd = open("/proc/objfs", O_RDONLY);
+  if (fd < 0 || (n = read(fd, stats, sizeof(stats) - 1)) <= 0) {
+    printf(stdout, "objfs_stress: failed to read /proc/objfs\n");
+    exit(1);
+  }
+  close(fd);
+  stats[n] = 0;
+  while ((errors = strstr(errors, "checksum errors ")) != 0) {
+    errors += strlen("checksum errors ");
+    if (errors[0] != '0' || (errors[1] >= '0' && errors[1] <= '9')) {
+      printf(stdout, "objfs_stress: scrub found corrupted objects\n");
+      exit(1);
+    }
+  }
+}
+
+// Returns the number following `label` in /proc/objfs.
+static int objfs_stat(char* label) {
+  static char stats[1024];
+  char* value;
+  int fd = open("/proc/objfs", O_RDONLY);
+  int n;
+
+  if (fd < 0 || (n = read(fd, stats, sizeof(stats) - 1)) <= 0) {
+    printf(stdout, "objfs_stress: failed to read /proc/objfs\n");
+    exit(1);
+  }
+  close(fd);
+  stats[n] = 0;
+  if ((value = strstr(stats, label)) == 0) {
+    printf(stdout, "objfs_stress: no %s in /proc/objfs\n", label);
+    exit(1);
+  }
+  return atoi(value + strlen(label));
+}
+
+// Writes a file in small chunks. The cache absorbs the writes to the same
+// extent, and closing the file writes each extent back about once.
+static void write_in_chunks(void) {
+  int writes = objfs_stat("writes ");
+  int writebacks = objfs_stat("writebacks ");
+  int fd = open("chunks", O_CREATE | O_RDWR);
+
+  if (fd < 0) {
+    printf(stdout, "objfs_stress: failed to create chunks\n");
+    exit(1);
+  }
+  memset(buf, 'z', sizeof(buf));
+  for (int off = 0; off < sizeof(buf); off += CHUNK_SIZE) {
+    if (write(fd, buf + off, CHUNK_SIZE) != CHUNK_SIZE) {
+      printf(stdout, "objfs_stress: failed to write chunks\n");
+      exit(1);
+    }
+  }
+  close(fd);
+  writes = objfs_stat("writes ") - writes;
+  writebacks = objfs_stat("writebacks ") - writebacks;
+  printf(stdout, "objfs_stress: %d cache writes, %d written back\n", writes,
+         writebacks);
+  if (writebacks * 2 > writes) {
+    printf(stdout, "objfs_stress: the cache did not absorb the writes\n");
+    exit(1);
+  }
+
+  fd = open("chunks", O_RDONLY);
+  memset(buf, 0, sizeof(buf));
+  if (fd < 0 || read(fd, buf, sizeof(buf)) != sizeof(buf)) {
+    printf(stdout, "objfs_stress: failed to read chunks\n");
+    exit(1);
+  }
+  close(fd);
+  for (int i = 0; i < sizeof(buf); i++) {
+    if (buf[i] != 'z') {
+      printf(stdout, "objfs_stress: bad content of chunks at %d\n", i);
+      exit(1);
+    }
+  }
+}
+
+// Reads a file which is not cached in small chunks, with a device latency.
+// The reader is sequential, so most of the chunks are read ahead.
+static void read_in_chunks(void) {
+  int hits = objfs_stat("readahead hits ");
+  int fd = open("reader0", O_RDONLY);
+
+  if (fd < 0) {
+    printf(stdout, "objfs_stress: failed to open reader0\n");
+    exit(1);
+  }
+  set_objfs_latency(1);
+  for (int off = 0; off < sizeof(buf); off += CHUNK_SIZE) {
+    if (read(fd, buf, CHUNK_SIZE) != CHUNK_SIZE) {
+      printf(stdout, "objfs_stress: failed to read reader0\n");
+      exit(1);
+    }
+    for (int i = 0; i < CHUNK_SIZE; i++) {
+      if (buf[i] != 'a') {
+        printf(stdout, "objfs_stress: bad content of reader0 at %d\n",
+               off + i);
+        exit(1);
+      }
+    }
+  }
+  set_objfs_latency(0);
+  close(fd);
+  hits = objfs_stat("readahead hits ") - hits;
+  printf(stdout, "objfs_stress: %d blocks read ahead and read\n", hits);
+  if (hits * 1024 < FILE_SIZE / 2) {
+    printf(stdout, "objfs_stress: the sequential reader was not read ahead\n");
+    exit(1);
+  }
+}
+
+static void file_name(char* name, int reader) {
+  strcpy(name, "reader0");
+  name[6] = '0' + reader;
+}
+
+static void create_files(void) {
+  char name[8];
+
+  for (int reader = 0; reader < MAX_READERS; reader++) {
+    file_name(name, reader);
+    int fd = open(name, O_CREATE | O_RDWR);
+    if (fd < 0) {
+      printf(stdout, "objfs_stress: failed to create %s\n", name);
+      exit(1);
+    }
+    memset(buf, 'a' + reader, sizeof(buf));
+    if (write(fd, buf, sizeof(buf)) != sizeof(buf)) {
+      printf(stdout, "objfs_stress: failed to write %s\n", name);
+      exit(1);
+    }
+    close(fd);
+  }
+}
+
+static void read_file(int reader) {
+  char name[8];
+
+  file_name(name, reader);
+  for (int round = 0; round < READ_ROUNDS; round++) {
+    int fd = open(name, O_RDONLY);
+    if (fd < 0 || read(fd, buf, sizeof(buf)) != sizeof(buf)) {
+      printf(stdout, "objfs_stress: failed to read %s\n", name);
+      exit(1);
+    }
+    for (int i = 0; i < sizeof(buf); i++) {
+      if (buf[i] != 'a' + reader) {
+        printf(stdout, "objfs_stress: bad content of %s at %d\n", name, i);
+        exit(1);
+      }
+    }
+    close(fd);
+  }
+}
+
+// Runs `readers` concurrent readers and prints the throughput.
+static void run_readers(int readers) {
+  int start, ticks, status;
+
+  start = uptime();
+  for (int reader = 0; reader < readers; reader++) {
+    int pid = fork();
+    if (pid < 0) {
+      printf(stdout, "objfs_stress: fork failed\n");
+      exit(1);
+    }
+    if (pid == 0) {
+      read_file(reader);
+      exit(0);
+    }
+  }
+  for (int reader = 0; reader < readers; reader++) {
+    if (wait(&status) < 0 || status != 0) {
+      printf(stdout, "objfs_stress: reader failed\n");
+      exit(1);
+    }
+  }
+  ticks = uptime() - start;
+  if (ticks == 0) ticks = 1;
+
+  printf(stdout, "objfs_stress: %d readers, %d ticks, %d KB per tick\n",
+         readers, ticks, readers * READ_ROUNDS * (FILE_SIZE / 1024) / ticks);
+}
+
+int main(void) {
+  printf(stdout, "objfs_stress starting\n");
+
+  unlink("objfs_stress_dir");
+  if (mkdir("objfs_stress_dir") < 0) {
+    printf(stdout, "objfs_stress: mkdir objfs_stress_dir failed\n");
+    exit(1);
+  }
+  if (mount(0, "objfs_stress_dir", "objfs") != 0) {
+    printf(stdout, "objfs_stress: failed to mount objfs\n");
+    exit(1);
+  }
+  if (chdir("objfs_stress_dir") < 0) {
+    printf(stdout, "objfs_stress: chdir objfs_stress_dir failed\n");
+    exit(1);
+  }
+
+  create_files();
+  set_fs_cache_state(0);
+  for (int readers = 1; readers <= MAX_READERS; readers *= 2) {
+    run_readers(readers);
+  }
+  set_objfs_latency(1);
+  printf(stdout, "objfs_stress: with a latency of 1 tick\n");
+  for (int readers = 1; readers <= MAX_READERS; readers *= 2) {
+    run_readers(readers);
+  }
+  set_objfs_latency(0);
+  set_fs_cache_state(1);
+  write_in_chunks();
+  read_in_chunks();
+  scrub_objfs();
+
+  if (chdir("..") < 0 || umount("objfs_stress_dir") < 0 ||
+      unlink("objfs_stress_dir") < 0) {
+    printf(stdout, "objfs_stress: cleanup failed\n");
+    exit(1);
+  }
+  printf(stdout, "objfs_stress passed successfully\n");
+  exit(0);
+}
@@ -0,0 +1,84 @@
+// Benchmark sequential reads of a large file from the disk.
+// The buffer cache is disabled, so that every read goes to the disk. The
+// file is read a block per read call, and then in large read calls, whose
+// blocks the file system reads from the disk in batches.
+
+#include "fcntl.h"
+#include "fsdefs.h"
+#include "param.h"
+#include "stat.h"
+#include "types.h"
+#include "user/lib/user.h"
+
+#define FILE_NAME "seqread"
+#define FILE_BLOCKS 256
+#define READ_ROUNDS 4
+#define LARGE_READ (64 * 1024)
+
+static char buf[LARGE_READ];
+
+static void fail(const char* message) {
+  printf(stdout, "seqread_bench: %s\n", message);
+  exit(1);
+}
+
+static void write_cache_control(const char* text) {
+  int fd = open("/proc/cache", O_WRONLY);
+  if (fd < 0) fail("failed to open /proc/cache");
+  if (write(fd, text, strlen(text)) < 0) fail("failed to write /proc/cache");
+  close(fd);
+}
+
+static void create_file(void) {
+  int fd = open(FILE_NAME, O_CREATE | O_RDWR);
+  if (fd < 0) fail("failed to create the file");
+  for (int i = 0; i < FILE_BLOCKS; i++) {
+    memset(buf, i, BSIZE);
+    if (write(fd, buf, BSIZE) != BSIZE) fail("failed to write the file");
+  }
+  close(fd);
+}
+
+// Reads the file in reads of `size` bytes, and checks its content.
+static void read_file(int size) {
+  int fd = open(FILE_NAME, O_RDONLY);
+  if (fd < 0) fail("failed to open the file");
+  for (int off = 0; off < FILE_BLOCKS * BSIZE; off += size) {
+    if (read(fd, buf, size) != size) fail("failed to read the file");
+    for (int i = 0; i < size; i += BSIZE) {
+      if (buf[i] != (char)((off + i) / BSIZE) ||
+          buf[i + BSIZE - 1] != (char)((off + i) / BSIZE))
+        fail("wrong file content");
+    }
+  }
+  close(fd);
+}
+
+// Reads the file READ_ROUNDS times in reads of `size` bytes, and prints the
+// throughput.
+static void run_reads(int size) {
+  int start = uptime();
+  for (int round = 0; round < READ_ROUNDS; round++) {
+    read_file(size);
+  }
+  int ticks = uptime() - start;
+  if (ticks == 0) ticks = 1;
+
+  int kbytes = READ_ROUNDS * FILE_BLOCKS * (BSIZE / 1024);
+  printf(stdout, "seqread_bench: %d KB reads, %d ticks, %d KB per tick\n",
+         size / 1024, ticks, kbytes / ticks);
+}
+
+int main(void) {
+  printf(stdout, "seqread_bench starting\n");
+
+  create_file();
+  write_cache_control("0\n");
+  run_reads(BSIZE);
+  run_reads(LARGE_READ);
+  write_cache_control("1\n");
+  if (unlink(FILE_NAME) < 0) fail("failed to remove the file");
+
+  printf(stdout, "seqread_bench passed successfully\n");
+  exit(0);
+}
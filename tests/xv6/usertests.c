@@ -31,6 +31,11 @@ char *echoargv[] = {"/echo", "ALL", "TESTS", "PASSED", 0};
 // See reasoning in BIGDIR_ITERATIONS.
 #define MANY_FILES_AMOUNT 50
 
+// For the big files test - the amount of 512 byte writes, which was MAXFILE
+// before the double and triple indirect blocks. The test runs on the obj fs
+// as well, which is too small for a file of MAXFILE blocks.
+#define BIGFILE_WRITES 268
+
 // does chdir() call iput(p->cwd) in a transaction?
 void iputtest(const char *fs_type) {
   printf(stdout, "%s iput test\n", fs_type);
@@ -230,7 +235,7 @@ void writetest1(const char *fs_type) {
     exit(1);
   }
 
-  for (i = 0; i < MAXFILE; i++) {
+  for (i = 0; i < BIGFILE_WRITES; i++) {
     ((int *)buf)[0] = i;
     if (write(fd, buf, 512) != 512) {
       printf(stdout, "error: write big file failed\n", i);
@@ -250,7 +255,7 @@ void writetest1(const char *fs_type) {
   for (;;) {
     i = read(fd, buf, 512);
     if (i == 0) {
-      if (n != MAXFILE) {
+      if (n != BIGFILE_WRITES) {
         printf(stdout, "read only %d blocks from big", n);
         exit(0);
       }
@@ -273,6 +278,62 @@ void writetest1(const char *fs_type) {
   printf(stdout, "%s big files test ok\n", fs_type);
 }
 
+// Writes chunks that are not aligned to the block size, then rewrites a range
+// in the middle of the file and checks the whole content.
+void unalignedwrites(const char *fs_type) {
+  int i, fd;
+  const int chunk = 300, chunks = 20;
+  const int rewrite_off = 1000, rewrite_len = 700;
+
+  printf(stdout, "%s unaligned writes test\n", fs_type);
+
+  fd = open("unaligned", O_CREATE | O_RDWR);
+  if (fd < 0) {
+    printf(stdout, "error: creat unaligned failed!\n");
+    exit(1);
+  }
+  for (i = 0; i < chunks; i++) {
+    memset(buf, 'a' + i, chunk);
+    if (write(fd, buf, chunk) != chunk) {
+      printf(stdout, "error: write unaligned chunk %d failed\n", i);
+      exit(1);
+    }
+  }
+  close(fd);
+
+  fd = open("unaligned", O_RDWR);
+  if (fd < 0 || read(fd, buf, rewrite_off) != rewrite_off) {
+    printf(stdout, "error: read unaligned failed!\n");
+    exit(1);
+  }
+  memset(buf, 'z', rewrite_len);
+  if (write(fd, buf, rewrite_len) != rewrite_len) {
+    printf(stdout, "error: rewrite unaligned failed\n");
+    exit(1);
+  }
+  close(fd);
+
+  fd = open("unaligned", O_RDONLY);
+  if (fd < 0 || read(fd, buf, sizeof(buf)) != chunk * chunks) {
+    printf(stdout, "error: read back unaligned failed!\n");
+    exit(1);
+  }
+  for (i = 0; i < chunk * chunks; i++) {
+    char expected = 'a' + i / chunk;
+    if (i >= rewrite_off && i < rewrite_off + rewrite_len) expected = 'z';
+    if (buf[i] != expected) {
+      printf(stdout, "unaligned content at %d is %d\n", i, buf[i]);
+      exit(1);
+    }
+  }
+  close(fd);
+  if (unlink("unaligned") < 0) {
+    printf(stdout, "unlink unaligned failed\n");
+    exit(1);
+  }
+  printf(stdout, "%s unaligned writes test ok\n", fs_type);
+}
+
 void createtest(const char *fs_type) {
   int i, fd;
 
@@ -1879,6 +1940,7 @@ void all_fs_tests(const char *fs_type) {
   openexclusivetest(fs_type);
   writetest(fs_type);
   writetest1(fs_type);
+  unalignedwrites(fs_type);
   createtest(fs_type);
   openiputtest(fs_type);
   exitiputtest(fs_type);
@@ -6,6 +6,8 @@ int main(int argc, const char* const argv[]) {
       "mount [-t [fstype]] [path]\n"
       "mount [path] [-t [fstype]]\n"
       "mount -t bind path target_path\n"
+      "mount -t objfs image path\n"
+      "mount -t objclone image path\n"
       "mount internal_fs_{a|b|c} path\n";
   const char* fstype = 0;
   const char* path = 0;
@@ -43,6 +45,13 @@ int main(int argc, const char* const argv[]) {
     }
   }
 
+  // The objfs store is kept in the image, instead of the memory. A clone
+  // shares the image's objects, and keeps its own writes in the memory.
+  if (bind && fstype &&
+      (!strcmp(fstype, "objfs") || !strcmp(fstype, "objclone"))) {
+    exit(mount(path, bind, fstype));
+  }
+
   if (bind && (!fstype || strcmp(fstype, "bind"))) {
     printf(stderr, usage);
     exit(1);
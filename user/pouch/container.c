@@ -378,7 +378,10 @@ static pouch_status pouch_container_mount(
         ret = MOUNT_IMAGE_ROOT_FS_FAILED_ERROR_CODE;
         goto error;
       }
-      if (mount(image_path, dest, 0)) {
+      // An objfs image is mounted as a writable clone, in constant time, and
+      // the container's writes don't reach the image.
+      const char* fstype = pouch_image_is_objfs(image_path) ? "objclone" : 0;
+      if (mount(image_path, dest, fstype)) {
         unlink(dest);
         printf(stderr, "Pouch: failed to mount image root fs\n");
         ret = MOUNT_IMAGE_ROOT_FS_FAILED_ERROR_CODE;
@@ -88,6 +88,20 @@ end:
   return status;
 }
 
+bool pouch_image_is_objfs(const char* const image_path) {
+  struct objsuperblock sb;
+  int fd;
+  bool is_objfs;
+
+  if ((fd = open(image_path, O_RDONLY)) < 0) {
+    return false;
+  }
+  is_objfs =
+      read(fd, &sb, sizeof(sb)) == sizeof(sb) && sb.magic == OBJ_FS_MAGIC;
+  close(fd);
+  return is_objfs;
+}
+
 pouch_status pouch_image_copy(const char* const source_image_name,
                               const char* const target_image_name) {
   char source_image_path[MAX_PATH_LENGTH], target_image_path[MAX_PATH_LENGTH];
@@ -27,6 +27,14 @@ pouch_status pouch_image_exists(const char* const image_name);
  */
 pouch_status pouch_image_get_path(const char* image_name, char* image_path);
 
+/*
+ *   Check if the image at image_path holds an objfs store, which containers
+ *   mount as a clone instead of copying
+ *   @input: image_path
+ *   @output: none
+ */
+bool pouch_image_is_objfs(const char* const image_path);
+
 /*
  *   Copy image from source to target
  *   @input: source_image_name, target_image_name